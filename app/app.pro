@@ -0,0 +1,16 @@
+# app.pro
+QT += core gui widgets charts
+
+TARGET = inventory_management
+TEMPLATE = app
+
+CONFIG += c++17
+
+include(../core/core.pri)
+
+SOURCES += ../src/main.cpp \
+    ../src/main_window.cpp \
+    ../src/category_chart_dialog.cpp
+
+HEADERS += ../includes/main_window.h \
+    ../includes/category_chart_dialog.h
@@ -0,0 +1,10 @@
+# benchmarks.pro
+TEMPLATE = subdirs
+
+# concurrent_benchmark: lock-striped store against a single global lock
+# operations_benchmark: every InventoryManager operation at several sizes, as JSON
+# generate_dataset:     seeded synthetic inventory CSV for benchmarks and load tests
+# schema_benchmark:     ProductSchema's generated field routines against hand-written ones
+# ledger_benchmark:     stock movement log memory, and indexed queries against replay
+SUBDIRS += concurrent_benchmark.pro operations_benchmark.pro generate_dataset.pro schema_benchmark.pro \
+    ledger_benchmark.pro
@@ -0,0 +1,101 @@
+#include "includes/concurrent_inventory.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+
+namespace
+{
+    const int PRODUCT_COUNT = 100000;
+    const int HOT_PRODUCT_COUNT = 16;
+    const int OPERATIONS_PER_THREAD = 200000;
+
+    /**
+     * @brief Reference store that serializes every write behind one mutex
+     */
+    class GlobalLockInventory
+    {
+    public:
+        explicit GlobalLockInventory(const InventoryManager &manager) : manager(manager) {}
+
+        void adjust_quantity(int id, int delta)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Product product = manager.get_product_by_id(id);
+            product.set_quantity(product.get_quantity() + delta);
+            manager.update_product(id, product);
+        }
+
+    private:
+        std::mutex mutex;
+        InventoryManager manager;
+    };
+
+    /**
+     * @brief Run an operation on several threads and report throughput
+     * @param label Name of the workload
+     * @param threads Number of worker threads
+     * @param operation Called with a thread-local generator for each operation
+     */
+    void run(const std::string &label, unsigned threads, const std::function<void(std::mt19937 &)> &operation)
+    {
+        std::atomic<bool> start(false);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&start, &operation, t]()
+                                 {
+                                     std::mt19937 random(t + 1);
+                                     while (!start.load())
+                                     {
+                                         std::this_thread::yield();
+                                     }
+                                     for (int i = 0; i < OPERATIONS_PER_THREAD; i++)
+                                     {
+                                         operation(random);
+                                     }
+                                 });
+        }
+
+        auto began = std::chrono::steady_clock::now();
+        start.store(true);
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+
+        double operations = double(threads) * OPERATIONS_PER_THREAD;
+        std::cout << label << "\t" << threads << " threads\t" << static_cast<long long>(operations / seconds)
+                  << " ops/s\n";
+    }
+}
+
+int main()
+{
+    InventoryManager manager;
+    for (int i = 0; i < PRODUCT_COUNT; i++)
+    {
+        manager.add_product(Product(0, "Product " + std::to_string(i), "Category " + std::to_string(i % 20),
+                                    999, 1000000));
+    }
+
+    unsigned max_threads = std::max(2u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+    {
+        GlobalLockInventory global(manager);
+        run("global lock, uniform", threads, [&global](std::mt19937 &random)
+            { global.adjust_quantity(1 + random() % PRODUCT_COUNT, 1); });
+
+        ConcurrentInventory striped(manager);
+        run("striped, uniform", threads, [&striped](std::mt19937 &random)
+            { striped.adjust_quantity(1 + random() % PRODUCT_COUNT, 1); });
+        run("striped, hot spot", threads, [&striped](std::mt19937 &random)
+            { striped.adjust_quantity(1 + random() % HOT_PRODUCT_COUNT, 1); });
+        run("striped, move", threads, [&striped](std::mt19937 &random)
+            { striped.move_quantity(1 + random() % PRODUCT_COUNT, 1 + random() % PRODUCT_COUNT, 1); });
+    }
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+# concurrent_benchmark.pro
+QT -= core gui
+
+TARGET = concurrent_benchmark
+TEMPLATE = app
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+include(../core/core.pri)
+
+SOURCES += concurrent_benchmark.cpp
@@ -0,0 +1,109 @@
+#include "includes/dataset_generator.h"
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    const char *const USAGE =
+        "Usage: generate_dataset COUNT [--movements N | --locations N] [--seed S]\n"
+        "                        [--output PATH]\n"
+        "\n"
+        "Writes COUNT synthetic products as inventory CSV, or with --movements,\n"
+        "N stock movements of products 1 to COUNT as movement CSV, or with\n"
+        "--locations, the stock of products 1 to COUNT across N warehouses. The\n"
+        "same seed always produces the same file. Defaults: --seed 42 --output -\n";
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = 0;
+    size_t movements = 0;
+    size_t locations = 0;
+    uint64_t seed = 42;
+    std::string output = "-";
+
+    try
+    {
+        bool have_count = false;
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--seed" && i + 1 < argc)
+            {
+                seed = std::stoull(argv[++i]);
+            }
+            else if (arg == "--movements" && i + 1 < argc)
+            {
+                movements = std::stoull(argv[++i]);
+            }
+            else if (arg == "--locations" && i + 1 < argc)
+            {
+                locations = std::stoull(argv[++i]);
+            }
+            else if (arg == "--output" && i + 1 < argc)
+            {
+                output = argv[++i];
+            }
+            else if (!have_count && arg.compare(0, 1, "-") != 0)
+            {
+                count = std::stoull(arg);
+                have_count = true;
+            }
+            else
+            {
+                throw std::invalid_argument(arg);
+            }
+        }
+        if (!have_count)
+        {
+            throw std::invalid_argument("missing COUNT");
+        }
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << USAGE;
+        return 2;
+    }
+
+    if ((movements > 0 || locations > 0) && (count == 0 || count > static_cast<size_t>(INT32_MAX) ||
+                                             (movements > 0 && locations > 0)))
+    {
+        std::cerr << USAGE;
+        return 2;
+    }
+
+    DatasetGenerator generator(seed);
+    auto write = [&generator, count, movements, locations](std::ostream &out)
+    {
+        if (movements > 0)
+        {
+            generator.write_movements_csv(out, static_cast<int>(count), movements);
+        }
+        else if (locations > 0)
+        {
+            generator.write_location_stock_csv(out, static_cast<int>(count), locations);
+        }
+        else
+        {
+            generator.write_csv(out, count);
+        }
+    };
+
+    if (output == "-")
+    {
+        std::ios::sync_with_stdio(false);
+        write(std::cout);
+        return std::cout.flush() ? 0 : 1;
+    }
+
+    std::ofstream file(output);
+    if (!file.is_open())
+    {
+        std::cerr << "generate_dataset: cannot open " << output << "\n";
+        return 1;
+    }
+    write(file);
+    file.close();
+    return file.fail() ? 1 : 0;
+}
@@ -0,0 +1,12 @@
+# generate_dataset.pro
+QT -= core gui
+
+TARGET = generate_dataset
+TEMPLATE = app
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+include(../core/core.pri)
+
+SOURCES += generate_dataset.cpp
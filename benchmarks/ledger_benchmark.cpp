@@ -0,0 +1,169 @@
+#include "includes/stock_ledger.h"
+#include "includes/dataset_generator.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+    const char *const USAGE =
+        "Usage: ledger_benchmark [MOVEMENTS] [--products N] [--seed S]\n"
+        "\n"
+        "Records MOVEMENTS generated stock movements (default 10000000) over N\n"
+        "products (default 10000), then reports the bytes held per movement and\n"
+        "the time of level and window queries against replaying the history.\n";
+
+    const int QUERIES = 20000;
+
+    // Movements are generated in chunks outside the timed part
+    const size_t CHUNK = 1 << 20;
+
+    double elapsed_ns(std::chrono::steady_clock::time_point began)
+    {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - began).count();
+    }
+
+    void report(const std::string &operation, double ns)
+    {
+        std::cout << std::left << std::setw(24) << operation << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << ns << "\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = 10000000;
+    int products = 10000;
+    uint64_t seed = 42;
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--products" && i + 1 < argc)
+            {
+                products = std::stoi(argv[++i]);
+            }
+            else if (arg == "--seed" && i + 1 < argc)
+            {
+                seed = std::stoull(argv[++i]);
+            }
+            else if (arg[0] != '-')
+            {
+                count = std::stoull(arg);
+            }
+            else
+            {
+                throw std::invalid_argument(arg);
+            }
+        }
+        if (products <= 0)
+        {
+            throw std::invalid_argument("--products");
+        }
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << USAGE;
+        return 2;
+    }
+
+    DatasetGenerator generator(seed);
+    StockLedger ledger;
+    int64_t first = 1704067200; // Where DatasetGenerator's movements start
+    int64_t timestamp = first;
+
+    std::vector<StockMovement> chunk;
+    double record_ns = 0.0;
+    for (size_t done = 0; done < count; done += chunk.size())
+    {
+        chunk.clear();
+        for (size_t i = done; i < count && chunk.size() < CHUNK; i++)
+        {
+            chunk.push_back(generator.next_movement(products, timestamp));
+        }
+
+        auto began = std::chrono::steady_clock::now();
+        for (const auto &movement : chunk)
+        {
+            ledger.record(movement.product_id, movement.timestamp, movement.delta, movement.reason);
+        }
+        record_ns += elapsed_ns(began);
+    }
+    record_ns /= count;
+    int64_t last = timestamp;
+
+    // Columns and block index grow with the movements; the product table and buckets do not
+    size_t total_bytes = 0, growing_bytes = 0, fixed_bytes = 0;
+    std::cout << std::left << std::setw(24) << "memory" << std::right << std::setw(14) << "bytes" << std::setw(14)
+              << "per movement\n";
+    for (const auto &component : ledger.get_memory_usage())
+    {
+        total_bytes += component.bytes;
+        (component.name == "movement columns" || component.name == "block index" ? growing_bytes : fixed_bytes) +=
+            component.bytes;
+        std::cout << std::left << std::setw(24) << component.name << std::right << std::setw(14) << component.bytes
+                  << std::setw(13) << std::fixed << std::setprecision(2) << double(component.bytes) / count << "\n";
+    }
+    std::cout << std::left << std::setw(24) << "total" << std::right << std::setw(14) << total_bytes << std::setw(13)
+              << double(total_bytes) / count << "\n"
+              << "projected for 100M movements over the same products: " << std::setprecision(0)
+              << (double(growing_bytes) / count * 1e8 + fixed_bytes) / (1 << 20) << " MiB\n\n";
+
+    // The same random products and times for every query kind; low IDs have the longest histories
+    std::vector<std::pair<int, int64_t>> queries;
+    for (int q = 0; q < QUERIES; q++)
+    {
+        int64_t ignored = 0;
+        int id = generator.next_movement(products, ignored).product_id;
+        int64_t at = first + static_cast<int64_t>((last - first) * ((q * 7919) % QUERIES) / double(QUERIES));
+        queries.push_back({id, at});
+    }
+    int64_t checksum = 0;
+
+    std::cout << std::left << std::setw(24) << "ns/operation" << std::right << std::setw(14) << "time\n";
+    report("record", record_ns);
+
+    auto began = std::chrono::steady_clock::now();
+    for (const auto &query : queries)
+    {
+        checksum += ledger.level_at(query.first, query.second);
+    }
+    double indexed_ns = elapsed_ns(began) / QUERIES;
+
+    began = std::chrono::steady_clock::now();
+    for (const auto &query : queries)
+    {
+        for (const auto &movement : ledger.get_movements(query.first, 0, query.second + 1))
+        {
+            checksum -= movement.delta;
+        }
+    }
+    double replay_ns = elapsed_ns(began) / QUERIES;
+    report("level_at", indexed_ns);
+    report("level_at by replay", replay_ns);
+    if (checksum != 0)
+    {
+        std::cerr << "ledger_benchmark: indexed levels differ from replayed history\n";
+        return 1;
+    }
+
+    const int64_t WEEK = 7 * 86400;
+    began = std::chrono::steady_clock::now();
+    for (const auto &query : queries)
+    {
+        checksum += ledger.window(query.first, query.second, query.second + WEEK).get_units(MovementReason::RECEIVED);
+    }
+    report("window (one week)", elapsed_ns(began) / QUERIES);
+
+    began = std::chrono::steady_clock::now();
+    for (const auto &query : queries)
+    {
+        int64_t day = query.second / 86400 * 86400;
+        checksum += ledger.window_all(day, day + WEEK).get_units(MovementReason::RECEIVED);
+    }
+    report("window_all (one week)", elapsed_ns(began) / QUERIES);
+
+    std::cerr << "checksum " << checksum << "\n";
+    return 0;
+}
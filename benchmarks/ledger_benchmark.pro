@@ -0,0 +1,12 @@
+# ledger_benchmark.pro
+QT -= core gui
+
+TARGET = ledger_benchmark
+TEMPLATE = app
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+include(../core/core.pri)
+
+SOURCES += ledger_benchmark.cpp
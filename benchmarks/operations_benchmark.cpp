@@ -0,0 +1,493 @@
+#include "includes/inventory_manager.h"
+#include "includes/dataset_generator.h"
+#include "includes/memory_accounting.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+
+namespace
+{
+    const char *const USAGE =
+        "Usage: operations_benchmark [--sizes N,N,...] [--seed S] [--min-time SECONDS]\n"
+        "                            [--output PATH] [--baseline PATH] [--tolerance FRACTION]\n"
+        "\n"
+        "Times every InventoryManager operation on generated inventories of each size\n"
+        "and writes the results as JSON. With --baseline, compares against an earlier\n"
+        "run and exits with status 1 if any operation got slower than the tolerance\n"
+        "(default 0.10). Defaults: --sizes 1000,100000,1000000,10000000 --seed 42\n"
+        "--min-time 0.5 --output -\n";
+
+    struct Options
+    {
+        std::vector<size_t> sizes = {1000, 100000, 1000000, 10000000};
+        uint64_t seed = 42;
+        double min_time = 0.5;
+        std::string output = "-";
+        std::string baseline;
+        double tolerance = 0.10;
+    };
+
+    struct Result
+    {
+        std::string operation;
+        size_t size;
+        uint64_t iterations;
+        double ns_per_op;
+        double allocations_per_op;
+    };
+
+    Options parse_options(int argc, char *argv[])
+    {
+        Options options;
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "-h" || arg == "--help")
+            {
+                throw std::invalid_argument("");
+            }
+            if (i + 1 >= argc)
+            {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+
+            std::string value = argv[++i];
+            if (arg == "--sizes")
+            {
+                options.sizes.clear();
+                std::stringstream list(value);
+                std::string size;
+                while (std::getline(list, size, ','))
+                {
+                    options.sizes.push_back(std::stoull(size));
+                }
+            }
+            else if (arg == "--seed")
+            {
+                options.seed = std::stoull(value);
+            }
+            else if (arg == "--min-time")
+            {
+                options.min_time = std::stod(value);
+            }
+            else if (arg == "--output")
+            {
+                options.output = value;
+            }
+            else if (arg == "--baseline")
+            {
+                options.baseline = value;
+            }
+            else if (arg == "--tolerance")
+            {
+                options.tolerance = std::stod(value);
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown option " + arg);
+            }
+        }
+        return options;
+    }
+
+    /**
+     * @brief Time an operation, repeating it until min_time has passed
+     *
+     * Iterations run in doubling batches so the clock is read rarely for fast
+     * operations. Allocations are read from the counting operator new.
+     *
+     * @param operation Name reported in the results
+     * @param size Inventory size the operation ran against
+     * @param min_time Seconds to keep repeating for
+     * @param max_iterations Upper bound on iterations, for operations that consume state
+     * @param run_one Runs iteration i
+     * @return The measurement
+     */
+    template <typename Operation>
+    Result measure(const std::string &operation, size_t size, double min_time, uint64_t max_iterations,
+                   Operation run_one)
+    {
+        AllocationCounts allocations_before = AllocationTracker::get_thread_counts();
+        auto began = std::chrono::steady_clock::now();
+        double elapsed = 0.0;
+        uint64_t iterations = 0;
+        uint64_t batch = 1;
+
+        while (iterations < max_iterations && elapsed < min_time)
+        {
+            uint64_t batch_end = std::min(iterations + batch, max_iterations);
+            for (; iterations < batch_end; iterations++)
+            {
+                run_one(iterations);
+            }
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+            batch *= 2;
+        }
+
+        AllocationCounts allocations_after = AllocationTracker::get_thread_counts();
+        Result result = {operation, size, iterations, elapsed * 1e9 / iterations,
+                         double(allocations_after.allocations - allocations_before.allocations) / iterations};
+        std::cerr << std::left << std::setw(20) << operation << std::right << std::setw(10) << size
+                  << std::setw(12) << iterations << std::setw(18) << std::fixed << std::setprecision(1)
+                  << result.ns_per_op << " ns/op" << std::setw(12) << result.allocations_per_op << " allocs/op\n";
+        return result;
+    }
+
+    void run_size(size_t size, const Options &options, std::vector<Result> &results, uint64_t &checksum)
+    {
+        namespace fs = std::filesystem;
+        const std::string csv_path = (fs::temp_directory_path() / ("inventory_benchmark_" + std::to_string(size) +
+                                                                   ".csv"))
+                                         .string();
+        const std::string saved_path = csv_path + ".saved";
+
+        DatasetGenerator generator(options.seed);
+        {
+            std::ofstream file(csv_path);
+            generator.write_csv(file, size);
+        }
+
+        std::mt19937_64 random(options.seed);
+        const double min_time = options.min_time;
+        const int id_count = static_cast<int>(size);
+        InventoryManager manager;
+        // Repeated searches would be answered by the query cache; only the *_cached entries use it
+        manager.set_query_cache_limit(0);
+
+        results.push_back(measure("load_from_file", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  { manager.load_from_file(csv_path); }));
+        results.push_back(measure("save_to_file", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  { manager.save_to_file(saved_path); }));
+
+        results.push_back(measure("lookup", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  { checksum += manager.get_product_by_id(1 + random() % id_count).get_quantity(); }));
+
+        // Hits and misses through the throwing and the non-throwing API; negative IDs always miss
+        Product found;
+        results.push_back(measure("lookup_miss", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  {
+                                      try
+                                      {
+                                          checksum += manager.get_product_by_id(-1 - static_cast<int>(random() % id_count)).get_quantity();
+                                      }
+                                      catch (const ProductNotFoundException &)
+                                      {
+                                          checksum++;
+                                      }
+                                  }));
+        results.push_back(measure("try_lookup", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  {
+                                      if (manager.try_get_product_by_id(1 + static_cast<int>(random() % id_count), found))
+                                      {
+                                          checksum += found.get_quantity();
+                                      }
+                                  }));
+        results.push_back(measure("try_lookup_miss", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  { checksum += manager.try_get_product_by_id(-1 - static_cast<int>(random() % id_count), found); }));
+
+        std::vector<std::string> skus;
+        for (const auto &product : manager.get_all_products())
+        {
+            skus.push_back(product.get_sku());
+        }
+        results.push_back(measure("find_by_sku", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  { checksum += manager.get_product_by_sku(skus[random() % skus.size()]).get_quantity(); }));
+
+        std::vector<std::string> words, categories;
+        for (int i = 0; i < 16; i++)
+        {
+            words.push_back(generator.next_name_word());
+            categories.push_back(generator.next_category());
+        }
+        results.push_back(measure("find_by_name", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  { checksum += manager.find_products_by_name(words[i % words.size()]).size(); }));
+        results.push_back(measure("find_by_category", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  { checksum += manager.find_products_by_category(categories[i % categories.size()]).size(); }));
+        results.push_back(measure("low_stock", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  { checksum += manager.get_low_stock_products(5 + i % 10).size(); }));
+
+        // The same searches answered from the query cache, and a cached search after a change,
+        // which re-tests only the changed product
+        manager.set_query_cache_limit(QueryCache::DEFAULT_MAX_BYTES);
+        results.push_back(measure("find_by_category_cached", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  { checksum += manager.find_products_by_category(categories[i % categories.size()]).size(); }));
+        results.push_back(measure("low_stock_cached", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  { checksum += manager.get_low_stock_products(5 + i % 10).size(); }));
+        results.push_back(measure("low_stock_after_update_cached", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  {
+                                      int id = 1 + static_cast<int>(random() % id_count);
+                                      Product product = manager.get_product_by_id(id);
+                                      product.set_quantity(static_cast<int>(i % 20));
+                                      manager.update_product(id, product);
+                                      checksum += manager.get_low_stock_products(10).size();
+                                  }));
+        manager.set_query_cache_limit(0);
+
+        results.push_back(measure("total_value", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  { checksum += static_cast<uint64_t>(manager.get_total_inventory_value()); }));
+        results.push_back(measure("total_value_async", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  { checksum += static_cast<uint64_t>(manager.get_total_inventory_value_async().get()); }));
+        results.push_back(measure("product_count", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  { checksum += manager.get_total_product_count(); }));
+
+        results.push_back(measure("update", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  {
+                                      int id = 1 + static_cast<int>(random() % id_count);
+                                      Product product = manager.get_product_by_id(id);
+                                      product.set_quantity(static_cast<int>(i % 500));
+                                      manager.update_product(id, product);
+                                  }));
+        results.push_back(measure("try_update", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  {
+                                      int id = 1 + static_cast<int>(random() % id_count);
+                                      if (manager.try_get_product_by_id(id, found))
+                                      {
+                                          found.set_quantity(static_cast<int>(i % 500));
+                                          checksum += manager.try_update_product(id, found) == InventoryStatus::OK;
+                                      }
+                                  }));
+        results.push_back(measure("update_miss", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  {
+                                      try
+                                      {
+                                          manager.update_product(-1 - static_cast<int>(random() % id_count), found);
+                                      }
+                                      catch (const ProductNotFoundException &)
+                                      {
+                                          checksum++;
+                                      }
+                                  }));
+        results.push_back(measure("try_update_miss", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  {
+                                      int id = -1 - static_cast<int>(random() % id_count);
+                                      checksum += manager.try_update_product(id, found) == InventoryStatus::NOT_FOUND;
+                                  }));
+
+        // Generated past the loaded IDs, so their SKUs are not taken
+        std::vector<Product> additions;
+        for (size_t i = 0; i < std::min<size_t>(size, 100000); i++)
+        {
+            additions.push_back(generator.next_product(id_count + 1 + static_cast<int>(i)));
+        }
+        results.push_back(measure("add", size, min_time, additions.size(), [&](uint64_t i)
+                                  { checksum += manager.add_product(additions[i]); }));
+
+        // Remove generated products in random order so every removal hits an existing ID
+        std::vector<int> removals(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            removals[i] = static_cast<int>(i + 1);
+        }
+        std::shuffle(removals.begin(), removals.end(), random);
+        results.push_back(measure("remove", size, min_time, size / 2, [&](uint64_t i)
+                                  { manager.remove_product(removals[i]); }));
+        results.push_back(measure("remove_miss", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  {
+                                      try
+                                      {
+                                          manager.remove_product(-1 - static_cast<int>(random() % id_count));
+                                      }
+                                      catch (const ProductNotFoundException &)
+                                      {
+                                          checksum++;
+                                      }
+                                  }));
+        results.push_back(measure("try_remove_miss", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  {
+                                      int id = -1 - static_cast<int>(random() % id_count);
+                                      checksum += manager.try_remove_product(id) == InventoryStatus::NOT_FOUND;
+                                  }));
+
+        // Stock split over a dozen warehouses, for the products that are left
+        const std::string stock_path = csv_path + ".locations";
+        {
+            std::ofstream file(stock_path);
+            generator.write_location_stock_csv(file, id_count, 12);
+        }
+        results.push_back(measure("load_location_stock", size, min_time, UINT64_MAX, [&](uint64_t)
+                                  { checksum += manager.load_location_stock(stock_path).applied; }));
+
+        const int location_count = static_cast<int>(manager.get_locations().size());
+        results.push_back(measure("low_stock_at_location", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  { checksum += manager.get_low_stock_products(5 + i % 10, i % location_count).size(); }));
+        results.push_back(measure("low_stock_any_location", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  {
+                                      checksum += manager.get_low_stock_products(5 + i % 10, LocationStock::ANY_LOCATION)
+                                                      .size();
+                                  }));
+        results.push_back(measure("location_value", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  { checksum += static_cast<uint64_t>(manager.get_total_inventory_value(i % location_count)); }));
+
+        std::vector<int> stocked_ids;
+        for (const auto &product : manager.get_all_products())
+        {
+            stocked_ids.push_back(product.get_id());
+        }
+        results.push_back(measure("set_location_quantity", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  {
+                                      int id = stocked_ids[random() % stocked_ids.size()];
+                                      manager.set_location_quantity(id, i % location_count, static_cast<int>(i % 200));
+                                  }));
+        results.push_back(measure("move_stock", size, min_time, UINT64_MAX, [&](uint64_t i)
+                                  {
+                                      int id = stocked_ids[random() % stocked_ids.size()];
+                                      int from = static_cast<int>(i % location_count);
+                                      int units = std::min(manager.get_location_quantity(id, from), 3);
+                                      manager.move_stock(id, from, (from + 1) % location_count, std::max(units, 0));
+                                  }));
+
+        std::remove(csv_path.c_str());
+        std::remove(saved_path.c_str());
+        std::remove(stock_path.c_str());
+    }
+
+    void write_json(std::ostream &out, const Options &options, const std::vector<Result> &results)
+    {
+        out << "{\n  \"seed\": " << options.seed << ",\n  \"results\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result &result = results[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"operation\": \"" << result.operation
+                << "\", \"size\": " << result.size << ", \"iterations\": " << result.iterations
+                << ", \"ns_per_op\": " << std::fixed << std::setprecision(1) << result.ns_per_op
+                << ", \"allocations_per_op\": " << std::setprecision(2) << result.allocations_per_op << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    // Reads a number following "key": on a line of write_json() output
+    bool read_json_number(const std::string &line, const std::string &key, double &value)
+    {
+        size_t found = line.find("\"" + key + "\": ");
+        if (found == std::string::npos)
+        {
+            return false;
+        }
+        value = std::stod(line.substr(found + key.size() + 4));
+        return true;
+    }
+
+    /**
+     * @brief Load the ns_per_op of each operation and size from an earlier run
+     * @param path JSON written by write_json()
+     * @return ns_per_op keyed by (operation, size)
+     */
+    std::map<std::pair<std::string, size_t>, double> read_baseline(const std::string &path)
+    {
+        std::ifstream file(path);
+        if (!file.is_open())
+        {
+            throw FileOperationException("open", path);
+        }
+
+        std::map<std::pair<std::string, size_t>, double> baseline;
+        std::string line;
+        const std::string operation_key = "\"operation\": \"";
+        while (std::getline(file, line))
+        {
+            size_t found = line.find(operation_key);
+            double size = 0, ns_per_op = 0;
+            if (found == std::string::npos || !read_json_number(line, "size", size) ||
+                !read_json_number(line, "ns_per_op", ns_per_op))
+            {
+                continue;
+            }
+            size_t start = found + operation_key.size();
+            std::string operation = line.substr(start, line.find('"', start) - start);
+            baseline[{operation, static_cast<size_t>(size)}] = ns_per_op;
+        }
+        return baseline;
+    }
+
+    /**
+     * @brief Print how each result compares with the baseline
+     * @return The number of operations slower than the tolerance allows
+     */
+    int compare_with_baseline(const std::vector<Result> &results, const Options &options)
+    {
+        auto baseline = read_baseline(options.baseline);
+        int regressions = 0;
+
+        std::cerr << "\nCompared with " << options.baseline << ":\n"
+                  << std::left << std::setw(20) << "operation" << std::right << std::setw(10) << "size"
+                  << std::setw(16) << "baseline ns" << std::setw(16) << "current ns" << std::setw(10) << "change\n";
+        for (const auto &result : results)
+        {
+            auto found = baseline.find({result.operation, result.size});
+            if (found == baseline.end())
+            {
+                continue;
+            }
+
+            double change = result.ns_per_op / found->second - 1.0;
+            bool regressed = change > options.tolerance;
+            regressions += regressed;
+            std::cerr << std::left << std::setw(20) << result.operation << std::right << std::setw(10) << result.size
+                      << std::setw(16) << found->second << std::setw(16) << result.ns_per_op << std::showpos
+                      << std::setw(9) << change * 100.0 << "%" << std::noshowpos << (regressed ? "  REGRESSION" : "")
+                      << "\n";
+        }
+        return regressions;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    try
+    {
+        options = parse_options(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        if (*e.what())
+        {
+            std::cerr << "operations_benchmark: " << e.what() << "\n\n";
+        }
+        std::cerr << USAGE;
+        return 2;
+    }
+
+    try
+    {
+        std::vector<Result> results;
+        uint64_t checksum = 0;
+        for (size_t size : options.sizes)
+        {
+            run_size(size, options, results, checksum);
+        }
+        std::cerr << "checksum " << checksum << "\n";
+
+        if (options.output == "-")
+        {
+            write_json(std::cout, options, results);
+        }
+        else
+        {
+            std::ofstream file(options.output);
+            if (!file.is_open())
+            {
+                throw FileOperationException("open", options.output);
+            }
+            write_json(file, options, results);
+        }
+
+        if (!options.baseline.empty() && compare_with_baseline(results, options) > 0)
+        {
+            return 1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "operations_benchmark: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+# operations_benchmark.pro
+QT -= core gui
+
+TARGET = operations_benchmark
+TEMPLATE = app
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+include(../core/core.pri)
+
+SOURCES += operations_benchmark.cpp
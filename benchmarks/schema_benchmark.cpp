@@ -0,0 +1,263 @@
+#include "includes/product_schema.h"
+#include "includes/csv_codec.h"
+#include "includes/dataset_generator.h"
+#include "includes/inventory_protocol.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    const char *const USAGE =
+        "Usage: schema_benchmark [PRODUCTS] [--seed S]\n"
+        "\n"
+        "Times the per-field routines generated from ProductSchema against\n"
+        "hand-written equivalents of each, on PRODUCTS generated products\n"
+        "(default 200000).\n";
+
+    // The hand-written routines the schema replaced, kept here as the reference
+
+    void hand_write_csv_row(std::ostream &out, const Product &product)
+    {
+        out << product.get_id() << ","
+            << csv_quote(product.get_name()) << ","
+            << csv_quote(product.get_category()) << ","
+            << format_cents(product.get_price_cents()) << ","
+            << product.get_quantity() << ","
+            << csv_quote(product.get_description()) << ","
+            << csv_quote(product.get_sku()) << ","
+            << format_cents(product.get_total_value()) << "\n";
+    }
+
+    bool hand_parse_csv_fields(const std::vector<std::string> &fields, Product &product)
+    {
+        if (fields.size() < 7)
+        {
+            return false;
+        }
+
+        Cents price_cents = 0;
+        if (!parse_cents(fields[3], price_cents) || !is_valid_price(price_cents))
+        {
+            return false;
+        }
+
+        try
+        {
+            product = Product(std::stoi(fields[0]), fields[1], fields[2],
+                              price_cents, std::stoi(fields[4]), fields[5], fields[6]);
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+        return true;
+    }
+
+    void hand_put_wire(WireWriter &writer, const Product &product)
+    {
+        writer.put_i32(product.get_id());
+        writer.put_string(product.get_name());
+        writer.put_string(product.get_category());
+        writer.put_i64(product.get_price_cents());
+        writer.put_i32(product.get_quantity());
+        writer.put_string(product.get_description());
+        writer.put_string(product.get_sku());
+    }
+
+    Product hand_get_wire(WireReader &reader)
+    {
+        int id = reader.get_i32();
+        std::string name = reader.get_string();
+        std::string category = reader.get_string();
+        Cents price_cents = reader.get_i64();
+        int quantity = reader.get_i32();
+        std::string description = reader.get_string();
+        std::string sku = reader.get_string();
+        return Product(id, name, category, price_cents, quantity, description, sku);
+    }
+
+    bool hand_same_content(const Product &a, const Product &b)
+    {
+        return a.get_name() == b.get_name() && a.get_category() == b.get_category() &&
+               a.get_price_cents() == b.get_price_cents() && a.get_quantity() == b.get_quantity() &&
+               a.get_description() == b.get_description() && a.get_sku() == b.get_sku();
+    }
+
+    /**
+     * @brief Time a pass over all products
+     * @return Nanoseconds per product
+     */
+    template <typename Operation>
+    double measure(size_t count, Operation run)
+    {
+        // Best of three passes, to skip page faults and cold caches
+        double best = 0.0;
+        for (int pass = 0; pass < 3; pass++)
+        {
+            auto began = std::chrono::steady_clock::now();
+            run();
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - began).count();
+            best = pass == 0 ? ns : std::min(best, ns);
+        }
+        return best / count;
+    }
+
+    void report(const std::string &operation, double hand_written, double generated)
+    {
+        std::cout << std::left << std::setw(16) << operation << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << hand_written << std::setw(14) << generated << std::setw(10)
+                  << std::setprecision(2) << generated / hand_written << "x\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = 200000;
+    uint64_t seed = 42;
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--seed" && i + 1 < argc)
+            {
+                seed = std::stoull(argv[++i]);
+            }
+            else if (arg[0] != '-')
+            {
+                count = std::stoull(arg);
+            }
+            else
+            {
+                throw std::invalid_argument(arg);
+            }
+        }
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << USAGE;
+        return 2;
+    }
+
+    DatasetGenerator generator(seed);
+    std::vector<Product> products = generator.generate(count);
+    std::vector<Product> copies = products;
+    uint64_t checksum = 0;
+
+    std::cout << std::left << std::setw(16) << "ns/product" << std::right << std::setw(14) << "hand-written"
+              << std::setw(14) << "generated" << std::setw(11) << "ratio\n";
+
+    // CSV rows
+    std::string csv;
+    auto write_all = [&products, &csv](auto write_row)
+    {
+        std::ostringstream out;
+        for (const auto &product : products)
+        {
+            write_row(out, product);
+        }
+        csv = out.str();
+    };
+    double hand_written = measure(count, [&]
+                                  { write_all(hand_write_csv_row); });
+    std::string hand_csv = csv;
+    double generated = measure(count, [&]
+                               { write_all(ProductSchema::write_csv_row); });
+    report("csv_write", hand_written, generated);
+    if (csv != hand_csv)
+    {
+        std::cerr << "schema_benchmark: generated CSV differs from the hand-written output\n";
+        return 1;
+    }
+
+    std::vector<std::vector<std::string>> rows;
+    std::istringstream lines(csv);
+    for (std::string line; std::getline(lines, line);)
+    {
+        rows.push_back(split_csv_line(line));
+    }
+    auto parse_all = [&rows, &checksum](auto parse_fields)
+    {
+        Product product;
+        for (const auto &fields : rows)
+        {
+            checksum += parse_fields(fields, product) ? product.get_quantity() : 0;
+        }
+    };
+    hand_written = measure(count, [&]
+                           { parse_all(hand_parse_csv_fields); });
+    generated = measure(count, [&]
+                        { parse_all([](const std::vector<std::string> &fields, Product &product)
+                                  { return ProductSchema::parse_csv_fields(fields, product); }); });
+    report("csv_parse", hand_written, generated);
+
+    // Wire encoding
+    std::string wire;
+    auto encode_all = [&products, &wire](auto put_product)
+    {
+        wire.clear();
+        WireWriter writer(wire);
+        for (const auto &product : products)
+        {
+            put_product(writer, product);
+        }
+    };
+    hand_written = measure(count, [&]
+                           { encode_all(hand_put_wire); });
+    generated = measure(count, [&]
+                        { encode_all([](WireWriter &writer, const Product &product)
+                                     { ProductSchema::put_wire(writer, product); }); });
+    report("wire_encode", hand_written, generated);
+
+    hand_written = measure(count, [&]
+                           {
+                               WireReader reader(wire.data(), wire.size());
+                               for (size_t i = 0; i < count; i++)
+                               {
+                                   checksum += hand_get_wire(reader).get_quantity();
+                               }
+                           });
+    generated = measure(count, [&]
+                        {
+                            WireReader reader(wire.data(), wire.size());
+                            Product product;
+                            for (size_t i = 0; i < count; i++)
+                            {
+                                checksum += ProductSchema::get_wire(reader, product) ? product.get_quantity() : 0;
+                            }
+                        });
+    report("wire_decode", hand_written, generated);
+
+    // Comparators
+    auto compare_all = [&products, &copies, &checksum](auto same)
+    {
+        for (size_t i = 0; i < products.size(); i++)
+        {
+            checksum += same(products[i], copies[i]);
+        }
+    };
+    hand_written = measure(count, [&]
+                           { compare_all(hand_same_content); });
+    generated = measure(count, [&]
+                        { compare_all(ProductSchema::same_content); });
+    report("same_content", hand_written, generated);
+
+    hand_written = measure(count, [&]
+                           {
+                               copies = products;
+                               std::sort(copies.begin(), copies.end(), [](const Product &a, const Product &b)
+                                         { return a.get_price_cents() < b.get_price_cents(); });
+                           });
+    generated = measure(count, [&]
+                        {
+                            copies = products;
+                            std::sort(copies.begin(), copies.end(), ProductSchema::Less<ProductSchema::column_index("Price")>());
+                        });
+    report("sort_by_price", hand_written, generated);
+
+    std::cerr << "checksum " << checksum << "\n";
+    return 0;
+}
@@ -0,0 +1,12 @@
+# schema_benchmark.pro
+QT -= core gui
+
+TARGET = schema_benchmark
+TEMPLATE = app
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+include(../core/core.pri)
+
+SOURCES += schema_benchmark.cpp
@@ -0,0 +1,12 @@
+# cli.pro
+QT -= core gui
+
+TARGET = inventory_cli
+TEMPLATE = app
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+include(../core/core.pri)
+
+SOURCES += ../src/inventory_cli.cpp
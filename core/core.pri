@@ -0,0 +1,16 @@
+# core.pri - include from a project to link it against the core library
+INCLUDEPATH += $$PWD/..
+DEPENDPATH += $$PWD/..
+
+CORE_LIB_DIR = $$shadowed($$PWD)
+LIBS += -L$$CORE_LIB_DIR -linventory_core
+
+win32-msvc* {
+    PRE_TARGETDEPS += $$CORE_LIB_DIR/inventory_core.lib
+} else {
+    PRE_TARGETDEPS += $$CORE_LIB_DIR/libinventory_core.a
+}
+
+unix: LIBS += -lpthread
+
+no_tracing: DEFINES += INVENTORY_NO_TRACING
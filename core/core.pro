@@ -0,0 +1,70 @@
+# core.pro
+QT -= core gui
+
+TARGET = inventory_core
+TEMPLATE = lib
+
+CONFIG += c++17 staticlib
+CONFIG -= debug_and_release
+
+# qmake CONFIG+=no_tracing compiles every TRACE_SCOPE out
+no_tracing: DEFINES += INVENTORY_NO_TRACING
+
+INCLUDEPATH += ..
+
+SOURCES += ../src/product.cpp \
+    ../src/inventory_manager.cpp \
+    ../src/text_fold.cpp \
+    ../src/fuzzy_index.cpp \
+    ../src/csv_codec.cpp \
+    ../src/sharded_store.cpp \
+    ../src/columnar_format.cpp \
+    ../src/product_query.cpp \
+    ../src/inventory_diff.cpp \
+    ../src/persistent_product_map.cpp \
+    ../src/concurrent_inventory.cpp \
+    ../src/inventory_protocol.cpp \
+    ../src/trace.cpp \
+    ../src/memory_accounting.cpp \
+    ../src/dataset_generator.cpp \
+    ../src/money.cpp \
+    ../src/cold_text.cpp \
+    ../src/category_totals.cpp \
+    ../src/stock_ledger.cpp \
+    ../src/location_stock.cpp \
+    ../src/sku_index.cpp \
+    ../src/task_executor.cpp \
+    ../src/query_cache.cpp
+
+HEADERS += ../includes/product.h \
+    ../includes/inventory_manager.h \
+    ../includes/text_fold.h \
+    ../includes/fuzzy_index.h \
+    ../includes/csv_codec.h \
+    ../includes/sharded_store.h \
+    ../includes/columnar_format.h \
+    ../includes/product_query.h \
+    ../includes/inventory_diff.h \
+    ../includes/persistent_product_map.h \
+    ../includes/concurrent_inventory.h \
+    ../includes/inventory_protocol.h \
+    ../includes/trace.h \
+    ../includes/memory_accounting.h \
+    ../includes/dataset_generator.h \
+    ../includes/money.h \
+    ../includes/product_schema.h \
+    ../includes/cold_text.h \
+    ../includes/category_totals.h \
+    ../includes/stock_ledger.h \
+    ../includes/location_stock.h \
+    ../includes/sku_index.h \
+    ../includes/task_executor.h \
+    ../includes/query_cache.h
+
+linux {
+    SOURCES += ../src/inventory_server.cpp \
+        ../src/inventory_client.cpp
+
+    HEADERS += ../includes/inventory_server.h \
+        ../includes/inventory_client.h
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "category_totals.h"
+
+// Qt includes
+#include <QDialog>
+
+// Chart includes
+#include <QtCharts/QChartView>
+#include <QtCharts/QPieSeries>
+#include <QtCharts/QBarSeries>
+#include <QtCharts/QBarSet>
+#include <QtCharts/QBarCategoryAxis>
+#include <QtCharts/QValueAxis>
+QT_CHARTS_USE_NAMESPACE
+
+/**
+ * @brief Chart of the largest categories that stays open and follows the inventory
+ *
+ * At most CATEGORY_LIMIT categories are drawn by name, with the rest in one
+ * "Other" entry, so redrawing costs the same however many categories there
+ * are. The series are built once; refresh() reads the running totals and
+ * changes only the values, labels and slices that differ from those shown.
+ */
+class CategoryChartDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief What the chart shows
+     */
+    enum class Kind
+    {
+        VALUE_BARS, // Bars of the total value of each category
+        COUNT_PIE   // Pie of the number of products in each category
+    };
+
+    // Categories drawn by name; the rest are combined into one entry
+    static const size_t CATEGORY_LIMIT = 12;
+
+    /**
+     * @brief Construct the chart dialog
+     * @param kind What the chart shows
+     * @param totals The totals to chart; must outlive the dialog
+     * @param parent Parent widget, defaults to nullptr
+     */
+    CategoryChartDialog(Kind kind, const CategoryTotals &totals, QWidget *parent = nullptr);
+
+    /**
+     * @brief Bring the chart up to date with the totals
+     *
+     * Does nothing while the dialog is hidden or if the totals have not
+     * changed since the last refresh. Showing the dialog refreshes it.
+     */
+    void refresh();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+
+private:
+    /**
+     * @brief Set the bar values and axes to a new set of entries
+     * @param entries The entries to show, in order
+     * @param relabel Whether any entry differs from the one shown at its position
+     */
+    void update_bars(const std::vector<CategoryTotal> &entries, bool relabel);
+
+    /**
+     * @brief Set the pie slices to a new set of entries
+     * @param entries The entries to show, in order
+     */
+    void update_pie(const std::vector<CategoryTotal> &entries);
+
+    Kind kind;
+    const CategoryTotals &totals;
+    uint64_t shown_version;           // Version of the totals the chart shows
+    std::vector<CategoryTotal> shown; // Entries the chart shows, in order
+
+    QPieSeries *pie_series;          // Pie chart only
+    QBarSet *bar_set;                // Bar chart only: one value per entry
+    QBarCategoryAxis *category_axis; // Bar chart only
+    QValueAxis *value_axis;          // Bar chart only
+};
@@ -0,0 +1,106 @@
+#pragma once
+#include "inventory_manager.h"
+#include "money.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Product count and value of one category, or of several combined
+ */
+struct CategoryTotal
+{
+    std::string category; // Category name, or OTHER_CATEGORIES for the combined remainder
+    size_t categories;    // Number of categories included: 1, or more for the remainder
+    size_t products;      // Number of products in them
+    CentsTotal value;     // Exact sum of their total values
+
+    CategoryTotal() : categories(0), products(0) {}
+};
+
+/**
+ * @brief Label of the entry that combines the categories outside the top ones
+ */
+extern const std::string OTHER_CATEGORIES;
+
+/**
+ * @brief Per-category product counts and values, kept current as the inventory changes
+ *
+ * Register it with InventoryManager::add_listener. Each change only adjusts
+ * the categories of the product before and after it, so reading the totals
+ * never scans the products, and ranking them costs time in the number of
+ * categories rather than products.
+ */
+class CategoryTotals : public InventoryListener
+{
+public:
+    /**
+     * @brief What categories are ranked by
+     */
+    enum class Measure
+    {
+        PRODUCT_COUNT,
+        VALUE
+    };
+
+    CategoryTotals();
+
+    void product_changed(const Product *before, const Product *after) override;
+
+    void products_replaced(const std::vector<Product> &products) override;
+
+    /**
+     * @brief Get the largest categories, combining the rest into one entry
+     *
+     * Ties are broken by category name, so the order is stable while the
+     * totals do not change.
+     *
+     * @param measure What to rank by
+     * @param limit Maximum number of categories listed by name
+     * @return Up to limit categories, largest first, then an OTHER_CATEGORIES
+     *         entry if any categories were left out
+     */
+    std::vector<CategoryTotal> top(Measure measure, size_t limit) const;
+
+    /**
+     * @brief Get the number of categories that have products
+     * @return The category count
+     */
+    size_t get_category_count() const;
+
+    /**
+     * @brief Get a number that changes whenever any total changes
+     * @return The change count since construction
+     */
+    uint64_t get_version() const;
+
+    /**
+     * @brief Set a function to call after every change to the totals
+     *
+     * It is called once per changed product, from inside the edit, so it
+     * should only note that the totals changed, such as by starting a timer.
+     *
+     * @param on_change The function, or an empty function for none
+     */
+    void set_change_callback(std::function<void()> on_change);
+
+private:
+    std::unordered_map<std::string, CategoryTotal> totals; // Category -> its totals
+    uint64_t version;
+    std::function<void()> on_change;
+
+    /**
+     * @brief Count a product into or out of its category
+     * @param product The product
+     * @param adding true to add it, false to take it away
+     */
+    void apply(const Product &product, bool adding);
+
+    /**
+     * @brief Record that the totals changed and call the change callback
+     */
+    void changed();
+};
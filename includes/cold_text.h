@@ -0,0 +1,164 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Read-only bytes that cold product fields point into
+ *
+ * A segment is either an inventory file, kept open so that fields can be
+ * read back by offset when they are needed, or text held in memory. File
+ * reads go through a small per-thread block cache, so reading the fields of
+ * consecutive rows, as saving does, costs one read per block rather than one
+ * per field.
+ *
+ * Files are never written in place by this program (see
+ * write_file_atomically), so an open segment keeps reading the contents it
+ * was opened with. If something else modifies the file in place, reads
+ * fail instead of returning the wrong text. The check compares the file's
+ * size and its modification and change times, so it is best effort: where
+ * those times are kept only to the second, a rewrite that keeps the size
+ * within the same second goes unnoticed.
+ */
+class ColdSegment
+{
+public:
+    /**
+     * @brief Open a file as a segment
+     * @param filename The file to open
+     * @return The segment
+     * @throws FileOperationException If the file cannot be opened
+     */
+    static std::shared_ptr<const ColdSegment> open_file(const std::string &filename);
+
+    /**
+     * @brief Create a segment holding text in memory
+     * @param text The contents
+     */
+    explicit ColdSegment(std::string text);
+
+    ~ColdSegment();
+
+    ColdSegment(const ColdSegment &) = delete;
+    ColdSegment &operator=(const ColdSegment &) = delete;
+
+    /**
+     * @brief View a range of the segment
+     * @param offset Position of the first byte
+     * @param length Number of bytes
+     * @return The bytes; for file segments, valid until this thread's next call to view()
+     * @throws FileOperationException If the range cannot be read or the file changed since it was opened
+     */
+    std::string_view view(uint64_t offset, uint32_t length) const;
+
+    /**
+     * @brief Check whether the segment reads from a file
+     * @return true for segments made by open_file()
+     */
+    bool is_file() const;
+
+    /**
+     * @brief Get the heap bytes held by the segment, not counting the object itself
+     * @return The size of the in-memory contents
+     */
+    size_t get_heap_bytes() const;
+
+private:
+    struct FileState;
+
+    std::string text;                      // Contents of in-memory segments
+    std::unique_ptr<const FileState> file; // Null for in-memory segments
+
+    ColdSegment();
+};
+
+/**
+ * @brief Text that lives in a ColdSegment until it is asked for
+ *
+ * Holds no text of its own: either a range of a file segment, read when
+ * str() is called, or a reference to an in-memory segment for text set in
+ * code. It is the size of a std::string, and copies share the segment
+ * rather than copying text.
+ */
+class ColdText
+{
+public:
+    /**
+     * @brief Construct empty text
+     */
+    ColdText() : offset(0), length(0), escaped(false) {}
+
+    /**
+     * @brief Construct text held in memory
+     * @param text The text
+     */
+    explicit ColdText(const std::string &text);
+
+    /**
+     * @brief Construct text read from a range of a segment when needed
+     * @param segment The segment holding the text
+     * @param offset Position of the text in the segment
+     * @param length Length of the text in the segment
+     * @param escaped true if the range is CSV-quoted text, with each quote doubled
+     */
+    ColdText(std::shared_ptr<const ColdSegment> segment, uint64_t offset, uint32_t length, bool escaped);
+
+    /**
+     * @brief Get the text, reading it from its file if necessary
+     * @return The text
+     * @throws FileOperationException If the text is in a file that can no longer be read
+     */
+    std::string str() const;
+
+    /**
+     * @brief Check whether the text is empty, without reading it
+     * @return true if there is no text
+     */
+    bool empty() const
+    {
+        return length == 0;
+    }
+
+    /**
+     * @brief Check whether the text would be read from a file
+     * @return true if str() reads from a file segment
+     */
+    bool is_cold() const;
+
+    /**
+     * @brief Write the text as a quoted CSV field
+     *
+     * Text read from a CSV file is copied as it appears there, without
+     * unescaping and escaping it again.
+     *
+     * @param out The stream to write to
+     */
+    void write_csv(std::ostream &out) const;
+
+    /**
+     * @brief Get the heap bytes held for this text
+     * @return The in-memory segment's size, or 0 for text in a file
+     */
+    size_t get_heap_bytes() const;
+
+    /**
+     * @brief Compare the text
+     * @param other The text to compare with
+     * @return true if both hold the same characters
+     */
+    bool operator==(const ColdText &other) const;
+
+    bool operator!=(const ColdText &other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    std::shared_ptr<const ColdSegment> segment; // Null for empty text
+    uint64_t offset;
+    uint32_t length;
+    bool escaped; // The range holds CSV-quoted text with doubled quotes
+};
@@ -0,0 +1,107 @@
+#pragma once
+#include <climits>
+#include <functional>
+#include <string>
+#include <vector>
+#include "product.h"
+
+/**
+ * @brief Range filter evaluated against block statistics and then each row
+ *
+ * Blocks whose min/max statistics cannot satisfy the predicate are skipped
+ * without being decoded. Bounds are inclusive; an empty category matches any.
+ */
+struct ColumnarPredicate
+{
+    int min_id;
+    int max_id;
+    int min_quantity;
+    int max_quantity;
+    Cents min_price_cents;
+    Cents max_price_cents;
+    std::string category;
+
+    ColumnarPredicate()
+        : min_id(INT_MIN), max_id(INT_MAX), min_quantity(INT_MIN), max_quantity(INT_MAX),
+          min_price_cents(INT64_MIN), max_price_cents(INT64_MAX) {}
+
+    /**
+     * @brief Check whether a product satisfies the predicate
+     * @param product The product to test
+     * @return true if every bound is satisfied
+     */
+    bool matches(const Product &product) const;
+};
+
+/**
+ * @brief Products read from a columnar file plus block-skipping statistics
+ */
+struct ColumnarScanResult
+{
+    std::vector<Product> products;
+    size_t blocks_read;
+    size_t blocks_skipped;
+
+    ColumnarScanResult() : blocks_read(0), blocks_skipped(0) {}
+};
+
+/**
+ * @brief Compact column-oriented inventory file for analytics hand-off
+ *
+ * Rows are grouped into blocks; inside a block each column is stored
+ * separately. IDs are delta-encoded and bit-packed, categories are codes into
+ * a sorted file-wide dictionary, quantities and prices (in cents) are
+ * bit-packed relative to the block minimum, and names, descriptions and SKUs
+ * are compressed with a built-in LZ77 coder. The derived total value is not
+ * stored. Each block starts with min/max statistics and its encoded length so
+ * readers can skip it entirely.
+ */
+class ColumnarFile
+{
+public:
+    /**
+     * @brief Default number of rows per block
+     */
+    static const size_t DEFAULT_BLOCK_ROWS = 8192;
+
+    /**
+     * @brief Write products to a columnar file
+     * @param filename The file to write
+     * @param products The products to write
+     * @param block_rows Number of rows per block
+     * @throws FileOperationException If the file cannot be written
+     */
+    static void write(const std::string &filename, const std::vector<Product> &products,
+                      size_t block_rows = DEFAULT_BLOCK_ROWS);
+
+    /**
+     * @brief Read the products matching a predicate from a columnar file
+     * @param filename The file to read
+     * @param predicate Filter applied to block statistics and rows
+     * @return The matching products in file order, and block counts
+     * @throws FileOperationException If the file cannot be read or is corrupt
+     */
+    static ColumnarScanResult read(const std::string &filename,
+                                   const ColumnarPredicate &predicate = ColumnarPredicate());
+
+    /**
+     * @brief Stream the products matching a predicate from a columnar file
+     *
+     * Only one block is decoded at a time, so memory use is bounded by the block size.
+     *
+     * @param filename The file to read
+     * @param predicate Filter applied to block statistics and rows
+     * @param visit Called for each matching product, in file order
+     * @return Block counts; the products member is left empty
+     * @throws FileOperationException If the file cannot be read or is corrupt
+     */
+    static ColumnarScanResult scan(const std::string &filename, const ColumnarPredicate &predicate,
+                                   const std::function<void(const Product &)> &visit);
+
+    /**
+     * @brief Check whether a file starts with the columnar format's magic bytes
+     * @param filename The file to check
+     * @return true if the file exists and is a columnar file
+     */
+    static bool is_columnar_file(const std::string &filename);
+};
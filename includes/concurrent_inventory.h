@@ -0,0 +1,249 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+#include "inventory_manager.h"
+
+/**
+ * @brief A product together with the version stamp it was read at
+ */
+struct VersionedProduct
+{
+    Product product;
+    uint64_t version; // Incremented on every write to the product
+};
+
+class InventoryTransaction;
+
+/**
+ * @brief Thread-safe stock store for many concurrent writers
+ *
+ * Products are spread over lock stripes by a hash of their ID, so writers
+ * touching different products rarely wait for each other and readers of a
+ * stripe run in parallel. Every product carries a version stamp that is
+ * bumped on each write; multi-product transactions read without holding
+ * locks and validate those stamps at commit.
+ *
+ * The concurrent mode covers stock movements on an existing catalogue:
+ * products are loaded from an InventoryManager and changes are written back
+ * to it with write_back(). Adding and removing products stays with the
+ * manager.
+ */
+class ConcurrentInventory
+{
+public:
+    /**
+     * @brief Load the products of an inventory into a concurrent store
+     * @param manager The inventory to copy products from
+     * @param stripe_count Number of lock stripes, rounded up to a power of two;
+     *                     0 picks a count from the number of hardware threads
+     */
+    explicit ConcurrentInventory(const InventoryManager &manager, size_t stripe_count = 0);
+
+    /**
+     * @brief Get a copy of a product
+     * @param id The product ID
+     * @return The product
+     * @throws ProductNotFoundException If no product has the ID
+     */
+    Product get_product_by_id(int id) const;
+
+    /**
+     * @brief Get a copy of a product and its version stamp
+     * @param id The product ID
+     * @return The product and version
+     * @throws ProductNotFoundException If no product has the ID
+     */
+    VersionedProduct get_versioned_product(int id) const;
+
+    /**
+     * @brief Overwrite every field except the ID of a product
+     * @param id The product ID
+     * @param updated_product The new field values
+     * @throws ProductNotFoundException If no product has the ID
+     */
+    void update_product(int id, const Product &updated_product);
+
+    /**
+     * @brief Overwrite a product only if it has not changed since it was read
+     * @param id The product ID
+     * @param expected_version The version the caller read
+     * @param updated_product The new field values
+     * @return true if the product was updated, false if its version had moved on
+     * @throws ProductNotFoundException If no product has the ID
+     */
+    bool update_product_if_version(int id, uint64_t expected_version, const Product &updated_product);
+
+    /**
+     * @brief Get a copy of a product if there is one, without throwing on a miss
+     * @param id The product ID
+     * @param product Receives the product; unchanged on a miss
+     * @return true if a product has the ID
+     */
+    bool try_get_product_by_id(int id, Product &product) const;
+
+    /**
+     * @brief Overwrite every field except the ID of a product, without throwing on a miss
+     * @param id The product ID
+     * @param updated_product The new field values
+     * @return OK or NOT_FOUND
+     */
+    InventoryStatus try_update_product(int id, const Product &updated_product);
+
+    /**
+     * @brief Add to or take from a product's quantity in one atomic step
+     * @param id The product ID
+     * @param delta The change in quantity, negative to take stock
+     * @return The new quantity
+     * @throws ProductNotFoundException If no product has the ID
+     * @throws InventoryException If the quantity would become negative or overflow
+     */
+    int adjust_quantity(int id, int delta);
+
+    /**
+     * @brief Move stock from one product to another atomically
+     * @param from_id The product to take stock from
+     * @param to_id The product to add stock to
+     * @param amount The number of units to move
+     * @throws ProductNotFoundException If either product does not exist
+     * @throws InventoryException If the source has too little stock, or the
+     *                            transaction keeps conflicting with other writers
+     */
+    void move_quantity(int from_id, int to_id, int amount);
+
+    /**
+     * @brief Run a transaction, retrying it when it conflicts with other writers
+     *
+     * The body may be called several times and should have no side effects
+     * besides reads and writes through the transaction. Exceptions thrown by
+     * the body abort the transaction and propagate.
+     *
+     * @param body Reads and writes products through the transaction
+     * @param max_attempts How many times to try before giving up
+     * @return true if the transaction committed, false if every attempt conflicted
+     */
+    bool run_transaction(const std::function<void(InventoryTransaction &)> &body, int max_attempts = 16);
+
+    /**
+     * @brief Get a consistent copy of every product, sorted by ID
+     *
+     * All stripes are read-locked together, so no transaction is seen half applied.
+     *
+     * @return The products
+     */
+    std::vector<Product> get_all_products() const;
+
+    /**
+     * @brief Copy products changed since loading back into an inventory
+     * @param manager The inventory to update, normally the one loaded from
+     * @return The number of products written
+     * @throws ProductNotFoundException If a changed product was removed from the manager
+     */
+    size_t write_back(InventoryManager &manager) const;
+
+private:
+    friend class InventoryTransaction;
+
+    /**
+     * @brief A product and its version stamp
+     */
+    struct Entry
+    {
+        Product product;
+        uint64_t version;
+    };
+
+    /**
+     * @brief One lock stripe, padded to its own cache line
+     */
+    struct alignas(64) Stripe
+    {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<int, Entry> entries;
+    };
+
+    std::unique_ptr<Stripe[]> stripes;
+    size_t stripe_mask;
+
+    /**
+     * @brief Get the stripe index that holds a product ID
+     * @param id The product ID
+     * @return Index into stripes
+     */
+    size_t stripe_of(int id) const;
+
+    /**
+     * @brief Find a product's entry in its stripe; the stripe must be locked
+     * @param id The product ID
+     * @return The entry
+     * @throws ProductNotFoundException If no product has the ID
+     */
+    Entry &locked_entry(int id) const;
+
+    /**
+     * @brief Find a product's entry in its stripe if there is one; the stripe must be locked
+     * @param id The product ID
+     * @return The entry, or nullptr if no product has the ID
+     */
+    Entry *find_locked_entry(int id) const;
+};
+
+/**
+ * @brief An optimistic multi-product transaction on a ConcurrentInventory
+ *
+ * Reads record the version of each product; writes are buffered. commit()
+ * locks the stripes involved in a fixed order, checks that every product read
+ * is still at the version seen and applies the writes, so a transaction
+ * either applies completely or not at all.
+ */
+class InventoryTransaction
+{
+public:
+    /**
+     * @brief Start a transaction on a store
+     * @param inventory The store to read and write
+     */
+    explicit InventoryTransaction(ConcurrentInventory &inventory);
+
+    /**
+     * @brief Read a product, seeing this transaction's own writes
+     * @param id The product ID
+     * @return The product
+     * @throws ProductNotFoundException If no product has the ID
+     */
+    Product read(int id);
+
+    /**
+     * @brief Buffer a write of every field except the ID of a product
+     * @param id The product ID
+     * @param updated_product The new field values
+     * @throws ProductNotFoundException If no product has the ID
+     */
+    void write(int id, const Product &updated_product);
+
+    /**
+     * @brief Buffer a change to a product's quantity
+     * @param id The product ID
+     * @param delta The change in quantity
+     * @return The new quantity as seen by this transaction
+     * @throws ProductNotFoundException If no product has the ID
+     * @throws InventoryException If the quantity would become negative or overflow
+     */
+    int adjust_quantity(int id, int delta);
+
+    /**
+     * @brief Validate the reads and apply the buffered writes
+     * @return true if committed, false if another writer changed a product this transaction read
+     */
+    bool commit();
+
+private:
+    ConcurrentInventory &inventory;
+    std::unordered_map<int, uint64_t> read_versions; // ID -> version first seen
+    std::unordered_map<int, Product> writes;         // ID -> buffered new value
+    bool conflicted;                                 // A product changed between two reads
+};
@@ -0,0 +1,131 @@
+#pragma once
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "product.h"
+
+/**
+ * @brief Header row written at the top of every inventory CSV file, generated from ProductSchema
+ */
+extern const std::string PRODUCT_CSV_HEADER;
+
+/**
+ * @brief Quote a field for CSV output, doubling any embedded quotes
+ * @param field The raw field value
+ * @return The field wrapped in double quotes
+ */
+std::string csv_quote(const std::string &field);
+
+/**
+ * @brief Write a field quoted for CSV output, without building a temporary string
+ * @param out The stream to write to
+ * @param field The raw field value
+ */
+void write_csv_quoted(std::ostream &out, std::string_view field);
+
+/**
+ * @brief Write one product as a CSV row, including the derived total value
+ * @param out The stream to write to
+ * @param product The product to write
+ */
+void write_product_csv_row(std::ostream &out, const Product &product);
+
+/**
+ * @brief Split a CSV line into fields, handling quoted fields and doubled quotes
+ * @param line A single line of CSV text
+ * @return The unquoted field values
+ */
+std::vector<std::string> split_csv_line(const std::string &line);
+
+/**
+ * @brief Split a CSV line into fields, reusing the strings of an earlier row
+ * @param line A single line of CSV text
+ * @param fields Receives the unquoted field values
+ */
+void split_csv_line(const std::string &line, std::vector<std::string> &fields);
+
+/**
+ * @brief Locate a field's text within a CSV line, as written by write_csv_quoted
+ *
+ * Only fields that are plainly quoted, or unquoted without any quotes, are
+ * located; for anything split_csv_line would have to reinterpret, such as
+ * text after a closing quote, this returns false.
+ *
+ * @param line A single line of CSV text
+ * @param index Position of the field
+ * @param start Receives the position of the field's text, inside any quotes
+ * @param length Receives the length of the text as it appears in the line
+ * @param escaped Receives whether the text contains doubled quotes
+ * @return false if the line has too few fields or the field is not plainly quoted
+ */
+bool find_csv_field(const std::string &line, size_t index, size_t &start, size_t &length, bool &escaped);
+
+/**
+ * @brief Build a product from the fields of a split CSV row
+ * @param fields Fields in save_to_file column order; extra trailing fields are ignored
+ * @param product Receives the parsed fields; unspecified if the row is invalid
+ * @return true if the fields held a valid product, false if the row should be skipped
+ */
+bool parse_product_csv_fields(const std::vector<std::string> &fields, Product &product);
+
+/**
+ * @brief Parse a CSV row produced by write_product_csv_row
+ * @param line A single line of CSV text
+ * @param product Receives the parsed product on success
+ * @return true if the row held a valid product, false if it should be skipped
+ */
+bool parse_product_csv_row(const std::string &line, Product &product);
+
+/**
+ * @brief Stream every valid product row of inventory CSV text
+ *
+ * Columns are found by their names in the header line, so files written
+ * before a column was added still read, with that column empty. Empty and
+ * malformed rows are skipped.
+ *
+ * @param in The stream to read, positioned at the header line
+ * @param visit Called for each product, in input order
+ */
+void read_product_csv(std::istream &in, const std::function<void(Product &)> &visit);
+
+/**
+ * @brief Stream every valid product row of an inventory CSV file
+ *
+ * Columns are found by their header as in read_product_csv(). Empty and
+ * malformed rows are skipped.
+ *
+ * @param filename The CSV file to read
+ * @param visit Called for each product, in file order
+ * @throws FileOperationException If the file cannot be opened
+ */
+void read_product_csv_file(const std::string &filename, const std::function<void(Product &)> &visit);
+
+/**
+ * @brief Stream every valid product row of an inventory CSV file, leaving cold fields in the file
+ *
+ * Cold fields, such as the description, are not copied into memory: each
+ * points at its text in the file, which stays open while any product refers
+ * to it and is read when the field is. Fields that are not plainly quoted are
+ * read into memory as usual.
+ *
+ * @param filename The CSV file to read
+ * @param visit Called for each product, in file order
+ * @throws FileOperationException If the file cannot be opened
+ */
+void read_product_csv_file_lazily(const std::string &filename, const std::function<void(Product &)> &visit);
+
+/**
+ * @brief Write a file through a temporary next to it, renamed over the original once complete
+ *
+ * Readers never see a partial file, a failed write leaves the original
+ * intact, and products whose cold fields point into the original keep
+ * reading its old contents.
+ *
+ * @param filename The file to write
+ * @param write Writes the contents
+ * @throws FileOperationException If the temporary file cannot be written or renamed
+ */
+void write_file_atomically(const std::string &filename, const std::function<void(std::ostream &)> &write);
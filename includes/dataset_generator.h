@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "product.h"
+#include "stock_ledger.h"
+
+/**
+ * @brief Produces synthetic inventories for benchmarks and load tests
+ *
+ * The same seed always produces the same products: the generator uses its
+ * own splitmix64 stream and distributions instead of the engines and
+ * implementation-defined distributions in <random>, so datasets do not
+ * change between standard libraries.
+ *
+ * Categories follow a Zipf distribution over a fixed list, so a few large
+ * categories dominate as in real catalogs. Names combine a brand, a modifier,
+ * an item and an optional size or pack count. Prices are log-normal around
+ * $25, most ending in .99 or .49. About one product in ten is low on stock.
+ * SKUs are EAN-13 barcodes derived from the ID, so every product has a
+ * unique one.
+ * Some names, categories and descriptions contain commas, double quotes and
+ * accented letters, so CSV quoting, escaping and case folding are exercised.
+ *
+ * Stock movements simulate a store from 2024-01-01: mostly sales of a few
+ * units, with deliveries, returns and count adjustments mixed in, spread
+ * unevenly so that low product IDs move most.
+ *
+ * Stock by location puts each product in a few warehouses, as sparse
+ * stocking across a chain does.
+ */
+class DatasetGenerator
+{
+public:
+    /**
+     * @brief Create a generator
+     * @param seed Selects the dataset; equal seeds give equal datasets
+     */
+    explicit DatasetGenerator(uint64_t seed);
+
+    /**
+     * @brief Generate the next product
+     * @param id The ID to give the product
+     * @return A product with generated fields
+     */
+    Product next_product(int id);
+
+    /**
+     * @brief Generate products with IDs 1 to count
+     * @param count The number of products
+     * @return The products, in ascending ID order
+     */
+    std::vector<Product> generate(size_t count);
+
+    /**
+     * @brief Write products with IDs 1 to count as inventory CSV, without holding them in memory
+     * @param out The stream to write to
+     * @param count The number of products
+     */
+    void write_csv(std::ostream &out, size_t count);
+
+    /**
+     * @brief Generate the next stock movement
+     * @param product_count Movements go to products with IDs 1 to product_count
+     * @param timestamp Time of the previous movement; advanced by a random gap averaging 30 seconds
+     * @return The movement, at the new time
+     */
+    StockMovement next_movement(int product_count, int64_t &timestamp);
+
+    /**
+     * @brief Write movements as the movement CSV that StockLedger::import_csv() reads
+     * @param out The stream to write to
+     * @param product_count Movements go to products with IDs 1 to product_count
+     * @param count The number of movements
+     */
+    void write_movements_csv(std::ostream &out, int product_count, size_t count);
+
+    /**
+     * @brief Write quantities by location as the CSV that InventoryManager::load_location_stock() reads
+     *
+     * Locations are named "Warehouse 1" onward. Each product is stocked at
+     * one to four of them, at random.
+     *
+     * @param out The stream to write to
+     * @param product_count Rows for products with IDs 1 to product_count
+     * @param location_count The number of locations
+     */
+    void write_location_stock_csv(std::ostream &out, int product_count, size_t location_count);
+
+    /**
+     * @brief Pick a category name the way next_product() does
+     * @return A category, favoring the large ones
+     */
+    const std::string &next_category();
+
+    /**
+     * @brief Pick a word that appears in generated names
+     * @return A brand or item word, suitable as a name search term
+     */
+    const std::string &next_name_word();
+
+private:
+    uint64_t state;
+    std::vector<double> category_weights; // Cumulative Zipf weights, one per category
+
+    uint64_t next_u64();
+    double next_double();
+    size_t next_index(size_t bound);
+    double next_normal();
+};
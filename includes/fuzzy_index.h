@@ -0,0 +1,135 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+/**
+ * @brief Compute the Levenshtein distance between two byte strings
+ *
+ * Uses Myers' bit-parallel algorithm when the first string is at most 64 bytes,
+ * falling back to the classic two-row dynamic programme otherwise.
+ *
+ * @param a The first string
+ * @param b The second string
+ * @return The number of single-byte insertions, deletions and substitutions
+ *         needed to turn a into b
+ */
+int edit_distance(const std::string &a, const std::string &b);
+
+/**
+ * @brief Index of product names for typo-tolerant lookup
+ *
+ * Names are split into words and each distinct word is stored once in a
+ * BK-tree, with a posting list of the product IDs whose name contains it.
+ * A query walks the tree using the triangle inequality to prune subtrees, so
+ * only a small fraction of the vocabulary is compared against each query word.
+ * Names are expected to be folded already (see fold_text).
+ */
+class FuzzyNameIndex
+{
+public:
+    /**
+     * @brief A product matched by a fuzzy query
+     */
+    struct Match
+    {
+        int id;       // Product ID
+        int distance; // Sum over query words of the closest word in the name
+    };
+
+    /**
+     * @brief Remove every name from the index
+     */
+    void clear();
+
+    /**
+     * @brief Index a product name
+     * @param id The product ID
+     * @param folded_name The folded product name
+     */
+    void add(int id, const std::string &folded_name);
+
+    /**
+     * @brief Remove a product name previously passed to add
+     * @param id The product ID
+     * @param folded_name The folded name the product was indexed under
+     */
+    void remove(int id, const std::string &folded_name);
+
+    /**
+     * @brief Re-index a renamed product, touching only the words that changed
+     * @param id The product ID
+     * @param old_folded_name The folded name the product was indexed under
+     * @param new_folded_name The new folded name
+     */
+    void update(int id, const std::string &old_folded_name, const std::string &new_folded_name);
+
+    /**
+     * @brief Find products whose names contain every query word within max_distance edits
+     *
+     * Short words tolerate fewer edits: words under 4 bytes must match exactly,
+     * and words under 8 bytes allow at most one edit.
+     *
+     * @param folded_query The folded search text
+     * @param max_distance Maximum edits allowed per query word
+     * @param max_results Maximum number of matches to return
+     * @return Matches ordered by ascending distance, then ascending ID
+     */
+    std::vector<Match> search(const std::string &folded_query, int max_distance,
+                              size_t max_results) const;
+
+    /**
+     * @brief Split folded text into the words used as index terms
+     * @param folded_text Folded text
+     * @return The words, in order of appearance
+     */
+    static std::vector<std::string> split_words(const std::string &folded_text);
+
+    /**
+     * @brief Get the heap bytes used by the index
+     * @return The size of the terms, postings, lookup table and tree
+     */
+    size_t get_memory_usage() const;
+
+private:
+    /**
+     * @brief Add an ID to the posting list of a word, creating the term if needed
+     */
+    void add_word(int id, const std::string &word);
+
+    /**
+     * @brief Remove an ID from the posting list of a word
+     */
+    void remove_word(int id, const std::string &word);
+
+    struct Term
+    {
+        std::string text;
+        std::vector<int> ids; // Sorted product IDs containing this word
+    };
+
+    struct Node
+    {
+        int term;
+        std::vector<std::pair<int, int>> children; // (distance to this term, child node)
+    };
+
+    std::vector<Term> terms;
+    std::unordered_map<std::string, int> term_lookup;
+    std::vector<Node> nodes; // nodes[0] is the root once any term exists
+
+    /**
+     * @brief Insert a newly created term into the BK-tree
+     * @param term Index of the term in terms
+     */
+    void insert_node(int term);
+
+    /**
+     * @brief Collect terms within max_distance of a word
+     * @param word The query word
+     * @param max_distance Maximum edit distance
+     * @return (term index, distance) pairs for terms that still have postings
+     */
+    std::vector<std::pair<int, int>> find_terms(const std::string &word, int max_distance) const;
+};
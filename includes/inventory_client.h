@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "inventory_protocol.h"
+
+/**
+ * @brief A decoded response frame
+ */
+struct ServiceResponse
+{
+    uint32_t request_id;
+    ResponseStatus status;
+    std::string body; // Response body; the error message when status is not OK
+};
+
+/**
+ * @brief Blocking client for the inventory service
+ *
+ * Requests can be pipelined: queue any number with send(), push them out
+ * with flush() and collect the responses, which arrive in request order,
+ * with receive(). The convenience methods send one request and wait for its
+ * response. Available on POSIX systems only.
+ */
+class InventoryClient
+{
+public:
+    /**
+     * @brief Connect to a server
+     * @param address "unix:PATH" or "tcp:HOST:PORT"
+     * @throws InventoryException If the address is invalid or the connection fails
+     */
+    explicit InventoryClient(const std::string &address);
+
+    /**
+     * @brief Close the connection
+     */
+    ~InventoryClient();
+
+    InventoryClient(const InventoryClient &) = delete;
+    InventoryClient &operator=(const InventoryClient &) = delete;
+
+    /**
+     * @brief Queue a request without sending it
+     * @param opcode The request type
+     * @param body The encoded request body
+     * @return The request ID, echoed in the response
+     */
+    uint32_t send(Opcode opcode, const std::string &body = std::string());
+
+    /**
+     * @brief Send every queued request
+     * @throws InventoryException If the connection fails
+     */
+    void flush();
+
+    /**
+     * @brief Wait for the next response, flushing queued requests first
+     * @return The response
+     * @throws InventoryException If the connection fails or the frame is invalid
+     */
+    ServiceResponse receive();
+
+    /**
+     * @brief Fetch one product
+     * @param id The product ID
+     * @return The product
+     * @throws ProductNotFoundException If the server has no such product
+     * @throws InventoryException If the request fails
+     */
+    Product get_product(int id);
+
+    /**
+     * @brief Change a product's quantity on the server
+     * @param id The product ID
+     * @param delta The change in quantity
+     * @return The new quantity
+     * @throws ProductNotFoundException If the server has no such product
+     * @throws InventoryException If the quantity would become negative or the request fails
+     */
+    int adjust_quantity(int id, int delta);
+
+    /**
+     * @brief Fetch the product count
+     * @return The number of products on the server
+     * @throws InventoryException If the request fails
+     */
+    size_t get_product_count();
+
+    /**
+     * @brief Decode a list of products from a response body
+     * @param body A FIND_BY_NAME, FIND_BY_CATEGORY or LOW_STOCK response body
+     * @return The products
+     * @throws InventoryException If the body is malformed
+     */
+    static std::vector<Product> decode_products(const std::string &body);
+
+private:
+    int fd;
+    uint32_t next_request_id;
+    std::string pending;  // Encoded requests not yet sent
+    std::string received; // Bytes read but not yet returned as responses
+    size_t received_used; // Bytes of received already returned
+
+    /**
+     * @brief Send a request and wait for its response, turning error statuses into exceptions
+     * @param opcode The request type
+     * @param body The encoded request body
+     * @param product_id The product the request names, reported in ProductNotFoundException
+     * @return The response body
+     * @throws ProductNotFoundException For NOT_FOUND responses
+     * @throws InventoryException For any other failure
+     */
+    std::string call(Opcode opcode, const std::string &body, int product_id);
+};
@@ -0,0 +1,132 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "product.h"
+
+/**
+ * @brief Streams products to a visitor; the source of one side of a diff
+ */
+typedef std::function<void(const std::function<void(const Product &)> &)> ProductStream;
+
+/**
+ * @brief One field whose value differs between two versions of a product
+ */
+struct FieldChange
+{
+    std::string field;  // Column name as in the CSV header
+    std::string before; // Old value, formatted as in the CSV export
+    std::string after;  // New value, formatted as in the CSV export
+};
+
+/**
+ * @brief A product that was added, removed or changed between two inventories
+ */
+struct ProductDiff
+{
+    enum class Kind
+    {
+        ADDED,
+        REMOVED,
+        CHANGED
+    };
+
+    Kind kind;
+    Product before;                   // Unset for ADDED
+    Product after;                    // Unset for REMOVED
+    std::vector<FieldChange> changes; // Only for CHANGED
+};
+
+/**
+ * @brief Counts of each kind of difference found
+ */
+struct DiffSummary
+{
+    size_t added;
+    size_t removed;
+    size_t changed;
+    size_t unchanged;
+
+    DiffSummary() : added(0), removed(0), changed(0), unchanged(0) {}
+};
+
+/**
+ * @brief Receives each difference as it is found
+ */
+typedef std::function<void(const ProductDiff &)> DiffVisitor;
+
+/**
+ * @brief Compares two inventories by product ID using partitioned hashing
+ *
+ * Each input is streamed exactly once. Rows are spread over partitions by a
+ * hash of their ID; when an input is too large for one partition the
+ * partitions are spilled to temporary files. Each partition of the "before"
+ * side is then held in a hash table of ID -> (content hash, row) while the
+ * matching partition of the "after" side is streamed against it. Memory is
+ * therefore bounded by the partition size, not the inventory size. Rows whose
+ * content hashes match are treated as unchanged without comparing fields.
+ * Differences are reported partition by partition, not in ID order.
+ */
+class InventoryDiff
+{
+public:
+    /**
+     * @brief Default upper bound on "before" rows held in memory at once
+     */
+    static const size_t DEFAULT_PARTITION_ROWS = 1000000;
+
+    /**
+     * @brief Open a saved inventory as a stream, detecting its format
+     * @param path A CSV file, columnar file or sharded directory
+     * @return A stream over the products in the file
+     */
+    static ProductStream open(const std::string &path);
+
+    /**
+     * @brief Estimate how many products a saved inventory holds, from its size on disk
+     * @param path A CSV file, columnar file or sharded directory
+     * @return An upper-end estimate of the row count
+     */
+    static size_t estimate_rows(const std::string &path);
+
+    /**
+     * @brief Compare two product streams
+     * @param before The older inventory
+     * @param before_rows Expected number of rows in before, used to choose the partition count
+     * @param after The newer inventory
+     * @param visit Called for each added, removed or changed product
+     * @param partition_rows Maximum before rows to hold in memory per partition
+     * @return Counts of each kind of difference
+     * @throws FileOperationException If a source or spill file cannot be read or written
+     */
+    static DiffSummary compare(const ProductStream &before, size_t before_rows,
+                               const ProductStream &after, const DiffVisitor &visit,
+                               size_t partition_rows = DEFAULT_PARTITION_ROWS);
+
+    /**
+     * @brief List the fields that differ between two versions of a product
+     * @param before The old version
+     * @param after The new version
+     * @return One entry per differing field
+     */
+    static std::vector<FieldChange> compare_fields(const Product &before, const Product &after);
+
+    /**
+     * @brief Hash every field of a product except its ID
+     * @param product The product to hash
+     * @return A 64-bit content hash
+     */
+    static uint64_t content_hash(const Product &product);
+
+    /**
+     * @brief Write a difference as CSV rows under the header "Change,ID,Field,Before,After"
+     *
+     * Added and removed products take one row; changed products take one row per field.
+     *
+     * @param out The stream to write to
+     * @param diff The difference to write
+     */
+    static void write_csv_rows(std::ostream &out, const ProductDiff &diff);
+};
@@ -2,7 +2,23 @@
 #include <vector>
 #include <string>
 #include <stdexcept>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
 #include "product.h"
+#include "product_query.h"
+#include "fuzzy_index.h"
+#include "sharded_store.h"
+#include "columnar_format.h"
+#include "inventory_diff.h"
+#include "persistent_product_map.h"
+#include "memory_accounting.h"
+#include "location_stock.h"
+#include "sku_index.h"
+#include "task_executor.h"
+#include "query_cache.h"
 
 // Custom exceptions
 /**
@@ -30,6 +46,13 @@ public:
      */
     ProductNotFoundException(int id)
         : InventoryException("Product with ID " + std::to_string(id) + " not found") {}
+
+    /**
+     * @brief Construct a new Product Not Found Exception
+     * @param sku The SKU no product was found with
+     */
+    ProductNotFoundException(const std::string &sku)
+        : InventoryException("Product with SKU " + sku + " not found") {}
 };
 
 /**
@@ -47,15 +70,283 @@ public:
         : InventoryException("Failed to " + operation + " file: " + filename) {}
 };
 
+/**
+ * @brief Outcome of an operation that reports failure instead of throwing
+ */
+enum class InventoryStatus
+{
+    OK,
+    NOT_FOUND, // No product has the ID
+    SKU_TAKEN, // Another product already has the SKU
+    FILE_ERROR // The file could not be opened or read
+};
+
+/**
+ * @brief A product returned by a fuzzy search, with its edit distance from the query
+ */
+struct FuzzyProductMatch
+{
+    Product product;
+    int distance;
+};
+
+/**
+ * @brief One page of products returned by a cursor-based query
+ */
+struct ProductPage
+{
+    std::vector<Product> products; // Matching products, in ascending ID order
+    std::string next_token;        // Continuation token for the next page
+    bool has_more;                 // false once the end of the inventory is reached
+
+    ProductPage() : has_more(false) {}
+};
+
+/**
+ * @brief Counts of what a merge import changed
+ */
+struct MergeReport
+{
+    size_t inserted;  // Rows whose ID was not in the inventory
+    size_t updated;   // Rows that changed an existing product
+    size_t unchanged; // Rows identical to the existing product
+    size_t deleted;   // Products removed by delete rows or delete_missing
+    size_t skipped;   // Malformed rows, delete rows for unknown IDs, or rows whose SKU another product has
+
+    MergeReport() : inserted(0), updated(0), unchanged(0), deleted(0), skipped(0) {}
+};
+
+/**
+ * @brief Counts of what a location stock load changed
+ */
+struct LocationStockReport
+{
+    size_t applied; // Products whose quantities by location were replaced
+    size_t skipped; // Malformed rows, or rows for unknown IDs
+
+    LocationStockReport() : applied(0), skipped(0) {}
+};
+
+/**
+ * @brief Receives every change made to an InventoryManager's products
+ *
+ * Listeners are called synchronously from the edit that made the change, so
+ * they should only update their own state. The products passed are valid
+ * for the duration of the call.
+ */
+class InventoryListener
+{
+public:
+    virtual ~InventoryListener() = default;
+
+    /**
+     * @brief Called when a single product is added, changed or removed
+     * @param before The product before the change, or nullptr if it was added
+     * @param after The product after the change, or nullptr if it was removed
+     */
+    virtual void product_changed(const Product *before, const Product *after) = 0;
+
+    /**
+     * @brief Called when the whole inventory was replaced, as by a load
+     * @param products Every product, in ascending ID order
+     */
+    virtual void products_replaced(const std::vector<Product> &products) = 0;
+};
+
 /**
  * @brief Manages a collection of products and provides CRUD operations
  */
 class InventoryManager
 {
 private:
-    std::vector<Product> products;
+    /**
+     * @brief Precomputed folded forms of the searchable text fields
+     */
+    struct SearchKeys
+    {
+        std::string name;
+        std::string category;
+    };
+
+    std::vector<Product> products;                // Kept sorted by ascending ID
+    std::unordered_map<int, size_t> id_index;     // Product ID -> position in products
+    std::vector<SearchKeys> search_keys;          // Folded keys, parallel to products
+    FuzzyNameIndex name_index;                    // Typo-tolerant index over folded names
+    ShardedStore shard_store;                     // Directory storage and dirty shard tracking
     int next_product_id;
 
+    bool history_enabled;                         // Whether versions are recorded for undo/redo
+    size_t history_limit;                         // Maximum number of undo steps kept
+    PersistentProductMap current_version;         // Same contents as products while history is enabled
+    std::vector<PersistentProductMap> undo_stack; // Earlier versions, most recent last
+    std::vector<PersistentProductMap> redo_stack; // Undone versions, most recent last
+
+    std::vector<InventoryListener *> listeners;   // Told about every change, in registration order
+    LocationStock stock;                          // Quantities by location, rows parallel to products
+    SkuIndex sku_index;                           // SKU -> position in products
+    std::shared_ptr<TaskExecutor> executor;       // Runs parallel scans and async operations; null for the shared one
+    mutable QueryCache query_cache;               // Matching IDs of recent queries, refreshed from the changes since
+
+    /**
+     * @brief Build the folded search keys for a product
+     * @param product The product to fold
+     * @return The folded name and category
+     */
+    static SearchKeys make_search_keys(const Product &product);
+
+    /**
+     * @brief Recompute id_index, search_keys and name_index after a bulk change
+     */
+    void rebuild_indexes();
+
+    /**
+     * @brief Append a product whose ID is larger than any in the store, updating indexes
+     * @param product The product to append
+     */
+    void append_product(const Product &product);
+
+    /**
+     * @brief Overwrite every field except the ID of the product at a position, updating indexes
+     * @param index Position of the product in products
+     * @param updated_product The new field values
+     */
+    void replace_product(size_t index, const Product &updated_product);
+
+    /**
+     * @brief Remove the product at a position, updating indexes
+     * @param index Position of the product in products
+     */
+    void erase_product(size_t index);
+
+    /**
+     * @brief Insert a product at its sorted position, updating indexes
+     * @param product The product to insert; its ID must not be in the store
+     */
+    void insert_product(const Product &product);
+
+    /**
+     * @brief Push the version before an edit onto the undo stack if the edit changed anything
+     * @param before The version captured when the edit started
+     */
+    void commit_version(const PersistentProductMap &before);
+
+    /**
+     * @brief Bring products and indexes to the contents of another version
+     *
+     * Only the products that differ between the versions are touched, unless
+     * so many were added or removed that a rebuild is cheaper.
+     *
+     * @param target The version to restore
+     */
+    void restore_version(const PersistentProductMap &target);
+
+    /**
+     * @brief Tell the listeners about a change to one product
+     * @param before The product before the change, or nullptr if it was added
+     * @param after The product after the change, or nullptr if it was removed
+     */
+    void notify_product_changed(const Product *before, const Product *after) const;
+
+    /**
+     * @brief Restore the store's invariants after products were bulk-loaded
+     *
+     * Sorts by ID, drops duplicate IDs (keeping the first), rebuilds indexes
+     * and tells the listeners the inventory was replaced.
+     */
+    void finish_bulk_load();
+
+    /**
+     * @brief Replace the inventory with the products of a CSV reader
+     * @param read Calls its argument with each product read
+     */
+    void load_products(const std::function<void(const std::function<void(Product &)> &)> &read);
+
+    /**
+     * @brief Locate a product by ID through the hash index
+     * @param id The ID to search for
+     * @return Iterator to the product, or products.end() if not present
+     */
+    std::vector<Product>::iterator find_product(int id);
+
+    /**
+     * @brief Locate a product by ID through the hash index
+     * @param id The ID to search for
+     * @return Iterator to the product, or products.end() if not present
+     */
+    std::vector<Product>::const_iterator find_product(int id) const;
+
+    /**
+     * @brief Check whether another product has a SKU
+     * @param sku The SKU; an empty SKU is never taken
+     * @param owner The product allowed to have it, or products.end()
+     * @return true if a product other than owner has the SKU
+     */
+    bool is_sku_taken(const std::string &sku, std::vector<Product>::const_iterator owner) const;
+
+    /**
+     * @brief A query prepared for scanning
+     */
+    struct QueryScan
+    {
+        size_t first, last;                                                   // Rows to test
+        std::vector<std::unordered_set<int>> fuzzy_names;                     // Per clause: IDs of fuzzy name matches
+        std::vector<std::unordered_map<std::string, bool>> fuzzy_categories;  // Per clause: closeness of folded categories seen
+        bool parallel_safe;                                                   // Whether rows may be tested on several threads
+    };
+
+    /**
+     * @brief Resolve what a query needs before its rows are tested
+     * @param query The query
+     * @return The rows to test and the fuzzy matches found
+     */
+    QueryScan prepare_scan(const ProductQuery &query) const;
+
+    /**
+     * @brief Test one product against every clause of a query
+     * @param query The query
+     * @param row Position of the product
+     * @param scan The prepared query; fuzzy category results are cached in it
+     * @return true if the product matches
+     */
+    bool row_matches(const ProductQuery &query, size_t row, QueryScan &scan) const;
+
+    /**
+     * @brief Test every product against a query
+     *
+     * Scans longer than a cutoff are split over the executor when the
+     * prepared query allows; the parts are joined in order.
+     *
+     * @param query The query
+     * @param scan The prepared query
+     * @return The IDs of the matching products, ascending
+     */
+    std::vector<int> scan_matching_ids(const ProductQuery &query, QueryScan &scan) const;
+
+    /**
+     * @brief Look up the products matching a query in the query cache
+     * @param query The query
+     * @param key The query's cache key
+     * @param scan The prepared query, for testing the products changed since the entry was stored
+     * @param ids Receives the IDs of the matching products, ascending
+     * @return true if the query was cached
+     */
+    bool find_cached_ids(const ProductQuery &query, const std::string &key, QueryScan &scan,
+                         QueryCache::IdList &ids) const;
+
+    /**
+     * @brief Copy out the products with given IDs
+     * @param ids IDs of products in the store
+     * @return The products, in the order of ids
+     */
+    std::vector<Product> products_with_ids(const std::vector<int> &ids) const;
+
+    /**
+     * @brief Describe a taken SKU, for the exceptions of the throwing operations
+     * @param sku The SKU
+     * @return A message naming the product that has it
+     */
+    std::string sku_taken_message(const std::string &sku) const;
+
 public:
     /**
      * @brief Construct a new Inventory Manager with default values
@@ -68,6 +359,7 @@ public:
      * @brief Add a new product to the inventory
      * @param product The product to add (ID will be assigned automatically)
      * @return The ID assigned to the new product
+     * @throws InventoryException If another product has the same SKU
      */
     int add_product(const Product &product);
 
@@ -76,6 +368,7 @@ public:
      * @param id The ID of the product to update
      * @param updated_product The product with updated values
      * @throws ProductNotFoundException If the product with the given ID doesn't exist
+     * @throws InventoryException If another product has the same SKU
      */
     void update_product(int id, const Product &updated_product);
 
@@ -94,6 +387,61 @@ public:
      */
     Product get_product_by_id(int id) const;
 
+    /**
+     * @brief Get a product by its SKU or barcode
+     *
+     * Looked up in a minimal perfect hash rebuilt on every load, so scanning
+     * a barcode costs a hash and a few memory reads.
+     *
+     * @param sku The SKU to look up
+     * @return The product with the SKU; if loaded files gave several products
+     *         the same SKU, the first loaded
+     * @throws ProductNotFoundException If no product has the SKU
+     */
+    Product get_product_by_sku(const std::string &sku) const;
+
+    // Non-throwing variants, for callers such as reconciliation jobs where misses are routine.
+    // They report failure in the return value, so a miss costs no exception or message.
+
+    /**
+     * @brief Add a new product to the inventory, reporting a taken SKU instead of throwing
+     * @param product The product to add (ID will be assigned automatically)
+     * @param id Receives the ID assigned to the new product
+     * @return OK, or SKU_TAKEN if another product has the same SKU
+     */
+    InventoryStatus try_add_product(const Product &product, int &id);
+
+    /**
+     * @brief Update an existing product's details, reporting failure instead of throwing
+     * @param id The ID of the product to update
+     * @param updated_product The product with updated values
+     * @return OK, NOT_FOUND, or SKU_TAKEN if another product has the same SKU
+     */
+    InventoryStatus try_update_product(int id, const Product &updated_product);
+
+    /**
+     * @brief Remove a product from the inventory, reporting a missing product instead of throwing
+     * @param id The ID of the product to remove
+     * @return OK or NOT_FOUND
+     */
+    InventoryStatus try_remove_product(int id);
+
+    /**
+     * @brief Get a product by its ID if there is one
+     * @param id The ID of the product to retrieve
+     * @param product Receives the product; unchanged on a miss
+     * @return true if a product has the ID
+     */
+    bool try_get_product_by_id(int id, Product &product) const;
+
+    /**
+     * @brief Get a product by its SKU or barcode if there is one
+     * @param sku The SKU to look up
+     * @param product Receives the product; unchanged on a miss
+     * @return true if a product has the SKU
+     */
+    bool try_get_product_by_sku(const std::string &sku, Product &product) const;
+
     /**
      * @brief Find products by matching their name
      * @param name The name or partial name to search for
@@ -101,6 +449,31 @@ public:
      */
     std::vector<Product> find_products_by_name(const std::string &name) const;
 
+    /**
+     * @brief Find products by matching their name using the given search mode
+     * @param name The name or partial name to search for
+     * @param mode Whether to compare exactly, ignoring case and accents, or fuzzily
+     * @return A vector of products whose names contain the search term; fuzzy
+     *         results are ranked closest match first
+     */
+    std::vector<Product> find_products_by_name(const std::string &name, SearchMode mode) const;
+
+    /**
+     * @brief Find products whose names approximately contain the search words
+     *
+     * Each search word must be within max_distance edits of some word in the
+     * product name (shorter words tolerate fewer edits). Matching ignores case
+     * and accents.
+     *
+     * @param name The search text
+     * @param max_distance Maximum edits per search word
+     * @param max_results Maximum number of matches to return
+     * @return Matches ordered by ascending total distance, then by ID
+     */
+    std::vector<FuzzyProductMatch> find_products_by_name_fuzzy(const std::string &name,
+                                                               int max_distance = 2,
+                                                               size_t max_results = 100) const;
+
     /**
      * @brief Find products by exact category match
      * @param category The category to search for
@@ -108,12 +481,99 @@ public:
      */
     std::vector<Product> find_products_by_category(const std::string &category) const;
 
+    /**
+     * @brief Find products by category using the given search mode
+     * @param category The category to search for
+     * @param mode Whether to compare exactly, ignoring case and accents, or
+     *             allowing up to two edits against the folded category
+     * @return A vector of products in the specified category
+     */
+    std::vector<Product> find_products_by_category(const std::string &category, SearchMode mode) const;
+
     /**
      * @brief Get all products in the inventory
      * @return A const reference to the vector of all products
      */
     const std::vector<Product> &get_all_products() const;
 
+    // Composable queries
+    /**
+     * @brief Call a function for every product matching a query, in ID order
+     *
+     * Nothing is copied or collected, so memory use does not depend on how
+     * many products match. A query already in the query cache visits the
+     * IDs cached for it instead of testing every product, but a query not
+     * in it is not added.
+     *
+     * @param query The query to evaluate
+     * @param visit Called once per matching product
+     * @param limit Stop after this many matches (0 = no limit)
+     */
+    void for_each_matching(const ProductQuery &query,
+                           const std::function<void(const Product &)> &visit, size_t limit = 0) const;
+
+    /**
+     * @brief Collect the products matching a query
+     *
+     * Results of queries with a cache key (see ProductQuery::get_cache_key)
+     * are cached. Repeating a query answers it from the cache, after testing
+     * only the products changed since; the name, category and low-stock
+     * searches go through here too.
+     *
+     * @param query The query to evaluate
+     * @return The matching products, in ID order
+     */
+    std::vector<Product> find_products(const ProductQuery &query) const;
+
+    /**
+     * @brief Limit the memory of the query cache
+     * @param max_bytes Limit on the heap bytes of cached results; 0 disables the cache
+     */
+    void set_query_cache_limit(size_t max_bytes);
+
+    /**
+     * @brief Get the hit counts and size of the query cache
+     * @return The stats
+     */
+    QueryCacheStats get_query_cache_stats() const;
+
+    /**
+     * @brief Get the store generation, which every change to the products advances
+     * @return The generation; equal values mean no product changed in between
+     */
+    uint64_t get_generation() const;
+
+    // Cursor-based pagination
+    /**
+     * @brief Get a page of products starting at a given ID
+     * @param start_id The smallest product ID to include
+     * @param limit The maximum number of products to return (must be positive)
+     * @param filter Optional predicate; only matching products are returned
+     * @param max_scanned Upper bound on products examined for this page (0 = no bound)
+     * @return The page, with a continuation token if more products may follow
+     * @throws InventoryException If limit is zero
+     */
+    ProductPage get_products_page(int start_id, size_t limit,
+                                  const ProductFilter &filter = ProductFilter(),
+                                  size_t max_scanned = 0) const;
+
+    /**
+     * @brief Get the next page of products from a continuation token
+     *
+     * Tokens record the last ID visited rather than a position, so they remain
+     * valid when products are added or removed between calls.
+     *
+     * @param token A token from a previous page, or an empty string for the first page
+     * @param limit The maximum number of products to return (must be positive)
+     * @param filter Optional predicate; only matching products are returned
+     * @param max_scanned Upper bound on products examined for this page (0 = no bound)
+     * @return The page, with a continuation token if more products may follow
+     * @throws InventoryException If the token is malformed or limit is zero
+     */
+    ProductPage get_products_page(const std::string &token, size_t limit,
+                                  const ProductFilter &filter = ProductFilter(),
+                                  size_t max_scanned = 0) const;
+
     // Inventory statistics
     /**
      * @brief Get the total number of unique products in the inventory
@@ -123,9 +583,13 @@ public:
 
     /**
      * @brief Calculate the total monetary value of all inventory
-     * @return The sum of (price * quantity) for all products
+     *
+     * The sum is exact and does not depend on the order of the products.
+     *
+     * @return The sum of (price * quantity) for all products, in cents
+     * @throws InventoryException If the total does not fit in 64-bit cents
      */
-    double get_total_inventory_value() const;
+    Cents get_total_inventory_value() const;
 
     /**
      * @brief Find products with stock below a specified threshold
@@ -134,21 +598,459 @@ public:
      */
     std::vector<Product> get_low_stock_products(int threshold) const;
 
+    /**
+     * @brief Find products with stock below a threshold at a location
+     * @param threshold The quantity threshold below which products are considered low stock
+     * @param location The location, or LocationStock::ANY_LOCATION for products low at any location
+     * @return The products low at the location, in ascending ID order
+     * @throws InventoryException If no location has the index
+     */
+    std::vector<Product> get_low_stock_products(int threshold, int location) const;
+
+    /**
+     * @brief Get the total value of the stock held at a location
+     *
+     * Location totals are kept up to date by every edit, so this does not scan.
+     *
+     * @param location The location
+     * @return The sum of (price * quantity at the location), in cents
+     * @throws InventoryException If no location has the index, or the total does not fit in 64-bit cents
+     */
+    Cents get_total_inventory_value(int location) const;
+
+    /**
+     * @brief Break down the heap memory held by the inventory
+     *
+     * Components are the product array, the products' text, the ID index,
+     * the folded search keys, the fuzzy name index, the shard table, the
+     * undo/redo history, the quantities by location, the SKU index and the
+     * query cache. History counts each node and product copy once, however
+     * many versions share it.
+     *
+     * @return One entry per component, in a fixed order
+     */
+    std::vector<MemoryComponent> get_memory_usage() const;
+
+    // Change notification
+
+    /**
+     * @brief Register a listener for changes to the products
+     *
+     * The listener is first given the current products through
+     * products_replaced(), then every later change. It must stay alive until
+     * it is removed or this manager is destroyed.
+     *
+     * @param listener The listener to add
+     */
+    void add_listener(InventoryListener *listener);
+
+    /**
+     * @brief Stop sending changes to a listener
+     * @param listener The listener to remove; ignored if it is not registered
+     */
+    void remove_listener(InventoryListener *listener);
+
+    // Stock locations
+
+    /**
+     * @brief Add a location that products are stocked at
+     *
+     * The first location added is the default: it starts with every
+     * product's whole quantity, and takes any change to a product's quantity
+     * that does not name a location, such as update_product() or a load.
+     * Later locations start empty.
+     *
+     * @param name The location's name
+     * @return The location's index
+     * @throws InventoryException If the name is empty or already used
+     */
+    int add_location(const std::string &name);
+
+    /**
+     * @brief Find a location by name
+     * @param name The name
+     * @return The location's index, or -1 if there is none
+     */
+    int find_location(const std::string &name) const;
+
+    /**
+     * @brief Get the names of the locations
+     * @return The names, by index
+     */
+    const std::vector<std::string> &get_locations() const;
+
+    /**
+     * @brief Get a product's quantity at a location
+     * @param id The product's ID
+     * @param location The location
+     * @return The quantity
+     * @throws ProductNotFoundException If no product has the ID
+     * @throws InventoryException If no location has the index
+     */
+    int get_location_quantity(int id, int location) const;
+
+    /**
+     * @brief Set a product's quantity at a location
+     *
+     * The product's quantity becomes the sum over its locations, recorded as
+     * one edit. Undoing it restores that quantity, with the difference at the
+     * default location.
+     *
+     * @param id The product's ID
+     * @param location The location
+     * @param quantity The new quantity
+     * @throws ProductNotFoundException If no product has the ID
+     * @throws InventoryException If no location has the index, or the product's quantity would not fit in an int
+     */
+    void set_location_quantity(int id, int location, int quantity);
+
+    /**
+     * @brief Move units of a product from one location to another
+     *
+     * The product's quantity does not change, so this is not an edit and
+     * listeners are not told.
+     *
+     * @param id The product's ID
+     * @param from The location to take the units from
+     * @param to The location to put them at
+     * @param quantity The number of units; at most what is held at from
+     * @throws ProductNotFoundException If no product has the ID
+     * @throws InventoryException If a location index is invalid or the quantity is negative or not held at from
+     */
+    void move_stock(int id, int from, int to, int quantity);
+
+    /**
+     * @brief Get the running totals of a location
+     * @param location The location
+     * @return The units, stocked products and value held there
+     * @throws InventoryException If no location has the index
+     */
+    const LocationTotals &get_location_totals(int location) const;
+
+    /**
+     * @brief Save every product's quantity at each location as CSV
+     *
+     * The header is "ID" followed by the location names. Products with no
+     * stock anywhere are left out.
+     *
+     * @param filename The file to write
+     * @throws FileOperationException If the file cannot be written
+     */
+    void save_location_stock(const std::string &filename) const;
+
+    /**
+     * @brief Load quantities by location from a file written by save_location_stock()
+     *
+     * Locations named in the header are added if missing, and every
+     * product's quantity at them is replaced by the file's, zero for
+     * products it leaves out. Product quantities become the sums over their
+     * locations, recorded as one edit. Rows that do not parse, and rows for
+     * unknown IDs, are skipped and counted, like merge_from_file.
+     *
+     * @param filename The file to read
+     * @return Counts of applied and skipped rows
+     * @throws FileOperationException If the file cannot be opened
+     * @throws InventoryException If the header is malformed, or a quantity would not fit in an int;
+     *         the inventory is then unchanged
+     */
+    LocationStockReport load_location_stock(const std::string &filename);
+
     // File operations
     /**
      * @brief Save the current inventory to a CSV file
+     *
+     * If filename names a sharded directory (see save_to_directory), the
+     * inventory is saved there instead, rewriting only dirty shards. A CSV
+     * file is written beside the original and renamed over it, so saving to
+     * the file the inventory was loaded from is safe.
+     *
      * @param filename The name of the file to save to
      * @throws FileOperationException If the file cannot be opened or written to
      */
     void save_to_file(const std::string &filename);
 
+    /**
+     * @brief Write the current inventory as CSV text
+     * @param out The stream to write to
+     */
+    void save_to_stream(std::ostream &out) const;
+
     /**
      * @brief Load inventory from a CSV file
+     *
+     * If filename names a sharded directory, it is loaded with
+     * load_from_directory; a columnar file is loaded with import_columnar.
+     * Descriptions in CSV files are not read until asked for; the file stays
+     * open while any product refers to it.
+     *
      * @param filename The name of the file to load from
      * @throws FileOperationException If the file cannot be opened or read from
      */
     void load_from_file(const std::string &filename);
 
+    /**
+     * @brief Load inventory like load_from_file, reporting failure instead of throwing
+     *
+     * Rows that do not parse are skipped either way. On failure the inventory is unchanged.
+     *
+     * @param filename The name of the file to load from
+     * @return OK, or FILE_ERROR if the file cannot be opened or read from
+     */
+    InventoryStatus try_load_from_file(const std::string &filename);
+
+    /**
+     * @brief Load inventory from CSV text, replacing the current contents
+     * @param in The stream to read, positioned at the header line
+     */
+    void load_from_stream(std::istream &in);
+
+    /**
+     * @brief Stream the products matching a query to a CSV file
+     *
+     * Rows are written as they are found, in the same format as save_to_file,
+     * without building a list of results first.
+     *
+     * @param filename The name of the file to write
+     * @param query The query selecting which products to export
+     * @return The number of products written
+     * @throws FileOperationException If the file cannot be opened or written to
+     */
+    size_t export_query_to_file(const std::string &filename, const ProductQuery &query) const;
+
+    /**
+     * @brief Stream the products matching a query as CSV text
+     * @param out The stream to write to
+     * @param query The query selecting which products to export
+     * @return The number of products written
+     */
+    size_t export_query(std::ostream &out, const ProductQuery &query) const;
+
+    /**
+     * @brief Merge a CSV file into the inventory instead of replacing it
+     *
+     * Each row is joined to the existing product with the same ID through the
+     * ID hash index: existing products are updated, unknown IDs are inserted
+     * with that ID, and rows with an ID of 0 or less are inserted with a newly
+     * assigned ID. If the header has an "Action" column, rows whose action is
+     * "delete" remove the product with that ID. Rows apply in file order, so
+     * when several rows name the same ID the later row wins: an upsert after
+     * a delete keeps the product, and a delete after an upsert removes it.
+     * Like add_product and update_product, a merge never gives two products
+     * the same SKU: a row whose SKU belongs to another product, in the
+     * inventory or earlier in the file, is skipped. Products the file
+     * deletes keep their SKUs until the merge is done. The work is
+     * proportional to the number of incoming rows, except that deletions,
+     * inserts below the largest existing ID and delete_missing each cost one
+     * extra pass over the inventory.
+     *
+     * @param filename The CSV file to merge, in the save_to_file format
+     * @param delete_missing Also remove products whose ID does not appear in the file
+     * @return Counts of inserted, updated, unchanged, deleted and skipped rows
+     * @throws FileOperationException If the file cannot be opened
+     */
+    MergeReport merge_from_file(const std::string &filename, bool delete_missing = false);
+
+    /**
+     * @brief Compare two saved inventories by product ID
+     *
+     * Each input may be a CSV file, a columnar file or a sharded directory, and
+     * is streamed once; see InventoryDiff for how memory stays bounded.
+     *
+     * @param before_path The older inventory
+     * @param after_path The newer inventory
+     * @param visit Called for each added, removed or changed product
+     * @return Counts of each kind of difference
+     * @throws FileOperationException If either input cannot be read
+     */
+    static DiffSummary diff_files(const std::string &before_path, const std::string &after_path,
+                                  const DiffVisitor &visit);
+
+    /**
+     * @brief Compare a saved inventory against the current one
+     * @param before_path The saved inventory (CSV, columnar or sharded directory)
+     * @param visit Called for each product added, removed or changed since it was saved
+     * @return Counts of each kind of difference
+     * @throws FileOperationException If the saved inventory cannot be read
+     */
+    DiffSummary diff_with_file(const std::string &before_path, const DiffVisitor &visit) const;
+
+    /**
+     * @brief Write the differences between two saved inventories as a CSV report
+     *
+     * The report has the columns Change, ID, Field, Before and After, with one
+     * row per added or removed product and one row per changed field.
+     *
+     * @param before_path The older inventory
+     * @param after_path The newer inventory
+     * @param report_filename The report file to write
+     * @return Counts of each kind of difference
+     * @throws FileOperationException If an input cannot be read or the report cannot be written
+     */
+    static DiffSummary write_diff_report(const std::string &before_path, const std::string &after_path,
+                                         const std::string &report_filename);
+
+    /**
+     * @brief Save the inventory as a directory of shard files written in parallel
+     *
+     * Saving again to the same directory with the same scheme only rewrites
+     * shards that contain products added, updated or removed since the last
+     * load or save.
+     *
+     * @param directory The directory to save to (created if missing)
+     * @param scheme Whether to shard by category or by ID range
+     * @param id_range_size Number of IDs per shard when sharding by ID range
+     * @throws FileOperationException If the directory or a shard cannot be written
+     * @throws InventoryException If id_range_size is not positive for ShardScheme::BY_ID_RANGE
+     */
+    void save_to_directory(const std::string &directory,
+                           ShardScheme scheme = ShardScheme::BY_CATEGORY,
+                           int id_range_size = 10000);
+
+    /**
+     * @brief Load inventory from a sharded directory, reading shards in parallel
+     * @param directory The directory written by save_to_directory
+     * @throws FileOperationException If the manifest or a shard cannot be read
+     */
+    void load_from_directory(const std::string &directory);
+
+    /**
+     * @brief Export the inventory in the compressed columnar format (see ColumnarFile)
+     * @param filename The name of the file to write
+     * @throws FileOperationException If the file cannot be opened or written to
+     */
+    void export_columnar(const std::string &filename) const;
+
+    /**
+     * @brief Replace the inventory with the contents of a columnar file
+     * @param filename The name of the file to read
+     * @throws FileOperationException If the file cannot be read or is corrupt
+     */
+    void import_columnar(const std::string &filename);
+
+    /**
+     * @brief Read matching products from a columnar file without loading it
+     *
+     * Blocks whose statistics rule out the predicate are skipped unread.
+     *
+     * @param filename The name of the file to read
+     * @param predicate The ID, quantity, price and category bounds to apply
+     * @return The matching products and the number of blocks read and skipped
+     * @throws FileOperationException If the file cannot be read or is corrupt
+     */
+    static ColumnarScanResult scan_columnar(const std::string &filename, const ColumnarPredicate &predicate);
+
+    // Versions and undo/redo
+
+    /**
+     * @brief Start or stop recording versions of the inventory
+     *
+     * While enabled every edit (add, update, remove, merge and each kind of
+     * load) records a new version that shares all unchanged products with
+     * the previous one, so keeping many versions costs little memory.
+     * Disabling discards the undo and redo history.
+     *
+     * @param enabled Whether to record versions
+     * @param max_undo_steps Maximum number of edits that can be undone
+     */
+    void set_history_enabled(bool enabled, size_t max_undo_steps = 100);
+
+    /**
+     * @brief Check whether versions are being recorded
+     * @return true if undo/redo history is enabled
+     */
+    bool is_history_enabled() const;
+
+    /**
+     * @brief Take an immutable snapshot of the current inventory
+     *
+     * The snapshot is O(1) while history is enabled and O(n) otherwise. It
+     * never changes afterwards and may be read from another thread, for
+     * example to export a consistent view while edits continue.
+     *
+     * @return The snapshot
+     */
+    PersistentProductMap snapshot() const;
+
+    /**
+     * @brief Write a snapshot to a CSV file in the same format as save_to_file
+     * @param snapshot The snapshot to write
+     * @param filename The name of the file to write
+     * @throws FileOperationException If the file cannot be written
+     */
+    static void save_snapshot(const PersistentProductMap &snapshot, const std::string &filename);
+
+    /**
+     * @brief Check whether there is an edit to undo
+     * @return true if undo() would change the inventory
+     */
+    bool can_undo() const;
+
+    /**
+     * @brief Check whether there is an undone edit to redo
+     * @return true if redo() would change the inventory
+     */
+    bool can_redo() const;
+
+    /**
+     * @brief Revert the most recent edit
+     *
+     * IDs handed out by the undone edit are not reused.
+     *
+     * @return true if an edit was undone, false if there was nothing to undo
+     */
+    bool undo();
+
+    /**
+     * @brief Reapply the most recently undone edit
+     * @return true if an edit was redone, false if there was nothing to redo
+     */
+    bool redo();
+
+    // Parallel and background work.
+    // Scans of more than a few thousand products are split over a work-stealing executor.
+    // The async operations run on it too and return at once; until their future is ready the
+    // inventory must not be changed, and during a load it must not be read either. The
+    // inventory must outlive the futures.
+
+    /**
+     * @brief Run parallel scans and async operations on a given executor
+     * @param executor The executor, or null for the process-wide one; change it only while no operation runs
+     */
+    void set_executor(std::shared_ptr<TaskExecutor> executor);
+
+    /**
+     * @brief Get the executor running parallel scans and async operations
+     * @return The executor set, or the process-wide one
+     */
+    TaskExecutor &get_executor() const;
+
+    /**
+     * @brief Load inventory from a file in the background, as load_from_file does
+     * @param filename The name of the file to load from
+     * @return A future that throws FileOperationException from get() if the load failed
+     */
+    TaskFuture<void> load_from_file_async(const std::string &filename);
+
+    /**
+     * @brief Save the inventory in the background, as save_to_file does
+     * @param filename The name of the file to save to
+     * @return A future that throws FileOperationException from get() if the save failed
+     */
+    TaskFuture<void> save_to_file_async(const std::string &filename);
+
+    /**
+     * @brief Collect the products matching a query in the background
+     * @param query The query to evaluate
+     * @return A future for the matching products, in ID order
+     */
+    TaskFuture<std::vector<Product>> find_products_async(const ProductQuery &query) const;
+
+    /**
+     * @brief Calculate the total monetary value of all inventory in the background
+     * @return A future for the total, in cents, that throws InventoryException from get() on overflow
+     */
+    TaskFuture<Cents> get_total_inventory_value_async() const;
+
     /**
      * @brief Replace all occurrences of a substring in a string
      * @param str The original string
@@ -0,0 +1,269 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "inventory_manager.h"
+
+/**
+ * Binary protocol spoken by the inventory service.
+ *
+ * Every message is a frame: a 4-byte little-endian payload length followed by
+ * the payload. Integers are little-endian, money is an i64 number of cents
+ * and strings are a u32 length followed by the bytes.
+ *
+ * Request payload:  u32 request_id, u8 opcode, body
+ * Response payload: u32 request_id, u8 status, body
+ *
+ * A product is encoded as i32 id, string name, string category, i64 price
+ * in cents, i32 quantity, string description. A product whose price is
+ * outside +/-MAX_PRICE_CENTS makes the request malformed. A response whose status is not OK
+ * carries an error message string as its body. Clients may pipeline any
+ * number of requests; responses on a connection come back in request order.
+ */
+
+/**
+ * @brief Request types understood by the service
+ */
+enum class Opcode : uint8_t
+{
+    PING = 0,             // Empty body; empty response
+    GET_PRODUCT = 1,      // i32 id -> product
+    GET_PRODUCTS = 2,     // u32 n, n x i32 id -> u32 n, n x (u8 found, product if found)
+    FIND_BY_NAME = 3,     // u8 search mode, string text, u32 limit -> u32 n, n x product
+    FIND_BY_CATEGORY = 4, // u8 search mode, string text, u32 limit -> u32 n, n x product
+    LOW_STOCK = 5,        // i32 threshold, u32 limit -> u32 n, n x product
+    STATS = 6,            // Empty body -> u32 product count, i64 total quantity, i64 total value in cents
+    CATEGORY_TOTALS = 7,  // Empty body -> u32 n, n x (string category, u32 products, i64 quantity, i64 value in cents)
+    ADD_PRODUCT = 8,      // product, ID ignored -> i32 assigned ID
+    UPDATE_PRODUCT = 9,   // product -> empty
+    REMOVE_PRODUCT = 10,  // i32 id -> empty
+    ADJUST_QUANTITY = 11  // i32 id, i32 delta -> i32 new quantity
+};
+
+/**
+ * @brief Outcome of a request
+ */
+enum class ResponseStatus : uint8_t
+{
+    OK = 0,
+    NOT_FOUND = 1,       // The product does not exist
+    INVALID_REQUEST = 2, // Unknown opcode or malformed body
+    FAILED = 3           // The operation was rejected, e.g. stock would go negative
+};
+
+/**
+ * @brief Largest payload either side accepts; bigger frames close the connection
+ */
+const uint32_t MAX_FRAME_PAYLOAD = 16 * 1024 * 1024;
+
+/**
+ * @brief Size of the length prefix in front of every payload
+ */
+const size_t FRAME_HEADER_SIZE = 4;
+
+/**
+ * @brief Start of the FAILED message of an ADJUST_QUANTITY that would take the quantity out of range
+ */
+const char QUANTITY_OUT_OF_RANGE_MESSAGE[] = "Quantity out of range for product with ID ";
+
+/**
+ * @brief Appends protocol values to a byte buffer
+ */
+class WireWriter
+{
+public:
+    /**
+     * @brief Construct a writer that appends to a buffer
+     * @param buffer The buffer to append to
+     */
+    explicit WireWriter(std::string &buffer);
+
+    /**
+     * @brief Reserve space for a frame length, to be filled in by end_frame()
+     */
+    void begin_frame();
+
+    /**
+     * @brief Fill in the length of the frame started by begin_frame()
+     */
+    void end_frame();
+
+    /**
+     * @brief Get the current end of the buffer, for patch_u32()
+     * @return The buffer size
+     */
+    size_t position() const;
+
+    /**
+     * @brief Overwrite a u32 written earlier, e.g. a count only known at the end
+     * @param position Buffer offset returned by position() before the value was written
+     * @param value The value to store
+     */
+    void patch_u32(size_t position, uint32_t value);
+
+    /**
+     * @brief Append a value in protocol encoding
+     * @param value The value to append
+     */
+    void put_u8(uint8_t value);
+    void put_u32(uint32_t value);
+    void put_i32(int32_t value);
+    void put_i64(int64_t value);
+    void put_string(const std::string &value);
+
+    /**
+     * @brief Append a product in protocol encoding
+     * @param product The product to append
+     */
+    void put_product(const Product &product);
+
+private:
+    std::string &buffer;
+    size_t frame_start;
+};
+
+/**
+ * @brief Reads protocol values from a payload, failing on truncation
+ */
+class WireReader
+{
+public:
+    /**
+     * @brief Construct a reader over a payload
+     * @param data Start of the payload
+     * @param size Payload length in bytes
+     */
+    WireReader(const char *data, size_t size);
+
+    /**
+     * @brief Check whether every read so far stayed inside the payload
+     * @return false once any read ran past the end
+     */
+    bool ok() const;
+
+    /**
+     * @brief Check whether the whole payload was consumed without error
+     * @return true if ok() and no bytes remain
+     */
+    bool at_end() const;
+
+    /**
+     * @brief Read the next value; returns zero or empty and marks the reader failed on truncation
+     * @return The value
+     */
+    uint8_t get_u8();
+    uint32_t get_u32();
+    int32_t get_i32();
+    int64_t get_i64();
+    std::string get_string();
+
+    /**
+     * @brief Read the next product
+     * @return The product; check ok() afterwards
+     */
+    Product get_product();
+
+private:
+    const char *data;
+    size_t size;
+    size_t position;
+    bool failed;
+
+    /**
+     * @brief Consume bytes from the payload
+     * @param bytes Number of bytes wanted
+     * @return Pointer to them, or nullptr if fewer remain (the reader is then failed)
+     */
+    const char *take(size_t bytes);
+};
+
+/**
+ * @brief Executes protocol requests against an inventory
+ *
+ * The service is not thread-safe; the server calls it from its event loop
+ * thread only, which makes that thread the inventory's single writer.
+ */
+class InventoryService
+{
+public:
+    /**
+     * @brief Largest result list returned by a search, whatever limit the client asks for
+     */
+    static const uint32_t MAX_RESULTS = 10000;
+
+    /**
+     * @brief Construct a service over an inventory
+     * @param manager The inventory to serve
+     */
+    explicit InventoryService(InventoryManager &manager);
+
+    /**
+     * @brief Execute one request and append its response frame
+     * @param payload The request payload, without the length prefix
+     * @param size Payload length in bytes
+     * @param out Buffer the response frame is appended to
+     */
+    void handle(const char *payload, size_t size, std::string &out);
+
+    /**
+     * @brief Execute every complete request frame at the start of a buffer
+     *
+     * Pipelined requests are handled in order and their responses are
+     * appended to out, so they can be sent back with one write.
+     *
+     * @param in Received bytes; may end with a partial frame
+     * @param size Number of received bytes
+     * @param out Buffer the response frames are appended to
+     * @return Number of bytes consumed, or SIZE_MAX if a frame is larger than MAX_FRAME_PAYLOAD
+     */
+    size_t handle_frames(const char *in, size_t size, std::string &out);
+
+    /**
+     * @brief Check whether any request so far changed the inventory
+     * @return true if a mutation succeeded since construction
+     */
+    bool has_mutations() const;
+
+    /**
+     * @brief Get the number of requests executed so far
+     * @return The request count
+     */
+    unsigned long long get_request_count() const;
+
+private:
+    InventoryManager &manager;
+    bool mutated;
+    unsigned long long request_count;
+
+    /**
+     * @brief Decode a request body, run it and encode the response body
+     *
+     * Missing products are common with some clients, so they are reported
+     * through the return value rather than an exception.
+     *
+     * @param opcode The request type
+     * @param request Reader positioned at the request body
+     * @param response Writer positioned after the response status
+     * @param message Receives the error message when the status is not OK
+     * @return OK, or NOT_FOUND if the request names a missing product
+     * @throws InventoryException If the request is malformed or the operation fails
+     */
+    ResponseStatus execute(Opcode opcode, WireReader &request, WireWriter &response, std::string &message);
+
+    /**
+     * @brief Report a missing product
+     * @param id The product's ID
+     * @param message Receives the error message
+     * @return NOT_FOUND
+     */
+    static ResponseStatus not_found(int id, std::string &message);
+
+    /**
+     * @brief Report a SKU another product already has
+     * @param sku The SKU
+     * @param message Receives the error message
+     * @return FAILED
+     */
+    static ResponseStatus sku_taken(const std::string &sku, std::string &message);
+};
@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "inventory_protocol.h"
+
+/**
+ * @brief Serves an inventory over a Unix domain or loopback TCP socket
+ *
+ * A single thread runs a non-blocking epoll loop. Each readiness event reads
+ * everything the client has sent, executes every complete request in order
+ * and answers them all with one write, so pipelined clients pay one system
+ * call per batch rather than per request. Because requests only ever run on
+ * the loop thread, reads and mutations are serialized without locks and the
+ * loop is the inventory's single writer. Available on Linux only.
+ */
+class InventoryServer
+{
+public:
+    /**
+     * @brief Construct a server for an inventory
+     * @param manager The inventory to serve; must outlive the server
+     */
+    explicit InventoryServer(InventoryManager &manager);
+
+    /**
+     * @brief Close every socket
+     */
+    ~InventoryServer();
+
+    InventoryServer(const InventoryServer &) = delete;
+    InventoryServer &operator=(const InventoryServer &) = delete;
+
+    /**
+     * @brief Listen on a Unix domain socket, replacing any stale socket file
+     * @param path The socket path
+     * @throws InventoryException If the socket cannot be created or bound
+     */
+    void listen_unix(const std::string &path);
+
+    /**
+     * @brief Listen on a TCP port on the loopback interface only
+     * @param port The port; 0 picks a free one
+     * @return The port actually bound
+     * @throws InventoryException If the socket cannot be created or bound
+     */
+    int listen_tcp(int port);
+
+    /**
+     * @brief Listen on an address of the form "unix:PATH" or "tcp:PORT"
+     * @param address The address
+     * @throws InventoryException If the address is invalid or cannot be bound
+     */
+    void listen(const std::string &address);
+
+    /**
+     * @brief Run the event loop until stop() is called
+     * @throws InventoryException If epoll fails
+     */
+    void run();
+
+    /**
+     * @brief Make run() return; safe to call from a signal handler or another thread
+     */
+    void stop();
+
+    /**
+     * @brief Check whether any request has changed the inventory
+     * @return true if a mutation succeeded since the server was created
+     */
+    bool has_mutations() const;
+
+    /**
+     * @brief Get the number of requests executed so far
+     * @return The request count
+     */
+    unsigned long long get_request_count() const;
+
+private:
+    /**
+     * @brief Buffers of one client connection
+     */
+    struct Connection
+    {
+        std::string input;  // Received bytes not yet executed
+        std::string output; // Responses not yet written
+        size_t output_sent; // Bytes of output already written
+        uint32_t events;    // Current epoll interest set
+        bool read_paused;   // Not reading until output drains
+    };
+
+    InventoryService service;
+    int epoll_fd;
+    int wake_fd;                 // eventfd written by stop()
+    std::vector<int> listen_fds;
+    std::string unix_path;       // Removed on destruction
+    std::unordered_map<int, Connection> connections;
+
+    /**
+     * @brief Register a listening socket with the event loop
+     * @param fd The bound socket
+     */
+    void add_listener(int fd);
+
+    /**
+     * @brief Accept every pending connection on a listening socket
+     * @param listen_fd The listening socket
+     */
+    void accept_connections(int listen_fd);
+
+    /**
+     * @brief Read available bytes from a client and execute complete requests
+     * @param fd The client socket
+     * @return false if the connection was closed
+     */
+    bool read_requests(int fd);
+
+    /**
+     * @brief Write as much buffered output as the socket accepts
+     * @param fd The client socket
+     * @return false if the connection was closed
+     */
+    bool flush_output(int fd);
+
+    /**
+     * @brief Update the epoll interest set of a connection after its buffers changed
+     * @param fd The client socket
+     */
+    void update_interest(int fd);
+
+    /**
+     * @brief Close a client connection
+     * @param fd The client socket
+     */
+    void close_connection(int fd);
+};
@@ -0,0 +1,174 @@
+#pragma once
+#include "product.h"
+#include "money.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Running totals of one stock location
+ */
+struct LocationTotals
+{
+    long long quantity; // Units held at the location
+    size_t stocked;     // Products with a positive quantity there
+    CentsTotal value;   // Exact sum of price * quantity over the location
+
+    LocationTotals() : quantity(0), stocked(0) {}
+};
+
+/**
+ * @brief Product quantities split across stock locations
+ *
+ * Quantities form a dense product-by-location matrix stored one column per
+ * location, each column an int per product in the same order as the
+ * inventory's products. A scan over one location reads one contiguous
+ * array, and the low-stock scans are branch-free loops that compilers
+ * vectorize. At a few dozen locations a dense cell costs four bytes, less
+ * than an entry of any sparse map, so products stocked in only some
+ * locations are stored the same way, with zeros.
+ *
+ * Each location's quantity, stocked product count and value are updated
+ * with every change, so reading them costs nothing.
+ *
+ * A product's quantity is the sum of its row. Changes to that quantity
+ * that do not name a location go to the first location, the default, so it
+ * may go negative until stock is moved there.
+ */
+class LocationStock
+{
+public:
+    // Location argument meaning "at any location"
+    static const int ANY_LOCATION = -1;
+
+    /**
+     * @brief Add a stock location
+     *
+     * The first location takes every product's whole quantity; later ones start empty.
+     *
+     * @param name The location's name
+     * @param products The products, in row order
+     * @return The new location's index
+     * @throws InventoryException If a location already has the name
+     */
+    int add_location(const std::string &name, const std::vector<Product> &products);
+
+    /**
+     * @brief Find a location by name
+     * @param name The name
+     * @return Its index, or -1 if there is none
+     */
+    int find_location(const std::string &name) const;
+
+    /**
+     * @brief Get the location names
+     * @return The names, by index
+     */
+    const std::vector<std::string> &get_location_names() const;
+
+    /**
+     * @brief Check a location index
+     * @param location The index
+     * @throws InventoryException If no location has the index
+     */
+    void check_location(int location) const;
+
+    /**
+     * @brief Add a row for a new product, with its whole quantity at the default location
+     * @param row Position of the product
+     * @param product The product
+     */
+    void insert_row(size_t row, const Product &product);
+
+    /**
+     * @brief Remove a product's row
+     * @param row Position of the product
+     * @param price The product's price, to take its cells out of the totals
+     */
+    void erase_row(size_t row, Cents price);
+
+    /**
+     * @brief Follow a change to a product's price or quantity
+     * @param row Position of the product
+     * @param previous_price The price before the change
+     * @param product The product after the change
+     */
+    void update_row(size_t row, Cents previous_price, const Product &product);
+
+    /**
+     * @brief Rebuild the rows after the products were replaced or reordered
+     *
+     * Products that had rows keep their cells, matched by ID; any difference
+     * from their quantity goes to the default location.
+     *
+     * @param products The products, in their new order
+     */
+    void rebuild(const std::vector<Product> &products);
+
+    /**
+     * @brief Get the quantity of a product at a location
+     * @param row Position of the product
+     * @param location The location
+     * @return The quantity
+     */
+    int get_quantity(size_t row, int location) const
+    {
+        return columns[location][row];
+    }
+
+    /**
+     * @brief Set the quantity of a product at a location
+     *
+     * The product's quantity is not changed; set it to row_total() after.
+     *
+     * @param row Position of the product
+     * @param location The location
+     * @param quantity The new quantity
+     * @param price The product's price, for the location's value
+     */
+    void set_quantity(size_t row, int location, int quantity, Cents price);
+
+    /**
+     * @brief Sum a product's quantities over the locations
+     * @param row Position of the product
+     * @return The total
+     */
+    long long row_total(size_t row) const;
+
+    /**
+     * @brief Get the running totals of a location
+     * @param location The location
+     * @return Its quantity, stocked products and value
+     */
+    const LocationTotals &get_totals(int location) const;
+
+    /**
+     * @brief Find the products low on stock at a location
+     * @param threshold Quantities below this are low
+     * @param location The location, or ANY_LOCATION for products low at any location
+     * @return The positions of the products, in order
+     */
+    std::vector<size_t> find_low_stock_rows(int threshold, int location) const;
+
+    /**
+     * @brief Get the heap bytes held by the matrix and names
+     * @return The byte count
+     */
+    size_t get_heap_bytes() const;
+
+private:
+    std::vector<std::string> names;
+    std::vector<std::vector<int>> columns; // One per location, a quantity per product row
+    std::vector<LocationTotals> totals;    // One per location
+    std::vector<int> row_ids;              // Product ID of each row, to keep cells across rebuilds
+
+    /**
+     * @brief Count a cell into or out of its location's totals
+     * @param location The location
+     * @param quantity The cell's quantity
+     * @param price The product's price
+     * @param adding true to add, false to take away
+     */
+    void count_cell(int location, int quantity, Cents price, bool adding);
+};
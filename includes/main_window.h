@@ -1,6 +1,8 @@
 #pragma once
 
 #include "inventory_manager.h"
+#include "category_totals.h"
+#include "category_chart_dialog.h"
 
 // Qt includes
 #include <QMainWindow>
@@ -10,15 +12,9 @@
 #include <QDoubleSpinBox>
 #include <QLabel>
 #include <QPushButton>
-
-// Chart includes
-#include <QtCharts/QChartView>
-#include <QtCharts/QPieSeries>
-#include <QtCharts/QBarSeries>
-#include <QtCharts/QBarSet>
-#include <QtCharts/QBarCategoryAxis>
-#include <QtCharts/QValueAxis>
-QT_CHARTS_USE_NAMESPACE
+#include <QComboBox>
+#include <QAction>
+#include <QTimer>
 
 /**
  * @brief Main application window for inventory management
@@ -41,6 +37,28 @@ private:
      */
     bool validate_form();
 
+    /**
+     * @brief Get the search mode selected in the search bar
+     * @return The SearchMode matching the current search mode selection
+     */
+    SearchMode selected_search_mode() const;
+
+    /**
+     * @brief Replace the table rows with the given products, one cell per ProductSchema table column
+     * @param products The products to show
+     * @param low_stock_threshold Quantities below this are highlighted
+     * @return The total value of the products shown
+     * @throws InventoryException If the total does not fit in Cents; the rows are filled regardless
+     */
+    Cents fill_table(const std::vector<Product> &products, int low_stock_threshold);
+
+    /**
+     * @brief Show a chart dialog, creating it the first time
+     * @param dialog The member holding the dialog, null until it is created
+     * @param kind What the chart shows
+     */
+    void show_chart_dialog(CategoryChartDialog *&dialog, CategoryChartDialog::Kind kind);
+
 private slots:
     /**
      * @brief Add a new product using the form data
@@ -73,17 +91,22 @@ private slots:
     void update_table();
 
     /**
-     * @brief Display a chart showing inventory value by category
+     * @brief Display a chart showing inventory value by category, kept up to date while open
      */
     void show_inventory_value_chart();
 
     /**
-     * @brief Display a chart showing product count distribution by category
+     * @brief Display a chart showing product count distribution by category, kept up to date while open
      */
     void show_category_distribution_chart();
 
     /**
-     * @brief Export inventory data to a CSV file
+     * @brief Update the open charts with the changes since their last refresh
+     */
+    void refresh_charts();
+
+    /**
+     * @brief Export the products matching the current search filter to a CSV file
      */
     void export_to_csv();
 
@@ -102,6 +125,11 @@ private slots:
      */
     void search_by_category();
 
+    /**
+     * @brief Show the product with the scanned or typed SKU
+     */
+    void search_by_sku();
+
     /**
      * @brief Display low stock products
      * @param threshold The quantity threshold below which products are considered low stock
@@ -113,6 +141,26 @@ private slots:
      */
     void reset_search();
 
+    /**
+     * @brief Revert the most recent change to the inventory
+     */
+    void undo();
+
+    /**
+     * @brief Reapply the most recently undone change
+     */
+    void redo();
+
+    /**
+     * @brief Save recorded operation timings as a latency summary or Chrome trace
+     */
+    void save_timings();
+
+    /**
+     * @brief Show the memory held by each part of the inventory and the allocations per operation
+     */
+    void show_memory_usage();
+
 private:
     QTableWidget *product_table;
     QLineEdit *name_edit;
@@ -120,17 +168,32 @@ private:
     QDoubleSpinBox *price_spin_box;
     QSpinBox *quantity_spin_box;
     QLineEdit *description_edit;
+    QLineEdit *sku_edit;
 
     // Search components
     QLineEdit *search_edit;
     QPushButton *search_name_button;
     QPushButton *search_category_button;
+    QPushButton *search_sku_button;
     QPushButton *reset_search_button;
     QPushButton *low_stock_button;
+    QComboBox *search_mode_combo_box;
 
     // File operation buttons
     QPushButton *import_button;
     QPushButton *export_button;
 
+    // Edit menu actions
+    QAction *undo_action;
+    QAction *redo_action;
+
+    // Charts follow the inventory through category_totals, which is declared
+    // first so that it outlives the manager that notifies it
+    CategoryTotals category_totals;
+    CategoryChartDialog *value_chart_dialog;
+    CategoryChartDialog *distribution_chart_dialog;
+    QTimer *chart_refresh_timer; // Batches the changes of one edit into one chart update
+
     InventoryManager inventory_manager;
+    ProductQuery current_query; // Filter behind the rows currently shown in the table
 };
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Memory introspection for the inventory data structures.
+ *
+ * The library replaces the global operator new and delete with counting
+ * versions that forward to malloc and free. Every allocation bumps two
+ * counters owned by the allocating thread, so the cost is two plain
+ * increments and no shared cache line. Tracing snapshots these counters
+ * around each traced scope to report allocations per operation.
+ *
+ * Per-component sizes are computed by walking each structure and summing the
+ * heap blocks it owns, rounded the way malloc rounds them, so the figures
+ * match what the counting operator new sees for the same data.
+ */
+
+/**
+ * @brief Number and total size of heap allocations
+ */
+struct AllocationCounts
+{
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+};
+
+/**
+ * @brief Reads the counters kept by the counting operator new
+ */
+class AllocationTracker
+{
+public:
+    /**
+     * @brief Get the allocations made so far by the calling thread
+     * @return Counts since the thread started; subtract two readings for an interval
+     */
+    static AllocationCounts get_thread_counts();
+};
+
+/**
+ * @brief Heap bytes owned by one part of a data structure
+ */
+struct MemoryComponent
+{
+    std::string name;
+    size_t bytes;
+};
+
+/**
+ * @brief Estimate the heap block malloc uses for a request
+ *
+ * Follows glibc: an 8-byte header, 16-byte alignment and a 32-byte minimum.
+ *
+ * @param requested The requested size in bytes
+ * @return The size of the block, or 0 for no request
+ */
+inline size_t heap_block_size(size_t requested)
+{
+    if (requested == 0)
+    {
+        return 0;
+    }
+    size_t block = (requested + sizeof(size_t) + 15) & ~static_cast<size_t>(15);
+    return block < 32 ? 32 : block;
+}
+
+/**
+ * @brief Get the heap bytes of a string's buffer
+ * @param text The string
+ * @return 0 when the text fits in the string's inline buffer
+ */
+inline size_t heap_bytes(const std::string &text)
+{
+    static const size_t inline_capacity = std::string().capacity();
+    return text.capacity() > inline_capacity ? heap_block_size(text.capacity() + 1) : 0;
+}
+
+/**
+ * @brief Get the heap bytes of a vector's buffer, not counting what its elements own
+ * @param items The vector
+ * @return The size of the element buffer
+ */
+template <typename T>
+size_t heap_bytes(const std::vector<T> &items)
+{
+    return heap_block_size(items.capacity() * sizeof(T));
+}
+
+/**
+ * @brief Get the heap bytes of an unordered container's buckets and nodes
+ *
+ * Each node holds a next pointer and the value; keys whose hash is slow to
+ * compute also cache it, which this does not count.
+ *
+ * @param table The unordered_map or unordered_set
+ * @return The size of the bucket array and nodes, not counting what the values own
+ */
+template <typename Table>
+size_t hash_table_heap_bytes(const Table &table)
+{
+    // A table with a single bucket keeps it inline
+    size_t buckets = table.bucket_count() > 1 ? table.bucket_count() : 0;
+    return heap_block_size(buckets * sizeof(void *)) +
+           table.size() * heap_block_size(sizeof(void *) + sizeof(typename Table::value_type));
+}
+
+/**
+ * @brief Get the heap bytes of an ordered container's nodes
+ *
+ * Each node holds a color, three pointers and the value.
+ *
+ * @param tree The map or set
+ * @return The size of the nodes, not counting what the values own
+ */
+template <typename Tree>
+size_t tree_heap_bytes(const Tree &tree)
+{
+    return tree.size() * heap_block_size(4 * sizeof(void *) + sizeof(typename Tree::value_type));
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Money is held as a whole number of cents in a signed 64-bit integer.
+ *
+ * Prices are exact, and sums of them do not depend on the order they are
+ * added in, so totals come out the same serially, in parallel and with SIMD.
+ * Conversion to and from text happens only at the CSV, protocol and GUI
+ * boundaries. Unit prices are limited to MAX_PRICE_CENTS so that price times
+ * any int quantity always fits in 64 bits.
+ */
+typedef int64_t Cents;
+
+/**
+ * @brief Largest accepted unit price, $42,949,672.95; price * INT_MAX still fits in Cents
+ */
+const Cents MAX_PRICE_CENTS = 4294967295LL;
+
+/**
+ * @brief Check whether an amount is acceptable as a unit price
+ * @param price_cents The price in cents
+ * @return true if the magnitude is at most MAX_PRICE_CENTS
+ */
+inline bool is_valid_price(Cents price_cents)
+{
+    return price_cents >= -MAX_PRICE_CENTS && price_cents <= MAX_PRICE_CENTS;
+}
+
+/**
+ * @brief Parse a decimal amount of money such as "12", "-3.5" or "19.99"
+ *
+ * Plain decimals are parsed exactly; a third decimal rounds half away from
+ * zero and further decimals are ignored. Other forms strtod accepts, such as
+ * "1.2e+06" written by older versions, are converted through a double and
+ * rounded to the nearest cent.
+ *
+ * @param text The amount, in dollars
+ * @param cents Receives the amount in cents on success
+ * @return false if the text is not a number or does not fit in Cents
+ */
+bool parse_cents(const std::string &text, Cents &cents);
+
+/**
+ * @brief Format cents as a decimal amount with exactly two decimals
+ * @param cents The amount in cents
+ * @return The amount in dollars, such as "19.99" or "-0.05"
+ */
+std::string format_cents(Cents cents);
+
+/**
+ * @brief Buffer size that holds any amount formatted by format_cents()
+ */
+const size_t CENTS_TEXT_SIZE = 24;
+
+/**
+ * @brief Format cents into a caller's buffer, without allocating
+ * @param cents The amount in cents
+ * @param buffer At least CENTS_TEXT_SIZE characters; not null-terminated
+ * @return The number of characters written
+ */
+size_t format_cents(Cents cents, char *buffer);
+
+/**
+ * @brief Convert an amount in dollars to cents, rounding to the nearest cent
+ * @param amount The amount in dollars, as shown in a spin box or stored by an older file format
+ * @return The amount in cents
+ * @throws InventoryException If the amount is not finite or does not fit in Cents
+ */
+Cents cents_from_double(double amount);
+
+/**
+ * @brief Convert cents to dollars for display, such as chart values
+ * @param cents The amount in cents
+ * @return The nearest double
+ */
+inline double cents_to_double(Cents cents)
+{
+    return static_cast<double>(cents) / 100.0;
+}
+
+/**
+ * @brief Exact sum of any number of Cents amounts
+ *
+ * The sum is kept as two 64-bit words: the low 32 bits of each amount are
+ * added into one and the high 32 bits (sign-extended) into the other. Neither
+ * word can overflow within 2^32 additions, far more products than int IDs
+ * allow, and there is no carry between them, so a loop of add() calls is two
+ * independent integer additions per element that compilers vectorize.
+ * Partial sums from different threads combine exactly with add(CentsTotal).
+ */
+class CentsTotal
+{
+public:
+    CentsTotal() : low(0), high(0) {}
+
+    /**
+     * @brief Add an amount
+     * @param amount The amount in cents
+     */
+    void add(Cents amount)
+    {
+        low += static_cast<uint32_t>(amount);
+        high += amount >> 32;
+    }
+
+    /**
+     * @brief Add another partial sum
+     * @param other The sum to add
+     */
+    void add(const CentsTotal &other);
+
+    /**
+     * @brief Take away an amount added earlier
+     *
+     * Carries are folded into the high word each time, so running totals
+     * stay exact through any number of add/subtract pairs.
+     *
+     * @param amount The amount in cents
+     */
+    void subtract(Cents amount);
+
+    /**
+     * @brief Get the sum as Cents
+     * @return The exact sum
+     * @throws InventoryException If the sum does not fit in Cents
+     */
+    Cents to_cents() const;
+
+    /**
+     * @brief Get the sum as a number of dollars for display
+     * @return The nearest double, even if the sum does not fit in Cents
+     */
+    double to_double() const;
+
+    /**
+     * @brief Compare two sums
+     * @param other The sum to compare with
+     * @return true if both hold the same value
+     */
+    bool operator==(const CentsTotal &other) const;
+
+    /**
+     * @brief Order two sums by value
+     * @param other The sum to compare with
+     * @return true if this sum is smaller
+     */
+    bool operator<(const CentsTotal &other) const;
+
+private:
+    uint64_t low; // Sum of the low 32 bits of each amount
+    int64_t high; // Sum of the high 32 bits of each amount; the value is high * 2^32 + low
+
+    /**
+     * @brief Move the carries out of low into high
+     */
+    void normalize();
+};
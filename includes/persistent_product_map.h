@@ -0,0 +1,133 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "product.h"
+#include "inventory_diff.h"
+
+/**
+ * @brief Immutable map from product ID to product with structural sharing
+ *
+ * The map is a 32-way trie over the bits of the ID (a hash array mapped trie
+ * keyed by the ID itself), with bitmap-compressed nodes. Every update returns
+ * a new map that copies only the nodes on the path to the changed ID, at most
+ * seven, and shares everything else with the original. Copying a map is O(1)
+ * and copies never change, so a copy is a consistent snapshot that can be
+ * read from other threads while the owner keeps editing. Iteration visits
+ * products in ascending ID order for non-negative IDs.
+ */
+class PersistentProductMap
+{
+public:
+    /**
+     * @brief Construct an empty map
+     */
+    PersistentProductMap();
+
+    /**
+     * @brief Build a map holding the given products
+     * @param products The products to insert
+     * @return The map
+     */
+    static PersistentProductMap from_products(const std::vector<Product> &products);
+
+    /**
+     * @brief Return a map with a product inserted or replaced
+     * @param product The product, keyed by its ID
+     * @return The new map; this map is unchanged
+     */
+    PersistentProductMap set(const Product &product) const;
+
+    /**
+     * @brief Return a map without the product with the given ID
+     * @param id The ID to remove
+     * @return The new map, or a copy of this map if the ID is absent
+     */
+    PersistentProductMap erase(int id) const;
+
+    /**
+     * @brief Look up a product by ID
+     * @param id The ID to look up
+     * @return The product, or nullptr if absent; valid while any map sharing it exists
+     */
+    const Product *find(int id) const;
+
+    /**
+     * @brief Get the number of products in the map
+     * @return The count
+     */
+    size_t size() const;
+
+    /**
+     * @brief Call a function for every product in ascending ID order
+     * @param visit Called once per product
+     */
+    void for_each(const std::function<void(const Product &)> &visit) const;
+
+    /**
+     * @brief Copy every product into a vector sorted by ID
+     * @return The products
+     */
+    std::vector<Product> to_vector() const;
+
+    /**
+     * @brief Check whether two maps are the same version
+     * @param other The map to compare with
+     * @return true if both share the same root, so their contents are identical
+     */
+    bool same_version(const PersistentProductMap &other) const;
+
+    /**
+     * @brief Get the heap bytes of the nodes and products not counted yet
+     *
+     * Versions share most of their nodes, so the size of a set of versions is
+     * the sum of calling this on each with the same counted set.
+     *
+     * @param counted Nodes and products already counted; updated with the ones counted now
+     * @return The size of the newly counted nodes and products, including their strings
+     */
+    size_t get_memory_usage(std::unordered_set<const void *> &counted) const;
+
+    /**
+     * @brief Report the products that differ between two maps
+     *
+     * Subtrees shared by both maps are skipped without being visited, so the
+     * cost is proportional to the number of changes rather than the map size.
+     *
+     * @param before The older map
+     * @param after The newer map
+     * @param visit Called for each added, removed or changed product
+     */
+    static void diff(const PersistentProductMap &before, const PersistentProductMap &after,
+                     const DiffVisitor &visit);
+
+private:
+    struct Node
+    {
+        uint32_t bitmap;                                    // Which of the 32 slots are occupied
+        std::vector<std::shared_ptr<const Node>> children;  // Occupied slots of an interior node
+        std::vector<std::shared_ptr<const Product>> values; // Occupied slots of a leaf node
+
+        Node() : bitmap(0) {}
+    };
+
+    typedef std::shared_ptr<const Node> NodePtr;
+    typedef std::pair<uint32_t, std::shared_ptr<const Product>> Entry;
+
+    NodePtr root;
+    size_t count;
+
+    PersistentProductMap(const NodePtr &root, size_t count);
+
+    static NodePtr build(const Entry *begin, const Entry *end, int shift);
+    static NodePtr set_in(const NodePtr &node, uint32_t key, int shift,
+                          const std::shared_ptr<const Product> &value, bool &added);
+    static NodePtr erase_in(const NodePtr &node, uint32_t key, int shift, bool &removed);
+    static size_t memory_usage_in(const NodePtr &node, std::unordered_set<const void *> &counted);
+    static void for_each_in(const NodePtr &node, int shift, const std::function<void(const Product &)> &visit);
+    static void diff_in(const NodePtr &before, const NodePtr &after, int shift, const DiffVisitor &visit);
+    static void report_all(const NodePtr &node, int shift, ProductDiff::Kind kind, const DiffVisitor &visit);
+};
@@ -1,5 +1,7 @@
 #pragma once
 #include <string>
+#include "cold_text.h"
+#include "money.h"
 
 /**
  * @brief Represents a product in the inventory system
@@ -10,9 +12,10 @@ private:
     int id;                  // Unique identifier
     std::string name;        // Product name
     std::string category;    // Product category
-    double price;            // Unit price
+    Cents price_cents;       // Unit price in cents
     int quantity;            // Available quantity
-    std::string description; // Product description
+    ColdText description;    // Product description; left in the inventory file until read
+    std::string sku;         // Barcode or stock-keeping unit code; empty if none
 
 public:
     /**
@@ -25,12 +28,14 @@ public:
      * @param id Unique identifier for the product
      * @param name The product name
      * @param category The product category
-     * @param price The unit price
+     * @param price_cents The unit price in cents
      * @param quantity The available quantity
      * @param description The product description (optional)
+     * @param sku The barcode or stock-keeping unit code (optional)
      */
     Product(int id, const std::string &name, const std::string &category,
-            double price, int quantity, const std::string &description = "");
+            Cents price_cents, int quantity, const std::string &description = "",
+            const std::string &sku = "");
 
     // Getters
     /**
@@ -53,9 +58,9 @@ public:
 
     /**
      * @brief Get the unit price
-     * @return The unit price
+     * @return The unit price in cents
      */
-    double get_price() const;
+    Cents get_price_cents() const;
 
     /**
      * @brief Get the available quantity
@@ -64,11 +69,18 @@ public:
     int get_quantity() const;
 
     /**
-     * @brief Get the product description
+     * @brief Get the product description, reading it from the loaded file if necessary
      * @return The product description
+     * @throws FileOperationException If the file it was loaded from can no longer be read
      */
     std::string get_description() const;
 
+    /**
+     * @brief Get the barcode or stock-keeping unit code
+     * @return The SKU, or an empty string if the product has none
+     */
+    std::string get_sku() const;
+
     // Setters
     /**
      * @brief Set the product ID
@@ -90,9 +102,9 @@ public:
 
     /**
      * @brief Set the unit price
-     * @param new_price The new price value
+     * @param new_price_cents The new price in cents
      */
-    void set_price(double new_price);
+    void set_price_cents(Cents new_price_cents);
 
     /**
      * @brief Set the available quantity
@@ -106,12 +118,18 @@ public:
      */
     void set_description(const std::string &new_description);
 
+    /**
+     * @brief Set the barcode or stock-keeping unit code
+     * @param new_sku The new SKU, or an empty string for none
+     */
+    void set_sku(const std::string &new_sku);
+
     // Helper methods
     /**
      * @brief Calculate the total value of this product (price * quantity)
-     * @return The total value
+     * @return The total value in cents; exact for any quantity when the price is valid
      */
-    double get_total_value() const;
+    Cents get_total_value() const;
 
     /**
      * @brief Check if the product is below the given stock threshold
@@ -126,6 +144,18 @@ public:
      */
     std::string to_string() const;
 
+    /**
+     * @brief Get the heap bytes held by the text fields, not counting the object itself
+     * @return The size of the heap buffers of every text field
+     */
+    size_t get_heap_bytes() const;
+
     // For inventory manager internal use
     friend class InventoryManager;
+
+    // Compares SKUs in place on every lookup
+    friend class SkuIndex;
+
+    // Field descriptors name the members directly; see product_schema.h
+    friend struct ProductSchema;
 };
\ No newline at end of file
@@ -0,0 +1,128 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include "product.h"
+
+/**
+ * @brief How search terms are compared against product fields
+ */
+enum class SearchMode
+{
+    EXACT,       // Byte-for-byte comparison
+    IGNORE_CASE, // Compare case-folded, normalized text (see fold_text)
+    FUZZY        // Like IGNORE_CASE, but tolerate a few typos per word
+};
+
+/**
+ * @brief Predicate used to filter products in paged queries
+ */
+typedef std::function<bool(const Product &)> ProductFilter;
+
+/**
+ * @brief A reusable description of which products to select
+ *
+ * A query is a conjunction of clauses: a product matches when it satisfies
+ * every clause, and a query with no clauses matches everything. Queries are
+ * evaluated by InventoryManager, which can use its precomputed search keys and
+ * indexes instead of re-deriving them per product.
+ */
+class ProductQuery
+{
+public:
+    /**
+     * @brief Create a query that matches every product
+     * @return The query
+     */
+    static ProductQuery all();
+
+    /**
+     * @brief Create a query on product names
+     * @param name The name or partial name to search for
+     * @param mode How to compare the name (fuzzy matches are limited to the closest 100)
+     * @return The query
+     */
+    static ProductQuery by_name(const std::string &name, SearchMode mode = SearchMode::EXACT);
+
+    /**
+     * @brief Create a query on product categories
+     * @param category The category to match
+     * @param mode How to compare the category
+     * @return The query
+     */
+    static ProductQuery by_category(const std::string &category, SearchMode mode = SearchMode::EXACT);
+
+    /**
+     * @brief Create a query for products with quantity below a threshold
+     * @param threshold The quantity threshold
+     * @return The query
+     */
+    static ProductQuery low_stock(int threshold);
+
+    /**
+     * @brief Create a query for the product with a SKU or barcode
+     * @param sku The exact SKU
+     * @return The query, answered through the SKU index instead of a scan
+     */
+    static ProductQuery by_sku(const std::string &sku);
+
+    /**
+     * @brief Create a query from an arbitrary predicate
+     * @param filter The predicate products must satisfy
+     * @return The query
+     */
+    static ProductQuery matching(const ProductFilter &filter);
+
+    /**
+     * @brief Add every clause of another query to this one
+     * @param other The query whose clauses must also hold
+     * @return This query, for chaining
+     */
+    ProductQuery &and_also(const ProductQuery &other);
+
+    /**
+     * @brief Check whether the query has no clauses
+     * @return true if the query matches every product
+     */
+    bool matches_all() const;
+
+    /**
+     * @brief Get a key naming what the query selects, for caching its results
+     *
+     * Clauses are normalized: queries with the same clauses in any order, or
+     * whose case-insensitive text differs only in case and accents, share a key.
+     *
+     * @param key Receives the key
+     * @return false if the query cannot be cached: predicates cannot be
+     *         compared, and fuzzy name matches depend on every other name
+     */
+    bool get_cache_key(std::string &key) const;
+
+private:
+    enum class Kind
+    {
+        NAME,
+        CATEGORY,
+        LOW_STOCK,
+        SKU,
+        PREDICATE
+    };
+
+    /**
+     * @brief One condition of the conjunction
+     */
+    struct Clause
+    {
+        Kind kind;
+        SearchMode mode;
+        std::string text;        // Search text as given
+        std::string folded_text; // fold_text(text), for IGNORE_CASE and FUZZY
+        int threshold;
+        ProductFilter filter;
+    };
+
+    std::vector<Clause> clauses;
+
+    // Queries are evaluated by the inventory manager
+    friend class InventoryManager;
+};
@@ -0,0 +1,699 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "product.h"
+#include "csv_codec.h"
+#include "memory_accounting.h"
+
+/**
+ * Codecs say how one type of field is written and read in each format. The
+ * schema picks a codec per column at compile time, so generated code calls
+ * them directly with no switch or virtual call per field.
+ */
+
+/**
+ * @brief Codec for int fields such as the ID and quantity
+ */
+struct IntegerCodec
+{
+    typedef int Value;
+    static constexpr bool NUMERIC = true;
+
+    static void write_csv(std::ostream &out, int value)
+    {
+        char buffer[16];
+        out.write(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr - buffer);
+    }
+
+    /**
+     * @brief Parse like std::stoi: leading blanks and a sign are allowed, trailing text is ignored
+     * @return false if there is no number or it does not fit in an int
+     */
+    static bool parse_csv(const std::string &text, int &value)
+    {
+        const char *begin = text.data();
+        const char *end = begin + text.size();
+        while (begin != end && (*begin == ' ' || *begin == '\t'))
+        {
+            begin++;
+        }
+        if (begin != end && *begin == '+')
+        {
+            begin++;
+        }
+        return std::from_chars(begin, end, value).ec == std::errc();
+    }
+
+    static std::string to_text(int value) { return std::to_string(value); }
+    static std::string to_display(int value) { return std::to_string(value); }
+    static size_t heap_bytes(int) { return 0; }
+
+    template <typename Writer>
+    static void put_wire(Writer &writer, int value) { writer.put_i32(value); }
+
+    template <typename Reader>
+    static bool get_wire(Reader &reader, int &value)
+    {
+        value = reader.get_i32();
+        return true;
+    }
+};
+
+/**
+ * @brief Codec for free text such as the name, category and description
+ */
+struct TextCodec
+{
+    typedef std::string Value;
+    static constexpr bool NUMERIC = false;
+
+    static void write_csv(std::ostream &out, const std::string &value)
+    {
+        write_csv_quoted(out, value);
+    }
+
+    static bool parse_csv(const std::string &text, std::string &value)
+    {
+        value = text;
+        return true;
+    }
+
+    static const std::string &to_text(const std::string &value) { return value; }
+    static const std::string &to_display(const std::string &value) { return value; }
+    static size_t heap_bytes(const std::string &value) { return ::heap_bytes(value); }
+
+    template <typename Writer>
+    static void put_wire(Writer &writer, const std::string &value) { writer.put_string(value); }
+
+    template <typename Reader>
+    static bool get_wire(Reader &reader, std::string &value)
+    {
+        value = reader.get_string();
+        return true;
+    }
+};
+
+/**
+ * @brief Codec for amounts of money held as cents
+ */
+struct MoneyCodec
+{
+    typedef Cents Value;
+    static constexpr bool NUMERIC = true;
+
+    static void write_csv(std::ostream &out, Cents value)
+    {
+        char buffer[CENTS_TEXT_SIZE];
+        out.write(buffer, format_cents(value, buffer));
+    }
+
+    static bool parse_csv(const std::string &text, Cents &value)
+    {
+        return parse_cents(text, value) && is_valid_price(value);
+    }
+
+    static std::string to_text(Cents value) { return format_cents(value); }
+    static std::string to_display(Cents value) { return "$" + format_cents(value); }
+    static size_t heap_bytes(Cents) { return 0; }
+
+    template <typename Writer>
+    static void put_wire(Writer &writer, Cents value) { writer.put_i64(value); }
+
+    template <typename Reader>
+    static bool get_wire(Reader &reader, Cents &value)
+    {
+        value = reader.get_i64();
+        return is_valid_price(value);
+    }
+};
+
+/**
+ * @brief Codec for large, rarely read text kept out of memory, such as the description
+ */
+struct ColdTextCodec
+{
+    typedef ColdText Value;
+    static constexpr bool NUMERIC = false;
+
+    static void write_csv(std::ostream &out, const ColdText &value) { value.write_csv(out); }
+
+    static bool parse_csv(const std::string &text, ColdText &value)
+    {
+        value = ColdText(text);
+        return true;
+    }
+
+    static std::string to_text(const ColdText &value) { return value.str(); }
+    static std::string to_display(const ColdText &value) { return value.str(); }
+    static size_t heap_bytes(const ColdText &value) { return value.get_heap_bytes(); }
+
+    template <typename Writer>
+    static void put_wire(Writer &writer, const ColdText &value) { writer.put_string(value.str()); }
+
+    template <typename Reader>
+    static bool get_wire(Reader &reader, ColdText &value)
+    {
+        value = ColdText(reader.get_string());
+        return true;
+    }
+};
+
+/**
+ * @brief Column flags, combined with |
+ */
+enum ColumnFlags : unsigned
+{
+    KEY_COLUMN = 1,  // Identifies the product; not part of its content
+    TABLE_COLUMN = 2 // Shown in the product table
+};
+
+/**
+ * @brief A column backed by a Product data member
+ * @tparam Member Pointer to the member
+ * @tparam ColumnCodec How the member is written and read
+ * @tparam Flags ColumnFlags
+ */
+template <auto Member, typename ColumnCodec, unsigned Flags = TABLE_COLUMN>
+struct StoredColumn
+{
+    typedef ColumnCodec Codec;
+    typedef typename Codec::Value Value;
+    static constexpr bool STORED = true;
+    static constexpr unsigned FLAGS = Flags;
+
+    const char *name; // Header in CSV files and the product table
+
+    static const Value &get(const Product &product) { return product.*Member; }
+    static Value &get(Product &product) { return product.*Member; }
+};
+
+/**
+ * @brief A column computed from other fields; written out but never read back
+ * @tparam Getter Pointer to the Product member function computing it
+ * @tparam ColumnCodec How the value is written
+ * @tparam Flags ColumnFlags
+ */
+template <auto Getter, typename ColumnCodec, unsigned Flags = TABLE_COLUMN>
+struct DerivedColumn
+{
+    typedef ColumnCodec Codec;
+    typedef typename Codec::Value Value;
+    static constexpr bool STORED = false;
+    static constexpr unsigned FLAGS = Flags;
+
+    const char *name;
+
+    static Value get(const Product &product) { return (product.*Getter)(); }
+};
+
+// Counts the stored columns in a tuple of column descriptors
+template <typename Columns>
+struct StoredColumnCount;
+
+template <typename... Columns>
+struct StoredColumnCount<std::tuple<Columns...>> : std::integral_constant<size_t, (size_t(Columns::STORED) + ... + 0)>
+{
+};
+
+/**
+ * @brief The fields of Product, and every per-field routine generated from them
+ *
+ * `columns` lists each field once, in CSV column order. CSV reading and
+ * writing, the wire encoding, the product table, diffs, merges, to_string()
+ * and memory accounting are all template expansions over that list, so adding
+ * a field to Product is one more line there. Stored columns must come before
+ * derived ones, because the wire format is read by position. CSV files are
+ * matched to the columns by their header (see csv_layout()), so files
+ * written before a column was added still read.
+ *
+ * Every routine unrolls at compile time into the calls a hand-written version
+ * would make; see benchmarks/schema_benchmark.cpp.
+ */
+struct ProductSchema
+{
+    static constexpr auto columns = std::make_tuple(
+        StoredColumn<&Product::id, IntegerCodec, KEY_COLUMN | TABLE_COLUMN>{"ID"},
+        StoredColumn<&Product::name, TextCodec>{"Name"},
+        StoredColumn<&Product::category, TextCodec>{"Category"},
+        StoredColumn<&Product::price_cents, MoneyCodec>{"Price"},
+        StoredColumn<&Product::quantity, IntegerCodec>{"Quantity"},
+        StoredColumn<&Product::description, ColdTextCodec, 0>{"Description"},
+        StoredColumn<&Product::sku, TextCodec>{"SKU"},
+        DerivedColumn<&Product::get_total_value, MoneyCodec>{"Total Value"});
+
+    static constexpr size_t COLUMN_COUNT = std::tuple_size<std::decay_t<decltype(columns)>>::value;
+
+    // Number of columns read from CSV files and the wire
+    static constexpr size_t STORED_COLUMN_COUNT = StoredColumnCount<std::decay_t<decltype(columns)>>::value;
+
+    // Position of a column that a CSV file does not have
+    static constexpr size_t NO_FIELD = SIZE_MAX;
+
+    /**
+     * @brief Where each stored column is in the rows of a CSV file
+     */
+    struct CsvLayout
+    {
+        size_t positions[STORED_COLUMN_COUNT]; // Field holding each stored column, or NO_FIELD
+        size_t min_fields;                     // Fields a row needs to hold every column present
+    };
+
+    /**
+     * @brief The descriptor type of a column
+     * @tparam I Position in `columns`
+     */
+    template <size_t I>
+    using Column = std::decay_t<decltype(std::get<I>(columns))>;
+
+    /**
+     * @brief Get the value of one column
+     * @tparam I Position in `columns`
+     * @param product The product to read
+     * @return The value, by reference for stored columns
+     */
+    template <size_t I>
+    static decltype(auto) get(const Product &product)
+    {
+        return Column<I>::get(product);
+    }
+
+    /**
+     * @brief Comparator ordering products by one column, for std::sort and ordered containers
+     * @tparam I Position in `columns`
+     */
+    template <size_t I>
+    struct Less
+    {
+        bool operator()(const Product &a, const Product &b) const
+        {
+            return Column<I>::get(a) < Column<I>::get(b);
+        }
+    };
+
+    /**
+     * @brief Find a column by name, at compile time
+     * @param name The column header
+     * @return The position in `columns`, or COLUMN_COUNT if no column has that name
+     */
+    static constexpr size_t column_index(std::string_view name)
+    {
+        return column_index(name, std::make_index_sequence<COLUMN_COUNT>());
+    }
+
+    /**
+     * @brief Check that no stored column follows a derived one
+     */
+    static constexpr bool stored_columns_first()
+    {
+        return stored_columns_first(std::make_index_sequence<COLUMN_COUNT>());
+    }
+
+    /**
+     * @brief Get the CSV header row, without a newline
+     * @return The column names separated by commas
+     */
+    static std::string csv_header()
+    {
+        std::string header;
+        for_each_index([&header](auto i)
+                       {
+                           header += i == 0 ? "" : ",";
+                           header += std::get<i>(columns).name;
+                       });
+        return header;
+    }
+
+    /**
+     * @brief Write a product as a CSV row, derived columns included, ending with a newline
+     */
+    static void write_csv_row(std::ostream &out, const Product &product)
+    {
+        for_each_index([&out, &product](auto i)
+                       {
+                           if constexpr (i > 0)
+                           {
+                               out.put(',');
+                           }
+                           Column<i>::Codec::write_csv(out, Column<i>::get(product));
+                       });
+        out.put('\n');
+    }
+
+    /**
+     * @brief Parse the stored columns of a split CSV row into a product
+     *
+     * Fields are parsed in place, so reusing one product across rows reuses
+     * its string buffers.
+     *
+     * @param fields The row's fields in column order; derived and extra fields are ignored
+     * @param product Receives the fields; unspecified if parsing fails
+     * @return false if there are too few fields or one is invalid
+     */
+    static bool parse_csv_fields(const std::vector<std::string> &fields, Product &product)
+    {
+        return fields.size() >= STORED_COLUMN_COUNT &&
+               parse_csv_fields(fields, product, std::make_index_sequence<STORED_COLUMN_COUNT>());
+    }
+
+    /**
+     * @brief Match the stored columns to the header row of a CSV file
+     *
+     * Columns are found by name, so files written before a column was added,
+     * or with the columns in another order, read correctly; columns the file
+     * lacks are left empty. A header that does not name the ID column, such
+     * as one with a byte order mark, is taken to be in column order.
+     *
+     * @param header The header row, split into fields
+     * @return The position of each stored column
+     */
+    static CsvLayout csv_layout(const std::vector<std::string> &header)
+    {
+        CsvLayout layout;
+        layout.min_fields = 0;
+        bool named_key = false;
+        for_each_stored_index([&header, &layout, &named_key](auto i)
+                              {
+                                  auto found = std::find(header.begin(), header.end(), std::get<i>(columns).name);
+                                  layout.positions[i] = found == header.end() ? NO_FIELD : size_t(found - header.begin());
+                                  if (found != header.end())
+                                  {
+                                      layout.min_fields = std::max(layout.min_fields, layout.positions[i] + 1);
+                                      named_key |= (Column<i>::FLAGS & KEY_COLUMN) != 0;
+                                  }
+                              });
+        if (!named_key)
+        {
+            for (size_t i = 0; i < STORED_COLUMN_COUNT; i++)
+            {
+                layout.positions[i] = i;
+            }
+            layout.min_fields = STORED_COLUMN_COUNT;
+        }
+        return layout;
+    }
+
+    /**
+     * @brief Parse the stored columns of a split CSV row laid out as in a file's header
+     * @param fields The row's fields
+     * @param product Receives the fields; columns the file lacks are cleared
+     * @param layout The positions returned by csv_layout()
+     * @return false if there are too few fields or one is invalid
+     */
+    static bool parse_csv_fields(const std::vector<std::string> &fields, Product &product, const CsvLayout &layout)
+    {
+        return fields.size() >= layout.min_fields &&
+               parse_csv_fields(fields, product, layout, std::make_index_sequence<STORED_COLUMN_COUNT>());
+    }
+
+    /**
+     * @brief Encode the stored columns of a product
+     * @param writer A WireWriter or anything with the same put_ functions
+     */
+    template <typename Writer>
+    static void put_wire(Writer &writer, const Product &product)
+    {
+        for_each_stored_index([&writer, &product](auto i)
+                              { Column<i>::Codec::put_wire(writer, Column<i>::get(product)); });
+    }
+
+    /**
+     * @brief Decode the stored columns of a product
+     * @param reader A WireReader or anything with the same get_ functions
+     * @param product Receives the fields
+     * @return false if a field held an invalid value
+     */
+    template <typename Reader>
+    static bool get_wire(Reader &reader, Product &product)
+    {
+        bool valid = true;
+        for_each_stored_index([&reader, &product, &valid](auto i)
+                              { valid &= Column<i>::Codec::get_wire(reader, Column<i>::get(product)); });
+        return valid;
+    }
+
+    /**
+     * @brief Compare every stored column except the key
+     * @return true if the two products differ at most in ID
+     */
+    static bool same_content(const Product &a, const Product &b)
+    {
+        bool same = true;
+        for_each_content_index([&a, &b, &same](auto i)
+                               { same = same && Column<i>::get(a) == Column<i>::get(b); });
+        return same;
+    }
+
+    /**
+     * @brief Copy every stored column except the key
+     * @param to The product to update
+     * @param from The product to copy from
+     */
+    static void copy_content(Product &to, const Product &from)
+    {
+        for_each_content_index([&to, &from](auto i)
+                               { Column<i>::get(to) = Column<i>::get(from); });
+    }
+
+    /**
+     * @brief Visit the value of every stored column except the key, in column order
+     * @param visit Called with each value; numbers as they are, text as std::string
+     */
+    template <typename Visitor>
+    static void for_each_content_value(const Product &product, Visitor &&visit)
+    {
+        for_each_content_index([&product, &visit](auto i)
+                               {
+                                   if constexpr (std::is_arithmetic<typename Column<i>::Value>::value)
+                                   {
+                                       visit(Column<i>::get(product));
+                                   }
+                                   else
+                                   {
+                                       visit(Column<i>::Codec::to_text(Column<i>::get(product)));
+                                   }
+                               });
+    }
+
+    /**
+     * @brief Visit the columns kept as ColdText
+     * @param visit Called with each column's position in `columns` and its value in the product
+     */
+    template <typename Visitor>
+    static void for_each_cold_column(Product &product, Visitor &&visit)
+    {
+        for_each_stored_index([&product, &visit](auto i)
+                              {
+                                  if constexpr (std::is_same<typename Column<i>::Value, ColdText>::value)
+                                  {
+                                      visit(size_t(i), Column<i>::get(product));
+                                  }
+                              });
+    }
+
+    /**
+     * @brief Visit every stored column, except the key, whose value differs
+     * @param visit Called with the column name and the old and new values as text
+     */
+    template <typename Visitor>
+    static void for_each_changed_field(const Product &before, const Product &after, Visitor &&visit)
+    {
+        for_each_content_index([&before, &after, &visit](auto i)
+                               {
+                                   const auto &old_value = Column<i>::get(before);
+                                   const auto &new_value = Column<i>::get(after);
+                                   if (old_value != new_value)
+                                   {
+                                       visit(std::get<i>(columns).name, Column<i>::Codec::to_text(old_value),
+                                             Column<i>::Codec::to_text(new_value));
+                                   }
+                               });
+    }
+
+    /**
+     * @brief Describe the stored table columns, as in "ID: 1, Name: Bolt, ..."
+     */
+    static std::string describe(const Product &product)
+    {
+        std::string text;
+        for_each_stored_index([&text, &product](auto i)
+                              {
+                                  if constexpr ((Column<i>::FLAGS & TABLE_COLUMN) != 0)
+                                  {
+                                      text += text.empty() ? "" : ", ";
+                                      text += std::get<i>(columns).name;
+                                      text += ": ";
+                                      text += Column<i>::Codec::to_display(Column<i>::get(product));
+                                  }
+                              });
+        return text;
+    }
+
+    /**
+     * @brief Get the heap bytes held by the product's fields
+     */
+    static size_t get_heap_bytes(const Product &product)
+    {
+        size_t bytes = 0;
+        for_each_stored_index([&bytes, &product](auto i)
+                              { bytes += Column<i>::Codec::heap_bytes(Column<i>::get(product)); });
+        return bytes;
+    }
+
+    /**
+     * @brief Get the headers of the product table columns, in display order
+     */
+    static std::vector<const char *> table_column_names()
+    {
+        std::vector<const char *> names;
+        for_each_index([&names](auto i)
+                       {
+                           if constexpr ((Column<i>::FLAGS & TABLE_COLUMN) != 0)
+                           {
+                               names.push_back(std::get<i>(columns).name);
+                           }
+                       });
+        return names;
+    }
+
+    /**
+     * @brief Find a product table column by name, at compile time
+     * @param name The column header
+     * @return The table column index, or -1 if no table column has that name
+     */
+    static constexpr int table_column_index(std::string_view name)
+    {
+        return table_column_index(name, std::make_index_sequence<COLUMN_COUNT>());
+    }
+
+    /**
+     * @brief Visit the product table cells of a product, in display order
+     * @param visit Called with the table column index, the display text and whether the value is numeric
+     */
+    template <typename Visitor>
+    static void for_each_table_cell(const Product &product, Visitor &&visit)
+    {
+        int column = 0;
+        for_each_index([&column, &product, &visit](auto i)
+                       {
+                           if constexpr ((Column<i>::FLAGS & TABLE_COLUMN) != 0)
+                           {
+                               visit(column++, Column<i>::Codec::to_display(Column<i>::get(product)),
+                                     Column<i>::Codec::NUMERIC);
+                           }
+                       });
+    }
+
+private:
+    // Calls visit(std::integral_constant<size_t, I>) for each column I, unrolled
+    template <typename Visitor, size_t... I>
+    static void for_each_index(Visitor &&visit, std::index_sequence<I...>)
+    {
+        (visit(std::integral_constant<size_t, I>()), ...);
+    }
+
+    template <typename Visitor>
+    static void for_each_index(Visitor &&visit)
+    {
+        for_each_index(visit, std::make_index_sequence<COLUMN_COUNT>());
+    }
+
+    template <typename Visitor>
+    static void for_each_stored_index(Visitor &&visit)
+    {
+        for_each_index(visit, std::make_index_sequence<STORED_COLUMN_COUNT>());
+    }
+
+    template <typename Visitor>
+    static void for_each_content_index(Visitor &&visit)
+    {
+        for_each_stored_index([&visit](auto i)
+                              {
+                                  if constexpr ((Column<i>::FLAGS & KEY_COLUMN) == 0)
+                                  {
+                                      visit(i);
+                                  }
+                              });
+    }
+
+    template <size_t... I>
+    static bool parse_csv_fields(const std::vector<std::string> &fields, Product &product, std::index_sequence<I...>)
+    {
+        return (Column<I>::Codec::parse_csv(fields[I], Column<I>::get(product)) && ...);
+    }
+
+    template <size_t... I>
+    static bool parse_csv_fields(const std::vector<std::string> &fields, Product &product, const CsvLayout &layout,
+                                 std::index_sequence<I...>)
+    {
+        return (parse_csv_field<I>(fields, product, layout.positions[I]) && ...);
+    }
+
+    template <size_t I>
+    static bool parse_csv_field(const std::vector<std::string> &fields, Product &product, size_t position)
+    {
+        if (position == NO_FIELD)
+        {
+            Column<I>::get(product) = typename Column<I>::Value();
+            return true;
+        }
+        return Column<I>::Codec::parse_csv(fields[position], Column<I>::get(product));
+    }
+
+    template <size_t... I>
+    static constexpr size_t column_index(std::string_view name, std::index_sequence<I...>)
+    {
+        const char *names[] = {std::get<I>(columns).name...};
+        for (size_t i = 0; i < COLUMN_COUNT; i++)
+        {
+            if (name == names[i])
+            {
+                return i;
+            }
+        }
+        return COLUMN_COUNT;
+    }
+
+    template <size_t... I>
+    static constexpr int table_column_index(std::string_view name, std::index_sequence<I...>)
+    {
+        const char *names[] = {std::get<I>(columns).name...};
+        const bool shown[] = {(Column<I>::FLAGS & TABLE_COLUMN) != 0 ...};
+        int position = 0;
+        for (size_t i = 0; i < COLUMN_COUNT; i++)
+        {
+            if (shown[i])
+            {
+                if (name == names[i])
+                {
+                    return position;
+                }
+                position++;
+            }
+        }
+        return -1;
+    }
+
+    template <size_t... I>
+    static constexpr bool stored_columns_first(std::index_sequence<I...>)
+    {
+        const bool stored[] = {Column<I>::STORED...};
+        for (size_t i = 1; i < COLUMN_COUNT; i++)
+        {
+            if (stored[i] && !stored[i - 1])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+static_assert(ProductSchema::stored_columns_first(), "Stored columns must precede derived ones");
@@ -0,0 +1,180 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Counters and size of a QueryCache
+ */
+struct QueryCacheStats
+{
+    uint64_t hits;      // Answered from an entry no change had touched
+    uint64_t refreshes; // Answered from an entry after re-testing the products changed since
+    uint64_t misses;    // Evaluated in full: not cached, or too much had changed
+    uint64_t evictions; // Entries dropped, least recently used first, to stay within the limit
+    size_t entries;
+    size_t bytes;       // Heap bytes held by the entries
+    size_t max_bytes;
+
+    QueryCacheStats() : hits(0), refreshes(0), misses(0), evictions(0), entries(0), bytes(0), max_bytes(0) {}
+
+    /**
+     * @brief Get the share of lookups answered without a full evaluation
+     * @return (hits + refreshes) / lookups, or 0 before the first lookup
+     */
+    double hit_ratio() const;
+};
+
+/**
+ * @brief Results of recent queries, kept current across changes to the products
+ *
+ * Entries hold the IDs of the matching products, in ascending order, under
+ * the query's normalized key (see ProductQuery::get_cache_key). Every change
+ * to a product advances the store's generation and logs the product's ID;
+ * an entry records the generation it was evaluated at. When an entry is
+ * looked up after products changed, only the logged products are tested
+ * again and merged into it, instead of evaluating the query over every
+ * product. Replacing the whole inventory, or more changes than the log
+ * holds, leaves older entries to be evaluated in full.
+ *
+ * Entries are dropped least recently used first to keep their heap bytes
+ * under a limit. Lookups share the entry's IDs rather than copying them; a
+ * refresh replaces them, leaving lists already handed out as they were.
+ * A mutex guards the cache, so const queries may look it up
+ * from several threads. Copies keep the limit and generation but start
+ * empty, so copying the store that owns a cache does not copy its results.
+ */
+class QueryCache
+{
+public:
+    // Limit on the heap bytes of the entries; about four bytes per cached match
+    static const size_t DEFAULT_MAX_BYTES = 16 << 20;
+
+    // IDs of the matching products, ascending
+    typedef std::shared_ptr<const std::vector<int>> IdList;
+
+    /**
+     * @brief Create an empty cache
+     * @param max_bytes Limit on the heap bytes of the entries; 0 disables caching
+     */
+    explicit QueryCache(size_t max_bytes = DEFAULT_MAX_BYTES);
+
+    /**
+     * @brief Create an empty cache with another's limit and generation
+     * @param other The cache to copy
+     */
+    QueryCache(const QueryCache &other);
+
+    /**
+     * @brief Empty the cache and take another's limit, advancing past both generations
+     * @param other The cache to copy
+     * @return This cache
+     */
+    QueryCache &operator=(const QueryCache &other);
+
+    /**
+     * @brief Look up a query's matches, bringing a stale entry up to date
+     * @param key The query's normalized key
+     * @param ids Receives the IDs of the matching products
+     * @param matches Tests whether the product with an ID matches the query now
+     * @return true if the entry was found; false if the query must be evaluated
+     */
+    bool find(const std::string &key, IdList &ids, const std::function<bool(int)> &matches);
+
+    /**
+     * @brief Store a query's matches
+     * @param key The query's normalized key
+     * @param ids The IDs of the matching products
+     * @param generation The generation the query was evaluated at, from get_generation()
+     */
+    void store(const std::string &key, IdList ids, uint64_t generation);
+
+    /**
+     * @brief Get the store generation, which every change advances
+     * @return The generation
+     */
+    uint64_t get_generation() const;
+
+    /**
+     * @brief Record that a product was added, changed or removed
+     * @param id The product's ID
+     */
+    void product_changed(int id);
+
+    /**
+     * @brief Record that the whole inventory was replaced
+     */
+    void products_replaced();
+
+    /**
+     * @brief Change the limit on the heap bytes of the entries, evicting as needed
+     * @param max_bytes The limit; 0 empties the cache and disables it
+     */
+    void set_max_bytes(size_t max_bytes);
+
+    /**
+     * @brief Check whether the cache stores anything
+     * @return false if the limit is 0
+     */
+    bool is_enabled() const;
+
+    /**
+     * @brief Get the counters and size of the cache
+     * @return The stats
+     */
+    QueryCacheStats get_stats() const;
+
+    /**
+     * @brief Get the heap bytes held by the entries and the change log
+     * @return The byte count
+     */
+    size_t get_heap_bytes() const;
+
+private:
+    /**
+     * @brief The matches of one query
+     */
+    struct Entry
+    {
+        std::string key;
+        IdList ids;
+        uint64_t generation;   // The generation ids reflect
+        size_t bytes;          // Heap bytes charged to the entry
+    };
+
+    std::list<Entry> entries; // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> by_key;
+    size_t bytes;
+    size_t max_bytes;
+
+    uint64_t generation;
+    uint64_t log_start;           // Generation before the first logged change
+    std::vector<int> changed_ids; // ID changed at each generation after log_start
+
+    QueryCacheStats stats;
+    mutable std::mutex mutex;
+
+    /**
+     * @brief Compute the heap bytes to charge an entry
+     * @param entry The entry
+     * @return Its list node, key, ID list and key table node
+     */
+    static size_t entry_bytes(const Entry &entry);
+
+    /**
+     * @brief Drop an entry
+     * @param entry The entry
+     */
+    void erase(std::list<Entry>::iterator entry);
+
+    /**
+     * @brief Drop least recently used entries until the entries fit the limit
+     */
+    void evict();
+};
@@ -0,0 +1,182 @@
+#pragma once
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "product.h"
+
+/**
+ * @brief How products are partitioned into shard files
+ */
+enum class ShardScheme
+{
+    BY_CATEGORY, // One shard per category
+    BY_ID_RANGE  // One shard per fixed-size range of IDs
+};
+
+/**
+ * @brief Directory-based inventory storage split into independently written shards
+ *
+ * A sharded directory holds a manifest plus one CSV file per shard, each in the
+ * same format as save_to_file. Shards are read and written in parallel, one per
+ * worker thread. Once a directory has been loaded or saved the store stays bound
+ * to it and tracks which shards contain modified products, so later saves to the
+ * same directory rewrite only those shards. Files are written to a temporary name
+ * and renamed into place, and the manifest is replaced last.
+ */
+class ShardedStore
+{
+public:
+    /**
+     * @brief Name of the manifest file inside a sharded directory
+     */
+    static const char *const MANIFEST_FILE;
+
+    /**
+     * @brief Construct an unbound store
+     */
+    ShardedStore();
+
+    /**
+     * @brief Check whether a path is a directory containing a shard manifest
+     * @param path The path to check
+     * @return true if the path can be passed to load
+     */
+    static bool is_sharded_directory(const std::string &path);
+
+    /**
+     * @brief List the shard files of a sharded directory
+     * @param directory The sharded directory
+     * @return Paths of every shard listed in the manifest
+     * @throws FileOperationException If the manifest cannot be read
+     */
+    static std::vector<std::string> shard_paths(const std::string &directory);
+
+    /**
+     * @brief Load every shard listed in a directory's manifest, in parallel
+     * @param directory The sharded directory
+     * @param next_product_id Receives the next free product ID recorded in the manifest
+     * @return All products, unsorted
+     * @throws FileOperationException If the manifest or a shard cannot be read
+     */
+    std::vector<Product> load(const std::string &directory, int &next_product_id);
+
+    /**
+     * @brief Save products using an explicit sharding scheme
+     *
+     * If the store is already bound to this directory with the same scheme, only
+     * dirty shards are rewritten; otherwise every shard is written and shard files
+     * from a previous manifest that are no longer used are removed.
+     *
+     * @param directory The target directory (created if missing)
+     * @param scheme How products are partitioned
+     * @param id_range_size Number of IDs per shard for ShardScheme::BY_ID_RANGE
+     * @param products All products in the inventory
+     * @param next_product_id The next free product ID, recorded in the manifest
+     * @throws FileOperationException If a shard or the manifest cannot be written
+     */
+    void save(const std::string &directory, ShardScheme scheme, int id_range_size,
+              const std::vector<Product> &products, int next_product_id);
+
+    /**
+     * @brief Save products reusing the directory's existing scheme
+     *
+     * Uses the bound scheme if bound to this directory, then the scheme in the
+     * directory's manifest, and finally ShardScheme::BY_CATEGORY.
+     *
+     * @param directory The target directory
+     * @param products All products in the inventory
+     * @param next_product_id The next free product ID, recorded in the manifest
+     * @throws FileOperationException If a shard or the manifest cannot be written
+     */
+    void save(const std::string &directory, const std::vector<Product> &products, int next_product_id);
+
+    /**
+     * @brief Record that a product's shard must be rewritten on the next save
+     * @param product The product that was added, changed or removed
+     */
+    void mark_dirty(const Product &product);
+
+    /**
+     * @brief Forget the bound directory, e.g. after loading from a plain CSV file
+     */
+    void unbind();
+
+    /**
+     * @brief Get the directory the store is bound to
+     * @return The directory, or an empty string if unbound
+     */
+    const std::string &get_directory() const;
+
+    /**
+     * @brief Get the number of shards that will be rewritten by the next save
+     * @return The count of dirty shards
+     */
+    size_t get_dirty_shard_count() const;
+
+    /**
+     * @brief Get the heap bytes used to track the bound directory and its shards
+     * @return The size of the shard table and dirty set
+     */
+    size_t get_memory_usage() const;
+
+private:
+    /**
+     * @brief A shard as recorded in the manifest
+     */
+    struct ShardEntry
+    {
+        std::string file;
+        size_t rows;
+    };
+
+    /**
+     * @brief The parsed contents of a manifest file
+     */
+    struct Manifest
+    {
+        ShardScheme scheme;
+        int id_range_size;
+        int next_product_id;
+        std::map<std::string, ShardEntry> shards; // Keyed by shard key
+    };
+
+    std::string directory;
+    ShardScheme scheme;
+    int id_range_size;
+    std::map<std::string, ShardEntry> shards;
+    std::unordered_set<std::string> dirty_shards;
+
+    /**
+     * @brief Get the key of the shard a product belongs to
+     * @param product The product
+     * @param scheme The sharding scheme
+     * @param id_range_size Number of IDs per shard for ShardScheme::BY_ID_RANGE
+     * @return The shard key (the category, or the first ID of the range)
+     */
+    static std::string shard_key(const Product &product, ShardScheme scheme, int id_range_size);
+
+    /**
+     * @brief Get the file name used for a shard key
+     * @param key The shard key
+     * @param scheme The sharding scheme
+     * @return A file name that is safe on any file system
+     */
+    static std::string shard_file_name(const std::string &key, ShardScheme scheme);
+
+    /**
+     * @brief Read and parse a directory's manifest
+     * @param directory The sharded directory
+     * @return The manifest
+     * @throws FileOperationException If the manifest cannot be read or is malformed
+     */
+    static Manifest read_manifest(const std::string &directory);
+
+    /**
+     * @brief Atomically replace a directory's manifest
+     * @param directory The sharded directory
+     * @param manifest The manifest to write
+     * @throws FileOperationException If the manifest cannot be written
+     */
+    static void write_manifest(const std::string &directory, const Manifest &manifest);
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include "product.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Index from SKU to product position, built as a minimal perfect hash
+ *
+ * build() gives every SKU its own slot in a table with exactly one slot per
+ * SKU, with no collisions to probe. SKUs are hashed into buckets of about
+ * four; each bucket stores a small "pilot" chosen at build time that sends
+ * all its SKUs to free slots. A lookup hashes the SKU once, reads the
+ * bucket's pilot, then the slot, and compares the SKU of the product there:
+ * three cache misses, about 9 bytes per SKU.
+ *
+ * SKUs added or changed after the build go to a hash map of their own, which
+ * is searched after the table. Once it holds a quarter as many SKUs as the
+ * table, the table is rebuilt with them, so adds stay amortized O(1).
+ *
+ * SKUs are meant to be unique. When several products share one, the index
+ * finds the one indexed first; the others wait in a side table and the
+ * lowest of their positions takes over once that one is removed.
+ */
+class SkuIndex
+{
+public:
+    // Returned by find() for SKUs no product has
+    static const size_t NOT_FOUND = SIZE_MAX;
+
+    SkuIndex();
+
+    /**
+     * @brief Rebuild the table over every product's SKU
+     * @param products The products; positions in the index are positions here
+     */
+    void build(const std::vector<Product> &products);
+
+    /**
+     * @brief Find the product with a SKU
+     * @param sku The SKU
+     * @param products The products the index was built over
+     * @return The product's position, or NOT_FOUND
+     */
+    size_t find(std::string_view sku, const std::vector<Product> &products) const;
+
+    /**
+     * @brief Index the SKU of a product that was added or changed
+     *
+     * Rebuilds the table if the overflow map has grown too large.
+     *
+     * @param row Position of the product
+     * @param products The products, with the product at row already in place
+     */
+    void add(size_t row, const std::vector<Product> &products);
+
+    /**
+     * @brief Stop indexing a product's SKU, before it is removed or its SKU changes
+     * @param row Position of the product
+     * @param sku The SKU it was indexed under
+     */
+    void remove(size_t row, const std::string &sku);
+
+    /**
+     * @brief Shift the positions of products after an insertion or removal
+     * @param first The first position that moved
+     * @param offset How far the products moved: 1 after an insertion, -1 after a removal
+     */
+    void shift_rows(size_t first, int offset);
+
+    /**
+     * @brief Get the heap bytes held by the table and overflow map
+     * @return The byte count
+     */
+    size_t get_heap_bytes() const;
+
+private:
+    // Slot::row of a slot whose product was removed
+    static const uint32_t EMPTY_ROW = UINT32_MAX;
+
+    /**
+     * @brief One table entry
+     */
+    struct Slot
+    {
+        uint32_t fingerprint; // Low bits of the SKU's hash, to skip most non-matching rows unread
+        uint32_t row;         // Position of the product, or EMPTY_ROW
+    };
+
+    std::vector<uint32_t> pilots; // Chosen per bucket at build time
+    std::vector<Slot> slots;      // One per SKU in the table
+    std::vector<uint32_t> remap;  // Slot for each position past the table end
+    uint64_t position_range;      // Positions drawn from [0, position_range); the rest remap into the table
+
+    std::unordered_map<std::string, size_t> overflow;      // SKUs added since the build
+    std::unordered_multimap<std::string, size_t> shadowed; // Rows whose SKU another row holds
+
+    /**
+     * @brief Hash a SKU
+     * @param sku The SKU
+     * @return A 64-bit hash, deciding the bucket, the slot and the fingerprint
+     */
+    static uint64_t hash(std::string_view sku);
+
+    /**
+     * @brief Find the slot the table gives a hash, whether or not that SKU was built in
+     * @param key_hash The SKU's hash
+     * @return The slot's position; the table must not be empty
+     */
+    size_t slot_of(uint64_t key_hash) const;
+
+    /**
+     * @brief Index a waiting row for a SKU whose holder was removed
+     * @param sku The SKU
+     */
+    void promote_shadowed(const std::string &sku);
+};
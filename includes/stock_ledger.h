@@ -0,0 +1,357 @@
+#pragma once
+#include "inventory_manager.h"
+#include "memory_accounting.h"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Why a product's stock changed
+ */
+enum class MovementReason : uint8_t
+{
+    RECEIVED, // Delivered into stock
+    SOLD,     // Shipped to a customer
+    RETURNED, // Brought back by a customer
+    ADJUSTED  // Counted, written off or edited by hand
+};
+
+// Number of MovementReason values; reasons are stored in two bits each
+const size_t MOVEMENT_REASON_COUNT = 4;
+
+/**
+ * @brief Get the name of a reason as written in movement CSV files
+ * @param reason The reason
+ * @return "received", "sold", "returned" or "adjusted"
+ */
+const char *movement_reason_name(MovementReason reason);
+
+/**
+ * @brief Parse the name of a reason
+ * @param name The name, as returned by movement_reason_name()
+ * @param reason Receives the reason
+ * @return true if the name is known
+ */
+bool parse_movement_reason(const std::string &name, MovementReason &reason);
+
+/**
+ * @brief Parse a time as seconds since 1970-01-01 UTC
+ *
+ * Accepts a number of seconds, a date ("2024-05-31") or a date and time in
+ * UTC ("2024-05-31T14:30:00", optionally ending in "Z").
+ *
+ * @param text The text to parse
+ * @param timestamp Receives the time
+ * @return true if the text is a valid time
+ */
+bool parse_timestamp(const std::string &text, int64_t &timestamp);
+
+/**
+ * @brief Format a time as a date and time in UTC, such as "2024-05-31T14:30:00Z"
+ * @param timestamp Seconds since 1970-01-01 UTC
+ * @return The formatted time
+ */
+std::string format_timestamp(int64_t timestamp);
+
+/**
+ * @brief One change to a product's stock
+ */
+struct StockMovement
+{
+    int product_id;
+    int64_t timestamp; // Seconds since 1970-01-01 UTC
+    int64_t delta;     // Units added, or removed if negative
+    MovementReason reason;
+};
+
+/**
+ * @brief Sums over a set of stock movements
+ */
+struct MovementTotals
+{
+    int64_t units[MOVEMENT_REASON_COUNT]; // Sum of the deltas with each reason
+    uint64_t movements;                   // Number of movements
+
+    MovementTotals() : units{}, movements(0) {}
+
+    /**
+     * @brief Get the sum of the deltas with one reason
+     * @param reason The reason
+     * @return The units moved for that reason; negative for sales and most write-offs
+     */
+    int64_t get_units(MovementReason reason) const
+    {
+        return units[static_cast<size_t>(reason)];
+    }
+
+    /**
+     * @brief Get the sum of all deltas
+     * @return The net change in stock
+     */
+    int64_t net() const;
+
+    /**
+     * @brief Count one movement in
+     * @param reason The reason of the movement
+     * @param delta The delta of the movement
+     */
+    void add(MovementReason reason, int64_t delta)
+    {
+        units[static_cast<size_t>(reason)] += delta;
+        movements++;
+    }
+
+    /**
+     * @brief Add another set of totals
+     * @param other The totals to add
+     */
+    void add(const MovementTotals &other);
+
+    /**
+     * @brief Take away totals that this includes
+     * @param other The totals to take away
+     */
+    void subtract(const MovementTotals &other);
+};
+
+/**
+ * @brief Append-only log of every product's stock movements
+ *
+ * Each product's movements are kept in time order as three byte columns:
+ * the gap from the previous timestamp and the delta as variable-length
+ * integers, and the reason in two bits. A block index over every
+ * BLOCK_MOVEMENTS movements holds the block's first timestamp and the running
+ * totals before it, so the stock level at a time, or the totals over a
+ * window, come from a binary search and the decoding of at most one block
+ * per window end, never from replaying history. Typical movements take about
+ * five bytes plus half a byte of index, so 100 million fit in about 550 MB.
+ *
+ * Totals over all products come from fixed time buckets kept in a Fenwick
+ * tree, which updates and answers prefix sums in O(log buckets).
+ *
+ * Registered with InventoryManager::add_listener, the ledger records every
+ * change to a product's quantity as it happens, so its levels always match
+ * the inventory.
+ */
+class StockLedger : public InventoryListener
+{
+public:
+    // Movements per block of the index; a query decodes at most this many per window end
+    static const size_t BLOCK_MOVEMENTS = 128;
+
+    // Movements must fall between 1970 and 2100, bounding the bucket table
+    static const int64_t MAX_TIMESTAMP = 4102444800;
+
+    /**
+     * @brief Create an empty ledger
+     * @param bucket_seconds Width of the buckets behind window_all(); the default is an hour
+     */
+    explicit StockLedger(int64_t bucket_seconds = 3600);
+
+    /**
+     * @brief Append a movement
+     * @param product_id The product whose stock moved
+     * @param timestamp When, in seconds since 1970-01-01 UTC
+     * @param delta Units added, or removed if negative
+     * @param reason Why
+     * @throws InventoryException If the time is out of range or earlier than the product's last movement
+     */
+    void record(int product_id, int64_t timestamp, int64_t delta, MovementReason reason);
+
+    /**
+     * @brief Get a product's stock level after all its movements
+     * @param product_id The product
+     * @return The sum of its deltas, or 0 if it has none
+     */
+    int64_t get_level(int product_id) const;
+
+    /**
+     * @brief Get a product's stock level at a time
+     * @param product_id The product
+     * @param timestamp The time; movements at exactly this time are included
+     * @return The sum of its deltas up to the time
+     */
+    int64_t level_at(int product_id, int64_t timestamp) const;
+
+    /**
+     * @brief Sum a product's movements over a window
+     * @param product_id The product
+     * @param from Start of the window, inclusive
+     * @param to End of the window, exclusive
+     * @return The totals of the movements in [from, to)
+     */
+    MovementTotals window(int product_id, int64_t from, int64_t to) const;
+
+    /**
+     * @brief Sum every product's movements over a window
+     *
+     * Both ends are rounded down to the start of their bucket, so the sum is
+     * exact when they fall on bucket boundaries, such as midnight for hourly
+     * buckets.
+     *
+     * @param from Start of the window, inclusive
+     * @param to End of the window, exclusive
+     * @return The totals of the movements in the buckets from from up to to
+     */
+    MovementTotals window_all(int64_t from, int64_t to) const;
+
+    /**
+     * @brief List a product's movements over a window
+     * @param product_id The product
+     * @param from Start of the window, inclusive
+     * @param to End of the window, exclusive
+     * @return The movements in [from, to), oldest first
+     */
+    std::vector<StockMovement> get_movements(int product_id, int64_t from, int64_t to) const;
+
+    /**
+     * @brief Get the IDs of the products with movements
+     * @return The IDs in ascending order, including products since removed
+     */
+    std::vector<int> get_product_ids() const;
+
+    /**
+     * @brief Get the number of movements recorded
+     * @return The movement count over all products
+     */
+    uint64_t get_movement_count() const;
+
+    /**
+     * @brief Get the width of the buckets behind window_all()
+     * @return The width in seconds
+     */
+    int64_t get_bucket_seconds() const;
+
+    /**
+     * @brief Break down the heap memory held by the ledger
+     * @return The movement columns, block index, product table and buckets, in that order
+     */
+    std::vector<MemoryComponent> get_memory_usage() const;
+
+    /**
+     * @brief Save the ledger in its compact binary form
+     * @param filename The file to write
+     * @throws FileOperationException If the file cannot be written
+     */
+    void save_to_file(const std::string &filename) const;
+
+    /**
+     * @brief Replace the ledger with one saved by save_to_file()
+     * @param filename The file to read
+     * @throws FileOperationException If the file cannot be read or is corrupt
+     */
+    void load_from_file(const std::string &filename);
+
+    /**
+     * @brief Check whether a file was written by save_to_file()
+     * @param filename The file to check
+     * @return true if the file starts with the ledger signature
+     */
+    static bool is_ledger_file(const std::string &filename);
+
+    /**
+     * @brief Append the movements of a CSV file with the columns ID,Timestamp,Delta,Reason
+     *
+     * Rows may be in any order; they are recorded in time order. The header
+     * row is optional.
+     *
+     * @param in The stream to read
+     * @return The number of movements recorded
+     * @throws InventoryException If a row is malformed or earlier than a product's last movement
+     */
+    size_t import_csv(std::istream &in);
+
+    /**
+     * @brief Write every movement as CSV, by product and then time
+     * @param out The stream to write to
+     */
+    void export_csv(std::ostream &out) const;
+
+    /**
+     * @brief Record a quantity change as a movement at the current time
+     *
+     * New products are recorded as received, other changes as adjusted. If
+     * the product already has a later movement, the change is recorded at
+     * that time instead, keeping its movements in order.
+     */
+    void product_changed(const Product *before, const Product *after) override;
+
+    /**
+     * @brief Record an adjustment for every product whose level differs from its quantity
+     *
+     * Products no longer present are adjusted to zero.
+     */
+    void products_replaced(const std::vector<Product> &products) override;
+
+private:
+    /**
+     * @brief Index entry for BLOCK_MOVEMENTS consecutive movements of a product
+     */
+    struct Block
+    {
+        int64_t first_timestamp; // Time of the block's first movement
+        uint32_t time_offset;    // Start of the block in Series::times
+        uint32_t delta_offset;   // Start of the block in Series::deltas
+        MovementTotals before;   // Totals of the product's movements before the block
+    };
+
+    /**
+     * @brief One product's movements
+     */
+    struct Series
+    {
+        std::vector<uint8_t> times;   // Varint gap from the previous timestamp
+        std::vector<uint8_t> deltas;  // Zigzag varint delta
+        std::vector<uint8_t> reasons; // Two bits per movement, lowest bits first
+        std::vector<Block> blocks;
+        int64_t last_timestamp;
+        MovementTotals totals; // Totals of all the movements
+    };
+
+    int64_t bucket_seconds;
+    std::unordered_map<int, Series> series;
+    uint64_t movement_count;
+
+    int64_t first_bucket;                // Bucket number of buckets[1]
+    std::vector<MovementTotals> buckets; // Fenwick tree over the buckets, 1-based
+
+    /**
+     * @brief Sum a product's movements before a time
+     * @param product The product's movements
+     * @param timestamp The time; movements at this time are excluded
+     * @return The totals of the earlier movements
+     */
+    static MovementTotals totals_before(const Series &product, int64_t timestamp);
+
+    /**
+     * @brief Sum the first buckets
+     * @param count Number of buckets to sum
+     * @return The totals of buckets[1] to buckets[count]
+     */
+    MovementTotals bucket_prefix(size_t count) const;
+
+    /**
+     * @brief Count a movement into its time bucket
+     * @param timestamp Time of the movement
+     * @param delta The delta
+     * @param reason The reason
+     */
+    void add_to_bucket(int64_t timestamp, int64_t delta, MovementReason reason);
+
+    /**
+     * @brief Sum the buckets before a time's bucket
+     * @param timestamp The time
+     * @return The totals of every movement in earlier buckets
+     */
+    MovementTotals buckets_before(int64_t timestamp) const;
+
+    /**
+     * @brief Get the current time for movements recorded through the listener
+     * @return Seconds since 1970-01-01 UTC
+     */
+    static int64_t now();
+};
@@ -0,0 +1,397 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class TaskExecutor;
+
+template <typename T>
+class TaskFuture;
+
+/**
+ * @brief State shared by a running task and its TaskFuture
+ */
+template <typename T>
+struct TaskState
+{
+    // void results hold a placeholder
+    typedef typename std::conditional<std::is_void<T>::value, char, T>::type Value;
+
+    TaskExecutor *executor;
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool ready = false;
+    Value value{};
+    std::exception_ptr failure;
+    std::vector<std::function<void()>> continuations; // Submitted once the task finishes
+
+    explicit TaskState(TaskExecutor *executor) : executor(executor) {}
+
+    /**
+     * @brief Run a function and store its result or exception, then release the waiters
+     * @param function Produces the result
+     */
+    template <typename Function>
+    void run(Function &&function);
+};
+
+/**
+ * @brief Work-stealing thread pool for parallel scans and background operations
+ *
+ * Each worker thread owns a queue. Tasks submitted from a worker go to the
+ * back of its own queue and it takes its next task from the back too, so
+ * work it splits off stays hot in its cache; a worker whose queue is empty
+ * steals from the front of another's, taking the oldest and usually largest
+ * piece of work. Tasks submitted from other threads are dealt round-robin.
+ *
+ * parallel_for() and parallel_reduce() split an index range into chunks and
+ * let the calling thread work through them together with the workers, so
+ * they may be called from inside a task without starving the pool. Partial
+ * results of parallel_reduce() are combined in index order, so results
+ * built from them come out in the same order as a sequential loop.
+ *
+ * async() runs a function in the background and returns a TaskFuture, whose
+ * then() chains further work onto the result without blocking a thread.
+ */
+class TaskExecutor
+{
+public:
+    /**
+     * @brief Start the worker threads
+     * @param thread_count Number of workers; 0 starts one per hardware thread
+     */
+    explicit TaskExecutor(size_t thread_count = 0);
+
+    /**
+     * @brief Finish every queued task, then stop the workers
+     */
+    ~TaskExecutor();
+
+    TaskExecutor(const TaskExecutor &) = delete;
+    TaskExecutor &operator=(const TaskExecutor &) = delete;
+
+    /**
+     * @brief Get the process-wide executor, starting it on first use
+     * @return The executor, with one worker per hardware thread
+     */
+    static std::shared_ptr<TaskExecutor> get_shared();
+
+    /**
+     * @brief Get the number of worker threads
+     * @return The count
+     */
+    size_t get_thread_count() const;
+
+    /**
+     * @brief Run one queued task on the calling thread, if any is queued
+     * @return true if a task was run
+     */
+    bool run_one();
+
+    /**
+     * @brief Run a function on the pool
+     * @param function The function; its result or exception is passed to the future
+     * @return A future for the function's result
+     */
+    template <typename Function>
+    auto async(Function function) -> TaskFuture<decltype(function())>
+    {
+        typedef decltype(function()) Result;
+        auto state = std::make_shared<TaskState<Result>>(this);
+        submit([state, function]() mutable
+               { state->run(function); });
+        return TaskFuture<Result>(state);
+    }
+
+    /**
+     * @brief Call body over consecutive subranges of [begin, end), in parallel
+     *
+     * Ranges no larger than grain, and any range on a single core, run on the
+     * calling thread alone. The first
+     * exception thrown by the body is rethrown once every chunk has finished.
+     *
+     * @param begin Start of the range
+     * @param end End of the range
+     * @param grain Smallest subrange worth a task of its own
+     * @param body Called as body(chunk_begin, chunk_end)
+     */
+    template <typename Body>
+    void parallel_for(size_t begin, size_t end, size_t grain, const Body &body)
+    {
+        size_t size = end > begin ? end - begin : 0;
+        size_t chunks = chunk_count(size, grain);
+        run_chunks(chunks, [begin, size, chunks, &body](size_t chunk)
+                   { body(begin + size * chunk / chunks, begin + size * (chunk + 1) / chunks); });
+    }
+
+    /**
+     * @brief Map consecutive subranges of [begin, end) to partial results in parallel, then combine them in order
+     * @param begin Start of the range
+     * @param end End of the range
+     * @param grain Smallest subrange worth a task of its own
+     * @param identity The result of an empty range
+     * @param map Called as map(chunk_begin, chunk_end), returning that subrange's result
+     * @param combine Called as combine(total, std::move(partial)) for each partial result, lowest range first
+     * @return The combined result
+     */
+    template <typename T, typename Map, typename Combine>
+    T parallel_reduce(size_t begin, size_t end, size_t grain, T identity, const Map &map, const Combine &combine)
+    {
+        size_t size = end > begin ? end - begin : 0;
+        size_t chunks = chunk_count(size, grain);
+        if (chunks == 1)
+        {
+            combine(identity, map(begin, end));
+            return identity;
+        }
+
+        std::vector<T> partials(chunks, identity);
+        run_chunks(chunks, [begin, size, chunks, &map, &partials](size_t chunk)
+                   { partials[chunk] = map(begin + size * chunk / chunks, begin + size * (chunk + 1) / chunks); });
+        for (auto &partial : partials)
+        {
+            combine(identity, std::move(partial));
+        }
+        return identity;
+    }
+
+private:
+    template <typename T>
+    friend class TaskFuture;
+    template <typename T>
+    friend struct TaskState;
+
+    /**
+     * @brief One worker's queue
+     */
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues; // One per worker
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next_queue;             // Where the next outside submission goes
+
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<long> queued; // Tasks in all queues; briefly negative while a submission is counted
+    bool stopping;            // Guarded by sleep_mutex
+
+    /**
+     * @brief Queue a task
+     * @param task The task; it must not throw
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Take a task, from the back of a worker's own queue or the front of another's
+     * @param home The queue to look in first
+     * @param task Receives the task
+     * @return true if a task was taken
+     */
+    bool take_task(size_t home, std::function<void()> &task);
+
+    /**
+     * @brief Run tasks until the executor stops
+     * @param index The worker's queue
+     */
+    void work(size_t index);
+
+    /**
+     * @brief Decide how many chunks to split a range into
+     * @param size Length of the range
+     * @param grain Smallest chunk worth a task
+     * @return 1 for ranges up to grain or without a second core, else enough chunks to balance the threads
+     */
+    size_t chunk_count(size_t size, size_t grain) const;
+
+    /**
+     * @brief Run run(0) .. run(count - 1) on the calling thread and the workers
+     * @param count Number of chunks
+     * @param run Runs one chunk
+     */
+    void run_chunks(size_t count, const std::function<void(size_t)> &run);
+};
+
+/**
+ * @brief Result of a task run by TaskExecutor::async()
+ *
+ * Like std::future, the result is taken once, by get() or by then().
+ * Waiting threads run queued tasks while they wait, so waiting inside a
+ * task cannot starve the pool.
+ */
+template <typename T>
+class TaskFuture
+{
+public:
+    TaskFuture() {}
+
+    explicit TaskFuture(std::shared_ptr<TaskState<T>> state) : state(std::move(state)) {}
+
+    /**
+     * @brief Check whether the future refers to a task
+     * @return false for default-constructed futures and after get() or then()
+     */
+    bool valid() const
+    {
+        return state != nullptr;
+    }
+
+    /**
+     * @brief Check whether the task has finished
+     * @return true if get() would not wait
+     */
+    bool is_ready() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->ready;
+    }
+
+    /**
+     * @brief Wait for the task to finish
+     */
+    void wait() const
+    {
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->ready)
+                {
+                    return;
+                }
+            }
+            if (!state->executor->run_one())
+            {
+                // Nothing to help with; the task is running elsewhere
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->finished.wait_for(lock, std::chrono::milliseconds(1), [this]
+                                         { return state->ready; });
+            }
+        }
+    }
+
+    /**
+     * @brief Wait for the task and take its result
+     * @return The result
+     * @throws Whatever the task threw
+     */
+    T get()
+    {
+        wait();
+        std::shared_ptr<TaskState<T>> taken = std::move(state);
+        if (taken->failure)
+        {
+            std::rethrow_exception(taken->failure);
+        }
+        if constexpr (!std::is_void<T>::value)
+        {
+            return std::move(taken->value);
+        }
+    }
+
+    /**
+     * @brief Run a function on the result once the task finishes
+     *
+     * The function runs on the pool and receives the result, or nothing for a
+     * void task. If the task threw, the function is skipped and the exception
+     * passes to the returned future.
+     *
+     * @param function The continuation
+     * @return A future for the continuation's result
+     */
+    template <typename Function>
+    auto then(Function function)
+    {
+        typedef typename std::conditional<std::is_void<T>::value, std::invoke_result<Function>,
+                                          std::invoke_result<Function, T>>::type::type Result;
+        std::shared_ptr<TaskState<T>> source = std::move(state);
+        TaskExecutor *executor = source->executor;
+        auto next = std::make_shared<TaskState<Result>>(executor);
+
+        auto continuation = [source, next, function]() mutable
+        {
+            if (source->failure)
+            {
+                std::exception_ptr failure = source->failure;
+                next->run([failure]() -> Result
+                          { std::rethrow_exception(failure); });
+                return;
+            }
+            if constexpr (std::is_void<T>::value)
+            {
+                next->run(function);
+            }
+            else
+            {
+                auto bound = [source, &function]() -> Result
+                { return function(std::move(source->value)); };
+                next->run(bound);
+            }
+        };
+
+        bool ready;
+        {
+            std::lock_guard<std::mutex> lock(source->mutex);
+            ready = source->ready;
+            if (!ready)
+            {
+                source->continuations.push_back(std::move(continuation));
+            }
+        }
+        if (ready)
+        {
+            executor->submit(std::move(continuation));
+        }
+        return TaskFuture<Result>(next);
+    }
+
+private:
+    std::shared_ptr<TaskState<T>> state;
+};
+
+template <typename T>
+template <typename Function>
+void TaskState<T>::run(Function &&function)
+{
+    try
+    {
+        if constexpr (std::is_void<T>::value)
+        {
+            function();
+        }
+        else
+        {
+            value = function();
+        }
+    }
+    catch (...)
+    {
+        failure = std::current_exception();
+    }
+
+    std::vector<std::function<void()>> waiting;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready = true;
+        waiting.swap(continuations);
+    }
+    finished.notify_all();
+    for (auto &continuation : waiting)
+    {
+        executor->submit(std::move(continuation));
+    }
+}
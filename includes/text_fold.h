@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+
+/**
+ * @brief Produce the case-folded, normalized form of a UTF-8 string
+ *
+ * Folding lowercases Latin, Greek and Cyrillic letters, strips diacritics from
+ * Latin letters (precomposed or followed by combining marks), maps fullwidth
+ * forms to ASCII and collapses runs of whitespace into a single space. Two
+ * strings that differ only in these respects fold to the same bytes, so
+ * case-insensitive matching becomes a plain byte comparison on folded keys.
+ * Invalid UTF-8 sequences are copied through unchanged.
+ *
+ * @param text The UTF-8 text to fold
+ * @return The folded text
+ */
+std::string fold_text(const std::string &text);
@@ -0,0 +1,209 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "memory_accounting.h"
+
+/**
+ * Low-overhead instrumentation for hot paths.
+ *
+ * TRACE_SCOPE("Class::method") at the top of a block times the rest of the
+ * block. Durations go into a histogram per call site and per thread, written
+ * only by the owning thread with relaxed atomics, so recording takes no lock
+ * and dumps can run while other threads keep working. Histograms use
+ * log-linear buckets (16 per power of two) like HdrHistogram, giving about
+ * 6% precision from nanoseconds to hours in under 8 KB. Each site also
+ * totals the heap allocations made inside it, read from the counting
+ * operator new in memory_accounting.h.
+ *
+ * Tracing starts disabled. A disabled scope costs one relaxed atomic load
+ * and a branch. Defining INVENTORY_NO_TRACING removes the macros entirely.
+ */
+
+/**
+ * @brief Latency summary of one call site, merged across threads
+ */
+struct TraceStats
+{
+    std::string name;
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t allocations;     // Heap allocations made inside the scope, over all calls
+    uint64_t allocated_bytes; // Bytes requested by those allocations
+};
+
+/**
+ * @brief A named instrumentation point, registered once per call site
+ */
+class TraceSite
+{
+public:
+    /**
+     * @brief Register a call site
+     * @param name Name shown in dumps; must outlive the program (a string literal)
+     */
+    explicit TraceSite(const char *name);
+
+    /**
+     * @brief Get the site's slot in the per-thread tables
+     * @return The index, or Tracing::MAX_SITES if the table was full
+     */
+    unsigned get_index() const;
+
+private:
+    unsigned index;
+};
+
+/**
+ * @brief Global control and output of tracing data
+ */
+class Tracing
+{
+public:
+    /**
+     * @brief Maximum number of distinct call sites; later sites are ignored
+     */
+    static const unsigned MAX_SITES = 256;
+
+    /**
+     * @brief Number of events kept per thread for Chrome traces; older ones are overwritten
+     */
+    static const size_t EVENTS_PER_THREAD = 65536;
+
+    /**
+     * @brief Start or stop recording durations
+     * @param on Whether scopes record
+     */
+    static void set_enabled(bool on);
+
+    /**
+     * @brief Check whether scopes record
+     * @return true if tracing is enabled
+     */
+    static bool is_enabled();
+
+    /**
+     * @brief Start or stop keeping individual events for write_chrome_trace()
+     *
+     * Histograms are always kept while tracing is enabled; events cost an
+     * extra buffer per thread and are only kept when asked for.
+     *
+     * @param capture Whether to keep events
+     */
+    static void set_capture_events(bool capture);
+
+    /**
+     * @brief Clear every histogram and event buffer
+     */
+    static void reset();
+
+    /**
+     * @brief Summarize every call site that recorded anything
+     * @return One entry per site, sorted by total time, largest first
+     */
+    static std::vector<TraceStats> get_stats();
+
+    /**
+     * @brief Write get_stats() as a JSON array
+     * @param out The stream to write to
+     */
+    static void write_json(std::ostream &out);
+
+    /**
+     * @brief Write captured events in Chrome trace event format
+     *
+     * The output loads in chrome://tracing and Perfetto.
+     *
+     * @param out The stream to write to
+     */
+    static void write_chrome_trace(std::ostream &out);
+
+    /**
+     * @brief Record one completed scope; called by ScopedTrace
+     * @param site The call site
+     * @param start_ns Start time from now_ns()
+     * @param duration_ns Elapsed time
+     * @param allocations Heap allocations made by the thread during the scope
+     */
+    static void record(const TraceSite &site, uint64_t start_ns, uint64_t duration_ns,
+                       const AllocationCounts &allocations);
+
+    /**
+     * @brief Read the trace clock
+     * @return Nanoseconds on a monotonic clock; never 0
+     */
+    static uint64_t now_ns()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch())
+                                         .count()) |
+               1;
+    }
+
+    static std::atomic<bool> enabled; // Read on every scope; use is_enabled() elsewhere
+};
+
+/**
+ * @brief Times the enclosing scope if tracing is enabled when it starts
+ */
+class ScopedTrace
+{
+public:
+    /**
+     * @brief Start timing
+     * @param site The call site being timed
+     */
+    explicit ScopedTrace(const TraceSite &site) : site(site), start_ns(0), start_allocations()
+    {
+        if (Tracing::enabled.load(std::memory_order_relaxed))
+        {
+            start_allocations = AllocationTracker::get_thread_counts();
+            start_ns = Tracing::now_ns();
+        }
+    }
+
+    /**
+     * @brief Stop timing and record the duration and allocations
+     */
+    ~ScopedTrace()
+    {
+        if (start_ns != 0)
+        {
+            uint64_t duration_ns = Tracing::now_ns() - start_ns;
+            AllocationCounts end_allocations = AllocationTracker::get_thread_counts();
+            Tracing::record(site, start_ns, duration_ns,
+                            {end_allocations.allocations - start_allocations.allocations,
+                             end_allocations.allocated_bytes - start_allocations.allocated_bytes});
+        }
+    }
+
+    ScopedTrace(const ScopedTrace &) = delete;
+    ScopedTrace &operator=(const ScopedTrace &) = delete;
+
+private:
+    const TraceSite &site;
+    uint64_t start_ns; // 0 when tracing was disabled at the start
+    AllocationCounts start_allocations;
+};
+
+#ifndef INVENTORY_NO_TRACING
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name)                                             \
+    static const TraceSite TRACE_CONCAT(trace_site_, __LINE__)(name); \
+    const ScopedTrace TRACE_CONCAT(trace_scope_, __LINE__)(TRACE_CONCAT(trace_site_, __LINE__))
+#else
+#define TRACE_SCOPE(name) \
+    do                    \
+    {                     \
+    } while (0)
+#endif
@@ -1,16 +1,19 @@
 # inventory.pro
-QT += core gui widgets charts
+TEMPLATE = subdirs
 
-TARGET = inventory_management
-TEMPLATE = app
+# core: the inventory engine as a static library with no Qt dependency
+# app:  the Qt Widgets desktop application
+# cli:  the headless command line tool for batch jobs and the socket service
+# tests: console programs checking core behaviour, each exiting non-zero on failure
+SUBDIRS += core app cli benchmarks tests
 
-CONFIG += c++11
+app.depends = core
+cli.depends = core
+benchmarks.depends = core
+tests.depends = core
 
-SOURCES += src/main.cpp \
-    src/product.cpp \
-    src/inventory_manager.cpp \
-    src/main_window.cpp
-
-HEADERS += includes/product.h \
-    includes/inventory_manager.h \
-    includes/main_window.h
\ No newline at end of file
+# loadgen: load generator for the socket service, which needs epoll
+linux {
+    SUBDIRS += loadgen
+    loadgen.depends = core
+}
@@ -0,0 +1,12 @@
+# loadgen.pro
+QT -= core gui
+
+TARGET = inventory_loadgen
+TEMPLATE = app
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+include(../core/core.pri)
+
+SOURCES += ../src/inventory_loadgen.cpp
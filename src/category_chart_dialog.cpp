@@ -0,0 +1,175 @@
+#include "includes/category_chart_dialog.h"
+#include "includes/trace.h"
+
+#include <QVBoxLayout>
+#include <QStringList>
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    // Legend and axis label for an entry; the combined entry says how many it holds
+    QString entry_label(const CategoryTotal &entry)
+    {
+        QString label = QString::fromStdString(entry.category);
+        if (entry.categories > 1)
+        {
+            label += QString(" (%1 categories)").arg(entry.categories);
+        }
+        return label;
+    }
+
+    bool same_entry(const CategoryTotal &a, const CategoryTotal &b)
+    {
+        return a.category == b.category && a.categories == b.categories;
+    }
+}
+
+CategoryChartDialog::CategoryChartDialog(Kind kind, const CategoryTotals &totals, QWidget *parent)
+    : QDialog(parent), kind(kind), totals(totals), shown_version(std::numeric_limits<uint64_t>::max()),
+      pie_series(nullptr), bar_set(nullptr), category_axis(nullptr), value_axis(nullptr)
+{
+    QString title = kind == Kind::VALUE_BARS ? "Inventory Value by Category" : "Product Distribution by Category";
+    setWindowTitle(title);
+    resize(600, 400);
+
+    // Create a vertical layout for the dialog
+    QVBoxLayout *layout = new QVBoxLayout(this);
+
+    QChart *chart = new QChart();
+    chart->setTitle(title);
+    // Updates arrive while the user edits; animating each one would redraw for every frame
+    chart->setAnimationOptions(QChart::NoAnimation);
+    chart->legend()->setVisible(true);
+    chart->legend()->setAlignment(Qt::AlignRight);
+
+    if (kind == Kind::VALUE_BARS)
+    {
+        // A single bar set with one value per category, labelled by the category axis
+        bar_set = new QBarSet("Value");
+        QBarSeries *series = new QBarSeries();
+        series->append(bar_set);
+        chart->addSeries(series);
+
+        value_axis = new QValueAxis();
+        value_axis->setTitleText("Value ($)");
+        chart->addAxis(value_axis, Qt::AlignLeft);
+        series->attachAxis(value_axis);
+
+        category_axis = new QBarCategoryAxis();
+        category_axis->setLabelsAngle(-45);
+        chart->addAxis(category_axis, Qt::AlignBottom);
+        series->attachAxis(category_axis);
+
+        // The axis names the bars, so the legend would only say "Value"
+        chart->legend()->setVisible(false);
+    }
+    else
+    {
+        pie_series = new QPieSeries();
+        chart->addSeries(pie_series);
+    }
+
+    // Create chart view
+    QChartView *chart_view = new QChartView(chart);
+    chart_view->setRenderHint(QPainter::Antialiasing);
+
+    layout->addWidget(chart_view);
+}
+
+void CategoryChartDialog::showEvent(QShowEvent *event)
+{
+    QDialog::showEvent(event);
+    refresh();
+}
+
+void CategoryChartDialog::refresh()
+{
+    if (!isVisible() || totals.get_version() == shown_version)
+    {
+        return;
+    }
+
+    TRACE_SCOPE("CategoryChartDialog::refresh");
+    std::vector<CategoryTotal> entries = totals.top(kind == Kind::VALUE_BARS ? CategoryTotals::Measure::VALUE
+                                                                             : CategoryTotals::Measure::PRODUCT_COUNT,
+                                                    CATEGORY_LIMIT);
+
+    if (kind == Kind::VALUE_BARS)
+    {
+        bool relabel = entries.size() != shown.size() ||
+                       !std::equal(entries.begin(), entries.end(), shown.begin(), same_entry);
+        update_bars(entries, relabel);
+    }
+    else
+    {
+        update_pie(entries);
+    }
+
+    shown = std::move(entries);
+    shown_version = totals.get_version();
+}
+
+void CategoryChartDialog::update_bars(const std::vector<CategoryTotal> &entries, bool relabel)
+{
+    int count = static_cast<int>(entries.size());
+    if (bar_set->count() > count)
+    {
+        bar_set->remove(count, bar_set->count() - count);
+    }
+
+    double largest = 0.0;
+    for (int i = 0; i < count; i++)
+    {
+        double value = entries[i].value.to_double();
+        largest = std::max(largest, value);
+        if (i >= bar_set->count())
+        {
+            bar_set->append(value);
+        }
+        else if (bar_set->at(i) != value)
+        {
+            bar_set->replace(i, value);
+        }
+    }
+
+    if (relabel)
+    {
+        QStringList labels;
+        for (const auto &entry : entries)
+        {
+            labels << entry_label(entry);
+        }
+        category_axis->setCategories(labels);
+    }
+    value_axis->setRange(0.0, largest > 0.0 ? largest * 1.05 : 1.0);
+}
+
+void CategoryChartDialog::update_pie(const std::vector<CategoryTotal> &entries)
+{
+    QList<QPieSlice *> slices = pie_series->slices();
+    while (slices.size() > static_cast<int>(entries.size()))
+    {
+        pie_series->remove(slices.takeLast());
+    }
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        double value = static_cast<double>(entries[i].products);
+        if (i >= static_cast<size_t>(slices.size()))
+        {
+            pie_series->append(entry_label(entries[i]), value);
+            continue;
+        }
+
+        QPieSlice *slice = slices[static_cast<int>(i)];
+        if (i >= shown.size() || !same_entry(shown[i], entries[i]))
+        {
+            slice->setLabel(entry_label(entries[i]));
+        }
+        if (slice->value() != value)
+        {
+            slice->setValue(value);
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#include "includes/category_totals.h"
+#include <algorithm>
+
+const std::string OTHER_CATEGORIES = "Other";
+
+CategoryTotals::CategoryTotals() : version(0) {}
+
+void CategoryTotals::product_changed(const Product *before, const Product *after)
+{
+    if (before && after && before->get_category() == after->get_category() &&
+        before->get_total_value() == after->get_total_value())
+    {
+        return; // Only the name, description or an equal-valued price/quantity changed
+    }
+
+    if (before)
+    {
+        apply(*before, false);
+    }
+    if (after)
+    {
+        apply(*after, true);
+    }
+    changed();
+}
+
+void CategoryTotals::products_replaced(const std::vector<Product> &products)
+{
+    totals.clear();
+    for (const auto &product : products)
+    {
+        apply(product, true);
+    }
+    changed();
+}
+
+void CategoryTotals::apply(const Product &product, bool adding)
+{
+    const std::string &category = product.get_category();
+    if (adding)
+    {
+        CategoryTotal &total = totals[category];
+        if (total.categories == 0)
+        {
+            total.category = category;
+            total.categories = 1;
+        }
+        total.products++;
+        total.value.add(product.get_total_value());
+        return;
+    }
+
+    auto found = totals.find(category);
+    if (found == totals.end())
+    {
+        return;
+    }
+    if (--found->second.products == 0)
+    {
+        totals.erase(found);
+    }
+    else
+    {
+        found->second.value.subtract(product.get_total_value());
+    }
+}
+
+void CategoryTotals::changed()
+{
+    version++;
+    if (on_change)
+    {
+        on_change();
+    }
+}
+
+std::vector<CategoryTotal> CategoryTotals::top(Measure measure, size_t limit) const
+{
+    std::vector<const CategoryTotal *> ranked;
+    ranked.reserve(totals.size());
+    for (const auto &entry : totals)
+    {
+        ranked.push_back(&entry.second);
+    }
+
+    auto larger = [measure](const CategoryTotal *a, const CategoryTotal *b)
+    {
+        if (measure == Measure::VALUE)
+        {
+            if (b->value < a->value || a->value < b->value)
+            {
+                return b->value < a->value;
+            }
+        }
+        else if (a->products != b->products)
+        {
+            return a->products > b->products;
+        }
+        return a->category < b->category;
+    };
+
+    // Only the named entries need ordering; the rest are summed in any order
+    size_t named = std::min(limit, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + named, ranked.end(), larger);
+
+    std::vector<CategoryTotal> result;
+    result.reserve(named + 1);
+    for (size_t i = 0; i < named; i++)
+    {
+        result.push_back(*ranked[i]);
+    }
+
+    if (named < ranked.size())
+    {
+        CategoryTotal other;
+        other.category = OTHER_CATEGORIES;
+        for (size_t i = named; i < ranked.size(); i++)
+        {
+            other.categories++;
+            other.products += ranked[i]->products;
+            other.value.add(ranked[i]->value);
+        }
+        result.push_back(other);
+    }
+    return result;
+}
+
+size_t CategoryTotals::get_category_count() const
+{
+    return totals.size();
+}
+
+uint64_t CategoryTotals::get_version() const
+{
+    return version;
+}
+
+void CategoryTotals::set_change_callback(std::function<void()> on_change)
+{
+    this->on_change = std::move(on_change);
+}
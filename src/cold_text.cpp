@@ -0,0 +1,248 @@
+#include "includes/cold_text.h"
+#include "includes/csv_codec.h"
+#include "includes/inventory_manager.h"
+#include "includes/memory_accounting.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const size_t BLOCK_SIZE = 64 * 1024;
+
+    std::atomic<uint64_t> next_serial(1);
+
+    // The most recently read block of a file segment, per thread
+    struct BlockCache
+    {
+        uint64_t serial = 0; // Segment the block belongs to; serials are never reused
+        uint64_t start = 0;
+        std::string bytes;
+    };
+
+    thread_local BlockCache block_cache;
+
+#ifndef _WIN32
+    /**
+     * @brief Check whether a file looks unchanged since it was last examined
+     *
+     * Writes in place update the change time, which Linux keeps to the
+     * nanosecond; elsewhere two writes within a second leaving the size
+     * alike go unnoticed.
+     *
+     * @param opened The file's status when it was opened
+     * @param current Its status now
+     * @return true if no change was detected
+     */
+    bool same_file_state(const struct stat &opened, const struct stat &current)
+    {
+        bool same = current.st_dev == opened.st_dev && current.st_ino == opened.st_ino &&
+                    current.st_size == opened.st_size && current.st_mtime == opened.st_mtime &&
+                    current.st_ctime == opened.st_ctime;
+#ifdef __linux__
+        same = same && current.st_mtim.tv_nsec == opened.st_mtim.tv_nsec &&
+               current.st_ctim.tv_nsec == opened.st_ctim.tv_nsec;
+#endif
+        return same;
+    }
+#endif
+}
+
+struct ColdSegment::FileState
+{
+    std::string filename;
+    uint64_t serial;
+#ifndef _WIN32
+    int descriptor;
+    struct stat opened; // Status when opened, to notice changes
+#endif
+};
+
+ColdSegment::ColdSegment() {}
+
+ColdSegment::ColdSegment(std::string text) : text(std::move(text)) {}
+
+ColdSegment::~ColdSegment()
+{
+#ifndef _WIN32
+    if (file)
+    {
+        ::close(file->descriptor);
+    }
+#endif
+}
+
+std::shared_ptr<const ColdSegment> ColdSegment::open_file(const std::string &filename)
+{
+    std::shared_ptr<ColdSegment> segment(new ColdSegment());
+    std::unique_ptr<FileState> state(new FileState());
+    state->filename = filename;
+    state->serial = next_serial++;
+
+#ifndef _WIN32
+    state->descriptor = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (state->descriptor < 0)
+    {
+        throw FileOperationException("open", filename);
+    }
+    if (::fstat(state->descriptor, &state->opened) != 0)
+    {
+        ::close(state->descriptor);
+        throw FileOperationException("open", filename);
+    }
+#else
+    // Without positioned reads, hold the file's contents in memory instead
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open())
+    {
+        throw FileOperationException("open", filename);
+    }
+    segment->text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+#endif
+
+    segment->file = std::move(state);
+    return segment;
+}
+
+std::string_view ColdSegment::view(uint64_t offset, uint32_t length) const
+{
+#ifndef _WIN32
+    if (file)
+    {
+        BlockCache &cache = block_cache;
+        if (cache.serial != file->serial || offset < cache.start ||
+            offset + length > cache.start + cache.bytes.size())
+        {
+            struct stat current;
+            if (::fstat(file->descriptor, &current) != 0 || !same_file_state(file->opened, current))
+            {
+                throw FileOperationException("read changed", file->filename);
+            }
+
+            cache.serial = 0;
+            cache.bytes.resize(std::max<size_t>(BLOCK_SIZE, length));
+            ssize_t read;
+            do
+            {
+                read = ::pread(file->descriptor, &cache.bytes[0], cache.bytes.size(), static_cast<off_t>(offset));
+            } while (read < 0 && errno == EINTR);
+            if (read < static_cast<ssize_t>(length))
+            {
+                throw FileOperationException("read", file->filename);
+            }
+            cache.bytes.resize(static_cast<size_t>(read));
+            cache.serial = file->serial;
+            cache.start = offset;
+        }
+        return std::string_view(cache.bytes).substr(offset - cache.start, length);
+    }
+#endif
+
+    if (offset + length > text.size())
+    {
+        throw FileOperationException("read", file ? file->filename : "(memory)");
+    }
+    return std::string_view(text).substr(offset, length);
+}
+
+bool ColdSegment::is_file() const
+{
+    return file != nullptr;
+}
+
+size_t ColdSegment::get_heap_bytes() const
+{
+    return heap_bytes(text) + (file ? heap_block_size(sizeof(FileState)) + heap_bytes(file->filename) : 0);
+}
+
+ColdText::ColdText(const std::string &text) : offset(0), length(static_cast<uint32_t>(text.size())), escaped(false)
+{
+    if (!text.empty())
+    {
+        segment = std::make_shared<const ColdSegment>(text);
+    }
+}
+
+ColdText::ColdText(std::shared_ptr<const ColdSegment> segment, uint64_t offset, uint32_t length, bool escaped)
+    : segment(std::move(segment)), offset(offset), length(length), escaped(escaped) {}
+
+std::string ColdText::str() const
+{
+    if (length == 0)
+    {
+        return std::string();
+    }
+
+    std::string_view bytes = segment->view(offset, length);
+    if (!escaped)
+    {
+        return std::string(bytes);
+    }
+
+    std::string text;
+    text.reserve(bytes.size());
+    for (size_t i = 0; i < bytes.size(); i++)
+    {
+        text += bytes[i];
+        if (bytes[i] == '"')
+        {
+            i++; // Skip the second quote of each doubled pair
+        }
+    }
+    return text;
+}
+
+bool ColdText::is_cold() const
+{
+    return segment && segment->is_file();
+}
+
+void ColdText::write_csv(std::ostream &out) const
+{
+    if (length == 0)
+    {
+        out << "\"\"";
+    }
+    else if (segment->is_file())
+    {
+        // Already escaped as it was in the file
+        std::string_view bytes = segment->view(offset, length);
+        out.put('"');
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        out.put('"');
+    }
+    else
+    {
+        write_csv_quoted(out, segment->view(offset, length));
+    }
+}
+
+size_t ColdText::get_heap_bytes() const
+{
+    if (!segment || segment->is_file())
+    {
+        return 0;
+    }
+    // make_shared allocates the reference counts and the segment together
+    return heap_block_size(2 * sizeof(void *) + sizeof(ColdSegment)) + segment->get_heap_bytes();
+}
+
+bool ColdText::operator==(const ColdText &other) const
+{
+    if (segment == other.segment && offset == other.offset && length == other.length && escaped == other.escaped)
+    {
+        return true;
+    }
+    if (!escaped && !other.escaped && length != other.length)
+    {
+        return false;
+    }
+    return str() == other.str();
+}
@@ -0,0 +1,703 @@
+#include "includes/columnar_format.h"
+#include "includes/inventory_manager.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+namespace
+{
+    const char FILE_MAGIC[] = "INVCOL";
+    const uint64_t FORMAT_VERSION = 1;
+
+    const unsigned char PRICE_CENTS = 0; // Prices stored as bit-packed cents
+    const unsigned char PRICE_RAW = 1;   // Prices stored as raw IEEE doubles; read from older files only
+
+    /**
+     * Thrown internally when encoded data ends early or is inconsistent.
+     */
+    struct CorruptData
+    {
+    };
+
+    void put_varint(std::string &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    uint64_t zigzag(int64_t value)
+    {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value)
+    {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    double bits_double(uint64_t bits)
+    {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    void put_u64(std::string &out, uint64_t value)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            out += static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+    }
+
+    /**
+     * Sequential reader over an in-memory buffer that throws CorruptData on overrun.
+     */
+    class ByteReader
+    {
+    public:
+        ByteReader(const std::string &buffer) : data(buffer), pos(0) {}
+
+        uint64_t varint()
+        {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                unsigned char byte = this->byte();
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                {
+                    return value;
+                }
+            }
+            throw CorruptData();
+        }
+
+        unsigned char byte()
+        {
+            if (pos >= data.size())
+            {
+                throw CorruptData();
+            }
+            return static_cast<unsigned char>(data[pos++]);
+        }
+
+        uint64_t u64()
+        {
+            uint64_t value = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                value |= static_cast<uint64_t>(byte()) << (8 * i);
+            }
+            return value;
+        }
+
+        std::string bytes(size_t count)
+        {
+            if (count > data.size() - pos)
+            {
+                throw CorruptData();
+            }
+            std::string result = data.substr(pos, count);
+            pos += count;
+            return result;
+        }
+
+        bool at_end() const
+        {
+            return pos == data.size();
+        }
+
+        const char *take(size_t count)
+        {
+            if (count > data.size() - pos)
+            {
+                throw CorruptData();
+            }
+            const char *start = data.data() + pos;
+            pos += count;
+            return start;
+        }
+
+    private:
+        const std::string &data;
+        size_t pos;
+    };
+
+    uint64_t read_varint(std::istream &in)
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            int c = in.get();
+            if (c == EOF)
+            {
+                throw CorruptData();
+            }
+            value |= static_cast<uint64_t>(c & 0x7F) << shift;
+            if (!(c & 0x80))
+            {
+                return value;
+            }
+        }
+        throw CorruptData();
+    }
+
+    int bit_width(uint64_t max_value)
+    {
+        int width = 0;
+        while (width < 64 && (max_value >> width) != 0)
+        {
+            width++;
+        }
+        return width;
+    }
+
+    /**
+     * Append values using the minimum width that holds the largest one.
+     */
+    void put_packed(std::string &out, const std::vector<uint64_t> &values)
+    {
+        uint64_t max_value = 0;
+        for (uint64_t value : values)
+        {
+            max_value = std::max(max_value, value);
+        }
+
+        int width = bit_width(max_value);
+        out += static_cast<char>(width);
+
+        uint64_t buffer = 0;
+        int buffered = 0;
+        for (uint64_t value : values)
+        {
+            for (int bit = 0; bit < width;)
+            {
+                int take = std::min(width - bit, 64 - buffered);
+                uint64_t mask = take == 64 ? ~uint64_t(0) : ((uint64_t(1) << take) - 1);
+                buffer |= ((value >> bit) & mask) << buffered;
+                buffered += take;
+                bit += take;
+                if (buffered == 64)
+                {
+                    put_u64(out, buffer);
+                    buffer = 0;
+                    buffered = 0;
+                }
+            }
+        }
+        for (; buffered > 0; buffered -= 8)
+        {
+            out += static_cast<char>(buffer & 0xFF);
+            buffer >>= 8;
+        }
+    }
+
+    std::vector<uint64_t> get_packed(ByteReader &in, size_t count)
+    {
+        int width = in.byte();
+        if (width > 64)
+        {
+            throw CorruptData();
+        }
+
+        size_t byte_count = (count * width + 7) / 8;
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(in.take(byte_count));
+
+        std::vector<uint64_t> values(count);
+        if (width == 0)
+        {
+            return values;
+        }
+
+        if (width <= 56)
+        {
+            // Any value then fits in one unaligned 64-bit load; pad so loads stay in bounds
+            std::vector<unsigned char> padded(bytes, bytes + byte_count);
+            padded.resize(byte_count + 8, 0);
+            uint64_t mask = (uint64_t(1) << width) - 1;
+            size_t bit_pos = 0;
+            for (size_t i = 0; i < count; i++, bit_pos += width)
+            {
+                uint64_t word;
+                std::memcpy(&word, &padded[bit_pos >> 3], sizeof(word));
+                values[i] = (word >> (bit_pos & 7)) & mask;
+            }
+            return values;
+        }
+
+        size_t bit_pos = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            uint64_t value = 0;
+            for (int bit = 0; bit < width; bit++, bit_pos++)
+            {
+                value |= static_cast<uint64_t>((bytes[bit_pos >> 3] >> (bit_pos & 7)) & 1) << bit;
+            }
+            values[i] = value;
+        }
+        return values;
+    }
+
+    const size_t MIN_MATCH = 4;
+    const int HASH_BITS = 14;
+
+    uint32_t read32(const char *p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    /**
+     * Compress with a greedy LZ77 coder. The output is a series of
+     * (literal length, literals, match length, match offset) sequences ending
+     * with a zero match length.
+     */
+    std::string lz_compress(const std::string &input)
+    {
+        std::string out;
+        std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+        const char *data = input.data();
+        size_t n = input.size();
+        size_t anchor = 0;
+        size_t i = 0;
+
+        while (i + MIN_MATCH <= n)
+        {
+            uint32_t hash = (read32(data + i) * 2654435761u) >> (32 - HASH_BITS);
+            size_t candidate = table[hash];
+            table[hash] = static_cast<uint32_t>(i + 1);
+
+            if (candidate == 0 || read32(data + candidate - 1) != read32(data + i))
+            {
+                i++;
+                continue;
+            }
+            candidate--;
+
+            size_t length = MIN_MATCH;
+            while (i + length < n && data[candidate + length] == data[i + length])
+            {
+                length++;
+            }
+
+            put_varint(out, i - anchor);
+            out.append(data + anchor, i - anchor);
+            put_varint(out, length);
+            put_varint(out, i - candidate);
+
+            i += length;
+            anchor = i;
+        }
+
+        put_varint(out, n - anchor);
+        out.append(data + anchor, n - anchor);
+        put_varint(out, 0);
+        return out;
+    }
+
+    std::string lz_decompress(const std::string &input, size_t expected_size)
+    {
+        ByteReader in(input);
+        std::string out;
+        out.reserve(expected_size);
+
+        while (true)
+        {
+            size_t literals = in.varint();
+            out.append(in.take(literals), literals);
+
+            size_t length = in.varint();
+            if (length == 0)
+            {
+                break;
+            }
+
+            size_t offset = in.varint();
+            if (offset == 0 || offset > out.size() || out.size() + length > expected_size)
+            {
+                throw CorruptData();
+            }
+
+            // Matches may overlap their own output, so copy byte by byte
+            size_t from = out.size() - offset;
+            for (size_t k = 0; k < length; k++)
+            {
+                out += out[from + k];
+            }
+        }
+
+        if (out.size() != expected_size)
+        {
+            throw CorruptData();
+        }
+        return out;
+    }
+
+    void put_strings(std::string &out, const std::vector<std::string> &strings)
+    {
+        std::string raw;
+        for (const auto &s : strings)
+        {
+            put_varint(raw, s.size());
+            raw += s;
+        }
+        std::string compressed = lz_compress(raw);
+        put_varint(out, raw.size());
+        put_varint(out, compressed.size());
+        out += compressed;
+    }
+
+    std::vector<std::string> get_strings(ByteReader &in, size_t count)
+    {
+        size_t raw_size = in.varint();
+        size_t compressed_size = in.varint();
+        std::string raw = lz_decompress(in.bytes(compressed_size), raw_size);
+
+        ByteReader strings(raw);
+        std::vector<std::string> result(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            result[i] = strings.bytes(strings.varint());
+        }
+        return result;
+    }
+
+    /**
+     * Encode one block of rows: statistics, then the encoded column payload.
+     */
+    std::string encode_block(const std::vector<Product> &products, size_t begin, size_t end,
+                             const std::map<std::string, uint64_t> &dictionary)
+    {
+        size_t rows = end - begin;
+        std::vector<uint64_t> ids, categories, quantities, prices;
+        std::vector<std::string> names, descriptions, skus;
+
+        int64_t min_id = products[begin].get_id(), max_id = min_id;
+        int64_t min_quantity = products[begin].get_quantity(), max_quantity = min_quantity;
+        int64_t min_cents = products[begin].get_price_cents(), max_cents = min_cents;
+
+        for (size_t i = begin; i < end; i++)
+        {
+            const Product &product = products[i];
+            min_id = std::min<int64_t>(min_id, product.get_id());
+            max_id = std::max<int64_t>(max_id, product.get_id());
+            min_quantity = std::min<int64_t>(min_quantity, product.get_quantity());
+            max_quantity = std::max<int64_t>(max_quantity, product.get_quantity());
+            min_cents = std::min<int64_t>(min_cents, product.get_price_cents());
+            max_cents = std::max<int64_t>(max_cents, product.get_price_cents());
+            categories.push_back(dictionary.at(product.get_category()));
+            names.push_back(product.get_name());
+            descriptions.push_back(product.get_description());
+            skus.push_back(product.get_sku());
+        }
+
+        // IDs: first value, then zigzagged deltas (small and positive when sorted)
+        int64_t previous = products[begin].get_id();
+        for (size_t i = begin + 1; i < end; i++)
+        {
+            ids.push_back(zigzag(static_cast<int64_t>(products[i].get_id()) - previous));
+            previous = products[i].get_id();
+        }
+
+        for (size_t i = begin; i < end; i++)
+        {
+            quantities.push_back(static_cast<uint64_t>(products[i].get_quantity() - min_quantity));
+        }
+
+        for (size_t i = begin; i < end; i++)
+        {
+            prices.push_back(static_cast<uint64_t>(products[i].get_price_cents() - min_cents));
+        }
+
+        std::string payload;
+        put_varint(payload, zigzag(products[begin].get_id()));
+        put_packed(payload, ids);
+        put_packed(payload, categories);
+        put_packed(payload, quantities);
+        put_packed(payload, prices);
+        put_strings(payload, names);
+        put_strings(payload, descriptions);
+        put_strings(payload, skus);
+
+        std::string block;
+        put_varint(block, rows);
+        put_varint(block, zigzag(min_id));
+        put_varint(block, zigzag(max_id));
+        put_varint(block, zigzag(min_quantity));
+        put_varint(block, zigzag(max_quantity));
+        put_varint(block, *std::min_element(categories.begin(), categories.end()));
+        put_varint(block, *std::max_element(categories.begin(), categories.end()));
+        block += static_cast<char>(PRICE_CENTS);
+        put_varint(block, zigzag(min_cents));
+        put_varint(block, zigzag(max_cents));
+        put_varint(block, payload.size());
+        block += payload;
+        return block;
+    }
+
+    // Older files stored prices that were not whole cents as doubles; they round to the nearest cent
+    Cents raw_price_cents(uint64_t bits)
+    {
+        double price = bits_double(bits);
+        if (!std::isfinite(price) || std::fabs(price) >= 9.2e16)
+        {
+            throw CorruptData();
+        }
+        return cents_from_double(price);
+    }
+
+    void decode_block(const std::string &payload, size_t rows, bool cents, int64_t min_quantity,
+                      int64_t min_cents, const std::vector<std::string> &dictionary,
+                      const ColumnarPredicate &predicate, const std::function<void(const Product &)> &visit)
+    {
+        ByteReader in(payload);
+
+        int64_t first_id = unzigzag(in.varint());
+        std::vector<uint64_t> id_deltas = get_packed(in, rows - 1);
+        std::vector<uint64_t> categories = get_packed(in, rows);
+        std::vector<uint64_t> quantities = get_packed(in, rows);
+
+        std::vector<Cents> prices(rows);
+        if (cents)
+        {
+            std::vector<uint64_t> packed = get_packed(in, rows);
+            for (size_t i = 0; i < rows; i++)
+            {
+                prices[i] = min_cents + static_cast<int64_t>(packed[i]);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < rows; i++)
+            {
+                prices[i] = raw_price_cents(in.u64());
+            }
+        }
+
+        std::vector<std::string> names = get_strings(in, rows);
+        std::vector<std::string> descriptions = get_strings(in, rows);
+
+        // Files written before products had SKUs end the block here
+        std::vector<std::string> skus = in.at_end() ? std::vector<std::string>(rows) : get_strings(in, rows);
+
+        int64_t id = first_id;
+        for (size_t i = 0; i < rows; i++)
+        {
+            if (i > 0)
+            {
+                id += unzigzag(id_deltas[i - 1]);
+            }
+            if (categories[i] >= dictionary.size())
+            {
+                throw CorruptData();
+            }
+
+            Product product(static_cast<int>(id), names[i], dictionary[categories[i]], prices[i],
+                            static_cast<int>(min_quantity + static_cast<int64_t>(quantities[i])),
+                            descriptions[i], skus[i]);
+            if (predicate.matches(product))
+            {
+                visit(product);
+            }
+        }
+    }
+}
+
+bool ColumnarPredicate::matches(const Product &product) const
+{
+    return product.get_id() >= min_id && product.get_id() <= max_id &&
+           product.get_quantity() >= min_quantity && product.get_quantity() <= max_quantity &&
+           product.get_price_cents() >= min_price_cents && product.get_price_cents() <= max_price_cents &&
+           (category.empty() || product.get_category() == category);
+}
+
+void ColumnarFile::write(const std::string &filename, const std::vector<Product> &products, size_t block_rows)
+{
+    if (block_rows == 0)
+    {
+        throw InventoryException("Columnar block size must be greater than zero");
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw FileOperationException("open", filename);
+    }
+
+    // Sorted dictionary, so code order matches string order for block statistics
+    std::map<std::string, uint64_t> dictionary;
+    for (const auto &product : products)
+    {
+        dictionary[product.get_category()] = 0;
+    }
+    uint64_t code = 0;
+    for (auto &entry : dictionary)
+    {
+        entry.second = code++;
+    }
+
+    std::string header(FILE_MAGIC, sizeof(FILE_MAGIC) - 1);
+    put_varint(header, FORMAT_VERSION);
+    put_varint(header, block_rows);
+    put_varint(header, products.size());
+    put_varint(header, dictionary.size());
+    for (const auto &entry : dictionary)
+    {
+        put_varint(header, entry.first.size());
+        header += entry.first;
+    }
+    put_varint(header, (products.size() + block_rows - 1) / block_rows);
+    file.write(header.data(), header.size());
+
+    for (size_t begin = 0; begin < products.size(); begin += block_rows)
+    {
+        std::string block = encode_block(products, begin, std::min(products.size(), begin + block_rows), dictionary);
+        file.write(block.data(), block.size());
+    }
+
+    file.close();
+    if (file.fail())
+    {
+        throw FileOperationException("write", filename);
+    }
+}
+
+ColumnarScanResult ColumnarFile::read(const std::string &filename, const ColumnarPredicate &predicate)
+{
+    std::vector<Product> products;
+    ColumnarScanResult result = scan(filename, predicate, [&products](const Product &product)
+                                     { products.push_back(product); });
+    result.products = std::move(products);
+    return result;
+}
+
+ColumnarScanResult ColumnarFile::scan(const std::string &filename, const ColumnarPredicate &predicate,
+                                      const std::function<void(const Product &)> &visit)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw FileOperationException("open", filename);
+    }
+
+    ColumnarScanResult result;
+    try
+    {
+        char magic[sizeof(FILE_MAGIC) - 1];
+        if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0 ||
+            read_varint(file) != FORMAT_VERSION)
+        {
+            throw CorruptData();
+        }
+
+        read_varint(file); // Block size, informational
+        read_varint(file); // Total row count, informational
+
+        std::vector<std::string> dictionary(read_varint(file));
+        for (auto &entry : dictionary)
+        {
+            entry.resize(read_varint(file));
+            if (!file.read(&entry[0], entry.size()))
+            {
+                throw CorruptData();
+            }
+        }
+
+        // An unknown category cannot match any block
+        uint64_t category_code = 0;
+        bool any_category = predicate.category.empty();
+        bool category_present = false;
+        if (!any_category)
+        {
+            auto found = std::lower_bound(dictionary.begin(), dictionary.end(), predicate.category);
+            category_present = found != dictionary.end() && *found == predicate.category;
+            category_code = found - dictionary.begin();
+        }
+
+        uint64_t block_count = read_varint(file);
+
+        for (uint64_t block = 0; block < block_count; block++)
+        {
+            size_t rows = read_varint(file);
+            int64_t min_id = unzigzag(read_varint(file));
+            int64_t max_id = unzigzag(read_varint(file));
+            int64_t min_quantity = unzigzag(read_varint(file));
+            int64_t max_quantity = unzigzag(read_varint(file));
+            uint64_t min_category = read_varint(file);
+            uint64_t max_category = read_varint(file);
+
+            int price_kind = file.get();
+            int64_t min_cents = 0, max_cents = 0;
+            if (price_kind == PRICE_CENTS)
+            {
+                min_cents = unzigzag(read_varint(file));
+                max_cents = unzigzag(read_varint(file));
+            }
+            else if (price_kind == PRICE_RAW)
+            {
+                char raw[16];
+                if (!file.read(raw, sizeof(raw)))
+                {
+                    throw CorruptData();
+                }
+                std::string bytes(raw, sizeof(raw));
+                ByteReader in(bytes);
+                min_cents = raw_price_cents(in.u64());
+                max_cents = raw_price_cents(in.u64());
+            }
+            else
+            {
+                throw CorruptData();
+            }
+
+            uint64_t payload_size = read_varint(file);
+            if (rows == 0)
+            {
+                throw CorruptData();
+            }
+
+            bool skip = max_id < predicate.min_id || min_id > predicate.max_id ||
+                        max_quantity < predicate.min_quantity || min_quantity > predicate.max_quantity ||
+                        max_cents < predicate.min_price_cents || min_cents > predicate.max_price_cents ||
+                        (!any_category && (!category_present || category_code < min_category ||
+                                           category_code > max_category));
+            if (skip)
+            {
+                file.seekg(payload_size, std::ios::cur);
+                result.blocks_skipped++;
+                continue;
+            }
+
+            std::string payload(payload_size, '\0');
+            if (!file.read(&payload[0], payload_size))
+            {
+                throw CorruptData();
+            }
+            decode_block(payload, rows, price_kind == PRICE_CENTS, min_quantity, min_cents,
+                         dictionary, predicate, visit);
+            result.blocks_read++;
+        }
+    }
+    catch (const CorruptData &)
+    {
+        throw FileOperationException("read", filename);
+    }
+
+    return result;
+}
+
+bool ColumnarFile::is_columnar_file(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(FILE_MAGIC) - 1];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, FILE_MAGIC, sizeof(magic)) == 0;
+}
@@ -0,0 +1,326 @@
+#include "includes/concurrent_inventory.h"
+#include <algorithm>
+#include <climits>
+#include <thread>
+
+namespace
+{
+    // Versions start here when products are loaded, so anything higher has
+    // been written since
+    const uint64_t INITIAL_VERSION = 1;
+
+    // Stripes per hardware thread when the caller does not choose a count
+    const size_t STRIPES_PER_THREAD = 16;
+
+    int checked_quantity(int id, int quantity, int delta)
+    {
+        long long result = static_cast<long long>(quantity) + delta;
+        if (result < 0)
+        {
+            throw InventoryException("Insufficient stock for product with ID " + std::to_string(id));
+        }
+        if (result > INT_MAX)
+        {
+            throw InventoryException("Quantity overflow for product with ID " + std::to_string(id));
+        }
+        return static_cast<int>(result);
+    }
+
+    Product with_id(const Product &product, int id)
+    {
+        Product copy = product;
+        copy.set_id(id);
+        return copy;
+    }
+}
+
+ConcurrentInventory::ConcurrentInventory(const InventoryManager &manager, size_t stripe_count)
+{
+    if (stripe_count == 0)
+    {
+        stripe_count = STRIPES_PER_THREAD * std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    size_t count = 1;
+    while (count < stripe_count)
+    {
+        count <<= 1;
+    }
+    stripes.reset(new Stripe[count]);
+    stripe_mask = count - 1;
+
+    for (const auto &product : manager.get_all_products())
+    {
+        Entry entry = {product, INITIAL_VERSION};
+        stripes[stripe_of(product.get_id())].entries.emplace(product.get_id(), entry);
+    }
+}
+
+size_t ConcurrentInventory::stripe_of(int id) const
+{
+    // Fibonacci hashing spreads consecutive IDs over all stripes
+    uint64_t hash = static_cast<uint32_t>(id) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(hash >> 32) & stripe_mask;
+}
+
+ConcurrentInventory::Entry &ConcurrentInventory::locked_entry(int id) const
+{
+    Entry *entry = find_locked_entry(id);
+    if (entry == nullptr)
+    {
+        throw ProductNotFoundException(id);
+    }
+    return *entry;
+}
+
+ConcurrentInventory::Entry *ConcurrentInventory::find_locked_entry(int id) const
+{
+    auto &entries = stripes[stripe_of(id)].entries;
+    auto found = entries.find(id);
+    return found == entries.end() ? nullptr : &found->second;
+}
+
+Product ConcurrentInventory::get_product_by_id(int id) const
+{
+    return get_versioned_product(id).product;
+}
+
+VersionedProduct ConcurrentInventory::get_versioned_product(int id) const
+{
+    std::shared_lock<std::shared_mutex> lock(stripes[stripe_of(id)].mutex);
+    const Entry &entry = locked_entry(id);
+    return VersionedProduct{entry.product, entry.version};
+}
+
+void ConcurrentInventory::update_product(int id, const Product &updated_product)
+{
+    std::unique_lock<std::shared_mutex> lock(stripes[stripe_of(id)].mutex);
+    Entry &entry = locked_entry(id);
+    entry.product = with_id(updated_product, id);
+    entry.version++;
+}
+
+bool ConcurrentInventory::update_product_if_version(int id, uint64_t expected_version,
+                                                    const Product &updated_product)
+{
+    std::unique_lock<std::shared_mutex> lock(stripes[stripe_of(id)].mutex);
+    Entry &entry = locked_entry(id);
+    if (entry.version != expected_version)
+    {
+        return false;
+    }
+    entry.product = with_id(updated_product, id);
+    entry.version++;
+    return true;
+}
+
+bool ConcurrentInventory::try_get_product_by_id(int id, Product &product) const
+{
+    std::shared_lock<std::shared_mutex> lock(stripes[stripe_of(id)].mutex);
+    const Entry *entry = find_locked_entry(id);
+    if (entry == nullptr)
+    {
+        return false;
+    }
+    product = entry->product;
+    return true;
+}
+
+InventoryStatus ConcurrentInventory::try_update_product(int id, const Product &updated_product)
+{
+    std::unique_lock<std::shared_mutex> lock(stripes[stripe_of(id)].mutex);
+    Entry *entry = find_locked_entry(id);
+    if (entry == nullptr)
+    {
+        return InventoryStatus::NOT_FOUND;
+    }
+    entry->product = with_id(updated_product, id);
+    entry->version++;
+    return InventoryStatus::OK;
+}
+
+int ConcurrentInventory::adjust_quantity(int id, int delta)
+{
+    std::unique_lock<std::shared_mutex> lock(stripes[stripe_of(id)].mutex);
+    Entry &entry = locked_entry(id);
+    int quantity = checked_quantity(id, entry.product.get_quantity(), delta);
+    entry.product.set_quantity(quantity);
+    entry.version++;
+    return quantity;
+}
+
+void ConcurrentInventory::move_quantity(int from_id, int to_id, int amount)
+{
+    if (amount < 0)
+    {
+        throw InventoryException("Cannot move a negative quantity");
+    }
+
+    bool committed = run_transaction([from_id, to_id, amount](InventoryTransaction &transaction)
+                                     {
+                                         transaction.adjust_quantity(from_id, -amount);
+                                         transaction.adjust_quantity(to_id, amount);
+                                     });
+    if (!committed)
+    {
+        throw InventoryException("Stock move aborted after repeated conflicts");
+    }
+}
+
+bool ConcurrentInventory::run_transaction(const std::function<void(InventoryTransaction &)> &body,
+                                          int max_attempts)
+{
+    for (int attempt = 0; attempt < max_attempts; attempt++)
+    {
+        InventoryTransaction transaction(*this);
+        body(transaction);
+        if (transaction.commit())
+        {
+            return true;
+        }
+        std::this_thread::yield();
+    }
+    return false;
+}
+
+std::vector<Product> ConcurrentInventory::get_all_products() const
+{
+    // Stripes are always locked in ascending order, as in commit()
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    locks.reserve(stripe_mask + 1);
+    size_t count = 0;
+    for (size_t i = 0; i <= stripe_mask; i++)
+    {
+        locks.emplace_back(stripes[i].mutex);
+        count += stripes[i].entries.size();
+    }
+
+    std::vector<Product> products;
+    products.reserve(count);
+    for (size_t i = 0; i <= stripe_mask; i++)
+    {
+        for (const auto &item : stripes[i].entries)
+        {
+            products.push_back(item.second.product);
+        }
+    }
+    locks.clear();
+
+    std::sort(products.begin(), products.end(), [](const Product &a, const Product &b)
+              { return a.get_id() < b.get_id(); });
+    return products;
+}
+
+size_t ConcurrentInventory::write_back(InventoryManager &manager) const
+{
+    std::vector<Product> changed;
+    for (size_t i = 0; i <= stripe_mask; i++)
+    {
+        std::shared_lock<std::shared_mutex> lock(stripes[i].mutex);
+        for (const auto &item : stripes[i].entries)
+        {
+            if (item.second.version != INITIAL_VERSION)
+            {
+                changed.push_back(item.second.product);
+            }
+        }
+    }
+
+    size_t written = 0;
+    for (const auto &product : changed)
+    {
+        if (!InventoryDiff::compare_fields(manager.get_product_by_id(product.get_id()), product).empty())
+        {
+            manager.update_product(product.get_id(), product);
+            written++;
+        }
+    }
+    return written;
+}
+
+InventoryTransaction::InventoryTransaction(ConcurrentInventory &inventory)
+    : inventory(inventory), conflicted(false) {}
+
+Product InventoryTransaction::read(int id)
+{
+    auto written = writes.find(id);
+    if (written != writes.end())
+    {
+        return written->second;
+    }
+
+    VersionedProduct current = inventory.get_versioned_product(id);
+    auto seen = read_versions.find(id);
+    if (seen == read_versions.end())
+    {
+        read_versions.emplace(id, current.version);
+    }
+    else if (seen->second != current.version)
+    {
+        // Two reads saw different values; commit() will fail, so stop early
+        conflicted = true;
+    }
+    return current.product;
+}
+
+void InventoryTransaction::write(int id, const Product &updated_product)
+{
+    if (!read_versions.count(id) && !writes.count(id))
+    {
+        read(id); // Records the version so a concurrent write is detected
+    }
+    writes[id] = with_id(updated_product, id);
+}
+
+int InventoryTransaction::adjust_quantity(int id, int delta)
+{
+    Product product = read(id);
+    int quantity = checked_quantity(id, product.get_quantity(), delta);
+    product.set_quantity(quantity);
+    writes[id] = product;
+    return quantity;
+}
+
+bool InventoryTransaction::commit()
+{
+    if (conflicted)
+    {
+        return false;
+    }
+
+    // Lock every stripe involved, in ascending order so concurrent commits
+    // cannot deadlock
+    std::vector<size_t> stripe_indexes;
+    for (const auto &read : read_versions)
+    {
+        stripe_indexes.push_back(inventory.stripe_of(read.first));
+    }
+    std::sort(stripe_indexes.begin(), stripe_indexes.end());
+    stripe_indexes.erase(std::unique(stripe_indexes.begin(), stripe_indexes.end()), stripe_indexes.end());
+
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    locks.reserve(stripe_indexes.size());
+    for (size_t index : stripe_indexes)
+    {
+        locks.emplace_back(inventory.stripes[index].mutex);
+    }
+
+    for (const auto &read : read_versions)
+    {
+        if (inventory.locked_entry(read.first).version != read.second)
+        {
+            return false;
+        }
+    }
+
+    for (const auto &write : writes)
+    {
+        ConcurrentInventory::Entry &entry = inventory.locked_entry(write.first);
+        entry.product = write.second;
+        entry.version++;
+    }
+
+    read_versions.clear();
+    writes.clear();
+    return true;
+}
@@ -0,0 +1,317 @@
+#include "includes/csv_codec.h"
+#include "includes/inventory_manager.h"
+#include "includes/product_schema.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+const std::string PRODUCT_CSV_HEADER = ProductSchema::csv_header();
+
+namespace
+{
+    // Get the next field of a row being split, reusing the string left from an earlier row
+    std::string &next_field(std::vector<std::string> &fields, size_t &count)
+    {
+        if (count == fields.size())
+        {
+            fields.emplace_back();
+        }
+        std::string &field = fields[count++];
+        field.clear();
+        return field;
+    }
+
+    // Match the product columns to a file's header line
+    ProductSchema::CsvLayout read_csv_layout(std::string header)
+    {
+        if (!header.empty() && header.back() == '\r')
+        {
+            header.pop_back();
+        }
+        return ProductSchema::csv_layout(split_csv_line(header));
+    }
+}
+
+std::string csv_quote(const std::string &field)
+{
+    std::string quoted;
+    quoted.reserve(field.size() + 2);
+    quoted += '"';
+    for (char c : field)
+    {
+        if (c == '"')
+        {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+void write_csv_quoted(std::ostream &out, std::string_view field)
+{
+    out.put('"');
+    size_t start = 0;
+    for (size_t quote = field.find('"'); quote != std::string_view::npos; quote = field.find('"', start))
+    {
+        out.write(field.data() + start, static_cast<std::streamsize>(quote + 1 - start));
+        out.put('"');
+        start = quote + 1;
+    }
+    out.write(field.data() + start, static_cast<std::streamsize>(field.size() - start));
+    out.put('"');
+}
+
+void write_product_csv_row(std::ostream &out, const Product &product)
+{
+    ProductSchema::write_csv_row(out, product);
+}
+
+std::vector<std::string> split_csv_line(const std::string &line)
+{
+    std::vector<std::string> fields;
+    split_csv_line(line, fields);
+    return fields;
+}
+
+void split_csv_line(const std::string &line, std::vector<std::string> &fields)
+{
+    size_t count = 0;
+    std::string *field = &next_field(fields, count);
+    bool in_quotes = false;
+    size_t pos = 0;
+
+    while (pos < line.length())
+    {
+        // Copy the run of regular characters up to the next quote, or comma outside quotes
+        size_t end = pos;
+        while (end < line.length() && line[end] != '"' && (in_quotes || line[end] != ','))
+        {
+            end++;
+        }
+        field->append(line, pos, end - pos);
+        pos = end;
+        if (pos == line.length())
+        {
+            break;
+        }
+
+        if (line[pos] == '"')
+        {
+            if (in_quotes && pos + 1 < line.length() && line[pos + 1] == '"')
+            {
+                // Escaped quote (two quotes in a row) inside a quoted field
+                *field += '"';
+                pos += 2;
+            }
+            else
+            {
+                // Opening or closing quote
+                in_quotes = !in_quotes;
+                pos++;
+            }
+        }
+        else
+        {
+            // End of field
+            field = &next_field(fields, count);
+            pos++;
+        }
+    }
+
+    fields.resize(count);
+}
+
+bool find_csv_field(const std::string &line, size_t index, size_t &start, size_t &length, bool &escaped)
+{
+    size_t pos = 0;
+    for (size_t field = 0;; field++)
+    {
+        size_t content_start = pos;
+        size_t content_end;
+        size_t end; // Just past the field
+        bool doubled = false;
+
+        if (pos < line.length() && line[pos] == '"')
+        {
+            content_start = pos + 1;
+            content_end = line.find('"', content_start);
+            while (content_end != std::string::npos && content_end + 1 < line.length() &&
+                   line[content_end + 1] == '"')
+            {
+                doubled = true;
+                content_end = line.find('"', content_end + 2);
+            }
+            if (content_end == std::string::npos)
+            {
+                return false;
+            }
+            end = content_end + 1;
+            if (end < line.length() && line[end] != ',')
+            {
+                // Text after the closing quote; split_csv_line joins it to the field
+                return false;
+            }
+        }
+        else
+        {
+            end = std::min(line.find(',', pos), line.length());
+            content_end = end;
+            if (line.find('"', pos) < end)
+            {
+                return false;
+            }
+        }
+
+        if (field == index)
+        {
+            start = content_start;
+            length = content_end - content_start;
+            escaped = doubled;
+            return true;
+        }
+        if (end >= line.length())
+        {
+            return false;
+        }
+        pos = end + 1;
+    }
+}
+
+bool parse_product_csv_row(const std::string &line, Product &product)
+{
+    return parse_product_csv_fields(split_csv_line(line), product);
+}
+
+bool parse_product_csv_fields(const std::vector<std::string> &fields, Product &product)
+{
+    // Prices convert to cents here, at the file boundary
+    return ProductSchema::parse_csv_fields(fields, product);
+}
+
+void read_product_csv_file(const std::string &filename, const std::function<void(Product &)> &visit)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        throw FileOperationException("open", filename);
+    }
+
+    read_product_csv(file, visit);
+}
+
+void read_product_csv(std::istream &in, const std::function<void(Product &)> &visit)
+{
+    std::string line;
+    std::getline(in, line);
+    ProductSchema::CsvLayout layout = read_csv_layout(line);
+
+    std::vector<std::string> fields;
+    Product product;
+    while (std::getline(in, line))
+    {
+        // Skip empty and invalid lines
+        if (line.empty())
+        {
+            continue;
+        }
+        split_csv_line(line, fields);
+        if (ProductSchema::parse_csv_fields(fields, product, layout))
+        {
+            visit(product);
+        }
+    }
+}
+
+void read_product_csv_file_lazily(const std::string &filename, const std::function<void(Product &)> &visit)
+{
+    std::shared_ptr<const ColdSegment> segment = ColdSegment::open_file(filename);
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw FileOperationException("open", filename);
+    }
+
+    std::string line;
+    std::getline(file, line);
+    uint64_t line_offset = line.size() + 1;
+    ProductSchema::CsvLayout layout = read_csv_layout(line);
+
+    struct ColdField
+    {
+        bool found;
+        size_t start;
+        size_t length;
+        bool escaped;
+    };
+    ColdField cold_fields[ProductSchema::COLUMN_COUNT] = {};
+
+    std::vector<std::string> fields;
+    Product product;
+    for (; std::getline(file, line); line_offset += line.size() + 1)
+    {
+        if (line.empty())
+        {
+            continue;
+        }
+        split_csv_line(line, fields);
+
+        // Locate each cold field in the line, and leave it out of the parse
+        ProductSchema::for_each_cold_column(product, [&](size_t column, ColdText &)
+                                            {
+                                                ColdField &cold = cold_fields[column];
+                                                size_t position = layout.positions[column];
+                                                cold.found = position < fields.size() &&
+                                                             find_csv_field(line, position, cold.start, cold.length, cold.escaped) &&
+                                                             cold.length <= UINT32_MAX;
+                                                if (cold.found)
+                                                {
+                                                    fields[position].clear();
+                                                }
+                                            });
+        if (!ProductSchema::parse_csv_fields(fields, product, layout))
+        {
+            continue;
+        }
+
+        ProductSchema::for_each_cold_column(product, [&](size_t column, ColdText &text)
+                                            {
+                                                const ColdField &cold = cold_fields[column];
+                                                if (cold.found && cold.length > 0)
+                                                {
+                                                    text = ColdText(segment, line_offset + cold.start,
+                                                                    static_cast<uint32_t>(cold.length), cold.escaped);
+                                                }
+                                            });
+        visit(product);
+    }
+}
+
+void write_file_atomically(const std::string &filename, const std::function<void(std::ostream &)> &write)
+{
+    std::string temp_path = filename + ".tmp";
+    {
+        std::ofstream file(temp_path);
+        if (!file.is_open())
+        {
+            throw FileOperationException("open", temp_path);
+        }
+        write(file);
+        file.close();
+        if (file.fail())
+        {
+            std::remove(temp_path.c_str());
+            throw FileOperationException("write", temp_path);
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, filename, error);
+    if (error)
+    {
+        std::remove(temp_path.c_str());
+        throw FileOperationException("rename", temp_path);
+    }
+}
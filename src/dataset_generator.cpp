@@ -0,0 +1,259 @@
+#include "includes/dataset_generator.h"
+#include "includes/csv_codec.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace
+{
+    const std::string CATEGORIES[] = {
+        "Electronics", "Home & Kitchen", "Tools", "Office Supplies", "Toys & Games",
+        "Garden, Patio & Outdoor", "Sports", "Clothing", "Books", "Grocery",
+        "Health", "Beauty", "Automotive", "Pet Supplies", "Baby",
+        "Music", "Jewelry", "Arts, Crafts & Sewing", "Industrial", "Software",
+        "Cafés & Bakery", "Kids' \"Fun\" Zone", "Lighting", "Plumbing", "Hardware",
+        "Luggage", "Footwear", "Furniture", "Appliances", "Stationery",
+        "Camping", "Fitness", "Video Games", "Cameras", "Phones",
+        "Networking", "Storage", "Cleaning", "Party Supplies", "Seasonal"};
+
+    const std::string BRANDS[] = {
+        "Acme", "Globex", "Initech", "Umbrella", "Stark", "Wayne", "Wonka", "Tyrell",
+        "Cyberdyne", "Soylent", "Hooli", "Vandelay", "Müller", "Señor Frío", "Øresund", "Zoë's"};
+
+    const std::string MODIFIERS[] = {
+        "", "", "", "Deluxe", "Compact", "Heavy-Duty", "Mini", "Pro", "Classic", "Eco",
+        "Wireless", "Stainless", "Ultra", "Smart", "Vintage", "Portable"};
+
+    const std::string ITEMS[] = {
+        "Widget", "Gadget", "Bolt", "Hammer", "Lamp", "Kettle", "Notebook", "Charger",
+        "Blender", "Backpack", "Drill", "Sprocket", "Cable", "Speaker", "Mug", "Tent",
+        "Router", "Stapler", "Scarf", "Helmet", "Blanket", "Puzzle", "Candle", "Sensor"};
+
+    const std::string SIZES[] = {
+        "", "", "", "", "", "Small", "Large", "XL", "12\"", "3/8\"", "500ml", "2m",
+        "(Pack of 3)", "(Pack of 12)", "Set, 6 pcs", "Red, Matte"};
+
+    const std::string DESCRIPTION_OPENERS[] = {
+        "", "", "Bestseller.", "New arrival.", "Limited stock.", "Imported, duty paid.",
+        "Ships in 2-3 days.", "Customer favorite: \"would buy again\"."};
+
+    const std::string DESCRIPTION_DETAILS[] = {
+        "Durable construction", "Easy to clean", "Includes batteries", "One-year warranty",
+        "Assembly required", "Fits most models", "Made from recycled materials", "Dishwasher safe"};
+
+    const int PRICE_CENTS[] = {99, 99, 99, 49, 0, 95};
+
+    const double ZIPF_EXPONENT = 1.1;
+
+    const int64_t MOVEMENTS_START = 1704067200; // 2024-01-01T00:00:00Z
+
+    // EAN-13 barcode from the in-store prefix 200 and the zero-padded ID, ending in its check digit
+    std::string ean13(int id)
+    {
+        std::string digits = std::to_string(id);
+        digits = "200" + std::string(9 - std::min<size_t>(digits.size(), 9), '0') + digits.substr(0, 9);
+        int sum = 0;
+        for (size_t i = 0; i < 12; i++)
+        {
+            sum += (digits[i] - '0') * (i % 2 == 0 ? 1 : 3);
+        }
+        return digits + char('0' + (10 - sum % 10) % 10);
+    }
+}
+
+DatasetGenerator::DatasetGenerator(uint64_t seed) : state(seed)
+{
+    double total = 0.0;
+    for (size_t rank = 1; rank <= std::size(CATEGORIES); rank++)
+    {
+        total += 1.0 / std::pow(double(rank), ZIPF_EXPONENT);
+        category_weights.push_back(total);
+    }
+    for (auto &weight : category_weights)
+    {
+        weight /= total;
+    }
+}
+
+uint64_t DatasetGenerator::next_u64()
+{
+    // splitmix64
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+double DatasetGenerator::next_double()
+{
+    // 53 random bits in [0, 1)
+    return double(next_u64() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+size_t DatasetGenerator::next_index(size_t bound)
+{
+    // Multiply-shift maps to [0, bound) with negligible bias for small bounds
+    return static_cast<size_t>(((next_u64() >> 32) * bound) >> 32);
+}
+
+double DatasetGenerator::next_normal()
+{
+    // Box-Muller; 1 - u keeps the logarithm finite
+    double u = 1.0 - next_double();
+    double v = next_double();
+    return std::sqrt(-2.0 * std::log(u)) * std::cos(6.283185307179586 * v);
+}
+
+const std::string &DatasetGenerator::next_category()
+{
+    double u = next_double();
+    size_t rank = 0;
+    while (rank + 1 < category_weights.size() && category_weights[rank] <= u)
+    {
+        rank++;
+    }
+    return CATEGORIES[rank];
+}
+
+const std::string &DatasetGenerator::next_name_word()
+{
+    return next_index(2) == 0 ? BRANDS[next_index(std::size(BRANDS))] : ITEMS[next_index(std::size(ITEMS))];
+}
+
+Product DatasetGenerator::next_product(int id)
+{
+    const std::string &category = next_category();
+
+    std::string name = BRANDS[next_index(std::size(BRANDS))];
+    const std::string &modifier = MODIFIERS[next_index(std::size(MODIFIERS))];
+    if (!modifier.empty())
+    {
+        name += ' ';
+        name += modifier;
+    }
+    name += ' ';
+    name += ITEMS[next_index(std::size(ITEMS))];
+    const std::string &size = SIZES[next_index(std::size(SIZES))];
+    if (!size.empty())
+    {
+        name += ' ';
+        name += size;
+    }
+
+    // Log-normal with a median of $25, clamped to a plausible shelf range
+    double dollars = std::floor(25.0 * std::exp(1.1 * next_normal()));
+    dollars = std::min(std::max(dollars, 0.0), 99999.0);
+    Cents price_cents = static_cast<Cents>(dollars) * 100 + PRICE_CENTS[next_index(std::size(PRICE_CENTS))];
+
+    // One in ten is low on stock; the rest spread geometrically up to a few hundred
+    int quantity = next_index(10) == 0 ? static_cast<int>(next_index(10))
+                                       : 10 + static_cast<int>(-std::log(1.0 - next_double()) * 80.0);
+
+    std::string description = DESCRIPTION_OPENERS[next_index(std::size(DESCRIPTION_OPENERS))];
+    size_t details = next_index(3);
+    for (size_t d = 0; d < details; d++)
+    {
+        if (!description.empty())
+        {
+            description += d == 0 ? " " : ", ";
+        }
+        description += DESCRIPTION_DETAILS[next_index(std::size(DESCRIPTION_DETAILS))];
+    }
+
+    // The SKU draws no random numbers, so adding it left the other fields of every seed unchanged
+    return Product(id, name, category, price_cents, quantity, description, ean13(id));
+}
+
+std::vector<Product> DatasetGenerator::generate(size_t count)
+{
+    std::vector<Product> products;
+    products.reserve(count);
+    for (size_t i = 1; i <= count; i++)
+    {
+        products.push_back(next_product(static_cast<int>(i)));
+    }
+    return products;
+}
+
+void DatasetGenerator::write_csv(std::ostream &out, size_t count)
+{
+    out << PRODUCT_CSV_HEADER << "\n";
+    for (size_t i = 1; i <= count; i++)
+    {
+        write_product_csv_row(out, next_product(static_cast<int>(i)));
+    }
+}
+
+StockMovement DatasetGenerator::next_movement(int product_count, int64_t &timestamp)
+{
+    timestamp += static_cast<int64_t>(-std::log(1.0 - next_double()) * 30.0);
+
+    StockMovement movement;
+    movement.product_id = 1 + static_cast<int>(next_index(1 + next_index(static_cast<size_t>(product_count))));
+    movement.timestamp = timestamp;
+
+    size_t kind = next_index(100);
+    if (kind < 70)
+    {
+        movement.reason = MovementReason::SOLD;
+        movement.delta = -1 - static_cast<int64_t>(next_index(4));
+    }
+    else if (kind < 85)
+    {
+        // Deliveries come in cases of a dozen
+        movement.reason = MovementReason::RECEIVED;
+        movement.delta = 12 * (1 + static_cast<int64_t>(next_index(10)));
+    }
+    else if (kind < 92)
+    {
+        movement.reason = MovementReason::RETURNED;
+        movement.delta = 1;
+    }
+    else
+    {
+        movement.reason = MovementReason::ADJUSTED;
+        movement.delta = (next_index(2) == 0 ? -1 : 1) * (1 + static_cast<int64_t>(next_index(3)));
+    }
+    return movement;
+}
+
+void DatasetGenerator::write_movements_csv(std::ostream &out, int product_count, size_t count)
+{
+    out << "ID,Timestamp,Delta,Reason\n";
+    int64_t timestamp = MOVEMENTS_START;
+    for (size_t i = 0; i < count; i++)
+    {
+        StockMovement movement = next_movement(product_count, timestamp);
+        out << movement.product_id << "," << format_timestamp(movement.timestamp) << "," << movement.delta << ","
+            << movement_reason_name(movement.reason) << "\n";
+    }
+}
+
+void DatasetGenerator::write_location_stock_csv(std::ostream &out, int product_count, size_t location_count)
+{
+    out << "ID";
+    for (size_t location = 1; location <= location_count; location++)
+    {
+        out << ",Warehouse " << location;
+    }
+    out << "\n";
+
+    std::vector<int> quantities(location_count);
+    for (int id = 1; id <= product_count; id++)
+    {
+        std::fill(quantities.begin(), quantities.end(), 0);
+        size_t stocked = 1 + next_index(std::min<size_t>(location_count, 4));
+        for (size_t i = 0; i < stocked; i++)
+        {
+            // Repeated picks land in the same location, so some products are in fewer
+            quantities[next_index(location_count)] = static_cast<int>(-std::log(1.0 - next_double()) * 40.0);
+        }
+
+        out << id;
+        for (int quantity : quantities)
+        {
+            out << "," << quantity;
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,420 @@
+#include "includes/fuzzy_index.h"
+#include "includes/memory_accounting.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+namespace
+{
+    /**
+     * Myers' bit-parallel edit distance with a precomputed pattern bitmap.
+     */
+    class BitParallelMatcher
+    {
+    public:
+        explicit BitParallelMatcher(const std::string &pattern)
+            : length(pattern.size())
+        {
+            std::fill(peq, peq + 256, 0);
+            for (size_t i = 0; i < length; i++)
+            {
+                peq[static_cast<unsigned char>(pattern[i])] |= uint64_t(1) << i;
+            }
+        }
+
+        int distance(const std::string &text) const
+        {
+            if (length == 0)
+            {
+                return static_cast<int>(text.size());
+            }
+
+            const uint64_t last = uint64_t(1) << (length - 1);
+            uint64_t pv = ~uint64_t(0);
+            uint64_t mv = 0;
+            int score = static_cast<int>(length);
+
+            for (size_t j = 0; j < text.size(); j++)
+            {
+                uint64_t eq = peq[static_cast<unsigned char>(text[j])];
+                uint64_t xv = eq | mv;
+                uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+                uint64_t ph = mv | ~(xh | pv);
+                uint64_t mh = pv & xh;
+
+                if (ph & last)
+                {
+                    score++;
+                }
+                else if (mh & last)
+                {
+                    score--;
+                }
+
+                // Row 0 grows by one per text byte, so shift a +1 delta in
+                ph = (ph << 1) | 1;
+                mh <<= 1;
+                pv = mh | ~(xv | ph);
+                mv = ph & xv;
+            }
+            return score;
+        }
+
+    private:
+        uint64_t peq[256];
+        size_t length;
+    };
+
+    int dynamic_programming_distance(const std::string &a, const std::string &b)
+    {
+        std::vector<int> previous(b.size() + 1), current(b.size() + 1);
+        for (size_t j = 0; j <= b.size(); j++)
+        {
+            previous[j] = static_cast<int>(j);
+        }
+
+        for (size_t i = 1; i <= a.size(); i++)
+        {
+            current[0] = static_cast<int>(i);
+            for (size_t j = 1; j <= b.size(); j++)
+            {
+                int substitution = previous[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+                current[j] = std::min(substitution, std::min(previous[j], current[j - 1]) + 1);
+            }
+            std::swap(previous, current);
+        }
+        return previous[b.size()];
+    }
+
+    const size_t MAX_BIT_PARALLEL_LENGTH = 64;
+
+    int allowed_edits(const std::string &word, int max_distance)
+    {
+        int limit = word.size() < 4 ? 0 : (word.size() < 8 ? 1 : max_distance);
+        return std::min(limit, max_distance);
+    }
+}
+
+int edit_distance(const std::string &a, const std::string &b)
+{
+    if (a.size() <= MAX_BIT_PARALLEL_LENGTH)
+    {
+        return BitParallelMatcher(a).distance(b);
+    }
+    return dynamic_programming_distance(a, b);
+}
+
+std::vector<std::string> FuzzyNameIndex::split_words(const std::string &folded_text)
+{
+    std::vector<std::string> words;
+    std::string word;
+
+    for (char c : folded_text)
+    {
+        unsigned char byte = static_cast<unsigned char>(c);
+        bool word_char = byte >= 0x80 || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+        if (word_char)
+        {
+            word += c;
+        }
+        else if (!word.empty())
+        {
+            words.push_back(word);
+            word.clear();
+        }
+    }
+
+    if (!word.empty())
+    {
+        words.push_back(word);
+    }
+    return words;
+}
+
+void FuzzyNameIndex::clear()
+{
+    terms.clear();
+    term_lookup.clear();
+    nodes.clear();
+}
+
+void FuzzyNameIndex::add(int id, const std::string &folded_name)
+{
+    for (const auto &word : split_words(folded_name))
+    {
+        add_word(id, word);
+    }
+}
+
+void FuzzyNameIndex::remove(int id, const std::string &folded_name)
+{
+    for (const auto &word : split_words(folded_name))
+    {
+        remove_word(id, word);
+    }
+}
+
+void FuzzyNameIndex::update(int id, const std::string &old_folded_name, const std::string &new_folded_name)
+{
+    if (old_folded_name == new_folded_name)
+    {
+        return;
+    }
+
+    // Common words can have very long posting lists, so leave shared words alone
+    std::vector<std::string> old_words = split_words(old_folded_name);
+    std::vector<std::string> new_words = split_words(new_folded_name);
+    std::sort(old_words.begin(), old_words.end());
+    std::sort(new_words.begin(), new_words.end());
+
+    std::vector<std::string> removed, added;
+    std::set_difference(old_words.begin(), old_words.end(), new_words.begin(), new_words.end(),
+                        std::back_inserter(removed));
+    std::set_difference(new_words.begin(), new_words.end(), old_words.begin(), old_words.end(),
+                        std::back_inserter(added));
+
+    for (const auto &word : removed)
+    {
+        remove_word(id, word);
+    }
+    for (const auto &word : added)
+    {
+        add_word(id, word);
+    }
+}
+
+void FuzzyNameIndex::add_word(int id, const std::string &word)
+{
+    auto found = term_lookup.find(word);
+    int term;
+    if (found == term_lookup.end())
+    {
+        term = static_cast<int>(terms.size());
+        terms.push_back(Term());
+        terms.back().text = word;
+        term_lookup[word] = term;
+        insert_node(term);
+    }
+    else
+    {
+        term = found->second;
+    }
+
+    // Keep postings sorted; new products have the largest IDs so this is usually an append
+    std::vector<int> &ids = terms[term].ids;
+    auto pos = std::lower_bound(ids.begin(), ids.end(), id);
+    if (pos == ids.end() || *pos != id)
+    {
+        ids.insert(pos, id);
+    }
+}
+
+void FuzzyNameIndex::remove_word(int id, const std::string &word)
+{
+    // Terms whose postings become empty stay in the tree and are skipped by
+    // queries; they are reused if the word is indexed again
+    auto found = term_lookup.find(word);
+    if (found == term_lookup.end())
+    {
+        return;
+    }
+
+    std::vector<int> &ids = terms[found->second].ids;
+    auto pos = std::lower_bound(ids.begin(), ids.end(), id);
+    if (pos != ids.end() && *pos == id)
+    {
+        ids.erase(pos);
+    }
+}
+
+void FuzzyNameIndex::insert_node(int term)
+{
+    Node node;
+    node.term = term;
+
+    if (nodes.empty())
+    {
+        nodes.push_back(node);
+        return;
+    }
+
+    const std::string &text = terms[term].text;
+    size_t current = 0;
+    while (true)
+    {
+        int distance = edit_distance(text, terms[nodes[current].term].text);
+        std::vector<std::pair<int, int>> &children = nodes[current].children;
+
+        auto child = std::find_if(children.begin(), children.end(),
+                                  [distance](const std::pair<int, int> &c)
+                                  { return c.first == distance; });
+        if (child == children.end())
+        {
+            children.push_back(std::make_pair(distance, static_cast<int>(nodes.size())));
+            nodes.push_back(node);
+            return;
+        }
+        current = child->second;
+    }
+}
+
+std::vector<std::pair<int, int>> FuzzyNameIndex::find_terms(const std::string &word, int max_distance) const
+{
+    std::vector<std::pair<int, int>> found;
+
+    if (max_distance == 0)
+    {
+        auto exact = term_lookup.find(word);
+        if (exact != term_lookup.end() && !terms[exact->second].ids.empty())
+        {
+            found.push_back(std::make_pair(exact->second, 0));
+        }
+        return found;
+    }
+
+    if (nodes.empty())
+    {
+        return found;
+    }
+
+    // The query word is the pattern, so its bitmap is built once per search
+    bool bit_parallel = word.size() <= MAX_BIT_PARALLEL_LENGTH;
+    BitParallelMatcher matcher(bit_parallel ? word : std::string());
+
+    std::vector<int> pending(1, 0);
+    while (!pending.empty())
+    {
+        const Node &node = nodes[pending.back()];
+        pending.pop_back();
+
+        const Term &term = terms[node.term];
+        int distance = bit_parallel ? matcher.distance(term.text)
+                                    : dynamic_programming_distance(word, term.text);
+
+        if (distance <= max_distance && !term.ids.empty())
+        {
+            found.push_back(std::make_pair(node.term, distance));
+        }
+
+        // Triangle inequality: only children at distance d +/- max_distance can match
+        for (const auto &child : node.children)
+        {
+            if (child.first >= distance - max_distance && child.first <= distance + max_distance)
+            {
+                pending.push_back(child.second);
+            }
+        }
+    }
+    return found;
+}
+
+std::vector<FuzzyNameIndex::Match> FuzzyNameIndex::search(const std::string &folded_query,
+                                                          int max_distance,
+                                                          size_t max_results) const
+{
+    std::vector<Match> matches;
+    std::vector<std::string> words = split_words(folded_query);
+    if (words.empty() || max_results == 0)
+    {
+        return matches;
+    }
+
+    // For each query word, build (id, distance) pairs sorted by ID by merging
+    // the already-sorted posting lists of every matching term
+    std::vector<std::vector<std::pair<int, int>>> per_word(words.size());
+    for (size_t w = 0; w < words.size(); w++)
+    {
+        std::vector<std::pair<int, int>> found_terms = find_terms(words[w], allowed_edits(words[w], max_distance));
+        std::vector<std::pair<int, int>> &hits = per_word[w];
+
+        for (const auto &term : found_terms)
+        {
+            for (int id : terms[term.first].ids)
+            {
+                hits.push_back(std::make_pair(id, term.second));
+            }
+        }
+
+        if (found_terms.size() > 1)
+        {
+            // Sorting by (id, distance) leaves the closest term first for each ID
+            std::sort(hits.begin(), hits.end());
+            hits.erase(std::unique(hits.begin(), hits.end(),
+                                   [](const std::pair<int, int> &a, const std::pair<int, int> &b)
+                                   { return a.first == b.first; }),
+                       hits.end());
+        }
+
+        if (hits.empty())
+        {
+            return matches;
+        }
+    }
+
+    // Every query word must match: intersect, starting from the shortest list
+    std::sort(per_word.begin(), per_word.end(),
+              [](const std::vector<std::pair<int, int>> &a, const std::vector<std::pair<int, int>> &b)
+              { return a.size() < b.size(); });
+
+    std::vector<std::pair<int, int>> scores = per_word[0];
+    for (size_t w = 1; w < per_word.size() && !scores.empty(); w++)
+    {
+        const std::vector<std::pair<int, int>> &hits = per_word[w];
+        size_t kept = 0;
+        auto hit = hits.begin();
+        for (size_t i = 0; i < scores.size(); i++)
+        {
+            hit = std::lower_bound(hit, hits.end(), std::make_pair(scores[i].first, 0));
+            if (hit == hits.end())
+            {
+                break;
+            }
+            if (hit->first == scores[i].first)
+            {
+                scores[kept].first = scores[i].first;
+                scores[kept].second = scores[i].second + hit->second;
+                kept++;
+            }
+        }
+        scores.resize(kept);
+    }
+
+    matches.reserve(scores.size());
+    for (const auto &entry : scores)
+    {
+        Match match;
+        match.id = entry.first;
+        match.distance = entry.second;
+        matches.push_back(match);
+    }
+
+    auto by_rank = [](const Match &a, const Match &b)
+    {
+        return a.distance != b.distance ? a.distance < b.distance : a.id < b.id;
+    };
+    if (matches.size() > max_results)
+    {
+        std::partial_sort(matches.begin(), matches.begin() + max_results, matches.end(), by_rank);
+        matches.resize(max_results);
+    }
+    else
+    {
+        std::sort(matches.begin(), matches.end(), by_rank);
+    }
+    return matches;
+}
+
+size_t FuzzyNameIndex::get_memory_usage() const
+{
+    size_t bytes = heap_bytes(terms) + hash_table_heap_bytes(term_lookup) + heap_bytes(nodes);
+    for (const auto &term : terms)
+    {
+        // term_lookup keys are copies of the term text
+        bytes += 2 * heap_bytes(term.text) + heap_bytes(term.ids);
+    }
+    for (const auto &node : nodes)
+    {
+        bytes += heap_bytes(node.children);
+    }
+    return bytes;
+}
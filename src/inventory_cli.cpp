@@ -0,0 +1,620 @@
+#include "includes/inventory_manager.h"
+#include "includes/inventory_diff.h"
+#include "includes/csv_codec.h"
+#include "includes/stock_ledger.h"
+#include "includes/trace.h"
+#ifdef __linux__
+#include "includes/inventory_server.h"
+#include <csignal>
+#endif
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+namespace
+{
+    const char *const USAGE =
+        "Usage: inventory_cli [-i INPUT] [-o OUTPUT] COMMAND [ARGS]\n"
+        "\n"
+        "  -i, --input PATH    Inventory to load: CSV file, columnar file, sharded\n"
+        "                      directory, or - for CSV on stdin (default -)\n"
+        "  -o, --output PATH   Where to write the result, or - for stdout (default -)\n"
+        "  --trace PATH        Write per-operation latency histograms to PATH as JSON\n"
+        "  --chrome-trace PATH Write a Chrome trace of every traced operation to PATH\n"
+        "\n"
+        "Commands:\n"
+        "  query [--name TEXT] [--category TEXT] [--low-stock N] [--sku CODE]\n"
+        "        [--mode exact|ignore-case|fuzzy]\n"
+        "                      Write the matching products as CSV\n"
+        "  aggregate           Write product count, quantity and value per category\n"
+        "  stats               Write product count, total quantity, total value and\n"
+        "                      low stock count (below --low-stock N, default 10)\n"
+        "  export [--format csv|columnar|sharded]\n"
+        "                      Write the whole inventory in the given format\n"
+        "  merge FILE [--delete-missing] [--ledger PATH]\n"
+        "                      Merge FILE into the inventory and write the result as CSV;\n"
+        "                      with --ledger, append the quantity changes to the stock\n"
+        "                      ledger at PATH, creating it if needed\n"
+        "  movements LEDGER [--from TIME] [--to TIME] [--at TIME]\n"
+        "                      Write each product's received, sold, returned and adjusted\n"
+        "                      units from --from up to --to, or with --at, its stock level\n"
+        "                      then. LEDGER is a saved ledger or a movement CSV; TIME is\n"
+        "                      seconds since 1970 or a UTC date like 2024-05-31[T12:00:00]\n"
+        "  locations STOCK [--low-stock N [--location NAME]]\n"
+        "                      Write the products, quantity and value held at each\n"
+        "                      location, or with --low-stock, the products below N at\n"
+        "                      NAME or at any location. STOCK is a CSV with the columns\n"
+        "                      ID and one per location; quantities become its row sums\n"
+        "  diff BEFORE         Write the changes from BEFORE to the inventory as CSV\n"
+        "  memory              Write the heap bytes held by each part of the inventory,\n"
+        "                      then the allocations made by each operation while loading\n"
+        "  serve --listen unix:PATH|tcp:PORT [--save PATH]\n"
+        "                      Serve the inventory over a socket until interrupted,\n"
+        "                      then save it to PATH if it changed (Linux only)\n";
+
+    /**
+     * @brief Exception thrown for invalid command lines; reported with the usage text
+     */
+    class UsageException : public InventoryException
+    {
+    public:
+        UsageException(const std::string &message) : InventoryException(message) {}
+    };
+
+    /**
+     * @brief Parsed command line
+     */
+    struct CommandLine
+    {
+        std::string input = "-";
+        std::string output = "-";
+        std::string command;
+        std::vector<std::string> arguments;         // Positional arguments after the command
+        std::map<std::string, std::string> options; // Command options, "--name" -> value
+        bool help = false;
+    };
+
+    // Command options that take no value
+    bool is_flag(const std::string &option)
+    {
+        return option == "--delete-missing" || option == "--help";
+    }
+
+    CommandLine parse_command_line(int argc, char *argv[])
+    {
+        CommandLine line;
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            bool takes_value = arg == "-i" || arg == "--input" || arg == "-o" || arg == "--output" ||
+                               (arg.compare(0, 2, "--") == 0 && !is_flag(arg));
+
+            if (takes_value && i + 1 >= argc)
+            {
+                throw UsageException("Missing value for " + arg);
+            }
+
+            if (arg == "-h" || arg == "--help")
+            {
+                line.help = true;
+            }
+            else if (arg == "-i" || arg == "--input")
+            {
+                line.input = argv[++i];
+            }
+            else if (arg == "-o" || arg == "--output")
+            {
+                line.output = argv[++i];
+            }
+            else if (is_flag(arg))
+            {
+                line.options[arg] = "";
+            }
+            else if (takes_value)
+            {
+                line.options[arg] = argv[++i];
+            }
+            else if (line.command.empty())
+            {
+                line.command = arg;
+            }
+            else
+            {
+                line.arguments.push_back(arg);
+            }
+        }
+
+        if (line.command.empty() && !line.help)
+        {
+            throw UsageException("No command given");
+        }
+        return line;
+    }
+
+    std::string option(const CommandLine &line, const std::string &name, const std::string &fallback = "")
+    {
+        auto found = line.options.find(name);
+        return found == line.options.end() ? fallback : found->second;
+    }
+
+    int int_option(const CommandLine &line, const std::string &name, int fallback)
+    {
+        std::string text = option(line, name);
+        if (text.empty())
+        {
+            return fallback;
+        }
+
+        try
+        {
+            size_t consumed = 0;
+            int value = std::stoi(text, &consumed);
+            if (consumed == text.size())
+            {
+                return value;
+            }
+        }
+        catch (const std::logic_error &)
+        {
+        }
+        throw UsageException("Invalid number for " + name + ": " + text);
+    }
+
+    int64_t time_option(const CommandLine &line, const std::string &name, int64_t fallback)
+    {
+        std::string text = option(line, name);
+        int64_t timestamp = fallback;
+        if (!text.empty() && !parse_timestamp(text, timestamp))
+        {
+            throw UsageException("Invalid time for " + name + ": " + text);
+        }
+        return timestamp;
+    }
+
+    SearchMode search_mode(const CommandLine &line)
+    {
+        std::string mode = option(line, "--mode", "exact");
+        if (mode == "exact")
+            return SearchMode::EXACT;
+        if (mode == "ignore-case")
+            return SearchMode::IGNORE_CASE;
+        if (mode == "fuzzy")
+            return SearchMode::FUZZY;
+        throw UsageException("Unknown search mode: " + mode);
+    }
+
+    void load_input(InventoryManager &manager, const std::string &input)
+    {
+        if (input == "-")
+        {
+            manager.load_from_stream(std::cin);
+        }
+        else
+        {
+            manager.load_from_file(input);
+        }
+    }
+
+    /**
+     * @brief Run a function with the output stream, opening the output file if one was given
+     * @param path The output path, or - for stdout
+     * @param write Writes the result
+     * @throws FileOperationException If the file cannot be opened or written to
+     */
+    void with_output(const std::string &path, const std::function<void(std::ostream &)> &write)
+    {
+        if (path == "-")
+        {
+            write(std::cout);
+            std::cout.flush();
+            return;
+        }
+
+        // Through a temporary, so the output may be the inventory being read
+        write_file_atomically(path, write);
+    }
+
+    void run_query(const InventoryManager &manager, const CommandLine &line)
+    {
+        SearchMode mode = search_mode(line);
+        ProductQuery query = ProductQuery::all();
+        if (line.options.count("--name"))
+        {
+            query.and_also(ProductQuery::by_name(option(line, "--name"), mode));
+        }
+        if (line.options.count("--category"))
+        {
+            query.and_also(ProductQuery::by_category(option(line, "--category"), mode));
+        }
+        if (line.options.count("--low-stock"))
+        {
+            query.and_also(ProductQuery::low_stock(int_option(line, "--low-stock", 0)));
+        }
+        if (line.options.count("--sku"))
+        {
+            query.and_also(ProductQuery::by_sku(option(line, "--sku")));
+        }
+
+        with_output(line.output, [&manager, &query](std::ostream &out)
+                    { manager.export_query(out, query); });
+    }
+
+    void run_aggregate(const InventoryManager &manager, const CommandLine &line)
+    {
+        struct CategoryTotals
+        {
+            size_t products = 0;
+            long long quantity = 0;
+            CentsTotal value;
+        };
+
+        std::map<std::string, CategoryTotals> totals;
+        for (const auto &product : manager.get_all_products())
+        {
+            CategoryTotals &category = totals[product.get_category()];
+            category.products++;
+            category.quantity += product.get_quantity();
+            category.value.add(product.get_total_value());
+        }
+
+        with_output(line.output, [&totals](std::ostream &out)
+                    {
+                        out << "Category,Products,Quantity,Total Value\n";
+                        for (const auto &category : totals)
+                        {
+                            out << csv_quote(category.first) << "," << category.second.products << ","
+                                << category.second.quantity << "," << format_cents(category.second.value.to_cents())
+                                << "\n";
+                        }
+                    });
+    }
+
+    void run_stats(const InventoryManager &manager, const CommandLine &line)
+    {
+        long long quantity = 0;
+        for (const auto &product : manager.get_all_products())
+        {
+            quantity += product.get_quantity();
+        }
+        size_t low_stock = manager.get_low_stock_products(int_option(line, "--low-stock", 10)).size();
+
+        with_output(line.output, [&manager, quantity, low_stock](std::ostream &out)
+                    {
+                        out << "products," << manager.get_total_product_count() << "\n"
+                            << "quantity," << quantity << "\n"
+                            << "total_value," << format_cents(manager.get_total_inventory_value()) << "\n"
+                            << "low_stock," << low_stock << "\n";
+                    });
+    }
+
+    void run_export(InventoryManager &manager, const CommandLine &line)
+    {
+        std::string format = option(line, "--format", "csv");
+        if (format == "csv")
+        {
+            with_output(line.output, [&manager](std::ostream &out)
+                        { manager.save_to_stream(out); });
+            return;
+        }
+
+        if (line.output == "-")
+        {
+            throw UsageException("The " + format + " format needs an output path");
+        }
+        if (format == "columnar")
+        {
+            manager.export_columnar(line.output);
+        }
+        else if (format == "sharded")
+        {
+            manager.save_to_directory(line.output);
+        }
+        else
+        {
+            throw UsageException("Unknown export format: " + format);
+        }
+    }
+
+    void run_merge(InventoryManager &manager, const CommandLine &line)
+    {
+        if (line.arguments.size() != 1)
+        {
+            throw UsageException("merge takes one file");
+        }
+
+        // The ledger first catches up with the loaded inventory, then records the merge
+        std::string ledger_path = option(line, "--ledger");
+        StockLedger ledger;
+        if (!ledger_path.empty())
+        {
+            if (std::ifstream(ledger_path).good())
+            {
+                ledger.load_from_file(ledger_path);
+            }
+            manager.add_listener(&ledger);
+        }
+
+        MergeReport report = manager.merge_from_file(line.arguments[0], line.options.count("--delete-missing") != 0);
+        if (!ledger_path.empty())
+        {
+            manager.remove_listener(&ledger);
+            ledger.save_to_file(ledger_path);
+        }
+        std::cerr << "inserted " << report.inserted << ", updated " << report.updated << ", unchanged "
+                  << report.unchanged << ", deleted " << report.deleted << ", skipped " << report.skipped << "\n";
+
+        with_output(line.output, [&manager](std::ostream &out)
+                    { manager.save_to_stream(out); });
+    }
+
+    void run_movements(const InventoryManager &manager, const CommandLine &line)
+    {
+        if (line.arguments.size() != 1)
+        {
+            throw UsageException("movements takes one ledger");
+        }
+
+        const std::string &path = line.arguments[0];
+        StockLedger ledger;
+        if (StockLedger::is_ledger_file(path))
+        {
+            ledger.load_from_file(path);
+        }
+        else
+        {
+            std::ifstream file(path);
+            if (!file.is_open())
+            {
+                throw FileOperationException("open", path);
+            }
+            ledger.import_csv(file);
+        }
+
+        // Names come from the inventory, for products it still holds
+        const std::vector<Product> &products = manager.get_all_products();
+        auto name_of = [&products](int id)
+        {
+            auto found = std::lower_bound(products.begin(), products.end(), id, [](const Product &product, int value)
+                                          { return product.get_id() < value; });
+            return found != products.end() && found->get_id() == id ? found->get_name() : std::string();
+        };
+
+        if (line.options.count("--at"))
+        {
+            int64_t at = time_option(line, "--at", 0);
+            with_output(line.output, [&ledger, &name_of, at](std::ostream &out)
+                        {
+                            out << "ID,Name,Level\n";
+                            for (int id : ledger.get_product_ids())
+                            {
+                                out << id << "," << csv_quote(name_of(id)) << "," << ledger.level_at(id, at) << "\n";
+                            }
+                        });
+            return;
+        }
+
+        int64_t from = time_option(line, "--from", 0);
+        int64_t to = time_option(line, "--to", StockLedger::MAX_TIMESTAMP);
+        with_output(line.output, [&ledger, &name_of, from, to](std::ostream &out)
+                    {
+                        out << "ID,Name,Received,Sold,Returned,Adjusted,Net,Movements\n";
+                        for (int id : ledger.get_product_ids())
+                        {
+                            MovementTotals totals = ledger.window(id, from, to);
+                            if (totals.movements == 0)
+                            {
+                                continue;
+                            }
+                            out << id << "," << csv_quote(name_of(id));
+                            for (int64_t units : totals.units)
+                            {
+                                out << "," << units;
+                            }
+                            out << "," << totals.net() << "," << totals.movements << "\n";
+                        }
+                    });
+    }
+
+    void run_locations(InventoryManager &manager, const CommandLine &line)
+    {
+        if (line.arguments.size() != 1)
+        {
+            throw UsageException("locations takes one stock file");
+        }
+        LocationStockReport report = manager.load_location_stock(line.arguments[0]);
+        std::cerr << "applied " << report.applied << ", skipped " << report.skipped << "\n";
+
+        if (line.options.count("--low-stock"))
+        {
+            int location = LocationStock::ANY_LOCATION;
+            if (line.options.count("--location"))
+            {
+                location = manager.find_location(option(line, "--location"));
+                if (location < 0)
+                {
+                    throw UsageException("Unknown location: " + option(line, "--location"));
+                }
+            }
+
+            std::vector<Product> low_stock = manager.get_low_stock_products(int_option(line, "--low-stock", 0), location);
+            with_output(line.output, [&low_stock](std::ostream &out)
+                        {
+                            out << PRODUCT_CSV_HEADER << "\n";
+                            for (const auto &product : low_stock)
+                            {
+                                write_product_csv_row(out, product);
+                            }
+                        });
+            return;
+        }
+
+        with_output(line.output, [&manager](std::ostream &out)
+                    {
+                        out << "Location,Products,Quantity,Total Value\n";
+                        const std::vector<std::string> &locations = manager.get_locations();
+                        for (size_t location = 0; location < locations.size(); location++)
+                        {
+                            const LocationTotals &totals = manager.get_location_totals(static_cast<int>(location));
+                            out << csv_quote(locations[location]) << "," << totals.stocked << "," << totals.quantity
+                                << "," << format_cents(totals.value.to_cents()) << "\n";
+                        }
+                    });
+    }
+
+    void run_diff(const InventoryManager &manager, const CommandLine &line)
+    {
+        if (line.arguments.size() != 1)
+        {
+            throw UsageException("diff takes one file");
+        }
+
+        with_output(line.output, [&manager, &line](std::ostream &out)
+                    {
+                        out << "Change,ID,Field,Before,After\n";
+                        manager.diff_with_file(line.arguments[0], [&out](const ProductDiff &diff)
+                                               { InventoryDiff::write_csv_rows(out, diff); });
+                    });
+    }
+
+    void run_memory(const InventoryManager &manager, const CommandLine &line)
+    {
+        std::vector<MemoryComponent> components = manager.get_memory_usage();
+        std::vector<TraceStats> operations = Tracing::get_stats();
+        size_t product_count = std::max(manager.get_total_product_count(), 1);
+
+        with_output(line.output, [&components, &operations, product_count](std::ostream &out)
+                    {
+                        size_t total = 0;
+                        out << "Component,Bytes,Bytes Per Product\n" << std::fixed << std::setprecision(1);
+                        for (const auto &component : components)
+                        {
+                            total += component.bytes;
+                            out << component.name << "," << component.bytes << ","
+                                << double(component.bytes) / product_count << "\n";
+                        }
+                        out << "total," << total << "," << double(total) / product_count << "\n";
+
+                        out << "\nOperation,Calls,Allocations,Allocated Bytes\n";
+                        for (const auto &operation : operations)
+                        {
+                            out << operation.name << "," << operation.count << "," << operation.allocations << ","
+                                << operation.allocated_bytes << "\n";
+                        }
+                    });
+    }
+
+#ifdef __linux__
+    InventoryServer *running_server = nullptr;
+
+    void stop_running_server(int)
+    {
+        running_server->stop();
+    }
+
+    void run_serve(InventoryManager &manager, const CommandLine &line)
+    {
+        std::string address = option(line, "--listen");
+        if (address.empty())
+        {
+            throw UsageException("serve needs --listen");
+        }
+
+        InventoryServer server(manager);
+        server.listen(address);
+
+        running_server = &server;
+        std::signal(SIGINT, stop_running_server);
+        std::signal(SIGTERM, stop_running_server);
+        std::cerr << "inventory_cli: serving " << manager.get_total_product_count() << " products on " << address
+                  << "\n";
+
+        server.run();
+
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        running_server = nullptr;
+        QueryCacheStats cache = manager.get_query_cache_stats();
+        std::cerr << "inventory_cli: stopped after " << server.get_request_count() << " requests; query cache hit "
+                  << std::fixed << std::setprecision(1) << 100 * cache.hit_ratio() << "% of "
+                  << cache.hits + cache.refreshes + cache.misses << " lookups, holding " << cache.bytes << " bytes\n";
+
+        std::string save_path = option(line, "--save");
+        if (!save_path.empty() && server.has_mutations())
+        {
+            manager.save_to_file(save_path);
+        }
+    }
+#else
+    void run_serve(InventoryManager &, const CommandLine &)
+    {
+        throw InventoryException("serve is only available on Linux");
+    }
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    std::ios::sync_with_stdio(false);
+
+    try
+    {
+        CommandLine line = parse_command_line(argc, argv);
+        if (line.help)
+        {
+            std::cout << USAGE;
+            return 0;
+        }
+
+        const std::map<std::string, std::function<void(InventoryManager &, const CommandLine &)>> commands = {
+            {"query", run_query},
+            {"aggregate", run_aggregate},
+            {"stats", run_stats},
+            {"export", run_export},
+            {"merge", run_merge},
+            {"movements", run_movements},
+            {"locations", run_locations},
+            {"diff", run_diff},
+            {"memory", run_memory},
+            {"serve", run_serve},
+        };
+
+        // Reject unknown commands before waiting on stdin for the input
+        auto command = commands.find(line.command);
+        if (command == commands.end())
+        {
+            throw UsageException("Unknown command: " + line.command);
+        }
+
+        std::string trace_path = option(line, "--trace");
+        std::string chrome_trace_path = option(line, "--chrome-trace");
+        Tracing::set_enabled(!trace_path.empty() || !chrome_trace_path.empty() || line.command == "memory");
+        Tracing::set_capture_events(!chrome_trace_path.empty());
+
+        InventoryManager manager;
+        load_input(manager, line.input);
+        command->second(manager, line);
+
+        if (!trace_path.empty())
+        {
+            with_output(trace_path, Tracing::write_json);
+        }
+        if (!chrome_trace_path.empty())
+        {
+            with_output(chrome_trace_path, Tracing::write_chrome_trace);
+        }
+    }
+    catch (const UsageException &e)
+    {
+        std::cerr << "inventory_cli: " << e.what() << "\n\n" << USAGE;
+        return 2;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "inventory_cli: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
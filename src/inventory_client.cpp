@@ -0,0 +1,252 @@
+#include "includes/inventory_client.h"
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    InventoryException system_error(const std::string &what)
+    {
+        return InventoryException(what + ": " + std::strerror(errno));
+    }
+
+    int connect_unix(const std::string &path)
+    {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path))
+        {
+            throw InventoryException("Invalid Unix socket path: " + path);
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            throw system_error("Failed to create socket");
+        }
+        if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+        {
+            close(fd);
+            throw system_error("Failed to connect to " + path);
+        }
+        return fd;
+    }
+
+    int connect_tcp(const std::string &host, const std::string &port)
+    {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo *addresses = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+        {
+            throw InventoryException("Cannot resolve " + host + ":" + port);
+        }
+
+        int fd = -1;
+        for (addrinfo *address = addresses; address && fd < 0; address = address->ai_next)
+        {
+            fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+            if (fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) < 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+
+        if (fd < 0)
+        {
+            throw system_error("Failed to connect to " + host + ":" + port);
+        }
+
+        int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        return fd;
+    }
+}
+
+InventoryClient::InventoryClient(const std::string &address) : fd(-1), next_request_id(1), received_used(0)
+{
+    if (address.compare(0, 5, "unix:") == 0)
+    {
+        fd = connect_unix(address.substr(5));
+        return;
+    }
+
+    size_t colon = address.rfind(':');
+    if (address.compare(0, 4, "tcp:") == 0 && colon > 4)
+    {
+        fd = connect_tcp(address.substr(4, colon - 4), address.substr(colon + 1));
+        return;
+    }
+
+    throw InventoryException("Invalid server address (expected unix:PATH or tcp:HOST:PORT): " + address);
+}
+
+InventoryClient::~InventoryClient()
+{
+    close(fd);
+}
+
+uint32_t InventoryClient::send(Opcode opcode, const std::string &body)
+{
+    uint32_t request_id = next_request_id++;
+    WireWriter writer(pending);
+    writer.begin_frame();
+    writer.put_u32(request_id);
+    writer.put_u8(static_cast<uint8_t>(opcode));
+    pending.append(body);
+    writer.end_frame();
+    return request_id;
+}
+
+void InventoryClient::flush()
+{
+    size_t sent = 0;
+    while (sent < pending.size())
+    {
+        ssize_t written = ::send(fd, pending.data() + sent, pending.size() - sent, MSG_NOSIGNAL);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw system_error("Failed to send request");
+        }
+        sent += written;
+    }
+    pending.clear();
+}
+
+ServiceResponse InventoryClient::receive()
+{
+    flush();
+
+    while (true)
+    {
+        size_t available = received.size() - received_used;
+        if (available >= FRAME_HEADER_SIZE)
+        {
+            WireReader header(received.data() + received_used, FRAME_HEADER_SIZE);
+            uint32_t length = header.get_u32();
+            if (length > MAX_FRAME_PAYLOAD || length < 5)
+            {
+                throw InventoryException("Invalid response frame");
+            }
+
+            if (available - FRAME_HEADER_SIZE >= length)
+            {
+                WireReader frame(received.data() + received_used + FRAME_HEADER_SIZE, length);
+                ServiceResponse response;
+                response.request_id = frame.get_u32();
+                response.status = static_cast<ResponseStatus>(frame.get_u8());
+                response.body.assign(received.data() + received_used + FRAME_HEADER_SIZE + 5, length - 5);
+
+                received_used += FRAME_HEADER_SIZE + length;
+                if (received_used == received.size())
+                {
+                    received.clear();
+                    received_used = 0;
+                }
+                return response;
+            }
+        }
+
+        // Compact before reading more so the buffer does not grow without bound
+        if (received_used > 0)
+        {
+            received.erase(0, received_used);
+            received_used = 0;
+        }
+
+        char chunk[64 * 1024];
+        ssize_t count = recv(fd, chunk, sizeof(chunk), 0);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            throw InventoryException("Connection to inventory server lost");
+        }
+        received.append(chunk, count);
+    }
+}
+
+std::string InventoryClient::call(Opcode opcode, const std::string &body, int product_id)
+{
+    send(opcode, body);
+    ServiceResponse response = receive();
+
+    if (response.status == ResponseStatus::OK)
+    {
+        return response.body;
+    }
+    if (response.status == ResponseStatus::NOT_FOUND)
+    {
+        throw ProductNotFoundException(product_id);
+    }
+
+    WireReader reader(response.body.data(), response.body.size());
+    throw InventoryException(reader.get_string());
+}
+
+Product InventoryClient::get_product(int id)
+{
+    std::string request;
+    WireWriter(request).put_i32(id);
+
+    std::string body = call(Opcode::GET_PRODUCT, request, id);
+    WireReader reader(body.data(), body.size());
+    Product product = reader.get_product();
+    if (!reader.at_end())
+    {
+        throw InventoryException("Malformed GET_PRODUCT response");
+    }
+    return product;
+}
+
+int InventoryClient::adjust_quantity(int id, int delta)
+{
+    std::string request;
+    WireWriter writer(request);
+    writer.put_i32(id);
+    writer.put_i32(delta);
+
+    std::string body = call(Opcode::ADJUST_QUANTITY, request, id);
+    WireReader reader(body.data(), body.size());
+    return reader.get_i32();
+}
+
+size_t InventoryClient::get_product_count()
+{
+    std::string body = call(Opcode::STATS, std::string(), 0);
+    WireReader reader(body.data(), body.size());
+    return reader.get_u32();
+}
+
+std::vector<Product> InventoryClient::decode_products(const std::string &body)
+{
+    WireReader reader(body.data(), body.size());
+    uint32_t count = reader.get_u32();
+
+    std::vector<Product> products;
+    for (uint32_t i = 0; i < count && reader.ok(); i++)
+    {
+        products.push_back(reader.get_product());
+    }
+    if (!reader.at_end())
+    {
+        throw InventoryException("Malformed product list");
+    }
+    return products;
+}
@@ -0,0 +1,320 @@
+#include "includes/inventory_diff.h"
+#include "includes/inventory_manager.h"
+#include "includes/csv_codec.h"
+#include "includes/columnar_format.h"
+#include "includes/sharded_store.h"
+#include "includes/product_schema.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Conservative bytes per row, so estimates err towards more partitions
+    const size_t MIN_BYTES_PER_ROW = 32;
+
+    const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+    const uint64_t FNV_PRIME = 1099511628211ULL;
+
+    void hash_bytes(uint64_t &hash, const void *data, size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+    }
+
+    void hash_string(uint64_t &hash, const std::string &text)
+    {
+        // Length prefix keeps ("ab", "c") distinct from ("a", "bc")
+        size_t size = text.size();
+        hash_bytes(hash, &size, sizeof(size));
+        hash_bytes(hash, text.data(), text.size());
+    }
+
+    size_t partition_of(int id, size_t partitions)
+    {
+        // Mix the ID so sequential IDs spread evenly
+        uint64_t mixed = static_cast<uint64_t>(static_cast<uint32_t>(id)) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<size_t>((mixed >> 32) % partitions);
+    }
+
+    struct BeforeRow
+    {
+        uint64_t hash;
+        Product product;
+        bool matched;
+    };
+
+    /**
+     * Join one partition: index the before rows, then stream the after rows against them.
+     */
+    void diff_partition(const ProductStream &before, const ProductStream &after,
+                        const DiffVisitor &visit, DiffSummary &summary)
+    {
+        std::unordered_map<int, BeforeRow> rows;
+        before([&rows](const Product &product)
+               {
+                   BeforeRow row;
+                   row.hash = InventoryDiff::content_hash(product);
+                   row.product = product;
+                   row.matched = false;
+                   rows[product.get_id()] = row;
+               });
+
+        after([&](const Product &product)
+              {
+                  auto found = rows.find(product.get_id());
+                  ProductDiff diff;
+                  if (found == rows.end())
+                  {
+                      diff.kind = ProductDiff::Kind::ADDED;
+                      diff.after = product;
+                      summary.added++;
+                      visit(diff);
+                      return;
+                  }
+
+                  found->second.matched = true;
+                  if (found->second.hash == InventoryDiff::content_hash(product))
+                  {
+                      summary.unchanged++;
+                      return;
+                  }
+
+                  diff.kind = ProductDiff::Kind::CHANGED;
+                  diff.before = found->second.product;
+                  diff.after = product;
+                  diff.changes = InventoryDiff::compare_fields(diff.before, diff.after);
+                  summary.changed++;
+                  visit(diff);
+              });
+
+        for (const auto &row : rows)
+        {
+            if (!row.second.matched)
+            {
+                ProductDiff diff;
+                diff.kind = ProductDiff::Kind::REMOVED;
+                diff.before = row.second.product;
+                summary.removed++;
+                visit(diff);
+            }
+        }
+    }
+
+    /**
+     * Temporary directory of spilled partition files, removed on destruction.
+     */
+    class SpillDirectory
+    {
+    public:
+        SpillDirectory()
+        {
+            static std::atomic<unsigned> counter(0);
+            path = fs::temp_directory_path() /
+                   ("inventory-diff-" + std::to_string(reinterpret_cast<uintptr_t>(this)) + "-" +
+                    std::to_string(counter++));
+            std::error_code error;
+            fs::create_directories(path, error);
+            if (error)
+            {
+                throw FileOperationException("create directory", path.string());
+            }
+        }
+
+        ~SpillDirectory()
+        {
+            std::error_code error;
+            fs::remove_all(path, error);
+        }
+
+        std::string file(const std::string &side, size_t partition) const
+        {
+            return (path / (side + "-" + std::to_string(partition) + ".csv")).string();
+        }
+
+    private:
+        fs::path path;
+    };
+
+    /**
+     * Stream a source once, appending each row to the CSV spill file of its partition.
+     */
+    void spill(const ProductStream &source, const SpillDirectory &spill_directory,
+               const std::string &side, size_t partitions)
+    {
+        std::vector<std::unique_ptr<std::ofstream>> files;
+        for (size_t p = 0; p < partitions; p++)
+        {
+            std::string filename = spill_directory.file(side, p);
+            files.emplace_back(new std::ofstream(filename));
+            if (!files.back()->is_open())
+            {
+                throw FileOperationException("open", filename);
+            }
+            *files.back() << PRODUCT_CSV_HEADER << "\n";
+        }
+
+        source([&files, partitions](const Product &product)
+               { write_product_csv_row(*files[partition_of(product.get_id(), partitions)], product); });
+
+        for (size_t p = 0; p < partitions; p++)
+        {
+            files[p]->close();
+            if (files[p]->fail())
+            {
+                throw FileOperationException("write", spill_directory.file(side, p));
+            }
+        }
+    }
+
+    ProductStream csv_stream(const std::string &filename)
+    {
+        return [filename](const std::function<void(const Product &)> &visit)
+        {
+            read_product_csv_file(filename, [&visit](Product &product)
+                                  { visit(product); });
+        };
+    }
+}
+
+uint64_t InventoryDiff::content_hash(const Product &product)
+{
+    uint64_t hash = FNV_OFFSET;
+    ProductSchema::for_each_content_value(product, [&hash](const auto &value)
+                                          {
+                                              if constexpr (std::is_same<std::decay_t<decltype(value)>, std::string>::value)
+                                              {
+                                                  hash_string(hash, value);
+                                              }
+                                              else
+                                              {
+                                                  hash_bytes(hash, &value, sizeof(value));
+                                              }
+                                          });
+    return hash;
+}
+
+std::vector<FieldChange> InventoryDiff::compare_fields(const Product &before, const Product &after)
+{
+    std::vector<FieldChange> changes;
+    ProductSchema::for_each_changed_field(before, after,
+                                          [&changes](const char *field, const std::string &old_value,
+                                                     const std::string &new_value)
+                                          {
+                                              FieldChange change;
+                                              change.field = field;
+                                              change.before = old_value;
+                                              change.after = new_value;
+                                              changes.push_back(change);
+                                          });
+    return changes;
+}
+
+ProductStream InventoryDiff::open(const std::string &path)
+{
+    if (ShardedStore::is_sharded_directory(path))
+    {
+        std::vector<std::string> shards = ShardedStore::shard_paths(path);
+        return [shards](const std::function<void(const Product &)> &visit)
+        {
+            for (const auto &shard : shards)
+            {
+                csv_stream(shard)(visit);
+            }
+        };
+    }
+
+    if (ColumnarFile::is_columnar_file(path))
+    {
+        return [path](const std::function<void(const Product &)> &visit)
+        {
+            ColumnarFile::scan(path, ColumnarPredicate(), visit);
+        };
+    }
+
+    return csv_stream(path);
+}
+
+size_t InventoryDiff::estimate_rows(const std::string &path)
+{
+    std::error_code error;
+    uintmax_t bytes = 0;
+
+    if (fs::is_directory(path, error))
+    {
+        for (const auto &entry : fs::directory_iterator(path, error))
+        {
+            if (entry.is_regular_file(error))
+            {
+                bytes += entry.file_size(error);
+            }
+        }
+    }
+    else
+    {
+        bytes = fs::file_size(path, error);
+        if (error)
+        {
+            return 0;
+        }
+        if (ColumnarFile::is_columnar_file(path))
+        {
+            // Columnar files are several times smaller than the CSV they replace
+            bytes *= 8;
+        }
+    }
+    return static_cast<size_t>(bytes / MIN_BYTES_PER_ROW);
+}
+
+DiffSummary InventoryDiff::compare(const ProductStream &before, size_t before_rows,
+                                   const ProductStream &after, const DiffVisitor &visit,
+                                   size_t partition_rows)
+{
+    DiffSummary summary;
+    size_t partitions = partition_rows == 0 ? 1 : (before_rows + partition_rows - 1) / partition_rows;
+
+    if (partitions <= 1)
+    {
+        diff_partition(before, after, visit, summary);
+        return summary;
+    }
+
+    SpillDirectory spill_directory;
+    spill(before, spill_directory, "before", partitions);
+    spill(after, spill_directory, "after", partitions);
+
+    for (size_t p = 0; p < partitions; p++)
+    {
+        diff_partition(csv_stream(spill_directory.file("before", p)),
+                       csv_stream(spill_directory.file("after", p)), visit, summary);
+    }
+    return summary;
+}
+
+void InventoryDiff::write_csv_rows(std::ostream &out, const ProductDiff &diff)
+{
+    switch (diff.kind)
+    {
+    case ProductDiff::Kind::ADDED:
+        out << "added," << diff.after.get_id() << ",,,\n";
+        break;
+    case ProductDiff::Kind::REMOVED:
+        out << "removed," << diff.before.get_id() << ",,,\n";
+        break;
+    case ProductDiff::Kind::CHANGED:
+        for (const auto &change : diff.changes)
+        {
+            out << "changed," << diff.after.get_id() << "," << change.field << "," << csv_quote(change.before)
+                << "," << csv_quote(change.after) << "\n";
+        }
+        break;
+    }
+}
@@ -0,0 +1,230 @@
+#include "includes/inventory_client.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+
+namespace
+{
+    const char *const USAGE =
+        "Usage: inventory_loadgen --connect unix:PATH|tcp:HOST:PORT [options]\n"
+        "\n"
+        "  --connections N    Concurrent connections, one thread each (default 1)\n"
+        "  --requests N       Requests per connection (default 1000000)\n"
+        "  --pipeline N       Requests in flight per connection (default 64)\n"
+        "  --write-ratio R    Fraction of requests that adjust a quantity (default 0)\n"
+        "  --max-id N         Look up IDs in [1, N] (default: the server's product count)\n";
+
+    /**
+     * @brief Results gathered by one connection
+     */
+    struct WorkerResult
+    {
+        unsigned long long requests = 0;
+        unsigned long long errors = 0;   // Responses other than OK, NOT_FOUND and rejected adjustments
+        unsigned long long not_found = 0;
+        unsigned long long rejected = 0; // Adjustments refused because they would take stock below zero
+        std::vector<double> batch_micros; // Round trip of each pipelined batch
+    };
+
+    /**
+     * @brief Check whether a response refuses an adjustment for taking the quantity out of range
+     * @param response The response to an ADJUST_QUANTITY request
+     * @return true for that refusal; other failures are errors
+     */
+    bool is_rejected_adjustment(const ServiceResponse &response)
+    {
+        if (response.status != ResponseStatus::FAILED)
+        {
+            return false;
+        }
+        WireReader reader(response.body.data(), response.body.size());
+        std::string message = reader.get_string();
+        return reader.ok() && message.compare(0, sizeof(QUANTITY_OUT_OF_RANGE_MESSAGE) - 1,
+                                              QUANTITY_OUT_OF_RANGE_MESSAGE) == 0;
+    }
+
+    void run_worker(const std::string &address, unsigned long long requests, unsigned pipeline,
+                    double write_ratio, int max_id, unsigned seed, WorkerResult &result)
+    {
+        InventoryClient client(address);
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<int> pick_id(1, max_id);
+        std::bernoulli_distribution pick_write(write_ratio);
+
+        std::string body;
+        std::vector<char> adjusts; // Per request of the batch: whether it is an ADJUST_QUANTITY
+        while (result.requests < requests)
+        {
+            unsigned batch = static_cast<unsigned>(std::min<unsigned long long>(pipeline, requests - result.requests));
+            auto started = std::chrono::steady_clock::now();
+
+            adjusts.assign(batch, 0);
+            for (unsigned i = 0; i < batch; i++)
+            {
+                body.clear();
+                WireWriter writer(body);
+                writer.put_i32(pick_id(random));
+                if (pick_write(random))
+                {
+                    // Add and take away in turn so stock stays level on average; products are picked at
+                    // random, so taking from one with no stock is rejected and counted apart from errors
+                    writer.put_i32(i % 2 == 0 ? 1 : -1);
+                    adjusts[i] = 1;
+                    client.send(Opcode::ADJUST_QUANTITY, body);
+                }
+                else
+                {
+                    client.send(Opcode::GET_PRODUCT, body);
+                }
+            }
+
+            for (unsigned i = 0; i < batch; i++)
+            {
+                ServiceResponse response = client.receive();
+                if (response.status == ResponseStatus::NOT_FOUND)
+                {
+                    result.not_found++;
+                }
+                else if (adjusts[i] && is_rejected_adjustment(response))
+                {
+                    result.rejected++;
+                }
+                else if (response.status != ResponseStatus::OK)
+                {
+                    result.errors++;
+                }
+            }
+
+            result.batch_micros.push_back(
+                std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count());
+            result.requests += batch;
+        }
+    }
+
+    double percentile(std::vector<double> &values, double fraction)
+    {
+        if (values.empty())
+        {
+            return 0.0;
+        }
+        size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string address;
+    unsigned connections = 1;
+    unsigned long long requests = 1000000;
+    unsigned pipeline = 64;
+    double write_ratio = 0.0;
+    int max_id = 0;
+
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+            {
+                std::cerr << USAGE;
+                return 2;
+            }
+
+            std::string value = argv[++i];
+            if (arg == "--connect")
+                address = value;
+            else if (arg == "--connections")
+                connections = std::max(1, std::stoi(value));
+            else if (arg == "--requests")
+                requests = std::stoull(value);
+            else if (arg == "--pipeline")
+                pipeline = std::max(1, std::stoi(value));
+            else if (arg == "--write-ratio")
+                write_ratio = std::min(1.0, std::max(0.0, std::stod(value)));
+            else if (arg == "--max-id")
+                max_id = std::stoi(value);
+            else
+            {
+                std::cerr << USAGE;
+                return 2;
+            }
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        std::cerr << USAGE;
+        return 2;
+    }
+
+    if (address.empty())
+    {
+        std::cerr << USAGE;
+        return 2;
+    }
+
+    try
+    {
+        if (max_id <= 0)
+        {
+            InventoryClient probe(address);
+            max_id = static_cast<int>(std::max<size_t>(1, probe.get_product_count()));
+        }
+
+        std::vector<WorkerResult> results(connections);
+        std::vector<std::thread> workers;
+        std::atomic<bool> failed(false);
+
+        auto started = std::chrono::steady_clock::now();
+        for (unsigned c = 0; c < connections; c++)
+        {
+            workers.emplace_back([&, c]()
+                                 {
+                                     try
+                                     {
+                                         run_worker(address, requests, pipeline, write_ratio, max_id, c + 1, results[c]);
+                                     }
+                                     catch (const std::exception &e)
+                                     {
+                                         std::cerr << "inventory_loadgen: " << e.what() << "\n";
+                                         failed = true;
+                                     }
+                                 });
+        }
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        WorkerResult total;
+        for (auto &result : results)
+        {
+            total.requests += result.requests;
+            total.errors += result.errors;
+            total.not_found += result.not_found;
+            total.rejected += result.rejected;
+            total.batch_micros.insert(total.batch_micros.end(), result.batch_micros.begin(), result.batch_micros.end());
+        }
+
+        std::cout << "requests:      " << total.requests << "\n"
+                  << "seconds:       " << seconds << "\n"
+                  << "requests/sec:  " << static_cast<long long>(total.requests / seconds) << "\n"
+                  << "not found:     " << total.not_found << "\n"
+                  << "rejected:      " << total.rejected << "\n"
+                  << "errors:        " << total.errors << "\n"
+                  << "batch p50 us:  " << percentile(total.batch_micros, 0.50) << "\n"
+                  << "batch p99 us:  " << percentile(total.batch_micros, 0.99) << "\n";
+        return failed ? 1 : 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "inventory_loadgen: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -1,52 +1,210 @@
 #include "includes/inventory_manager.h"
+#include "includes/text_fold.h"
+#include "includes/csv_codec.h"
+#include "includes/product_schema.h"
+#include "includes/trace.h"
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
 
-InventoryManager::InventoryManager() : next_product_id(1) {}
+namespace
+{
+    // Prefix that marks a continuation token produced by get_products_page
+    const std::string PAGE_TOKEN_PREFIX = "after:";
 
-int InventoryManager::add_product(const Product &product)
+    // Scans of more products than this are split over the executor, in parts of at least this many
+    const size_t PARALLEL_SCAN_ROWS = 16384;
+
+    // Restoring a version that adds or removes more products than this
+    // rebuilds the store instead of shifting it once per product
+    const size_t MAX_INCREMENTAL_RESTORE = 64;
+
+    bool product_id_less(const Product &product, int id)
+    {
+        return product.get_id() < id;
+    }
+}
+
+InventoryManager::InventoryManager() : next_product_id(1), history_enabled(false), history_limit(0) {}
+
+InventoryManager::SearchKeys InventoryManager::make_search_keys(const Product &product)
 {
-    // Create a new product with the next available ID
-    Product new_product = product;
-    new_product.set_id(next_product_id++);
+    SearchKeys keys;
+    keys.name = fold_text(product.name);
+    keys.category = fold_text(product.category);
+    return keys;
+}
+
+void InventoryManager::rebuild_indexes()
+{
+    TRACE_SCOPE("InventoryManager::rebuild_indexes");
+    search_keys.clear();
+    search_keys.reserve(products.size());
+    name_index.clear();
+    id_index.clear();
+    id_index.reserve(products.size());
+    for (size_t i = 0; i < products.size(); i++)
+    {
+        search_keys.push_back(make_search_keys(products[i]));
+        name_index.add(products[i].id, search_keys.back().name);
+        id_index[products[i].id] = i;
+    }
+    stock.rebuild(products);
+    sku_index.build(products);
+}
 
-    // Add to vector
-    products.push_back(new_product);
-    return new_product.get_id();
+std::vector<Product>::iterator InventoryManager::find_product(int id)
+{
+    auto found = id_index.find(id);
+    return found == id_index.end() ? products.end() : products.begin() + found->second;
 }
 
-void InventoryManager::update_product(int id, const Product &updated_product)
+std::vector<Product>::const_iterator InventoryManager::find_product(int id) const
 {
-    auto it = std::find_if(products.begin(), products.end(),
-                           [id](const Product &p)
-                           { return p.get_id() == id; });
+    auto found = id_index.find(id);
+    return found == id_index.end() ? products.end() : products.begin() + found->second;
+}
 
-    if (it != products.end())
+void InventoryManager::append_product(const Product &product)
+{
+    products.push_back(product);
+    id_index[product.id] = products.size() - 1;
+    shard_store.mark_dirty(product);
+    search_keys.push_back(make_search_keys(product));
+    name_index.add(product.id, search_keys.back().name);
+    stock.insert_row(products.size() - 1, product);
+    sku_index.add(products.size() - 1, products);
+    if (history_enabled)
     {
-        it->set_name(updated_product.get_name());
-        it->set_category(updated_product.get_category());
-        it->set_price(updated_product.get_price());
-        it->set_quantity(updated_product.get_quantity());
-        it->set_description(updated_product.get_description());
+        current_version = current_version.set(product);
     }
-    else
+    notify_product_changed(nullptr, &products.back());
+}
+
+void InventoryManager::insert_product(const Product &product)
+{
+    auto position = std::lower_bound(products.begin(), products.end(), product.id, product_id_less);
+    if (position == products.end())
     {
-        throw ProductNotFoundException(id);
+        append_product(product);
+        return;
+    }
+
+    size_t index = position - products.begin();
+    products.insert(position, product);
+    shard_store.mark_dirty(product);
+    search_keys.insert(search_keys.begin() + index, make_search_keys(product));
+    name_index.add(product.id, search_keys[index].name);
+    stock.insert_row(index, product);
+
+    // Every later product moved up one slot
+    for (size_t i = index; i < products.size(); i++)
+    {
+        id_index[products[i].id] = i;
     }
+    sku_index.shift_rows(index, 1);
+    sku_index.add(index, products);
+
+    if (history_enabled)
+    {
+        current_version = current_version.set(product);
+    }
+    notify_product_changed(nullptr, &products[index]);
 }
 
-void InventoryManager::remove_product(int id)
+void InventoryManager::replace_product(size_t index, const Product &updated_product)
 {
-    auto it = std::find_if(products.begin(), products.end(),
-                           [id](const Product &p)
-                           { return p.get_id() == id; });
+    Product &product = products[index];
+    Product previous;
+    if (!listeners.empty())
+    {
+        previous = product;
+    }
 
-    if (it != products.end())
+    // The category may change, so both the old and new shard are dirty
+    Cents previous_price = product.get_price_cents();
+    bool sku_changed = product.sku != updated_product.sku;
+    if (sku_changed)
     {
-        products.erase(it);
+        sku_index.remove(index, product.sku);
     }
-    else
+    shard_store.mark_dirty(product);
+    ProductSchema::copy_content(product, updated_product);
+    shard_store.mark_dirty(product);
+    stock.update_row(index, previous_price, product);
+    if (sku_changed)
+    {
+        sku_index.add(index, products);
+    }
+
+    SearchKeys keys = make_search_keys(product);
+    name_index.update(product.id, search_keys[index].name, keys.name);
+    search_keys[index] = std::move(keys);
+
+    if (history_enabled)
+    {
+        current_version = current_version.set(product);
+    }
+    notify_product_changed(&previous, &product);
+}
+
+void InventoryManager::erase_product(size_t index)
+{
+    const Product &product = products[index];
+    notify_product_changed(&product, nullptr);
+    shard_store.mark_dirty(product);
+    name_index.remove(product.id, search_keys[index].name);
+    id_index.erase(product.id);
+    if (history_enabled)
+    {
+        current_version = current_version.erase(product.id);
+    }
+
+    stock.erase_row(index, product.get_price_cents());
+    sku_index.remove(index, product.sku);
+    search_keys.erase(search_keys.begin() + index);
+    products.erase(products.begin() + index);
+
+    // Every later product moved down one slot
+    for (size_t i = index; i < products.size(); i++)
+    {
+        id_index[products[i].id] = i;
+    }
+    sku_index.shift_rows(index + 1, -1);
+}
+
+int InventoryManager::add_product(const Product &product)
+{
+    TRACE_SCOPE("InventoryManager::add_product");
+    int id = 0;
+    if (try_add_product(product, id) == InventoryStatus::SKU_TAKEN)
+    {
+        throw InventoryException(sku_taken_message(product.sku));
+    }
+    return id;
+}
+
+void InventoryManager::update_product(int id, const Product &updated_product)
+{
+    TRACE_SCOPE("InventoryManager::update_product");
+    switch (try_update_product(id, updated_product))
+    {
+    case InventoryStatus::NOT_FOUND:
+        throw ProductNotFoundException(id);
+    case InventoryStatus::SKU_TAKEN:
+        throw InventoryException(sku_taken_message(updated_product.sku));
+    default:
+        break;
+    }
+}
+
+void InventoryManager::remove_product(int id)
+{
+    TRACE_SCOPE("InventoryManager::remove_product");
+    if (try_remove_product(id) == InventoryStatus::NOT_FOUND)
     {
         throw ProductNotFoundException(id);
     }
@@ -54,9 +212,8 @@ void InventoryManager::remove_product(int id)
 
 Product InventoryManager::get_product_by_id(int id) const
 {
-    auto it = std::find_if(products.begin(), products.end(),
-                           [id](const Product &p)
-                           { return p.get_id() == id; });
+    TRACE_SCOPE("InventoryManager::get_product_by_id");
+    auto it = find_product(id);
 
     if (it != products.end())
     {
@@ -68,197 +225,1522 @@ Product InventoryManager::get_product_by_id(int id) const
     }
 }
 
-std::vector<Product> InventoryManager::find_products_by_name(const std::string &name) const
+Product InventoryManager::get_product_by_sku(const std::string &sku) const
 {
-    std::vector<Product> result;
-    for (const auto &product : products)
+    TRACE_SCOPE("InventoryManager::get_product_by_sku");
+    size_t row = sku_index.find(sku, products);
+    if (row == SkuIndex::NOT_FOUND)
     {
-        if (product.get_name().find(name) != std::string::npos)
-        {
-            result.push_back(product);
-        }
+        throw ProductNotFoundException(sku);
     }
-    return result;
+    return products[row];
 }
 
-std::vector<Product> InventoryManager::find_products_by_category(const std::string &category) const
+InventoryStatus InventoryManager::try_add_product(const Product &product, int &id)
 {
-    std::vector<Product> result;
-    for (const auto &product : products)
+    TRACE_SCOPE("InventoryManager::try_add_product");
+    if (is_sku_taken(product.sku, products.end()))
     {
-        if (product.get_category() == category)
-        {
-            result.push_back(product);
-        }
+        return InventoryStatus::SKU_TAKEN;
     }
-    return result;
-}
 
-const std::vector<Product> &InventoryManager::get_all_products() const
-{
-    return products;
+    // Create a new product with the next available ID
+    Product new_product = product;
+    new_product.set_id(next_product_id++);
+
+    // IDs only ever increase, so appending keeps the vector sorted
+    PersistentProductMap before = current_version;
+    append_product(new_product);
+    commit_version(before);
+    id = new_product.get_id();
+    return InventoryStatus::OK;
 }
 
-int InventoryManager::get_total_product_count() const
+InventoryStatus InventoryManager::try_update_product(int id, const Product &updated_product)
 {
-    return products.size();
+    TRACE_SCOPE("InventoryManager::try_update_product");
+    auto it = find_product(id);
+    if (it == products.end())
+    {
+        return InventoryStatus::NOT_FOUND;
+    }
+    // Products loaded with a shared SKU keep it; only a changed SKU must be free
+    if (updated_product.sku != it->sku && is_sku_taken(updated_product.sku, it))
+    {
+        return InventoryStatus::SKU_TAKEN;
+    }
+
+    PersistentProductMap before = current_version;
+    replace_product(it - products.begin(), updated_product);
+    commit_version(before);
+    return InventoryStatus::OK;
 }
 
-double InventoryManager::get_total_inventory_value() const
+InventoryStatus InventoryManager::try_remove_product(int id)
 {
-    double total = 0.0;
-    for (const auto &product : products)
+    TRACE_SCOPE("InventoryManager::try_remove_product");
+    auto it = find_product(id);
+    if (it == products.end())
     {
-        total += product.get_total_value();
+        return InventoryStatus::NOT_FOUND;
     }
-    return total;
+
+    PersistentProductMap before = current_version;
+    erase_product(it - products.begin());
+    commit_version(before);
+    return InventoryStatus::OK;
 }
 
-std::vector<Product> InventoryManager::get_low_stock_products(int threshold) const
+bool InventoryManager::try_get_product_by_id(int id, Product &product) const
 {
-    std::vector<Product> result;
-    for (const auto &product : products)
+    TRACE_SCOPE("InventoryManager::try_get_product_by_id");
+    auto it = find_product(id);
+    if (it == products.end())
     {
-        if (product.is_low_stock(threshold))
-        {
-            result.push_back(product);
-        }
+        return false;
     }
-    return result;
+    product = *it;
+    return true;
 }
 
-void InventoryManager::save_to_file(const std::string &filename)
+bool InventoryManager::try_get_product_by_sku(const std::string &sku, Product &product) const
 {
-    std::ofstream file(filename);
-    if (!file.is_open())
+    TRACE_SCOPE("InventoryManager::try_get_product_by_sku");
+    size_t row = sku_index.find(sku, products);
+    if (row == SkuIndex::NOT_FOUND)
     {
-        throw FileOperationException("open", filename);
+        return false;
     }
+    product = products[row];
+    return true;
+}
 
-    // Write header
-    file << "ID,Name,Category,Price,Quantity,Description,Total Value\n";
+bool InventoryManager::is_sku_taken(const std::string &sku, std::vector<Product>::const_iterator owner) const
+{
+    size_t row = sku_index.find(sku, products);
+    return row != SkuIndex::NOT_FOUND && products.begin() + row != owner;
+}
 
-    for (const auto &product : products)
-    {
-        double total_value = product.get_total_value();
+std::string InventoryManager::sku_taken_message(const std::string &sku) const
+{
+    size_t row = sku_index.find(sku, products);
+    return "SKU " + sku + " already belongs to product " + std::to_string(products[row].id);
+}
 
-        file << product.get_id() << ",";
+std::vector<Product> InventoryManager::find_products_by_name(const std::string &name) const
+{
+    TRACE_SCOPE("InventoryManager::find_products_by_name");
+    return find_products(ProductQuery::by_name(name));
+}
 
-        // Escape name with quotes
-        file << "\"" << replace_all(product.get_name(), "\"", "\"\"") << "\",";
+std::vector<Product> InventoryManager::find_products_by_name(const std::string &name, SearchMode mode) const
+{
+    TRACE_SCOPE("InventoryManager::find_products_by_name(mode)");
+    if (mode == SearchMode::EXACT)
+    {
+        return find_products_by_name(name);
+    }
 
-        // Escape category with quotes
-        file << "\"" << replace_all(product.get_category(), "\"", "\"\"") << "\",";
+    if (mode == SearchMode::FUZZY)
+    {
+        std::vector<Product> result;
+        for (auto &match : find_products_by_name_fuzzy(name))
+        {
+            result.push_back(std::move(match.product));
+        }
+        return result;
+    }
 
-        file << product.get_price() << ","
-             << product.get_quantity() << ",";
+    return find_products(ProductQuery::by_name(name, mode));
+}
 
-        // Escape description with quotes
-        file << "\"" << replace_all(product.get_description(), "\"", "\"\"") << "\",";
+std::vector<Product> InventoryManager::find_products_by_category(const std::string &category) const
+{
+    TRACE_SCOPE("InventoryManager::find_products_by_category");
+    return find_products(ProductQuery::by_category(category));
+}
 
-        // Add total value
-        file << total_value << "\n";
+std::vector<Product> InventoryManager::find_products_by_category(const std::string &category, SearchMode mode) const
+{
+    TRACE_SCOPE("InventoryManager::find_products_by_category(mode)");
+    if (mode == SearchMode::EXACT)
+    {
+        return find_products_by_category(category);
     }
-
-    file.close();
+    return find_products(ProductQuery::by_category(category, mode));
 }
 
-void InventoryManager::load_from_file(const std::string &filename)
+std::vector<FuzzyProductMatch> InventoryManager::find_products_by_name_fuzzy(const std::string &name,
+                                                                             int max_distance,
+                                                                             size_t max_results) const
 {
-    std::ifstream file(filename);
-    if (!file.is_open())
+    TRACE_SCOPE("InventoryManager::find_products_by_name_fuzzy");
+    std::vector<FuzzyProductMatch> result;
+    for (const auto &match : name_index.search(fold_text(name), max_distance, max_results))
     {
-        throw FileOperationException("open", filename);
+        auto it = find_product(match.id);
+        if (it != products.end())
+        {
+            FuzzyProductMatch found;
+            found.product = *it;
+            found.distance = match.distance;
+            result.push_back(found);
+        }
     }
+    return result;
+}
 
-    products.clear();
-    next_product_id = 1;
+const std::vector<Product> &InventoryManager::get_all_products() const
+{
+    return products;
+}
 
-    std::string line;
-    // Skip header line
-    std::getline(file, line);
+InventoryManager::QueryScan InventoryManager::prepare_scan(const ProductQuery &query) const
+{
+    const std::vector<ProductQuery::Clause> &clauses = query.clauses;
+    QueryScan scan;
+    scan.first = 0;
+    scan.last = products.size();
+    scan.parallel_safe = true;
 
-    while (std::getline(file, line))
+    // Fuzzy name clauses are resolved up front through the name index; fuzzy
+    // category clauses compare each distinct category only once
+    scan.fuzzy_names.resize(clauses.size());
+    scan.fuzzy_categories.resize(clauses.size());
+    for (size_t c = 0; c < clauses.size(); c++)
     {
-        if (line.empty())
-            continue;
+        if (clauses[c].kind == ProductQuery::Kind::NAME && clauses[c].mode == SearchMode::FUZZY)
+        {
+            for (const auto &match : name_index.search(clauses[c].folded_text, 2, 100))
+            {
+                scan.fuzzy_names[c].insert(match.id);
+            }
+        }
+        // Caller predicates need not be thread-safe, and the category cache is not
+        if (clauses[c].kind == ProductQuery::Kind::PREDICATE ||
+            (clauses[c].kind == ProductQuery::Kind::CATEGORY && clauses[c].mode == SearchMode::FUZZY))
+        {
+            scan.parallel_safe = false;
+        }
+    }
 
-        int id = 0;
-        std::string name, category, description;
-        double price = 0.0;
-        int quantity = 0;
+    // A SKU clause narrows the scan to the one product the SKU index finds
+    for (const auto &clause : clauses)
+    {
+        if (clause.kind == ProductQuery::Kind::SKU)
+        {
+            size_t row = sku_index.find(clause.text, products);
+            scan.first = row == SkuIndex::NOT_FOUND ? 0 : row;
+            scan.last = row == SkuIndex::NOT_FOUND ? 0 : row + 1;
+            break;
+        }
+    }
+    return scan;
+}
 
-        // CSV parsing state
-        size_t pos = 0;
-        bool in_quotes = false;
-        std::vector<std::string> fields;
-        std::string current_field;
+bool InventoryManager::row_matches(const ProductQuery &query, size_t row, QueryScan &scan) const
+{
+    const std::vector<ProductQuery::Clause> &clauses = query.clauses;
+    const Product &product = products[row];
+    bool matched = true;
 
-        // Parse CSV row manually to handle quoted fields
-        while (pos < line.length())
+    for (size_t c = 0; matched && c < clauses.size(); c++)
+    {
+        const ProductQuery::Clause &clause = clauses[c];
+        switch (clause.kind)
         {
-            char c = line[pos];
-
-            if (c == '"')
+        case ProductQuery::Kind::NAME:
+            if (clause.mode == SearchMode::EXACT)
+            {
+                matched = product.name.find(clause.text) != std::string::npos;
+            }
+            else if (clause.mode == SearchMode::IGNORE_CASE)
+            {
+                matched = search_keys[row].name.find(clause.folded_text) != std::string::npos;
+            }
+            else
             {
-                // Toggle quote state
-                in_quotes = !in_quotes;
+                matched = scan.fuzzy_names[c].count(product.id) != 0;
+            }
+            break;
 
-                // Check for escaped quotes (two quotes in a row)
-                if (in_quotes && pos + 1 < line.length() && line[pos + 1] == '"')
-                {
-                    current_field += '"';
-                    pos += 2; // Skip both quotes
-                }
-                else
-                {
-                    pos++; // Skip the quote character
-                }
+        case ProductQuery::Kind::CATEGORY:
+            if (clause.mode == SearchMode::EXACT)
+            {
+                matched = product.category == clause.text;
             }
-            else if (c == ',' && !in_quotes)
+            else if (clause.mode == SearchMode::IGNORE_CASE)
             {
-                // End of field
-                fields.push_back(current_field);
-                current_field.clear();
-                pos++;
+                matched = search_keys[row].category == clause.folded_text;
             }
             else
             {
-                // Regular character
-                current_field += c;
-                pos++;
+                const std::string &category = search_keys[row].category;
+                auto cached = scan.fuzzy_categories[c].find(category);
+                if (cached == scan.fuzzy_categories[c].end())
+                {
+                    bool close = edit_distance(clause.folded_text, category) <= 2;
+                    cached = scan.fuzzy_categories[c].insert(std::make_pair(category, close)).first;
+                }
+                matched = cached->second;
             }
+            break;
+
+        case ProductQuery::Kind::LOW_STOCK:
+            matched = product.is_low_stock(clause.threshold);
+            break;
+
+        case ProductQuery::Kind::SKU:
+            matched = product.sku == clause.text;
+            break;
+
+        case ProductQuery::Kind::PREDICATE:
+            matched = !clause.filter || clause.filter(product);
+            break;
         }
+    }
+    return matched;
+}
 
-        // Don't forget the last field
-        fields.push_back(current_field);
+void InventoryManager::for_each_matching(const ProductQuery &query,
+                                         const std::function<void(const Product &)> &visit, size_t limit) const
+{
+    TRACE_SCOPE("InventoryManager::for_each_matching");
+    if (limit == 0)
+    {
+        limit = std::numeric_limits<size_t>::max();
+    }
 
-        // Now process the fields
-        if (fields.size() < 6) // Need at least ID, name, category, price, quantity, description
-            continue;
+    QueryScan scan = prepare_scan(query);
+    std::string key;
+    QueryCache::IdList ids;
+    if (query_cache.is_enabled() && query.get_cache_key(key) && find_cached_ids(query, key, scan, ids))
+    {
+        size_t count = std::min(limit, ids->size());
+        for (size_t i = 0; i < count; i++)
+        {
+            visit(products[id_index.at((*ids)[i])]);
+        }
+        return;
+    }
 
-        try
+    // Streamed rather than collected for the cache, so memory use stays constant
+    size_t visited = 0;
+    for (size_t i = scan.first; i < scan.last && visited < limit; i++)
+    {
+        if (row_matches(query, i, scan))
         {
-            id = std::stoi(fields[0]);
-            next_product_id = std::max(next_product_id, id + 1);
+            visit(products[i]);
+            visited++;
+        }
+    }
+}
+
+std::vector<Product> InventoryManager::find_products(const ProductQuery &query) const
+{
+    TRACE_SCOPE("InventoryManager::find_products");
+    QueryScan scan = prepare_scan(query);
+    std::string key;
+    if (!query_cache.is_enabled() || !query.get_cache_key(key))
+    {
+        return products_with_ids(scan_matching_ids(query, scan));
+    }
 
-            name = fields[1];
-            category = fields[2];
-            price = std::stod(fields[3]);
-            quantity = std::stoi(fields[4]);
-            description = fields[5];
+    QueryCache::IdList ids;
+    if (!find_cached_ids(query, key, scan, ids))
+    {
+        uint64_t generation = query_cache.get_generation();
+        ids = std::make_shared<const std::vector<int>>(scan_matching_ids(query, scan));
+        query_cache.store(key, ids, generation);
+    }
+    return products_with_ids(*ids);
+}
 
-            products.emplace_back(id, name, category, price, quantity, description);
+std::vector<int> InventoryManager::scan_matching_ids(const ProductQuery &query, QueryScan &scan) const
+{
+    auto collect = [this, &query, &scan](size_t begin, size_t end)
+    {
+        std::vector<int> ids;
+        for (size_t row = begin; row < end; row++)
+        {
+            if (row_matches(query, row, scan))
+            {
+                ids.push_back(products[row].id);
+            }
         }
-        catch (const std::exception &e)
+        return ids;
+    };
+    if (!scan.parallel_safe || scan.last - scan.first <= PARALLEL_SCAN_ROWS)
+    {
+        return collect(scan.first, scan.last);
+    }
+
+    // Parts are joined lowest rows first, keeping the IDs ascending
+    return get_executor().parallel_reduce(scan.first, scan.last, PARALLEL_SCAN_ROWS, std::vector<int>(), collect,
+                                          [](std::vector<int> &into, std::vector<int> &&part)
+                                          { into.insert(into.end(), part.begin(), part.end()); });
+}
+
+bool InventoryManager::find_cached_ids(const ProductQuery &query, const std::string &key, QueryScan &scan,
+                                       QueryCache::IdList &ids) const
+{
+    auto matches_now = [this, &query, &scan](int id)
+    {
+        auto it = find_product(id);
+        return it != products.end() && row_matches(query, it - products.begin(), scan);
+    };
+
+    return query_cache.find(key, ids, matches_now);
+}
+
+std::vector<Product> InventoryManager::products_with_ids(const std::vector<int> &ids) const
+{
+    std::vector<Product> result(ids.size());
+    auto copy = [this, &ids, &result](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
         {
-            // Skip invalid line
-            continue;
+            result[i] = products[id_index.at(ids[i])];
         }
+    };
+    if (ids.size() <= PARALLEL_SCAN_ROWS)
+    {
+        copy(0, ids.size());
+    }
+    else
+    {
+        get_executor().parallel_for(0, ids.size(), PARALLEL_SCAN_ROWS, copy);
     }
+    return result;
+}
 
-    file.close();
+void InventoryManager::set_query_cache_limit(size_t max_bytes)
+{
+    query_cache.set_max_bytes(max_bytes);
+}
+
+QueryCacheStats InventoryManager::get_query_cache_stats() const
+{
+    return query_cache.get_stats();
+}
+
+uint64_t InventoryManager::get_generation() const
+{
+    return query_cache.get_generation();
 }
+
+ProductPage InventoryManager::get_products_page(int start_id, size_t limit,
+                                                const ProductFilter &filter,
+                                                size_t max_scanned) const
+{
+    TRACE_SCOPE("InventoryManager::get_products_page");
+    if (limit == 0)
+    {
+        throw InventoryException("Page limit must be greater than zero");
+    }
+
+    ProductPage page;
+    size_t scanned = 0;
+    auto it = std::lower_bound(products.begin(), products.end(), start_id, product_id_less);
+
+    for (; it != products.end(); ++it)
+    {
+        if (page.products.size() == limit || (max_scanned != 0 && scanned == max_scanned))
+        {
+            break;
+        }
+
+        scanned++;
+        if (!filter || filter(*it))
+        {
+            page.products.push_back(*it);
+        }
+    }
+
+    // Resume after the last product examined, which may not have matched the filter
+    page.has_more = it != products.end();
+    if (page.has_more)
+    {
+        page.next_token = PAGE_TOKEN_PREFIX + std::to_string((it - 1)->get_id());
+    }
+    return page;
+}
+
+ProductPage InventoryManager::get_products_page(const std::string &token, size_t limit,
+                                                const ProductFilter &filter,
+                                                size_t max_scanned) const
+{
+    TRACE_SCOPE("InventoryManager::get_products_page(token)");
+    if (limit == 0)
+    {
+        throw InventoryException("Page limit must be greater than zero");
+    }
+
+    if (token.empty())
+    {
+        return get_products_page(0, limit, filter, max_scanned);
+    }
+
+    if (token.compare(0, PAGE_TOKEN_PREFIX.size(), PAGE_TOKEN_PREFIX) != 0)
+    {
+        throw InventoryException("Invalid page token: " + token);
+    }
+
+    int last_id = 0;
+    try
+    {
+        size_t consumed = 0;
+        std::string id_text = token.substr(PAGE_TOKEN_PREFIX.size());
+        last_id = std::stoi(id_text, &consumed);
+        if (consumed != id_text.size())
+        {
+            throw InventoryException("Invalid page token: " + token);
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        throw InventoryException("Invalid page token: " + token);
+    }
+
+    // No ID follows the largest one, so the page after it is the empty last page
+    if (last_id == std::numeric_limits<int>::max())
+    {
+        return ProductPage();
+    }
+    return get_products_page(last_id + 1, limit, filter, max_scanned);
+}
+
+int InventoryManager::get_total_product_count() const
+{
+    return products.size();
+}
+
+Cents InventoryManager::get_total_inventory_value() const
+{
+    TRACE_SCOPE("InventoryManager::get_total_inventory_value");
+    auto sum_values = [this](size_t begin, size_t end)
+    {
+        CentsTotal total;
+        for (size_t row = begin; row < end; row++)
+        {
+            total.add(products[row].get_total_value());
+        }
+        return total;
+    };
+    if (products.size() <= PARALLEL_SCAN_ROWS)
+    {
+        return sum_values(0, products.size()).to_cents();
+    }
+
+    // Partial sums are exact, so splitting the sum does not change it
+    CentsTotal total = get_executor().parallel_reduce(0, products.size(), PARALLEL_SCAN_ROWS, CentsTotal(), sum_values,
+                                                      [](CentsTotal &into, CentsTotal &&part)
+                                                      { into.add(part); });
+    return total.to_cents();
+}
+
+std::vector<MemoryComponent> InventoryManager::get_memory_usage() const
+{
+    TRACE_SCOPE("InventoryManager::get_memory_usage");
+    size_t product_text = 0;
+    for (const auto &product : products)
+    {
+        product_text += product.get_heap_bytes();
+    }
+
+    size_t search_key_bytes = heap_bytes(search_keys);
+    for (const auto &keys : search_keys)
+    {
+        search_key_bytes += heap_bytes(keys.name) + heap_bytes(keys.category);
+    }
+
+    std::unordered_set<const void *> counted;
+    size_t history_bytes = current_version.get_memory_usage(counted);
+    for (const auto &version : undo_stack)
+    {
+        history_bytes += version.get_memory_usage(counted);
+    }
+    for (const auto &version : redo_stack)
+    {
+        history_bytes += version.get_memory_usage(counted);
+    }
+
+    return {
+        {"products", heap_bytes(products)},
+        {"product text", product_text},
+        {"id index", hash_table_heap_bytes(id_index)},
+        {"search keys", search_key_bytes},
+        {"name index", name_index.get_memory_usage()},
+        {"shard store", shard_store.get_memory_usage()},
+        {"history", history_bytes},
+        {"location stock", stock.get_heap_bytes()},
+        {"sku index", sku_index.get_heap_bytes()},
+        {"query cache", query_cache.get_heap_bytes()},
+    };
+}
+
+void InventoryManager::add_listener(InventoryListener *listener)
+{
+    listeners.push_back(listener);
+    listener->products_replaced(products);
+}
+
+void InventoryManager::remove_listener(InventoryListener *listener)
+{
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+}
+
+std::vector<Product> InventoryManager::get_low_stock_products(int threshold) const
+{
+    TRACE_SCOPE("InventoryManager::get_low_stock_products");
+    return find_products(ProductQuery::low_stock(threshold));
+}
+
+std::vector<Product> InventoryManager::get_low_stock_products(int threshold, int location) const
+{
+    TRACE_SCOPE("InventoryManager::get_low_stock_products");
+    std::vector<Product> result;
+    for (size_t row : stock.find_low_stock_rows(threshold, location))
+    {
+        result.push_back(products[row]);
+    }
+    return result;
+}
+
+Cents InventoryManager::get_total_inventory_value(int location) const
+{
+    return stock.get_totals(location).value.to_cents();
+}
+
+int InventoryManager::add_location(const std::string &name)
+{
+    return stock.add_location(name, products);
+}
+
+int InventoryManager::find_location(const std::string &name) const
+{
+    return stock.find_location(name);
+}
+
+const std::vector<std::string> &InventoryManager::get_locations() const
+{
+    return stock.get_location_names();
+}
+
+int InventoryManager::get_location_quantity(int id, int location) const
+{
+    auto it = find_product(id);
+    if (it == products.end())
+    {
+        throw ProductNotFoundException(id);
+    }
+    stock.check_location(location);
+    return stock.get_quantity(it - products.begin(), location);
+}
+
+void InventoryManager::set_location_quantity(int id, int location, int quantity)
+{
+    TRACE_SCOPE("InventoryManager::set_location_quantity");
+    auto it = find_product(id);
+    if (it == products.end())
+    {
+        throw ProductNotFoundException(id);
+    }
+    stock.check_location(location);
+
+    size_t index = it - products.begin();
+    long long total = stock.row_total(index) - stock.get_quantity(index, location) + quantity;
+    if (total < std::numeric_limits<int>::min() || total > std::numeric_limits<int>::max())
+    {
+        throw InventoryException("Quantity of product " + std::to_string(id) + " would not fit in an int");
+    }
+
+    stock.set_quantity(index, location, quantity, it->get_price_cents());
+    Product updated = *it;
+    updated.set_quantity(static_cast<int>(total));
+
+    PersistentProductMap before = current_version;
+    replace_product(index, updated);
+    commit_version(before);
+}
+
+void InventoryManager::move_stock(int id, int from, int to, int quantity)
+{
+    TRACE_SCOPE("InventoryManager::move_stock");
+    auto it = find_product(id);
+    if (it == products.end())
+    {
+        throw ProductNotFoundException(id);
+    }
+    stock.check_location(from);
+    stock.check_location(to);
+
+    size_t index = it - products.begin();
+    int held = stock.get_quantity(index, from);
+    if (quantity < 0 || quantity > held)
+    {
+        throw InventoryException("Cannot move " + std::to_string(quantity) + " units of product " +
+                                 std::to_string(id) + " from a location holding " + std::to_string(held));
+    }
+    if (from == to)
+    {
+        return;
+    }
+
+    long long arriving = static_cast<long long>(stock.get_quantity(index, to)) + quantity;
+    if (arriving > std::numeric_limits<int>::max())
+    {
+        throw InventoryException("Quantity of product " + std::to_string(id) + " would not fit in an int");
+    }
+    stock.set_quantity(index, from, held - quantity, it->get_price_cents());
+    stock.set_quantity(index, to, static_cast<int>(arriving), it->get_price_cents());
+}
+
+const LocationTotals &InventoryManager::get_location_totals(int location) const
+{
+    return stock.get_totals(location);
+}
+
+void InventoryManager::save_location_stock(const std::string &filename) const
+{
+    TRACE_SCOPE("InventoryManager::save_location_stock");
+    const std::vector<std::string> &locations = stock.get_location_names();
+    write_file_atomically(filename, [this, &locations](std::ostream &out)
+                          {
+                              out << "ID";
+                              for (const auto &name : locations)
+                              {
+                                  out << "," << csv_quote(name);
+                              }
+                              out << "\n";
+
+                              for (size_t row = 0; row < products.size(); row++)
+                              {
+                                  bool stocked = false;
+                                  for (size_t location = 0; location < locations.size() && !stocked; location++)
+                                  {
+                                      stocked = stock.get_quantity(row, static_cast<int>(location)) != 0;
+                                  }
+                                  if (!stocked)
+                                  {
+                                      continue;
+                                  }
+
+                                  out << products[row].id;
+                                  for (size_t location = 0; location < locations.size(); location++)
+                                  {
+                                      out << "," << stock.get_quantity(row, static_cast<int>(location));
+                                  }
+                                  out << "\n";
+                              } });
+}
+
+LocationStockReport InventoryManager::load_location_stock(const std::string &filename)
+{
+    TRACE_SCOPE("InventoryManager::load_location_stock");
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        throw FileOperationException("open", filename);
+    }
+
+    std::string line;
+    std::getline(file, line);
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.pop_back();
+    }
+    std::vector<std::string> header = split_csv_line(line);
+    if (header.size() < 2 || header[0] != "ID")
+    {
+        throw InventoryException("Location stock file has no ID,<locations> header: " + filename);
+    }
+
+    // Read every row before changing anything, so a rejected file leaves the inventory as it was
+    LocationStockReport report;
+    std::vector<std::pair<size_t, std::vector<int>>> rows; // Product position, quantity per file column
+    std::unordered_map<size_t, size_t> row_of;             // Product position -> entry in rows
+    std::vector<std::string> fields;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (line.empty())
+        {
+            continue;
+        }
+
+        split_csv_line(line, fields);
+        std::vector<int> quantities(header.size() - 1);
+        int id = 0;
+        bool parsed = fields.size() == header.size() && IntegerCodec::parse_csv(fields[0], id);
+        for (size_t column = 1; parsed && column < fields.size(); column++)
+        {
+            parsed = IntegerCodec::parse_csv(fields[column], quantities[column - 1]);
+        }
+
+        auto found = parsed ? id_index.find(id) : id_index.end();
+        if (found == id_index.end())
+        {
+            report.skipped++;
+            continue;
+        }
+
+        // Repeated ID within the file: the later row wins
+        auto repeated = row_of.find(found->second);
+        if (repeated != row_of.end())
+        {
+            rows[repeated->second].second = std::move(quantities);
+        }
+        else
+        {
+            row_of[found->second] = rows.size();
+            rows.emplace_back(found->second, std::move(quantities));
+        }
+    }
+
+    // Locations new to the inventory hold nothing yet, so they are added only once the totals fit
+    std::vector<int> columns;
+    for (size_t column = 1; column < header.size(); column++)
+    {
+        columns.push_back(stock.find_location(header[column]));
+    }
+
+    // Every product's total is checked before any cell is written
+    std::vector<long long> totals(products.size());
+    std::vector<char> listed(products.size(), 0);
+    for (size_t row = 0; row < products.size(); row++)
+    {
+        totals[row] = stock.row_total(row);
+        for (int location : columns)
+        {
+            if (location >= 0)
+            {
+                totals[row] -= stock.get_quantity(row, location);
+            }
+        }
+    }
+    for (const auto &row : rows)
+    {
+        listed[row.first] = 1;
+        for (int quantity : row.second)
+        {
+            totals[row.first] += quantity;
+        }
+    }
+    for (size_t row = 0; row < products.size(); row++)
+    {
+        if (totals[row] < std::numeric_limits<int>::min() || totals[row] > std::numeric_limits<int>::max())
+        {
+            throw InventoryException("Quantity of product " + std::to_string(products[row].id) +
+                                     " would not fit in an int");
+        }
+    }
+    for (size_t column = 0; column < columns.size(); column++)
+    {
+        if (columns[column] < 0)
+        {
+            // The header may name a new location twice
+            int location = stock.find_location(header[column + 1]);
+            columns[column] = location >= 0 ? location : stock.add_location(header[column + 1], products);
+        }
+    }
+
+    for (size_t row = 0; row < products.size(); row++)
+    {
+        if (!listed[row])
+        {
+            for (int location : columns)
+            {
+                stock.set_quantity(row, location, 0, products[row].get_price_cents());
+            }
+        }
+    }
+    for (const auto &row : rows)
+    {
+        for (size_t column = 0; column < columns.size(); column++)
+        {
+            stock.set_quantity(row.first, columns[column], row.second[column], products[row.first].get_price_cents());
+        }
+    }
+
+    PersistentProductMap before = current_version;
+    for (size_t row = 0; row < products.size(); row++)
+    {
+        if (products[row].get_quantity() != totals[row])
+        {
+            Product updated = products[row];
+            updated.set_quantity(static_cast<int>(totals[row]));
+            replace_product(row, updated);
+        }
+    }
+    commit_version(before);
+    report.applied = rows.size();
+    return report;
+}
+
+void InventoryManager::save_to_file(const std::string &filename)
+{
+    TRACE_SCOPE("InventoryManager::save_to_file");
+    if (ShardedStore::is_sharded_directory(filename) || filename == shard_store.get_directory())
+    {
+        shard_store.save(filename, products, next_product_id);
+        return;
+    }
+
+    write_file_atomically(filename, [this](std::ostream &out)
+                          { save_to_stream(out); });
+}
+
+void InventoryManager::save_to_stream(std::ostream &out) const
+{
+    TRACE_SCOPE("InventoryManager::save_to_stream");
+    // Write header
+    out << PRODUCT_CSV_HEADER << "\n";
+
+    for (const auto &product : products)
+    {
+        write_product_csv_row(out, product);
+    }
+}
+
+void InventoryManager::load_from_file(const std::string &filename)
+{
+    TRACE_SCOPE("InventoryManager::load_from_file");
+    if (ShardedStore::is_sharded_directory(filename))
+    {
+        load_from_directory(filename);
+        return;
+    }
+
+    if (ColumnarFile::is_columnar_file(filename))
+    {
+        import_columnar(filename);
+        return;
+    }
+
+    load_products([&filename](const std::function<void(Product &)> &visit)
+                  { read_product_csv_file_lazily(filename, visit); });
+}
+
+InventoryStatus InventoryManager::try_load_from_file(const std::string &filename)
+{
+    TRACE_SCOPE("InventoryManager::try_load_from_file");
+    // A missing file, the usual failure, is reported without throwing. Rows
+    // are parsed without exceptions, so only unreadable or corrupt files
+    // still go through one below.
+    if (!ShardedStore::is_sharded_directory(filename) && !std::ifstream(filename).is_open())
+    {
+        return InventoryStatus::FILE_ERROR;
+    }
+
+    try
+    {
+        load_from_file(filename);
+    }
+    catch (const InventoryException &)
+    {
+        return InventoryStatus::FILE_ERROR;
+    }
+    return InventoryStatus::OK;
+}
+
+void InventoryManager::load_from_stream(std::istream &in)
+{
+    TRACE_SCOPE("InventoryManager::load_from_stream");
+    load_products([&in](const std::function<void(Product &)> &visit)
+                  { read_product_csv(in, visit); });
+}
+
+void InventoryManager::load_products(const std::function<void(const std::function<void(Product &)> &)> &read)
+{
+    std::vector<Product> loaded;
+    int loaded_next_id = 1;
+    read([&loaded, &loaded_next_id](Product &product)
+         {
+             loaded_next_id = std::max(loaded_next_id, product.get_id() + 1);
+             loaded.push_back(std::move(product));
+         });
+
+    PersistentProductMap before = current_version;
+    products = std::move(loaded);
+    next_product_id = loaded_next_id;
+
+    shard_store.unbind();
+    finish_bulk_load();
+    commit_version(before);
+}
+
+size_t InventoryManager::export_query_to_file(const std::string &filename, const ProductQuery &query) const
+{
+    TRACE_SCOPE("InventoryManager::export_query_to_file");
+    size_t rows = 0;
+    write_file_atomically(filename, [this, &query, &rows](std::ostream &out)
+                          { rows = export_query(out, query); });
+    return rows;
+}
+
+size_t InventoryManager::export_query(std::ostream &out, const ProductQuery &query) const
+{
+    TRACE_SCOPE("InventoryManager::export_query");
+    out << PRODUCT_CSV_HEADER << "\n";
+
+    size_t rows = 0;
+    for_each_matching(query, [&out, &rows](const Product &product)
+                      {
+                          write_product_csv_row(out, product);
+                          rows++;
+                      });
+    return rows;
+}
+
+MergeReport InventoryManager::merge_from_file(const std::string &filename, bool delete_missing)
+{
+    TRACE_SCOPE("InventoryManager::merge_from_file");
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        throw FileOperationException("open", filename);
+    }
+
+    // An optional "Action" column marks rows that delete a product
+    std::string line;
+    std::getline(file, line);
+    std::vector<std::string> header = split_csv_line(line);
+    size_t action_column = std::find(header.begin(), header.end(), "Action") - header.begin();
+    ProductSchema::CsvLayout layout = ProductSchema::csv_layout(header);
+
+    PersistentProductMap before = current_version;
+    MergeReport report;
+    std::vector<Product> inserts;                     // New products, in file order
+    std::unordered_map<int, size_t> insert_rows;      // ID -> position in inserts
+    std::unordered_map<std::string, int> insert_skus; // SKU -> ID of the insert that has it
+    std::vector<char> doomed;                         // Existing products to delete, by position
+    std::vector<char> seen;                           // Existing products present in the file
+    if (delete_missing)
+    {
+        seen.assign(products.size(), 0);
+    }
+
+    // Products deleted by the file keep their SKUs until the merge is done
+    auto sku_taken = [this, &insert_skus](const Product &product, std::vector<Product>::const_iterator owner)
+    {
+        if (is_sku_taken(product.sku, owner))
+        {
+            return true;
+        }
+        auto pending = product.sku.empty() ? insert_skus.end() : insert_skus.find(product.sku);
+        return pending != insert_skus.end() && pending->second != product.id;
+    };
+
+    Product incoming;
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+            continue;
+
+        std::vector<std::string> fields = split_csv_line(line);
+        bool is_delete = action_column < fields.size() && fold_text(fields[action_column]) == "delete";
+
+        if (is_delete)
+        {
+            int id = 0;
+            if (!IntegerCodec::parse_csv(fields[0], id))
+            {
+                report.skipped++;
+                continue;
+            }
+
+            auto existing = id_index.find(id);
+            auto pending = insert_rows.find(id);
+            if (existing != id_index.end() && !(doomed.size() > existing->second && doomed[existing->second]))
+            {
+                doomed.resize(products.size(), 0);
+                doomed[existing->second] = 1;
+                report.deleted++;
+            }
+            else if (pending != insert_rows.end())
+            {
+                // Cancel an insert made earlier in the same file
+                insert_skus.erase(inserts[pending->second].sku);
+                inserts[pending->second].set_id(0);
+                insert_rows.erase(pending);
+                report.inserted--;
+            }
+            else
+            {
+                report.skipped++;
+            }
+            continue;
+        }
+
+        if (!ProductSchema::parse_csv_fields(fields, incoming, layout))
+        {
+            report.skipped++;
+            continue;
+        }
+
+        if (incoming.id <= 0)
+        {
+            incoming.id = next_product_id++;
+        }
+
+        auto existing = id_index.find(incoming.id);
+        if (existing != id_index.end())
+        {
+            size_t index = existing->second;
+            if (delete_missing)
+            {
+                seen[index] = 1;
+            }
+            if (incoming.sku != products[index].sku && sku_taken(incoming, products.begin() + index))
+            {
+                report.skipped++;
+                continue;
+            }
+            if (doomed.size() > index && doomed[index])
+            {
+                // Deleted by an earlier row: the later row wins and keeps the product
+                doomed[index] = 0;
+                report.deleted--;
+            }
+
+            const Product &current = products[index];
+            if (ProductSchema::same_content(current, incoming))
+            {
+                report.unchanged++;
+            }
+            else
+            {
+                replace_product(index, incoming);
+                report.updated++;
+            }
+            continue;
+        }
+
+        if (sku_taken(incoming, products.end()))
+        {
+            report.skipped++;
+            continue;
+        }
+
+        auto pending = insert_rows.find(incoming.id);
+        if (pending != insert_rows.end())
+        {
+            // Repeated ID within the file: the later row wins
+            insert_skus.erase(inserts[pending->second].sku);
+            inserts[pending->second] = incoming;
+        }
+        else
+        {
+            insert_rows[incoming.id] = inserts.size();
+            inserts.push_back(incoming);
+            report.inserted++;
+        }
+        if (!incoming.sku.empty())
+        {
+            insert_skus[incoming.sku] = incoming.id;
+        }
+        next_product_id = std::max(next_product_id, incoming.id + 1);
+    }
+
+    file.close();
+
+    if (delete_missing)
+    {
+        doomed.resize(products.size(), 0);
+        for (size_t i = 0; i < products.size(); i++)
+        {
+            if (!seen[i] && !doomed[i])
+            {
+                doomed[i] = 1;
+                report.deleted++;
+            }
+        }
+    }
+
+    // Apply deletions with a single compaction pass
+    if (report.deleted > 0)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < products.size(); i++)
+        {
+            if (doomed[i])
+            {
+                notify_product_changed(&products[i], nullptr);
+                shard_store.mark_dirty(products[i]);
+                name_index.remove(products[i].id, search_keys[i].name);
+                id_index.erase(products[i].id);
+                if (history_enabled)
+                {
+                    current_version = current_version.erase(products[i].id);
+                }
+                continue;
+            }
+            if (kept != i)
+            {
+                products[kept] = std::move(products[i]);
+                search_keys[kept] = std::move(search_keys[i]);
+                id_index[products[kept].id] = kept;
+            }
+            kept++;
+        }
+        products.resize(kept);
+        search_keys.resize(kept);
+        stock.rebuild(products);
+        sku_index.build(products);
+    }
+
+    // Cancelled inserts were given ID 0
+    inserts.erase(std::remove_if(inserts.begin(), inserts.end(),
+                                 [](const Product &p)
+                                 { return p.id == 0; }),
+                  inserts.end());
+    std::sort(inserts.begin(), inserts.end(),
+              [](const Product &a, const Product &b)
+              { return a.id < b.id; });
+
+    if (!inserts.empty() && !products.empty() && inserts.front().id < products.back().id)
+    {
+        // Some new IDs fall between existing ones: merge once and reindex
+        for (const auto &product : inserts)
+        {
+            shard_store.mark_dirty(product);
+            if (history_enabled)
+            {
+                current_version = current_version.set(product);
+            }
+            notify_product_changed(nullptr, &product);
+        }
+        size_t middle = products.size();
+        products.insert(products.end(), inserts.begin(), inserts.end());
+        std::inplace_merge(products.begin(), products.begin() + middle, products.end(),
+                           [](const Product &a, const Product &b)
+                           { return a.id < b.id; });
+        rebuild_indexes();
+    }
+    else
+    {
+        for (const auto &product : inserts)
+        {
+            append_product(product);
+        }
+    }
+
+    commit_version(before);
+    return report;
+}
+
+DiffSummary InventoryManager::diff_files(const std::string &before_path, const std::string &after_path,
+                                         const DiffVisitor &visit)
+{
+    TRACE_SCOPE("InventoryManager::diff_files");
+    return InventoryDiff::compare(InventoryDiff::open(before_path), InventoryDiff::estimate_rows(before_path),
+                                  InventoryDiff::open(after_path), visit);
+}
+
+DiffSummary InventoryManager::diff_with_file(const std::string &before_path, const DiffVisitor &visit) const
+{
+    TRACE_SCOPE("InventoryManager::diff_with_file");
+    ProductStream current = [this](const std::function<void(const Product &)> &visit_product)
+    {
+        for (const auto &product : products)
+        {
+            visit_product(product);
+        }
+    };
+    return InventoryDiff::compare(InventoryDiff::open(before_path), InventoryDiff::estimate_rows(before_path),
+                                  current, visit);
+}
+
+DiffSummary InventoryManager::write_diff_report(const std::string &before_path, const std::string &after_path,
+                                                const std::string &report_filename)
+{
+    TRACE_SCOPE("InventoryManager::write_diff_report");
+    std::ofstream report(report_filename);
+    if (!report.is_open())
+    {
+        throw FileOperationException("open", report_filename);
+    }
+
+    report << "Change,ID,Field,Before,After\n";
+    DiffSummary summary = diff_files(before_path, after_path, [&report](const ProductDiff &diff)
+                                     { InventoryDiff::write_csv_rows(report, diff); });
+
+    report.close();
+    if (report.fail())
+    {
+        throw FileOperationException("write", report_filename);
+    }
+    return summary;
+}
+
+void InventoryManager::save_to_directory(const std::string &directory, ShardScheme scheme, int id_range_size)
+{
+    TRACE_SCOPE("InventoryManager::save_to_directory");
+    shard_store.save(directory, scheme, id_range_size, products, next_product_id);
+}
+
+void InventoryManager::load_from_directory(const std::string &directory)
+{
+    TRACE_SCOPE("InventoryManager::load_from_directory");
+    PersistentProductMap before = current_version;
+    products = shard_store.load(directory, next_product_id);
+    finish_bulk_load();
+    commit_version(before);
+}
+
+void InventoryManager::export_columnar(const std::string &filename) const
+{
+    TRACE_SCOPE("InventoryManager::export_columnar");
+    ColumnarFile::write(filename, products);
+}
+
+void InventoryManager::import_columnar(const std::string &filename)
+{
+    TRACE_SCOPE("InventoryManager::import_columnar");
+    std::vector<Product> loaded = ColumnarFile::read(filename).products;
+    PersistentProductMap before = current_version;
+    products = std::move(loaded);
+
+    next_product_id = 1;
+    for (const auto &product : products)
+    {
+        next_product_id = std::max(next_product_id, product.get_id() + 1);
+    }
+
+    shard_store.unbind();
+    finish_bulk_load();
+    commit_version(before);
+}
+
+ColumnarScanResult InventoryManager::scan_columnar(const std::string &filename, const ColumnarPredicate &predicate)
+{
+    TRACE_SCOPE("InventoryManager::scan_columnar");
+    return ColumnarFile::read(filename, predicate);
+}
+
+void InventoryManager::finish_bulk_load()
+{
+    TRACE_SCOPE("InventoryManager::finish_bulk_load");
+    // Files written by save_to_file are already in ID order; anything else is
+    // sorted here, keeping the first row for any duplicated ID
+    if (!std::is_sorted(products.begin(), products.end(),
+                        [](const Product &a, const Product &b)
+                        { return a.get_id() < b.get_id(); }))
+    {
+        std::stable_sort(products.begin(), products.end(),
+                         [](const Product &a, const Product &b)
+                         { return a.get_id() < b.get_id(); });
+    }
+    products.erase(std::unique(products.begin(), products.end(),
+                               [](const Product &a, const Product &b)
+                               { return a.get_id() == b.get_id(); }),
+                   products.end());
+
+    rebuild_indexes();
+    if (history_enabled)
+    {
+        current_version = PersistentProductMap::from_products(products);
+    }
+    query_cache.products_replaced();
+    for (InventoryListener *listener : listeners)
+    {
+        listener->products_replaced(products);
+    }
+}
+
+void InventoryManager::notify_product_changed(const Product *before, const Product *after) const
+{
+    query_cache.product_changed(after ? after->id : before->id);
+    for (InventoryListener *listener : listeners)
+    {
+        listener->product_changed(before, after);
+    }
+}
+
+void InventoryManager::set_history_enabled(bool enabled, size_t max_undo_steps)
+{
+    TRACE_SCOPE("InventoryManager::set_history_enabled");
+    history_enabled = enabled;
+    history_limit = max_undo_steps;
+    undo_stack.clear();
+    redo_stack.clear();
+    current_version = enabled ? PersistentProductMap::from_products(products) : PersistentProductMap();
+}
+
+bool InventoryManager::is_history_enabled() const
+{
+    return history_enabled;
+}
+
+PersistentProductMap InventoryManager::snapshot() const
+{
+    TRACE_SCOPE("InventoryManager::snapshot");
+    return history_enabled ? current_version : PersistentProductMap::from_products(products);
+}
+
+void InventoryManager::save_snapshot(const PersistentProductMap &snapshot, const std::string &filename)
+{
+    TRACE_SCOPE("InventoryManager::save_snapshot");
+    write_file_atomically(filename, [&snapshot](std::ostream &out)
+                          {
+                              out << PRODUCT_CSV_HEADER << "\n";
+                              snapshot.for_each([&out](const Product &product)
+                                                { write_product_csv_row(out, product); });
+                          });
+}
+
+void InventoryManager::commit_version(const PersistentProductMap &before)
+{
+    if (!history_enabled || before.same_version(current_version))
+    {
+        return;
+    }
+
+    undo_stack.push_back(before);
+    if (undo_stack.size() > history_limit)
+    {
+        undo_stack.erase(undo_stack.begin());
+    }
+    redo_stack.clear();
+}
+
+void InventoryManager::restore_version(const PersistentProductMap &target)
+{
+    TRACE_SCOPE("InventoryManager::restore_version");
+    std::vector<ProductDiff> changes;
+    size_t structural_changes = 0;
+    PersistentProductMap::diff(current_version, target, [&changes, &structural_changes](const ProductDiff &diff)
+                               {
+                                   if (diff.kind != ProductDiff::Kind::CHANGED)
+                                   {
+                                       structural_changes++;
+                                   }
+                                   changes.push_back(diff);
+                               });
+
+    // The helpers below would record new versions; the result is target itself
+    history_enabled = false;
+
+    if (structural_changes > MAX_INCREMENTAL_RESTORE)
+    {
+        for (const auto &change : changes)
+        {
+            shard_store.mark_dirty(change.kind == ProductDiff::Kind::ADDED ? change.after : change.before);
+            if (change.kind == ProductDiff::Kind::CHANGED)
+            {
+                shard_store.mark_dirty(change.after);
+            }
+        }
+        products = target.to_vector();
+        finish_bulk_load();
+    }
+    else
+    {
+        for (const auto &change : changes)
+        {
+            switch (change.kind)
+            {
+            case ProductDiff::Kind::ADDED:
+                insert_product(change.after);
+                break;
+            case ProductDiff::Kind::REMOVED:
+                erase_product(id_index.at(change.before.id));
+                break;
+            case ProductDiff::Kind::CHANGED:
+                replace_product(id_index.at(change.after.id), change.after);
+                break;
+            }
+        }
+    }
+
+    history_enabled = true;
+    current_version = target;
+
+    // A version from before a load may hold IDs above the loaded file's, and none may be handed out again
+    if (!products.empty())
+    {
+        next_product_id = std::max(next_product_id, products.back().id + 1);
+    }
+}
+
+bool InventoryManager::can_undo() const
+{
+    return !undo_stack.empty();
+}
+
+bool InventoryManager::can_redo() const
+{
+    return !redo_stack.empty();
+}
+
+bool InventoryManager::undo()
+{
+    TRACE_SCOPE("InventoryManager::undo");
+    if (undo_stack.empty())
+    {
+        return false;
+    }
+
+    PersistentProductMap target = undo_stack.back();
+    undo_stack.pop_back();
+    redo_stack.push_back(current_version);
+    restore_version(target);
+    return true;
+}
+
+bool InventoryManager::redo()
+{
+    TRACE_SCOPE("InventoryManager::redo");
+    if (redo_stack.empty())
+    {
+        return false;
+    }
+
+    PersistentProductMap target = redo_stack.back();
+    redo_stack.pop_back();
+    undo_stack.push_back(current_version);
+    restore_version(target);
+    return true;
+}
+
+void InventoryManager::set_executor(std::shared_ptr<TaskExecutor> executor)
+{
+    this->executor = std::move(executor);
+}
+
+TaskExecutor &InventoryManager::get_executor() const
+{
+    return executor ? *executor : *TaskExecutor::get_shared();
+}
+
+TaskFuture<void> InventoryManager::load_from_file_async(const std::string &filename)
+{
+    return get_executor().async([this, filename]()
+                                { load_from_file(filename); });
+}
+
+TaskFuture<void> InventoryManager::save_to_file_async(const std::string &filename)
+{
+    return get_executor().async([this, filename]()
+                                { save_to_file(filename); });
+}
+
+TaskFuture<std::vector<Product>> InventoryManager::find_products_async(const ProductQuery &query) const
+{
+    return get_executor().async([this, query]()
+                                { return find_products(query); });
+}
+
+TaskFuture<Cents> InventoryManager::get_total_inventory_value_async() const
+{
+    return get_executor().async([this]()
+                                { return get_total_inventory_value(); });
+}
+
 std::string InventoryManager::replace_all(std::string str, const std::string &from, const std::string &to)
 {
     size_t start_pos = 0;
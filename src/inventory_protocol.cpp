@@ -0,0 +1,491 @@
+#include "includes/inventory_protocol.h"
+#include "includes/product_schema.h"
+#include "includes/trace.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <map>
+
+const uint32_t InventoryService::MAX_RESULTS;
+
+namespace
+{
+    /**
+     * @brief Thrown when a request body cannot be decoded
+     */
+    class MalformedRequestException : public InventoryException
+    {
+    public:
+        MalformedRequestException(const std::string &message) : InventoryException(message) {}
+    };
+
+    void expect_end(const WireReader &request)
+    {
+        if (!request.at_end())
+        {
+            throw MalformedRequestException("Malformed request body");
+        }
+    }
+
+    SearchMode decode_search_mode(uint8_t mode)
+    {
+        switch (mode)
+        {
+        case 0:
+            return SearchMode::EXACT;
+        case 1:
+            return SearchMode::IGNORE_CASE;
+        case 2:
+            return SearchMode::FUZZY;
+        }
+        throw MalformedRequestException("Unknown search mode " + std::to_string(mode));
+    }
+}
+
+WireWriter::WireWriter(std::string &buffer) : buffer(buffer), frame_start(0) {}
+
+void WireWriter::begin_frame()
+{
+    frame_start = buffer.size();
+    put_u32(0);
+}
+
+void WireWriter::end_frame()
+{
+    patch_u32(frame_start, static_cast<uint32_t>(buffer.size() - frame_start - FRAME_HEADER_SIZE));
+}
+
+size_t WireWriter::position() const
+{
+    return buffer.size();
+}
+
+void WireWriter::patch_u32(size_t position, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        buffer[position + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+void WireWriter::put_u8(uint8_t value)
+{
+    buffer.push_back(static_cast<char>(value));
+}
+
+void WireWriter::put_u32(uint32_t value)
+{
+    char bytes[4];
+    for (int i = 0; i < 4; i++)
+    {
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+    buffer.append(bytes, sizeof(bytes));
+}
+
+void WireWriter::put_i32(int32_t value)
+{
+    put_u32(static_cast<uint32_t>(value));
+}
+
+void WireWriter::put_i64(int64_t value)
+{
+    uint64_t bits = static_cast<uint64_t>(value);
+    put_u32(static_cast<uint32_t>(bits));
+    put_u32(static_cast<uint32_t>(bits >> 32));
+}
+
+void WireWriter::put_string(const std::string &value)
+{
+    put_u32(static_cast<uint32_t>(value.size()));
+    buffer.append(value);
+}
+
+void WireWriter::put_product(const Product &product)
+{
+    ProductSchema::put_wire(*this, product);
+}
+
+WireReader::WireReader(const char *data, size_t size) : data(data), size(size), position(0), failed(false) {}
+
+bool WireReader::ok() const
+{
+    return !failed;
+}
+
+bool WireReader::at_end() const
+{
+    return !failed && position == size;
+}
+
+const char *WireReader::take(size_t bytes)
+{
+    if (failed || size - position < bytes)
+    {
+        failed = true;
+        return nullptr;
+    }
+    const char *start = data + position;
+    position += bytes;
+    return start;
+}
+
+uint8_t WireReader::get_u8()
+{
+    const char *bytes = take(1);
+    return bytes ? static_cast<uint8_t>(bytes[0]) : 0;
+}
+
+uint32_t WireReader::get_u32()
+{
+    const char *bytes = take(4);
+    if (!bytes)
+    {
+        return 0;
+    }
+
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+    }
+    return value;
+}
+
+int32_t WireReader::get_i32()
+{
+    return static_cast<int32_t>(get_u32());
+}
+
+int64_t WireReader::get_i64()
+{
+    uint64_t low = get_u32();
+    uint64_t high = get_u32();
+    return static_cast<int64_t>(low | (high << 32));
+}
+
+std::string WireReader::get_string()
+{
+    uint32_t length = get_u32();
+    const char *bytes = take(length);
+    return bytes ? std::string(bytes, length) : std::string();
+}
+
+Product WireReader::get_product()
+{
+    Product product;
+    if (!ProductSchema::get_wire(*this, product))
+    {
+        failed = true;
+    }
+    return product;
+}
+
+InventoryService::InventoryService(InventoryManager &manager) : manager(manager), mutated(false), request_count(0) {}
+
+bool InventoryService::has_mutations() const
+{
+    return mutated;
+}
+
+unsigned long long InventoryService::get_request_count() const
+{
+    return request_count;
+}
+
+void InventoryService::handle(const char *payload, size_t size, std::string &out)
+{
+    TRACE_SCOPE("InventoryService::handle");
+    request_count++;
+    WireReader request(payload, size);
+    uint32_t request_id = request.get_u32();
+    uint8_t opcode = request.get_u8();
+
+    WireWriter response(out);
+    response.begin_frame();
+    response.put_u32(request_id);
+    size_t status_position = response.position();
+    response.put_u8(static_cast<uint8_t>(ResponseStatus::OK));
+    size_t body_start = response.position();
+
+    ResponseStatus status = ResponseStatus::OK;
+    std::string message;
+    try
+    {
+        if (!request.ok())
+        {
+            throw MalformedRequestException("Truncated request header");
+        }
+        status = execute(static_cast<Opcode>(opcode), request, response, message);
+    }
+    catch (const MalformedRequestException &e)
+    {
+        status = ResponseStatus::INVALID_REQUEST;
+        message = e.what();
+    }
+    catch (const ProductNotFoundException &e)
+    {
+        status = ResponseStatus::NOT_FOUND;
+        message = e.what();
+    }
+    catch (const std::exception &e)
+    {
+        status = ResponseStatus::FAILED;
+        message = e.what();
+    }
+
+    if (status != ResponseStatus::OK)
+    {
+        // Drop any partial body and send the message instead
+        out.resize(body_start);
+        out[status_position] = static_cast<char>(status);
+        response.put_string(message);
+    }
+    response.end_frame();
+}
+
+size_t InventoryService::handle_frames(const char *in, size_t size, std::string &out)
+{
+    size_t consumed = 0;
+    while (size - consumed >= FRAME_HEADER_SIZE)
+    {
+        WireReader header(in + consumed, FRAME_HEADER_SIZE);
+        uint32_t length = header.get_u32();
+        if (length > MAX_FRAME_PAYLOAD)
+        {
+            return SIZE_MAX;
+        }
+        if (size - consumed - FRAME_HEADER_SIZE < length)
+        {
+            break; // Wait for the rest of the frame
+        }
+
+        handle(in + consumed + FRAME_HEADER_SIZE, length, out);
+        consumed += FRAME_HEADER_SIZE + length;
+    }
+    return consumed;
+}
+
+ResponseStatus InventoryService::not_found(int id, std::string &message)
+{
+    message = ProductNotFoundException(id).what();
+    return ResponseStatus::NOT_FOUND;
+}
+
+ResponseStatus InventoryService::sku_taken(const std::string &sku, std::string &message)
+{
+    message = "SKU " + sku + " already belongs to another product";
+    return ResponseStatus::FAILED;
+}
+
+ResponseStatus InventoryService::execute(Opcode opcode, WireReader &request, WireWriter &response,
+                                         std::string &message)
+{
+    switch (opcode)
+    {
+    case Opcode::PING:
+        expect_end(request);
+        return ResponseStatus::OK;
+
+    case Opcode::GET_PRODUCT:
+    {
+        int id = request.get_i32();
+        expect_end(request);
+        Product product;
+        if (!manager.try_get_product_by_id(id, product))
+        {
+            return not_found(id, message);
+        }
+        response.put_product(product);
+        return ResponseStatus::OK;
+    }
+
+    case Opcode::GET_PRODUCTS:
+    {
+        uint32_t count = request.get_u32();
+        if (count > MAX_RESULTS)
+        {
+            throw MalformedRequestException("Too many IDs in one request");
+        }
+        std::vector<int> ids(count);
+        for (auto &id : ids)
+        {
+            id = request.get_i32();
+        }
+        expect_end(request);
+
+        const std::vector<Product> &products = manager.get_all_products();
+        response.put_u32(count);
+        for (int id : ids)
+        {
+            // Products are sorted by ID, so no exception is needed for misses
+            auto found = std::lower_bound(products.begin(), products.end(), id,
+                                          [](const Product &product, int key)
+                                          { return product.get_id() < key; });
+            bool present = found != products.end() && found->get_id() == id;
+            response.put_u8(present ? 1 : 0);
+            if (present)
+            {
+                response.put_product(*found);
+            }
+        }
+        return ResponseStatus::OK;
+    }
+
+    case Opcode::FIND_BY_NAME:
+    case Opcode::FIND_BY_CATEGORY:
+    case Opcode::LOW_STOCK:
+    {
+        ProductQuery query;
+        if (opcode == Opcode::LOW_STOCK)
+        {
+            query = ProductQuery::low_stock(request.get_i32());
+        }
+        else
+        {
+            SearchMode mode = decode_search_mode(request.get_u8());
+            std::string text = request.get_string();
+            query = opcode == Opcode::FIND_BY_NAME ? ProductQuery::by_name(text, mode)
+                                                   : ProductQuery::by_category(text, mode);
+        }
+        uint32_t limit = std::min(request.get_u32(), MAX_RESULTS);
+        expect_end(request);
+
+        size_t count_position = response.position();
+        uint32_t count = 0;
+        response.put_u32(0);
+        if (limit > 0)
+        {
+            // The scan stops at the limit rather than visiting every match
+            manager.for_each_matching(query, [&response, &count](const Product &product)
+                                      {
+                                          response.put_product(product);
+                                          count++;
+                                      },
+                                      limit);
+        }
+        response.patch_u32(count_position, count);
+        return ResponseStatus::OK;
+    }
+
+    case Opcode::STATS:
+    {
+        expect_end(request);
+        int64_t quantity = 0;
+        for (const auto &product : manager.get_all_products())
+        {
+            quantity += product.get_quantity();
+        }
+        response.put_u32(static_cast<uint32_t>(manager.get_total_product_count()));
+        response.put_i64(quantity);
+        response.put_i64(manager.get_total_inventory_value());
+        return ResponseStatus::OK;
+    }
+
+    case Opcode::CATEGORY_TOTALS:
+    {
+        expect_end(request);
+        struct Totals
+        {
+            uint32_t products = 0;
+            int64_t quantity = 0;
+            CentsTotal value;
+        };
+        std::map<std::string, Totals> categories;
+        for (const auto &product : manager.get_all_products())
+        {
+            Totals &totals = categories[product.get_category()];
+            totals.products++;
+            totals.quantity += product.get_quantity();
+            totals.value.add(product.get_total_value());
+        }
+
+        response.put_u32(static_cast<uint32_t>(categories.size()));
+        for (const auto &category : categories)
+        {
+            response.put_string(category.first);
+            response.put_u32(category.second.products);
+            response.put_i64(category.second.quantity);
+            response.put_i64(category.second.value.to_cents());
+        }
+        return ResponseStatus::OK;
+    }
+
+    case Opcode::ADD_PRODUCT:
+    {
+        Product product = request.get_product();
+        expect_end(request);
+        int id = 0;
+        if (manager.try_add_product(product, id) == InventoryStatus::SKU_TAKEN)
+        {
+            return sku_taken(product.get_sku(), message);
+        }
+        response.put_i32(id);
+        mutated = true;
+        return ResponseStatus::OK;
+    }
+
+    case Opcode::UPDATE_PRODUCT:
+    {
+        Product product = request.get_product();
+        expect_end(request);
+        switch (manager.try_update_product(product.get_id(), product))
+        {
+        case InventoryStatus::NOT_FOUND:
+            return not_found(product.get_id(), message);
+        case InventoryStatus::SKU_TAKEN:
+            return sku_taken(product.get_sku(), message);
+        default:
+            break;
+        }
+        mutated = true;
+        return ResponseStatus::OK;
+    }
+
+    case Opcode::REMOVE_PRODUCT:
+    {
+        int id = request.get_i32();
+        expect_end(request);
+        if (manager.try_remove_product(id) == InventoryStatus::NOT_FOUND)
+        {
+            return not_found(id, message);
+        }
+        mutated = true;
+        return ResponseStatus::OK;
+    }
+
+    case Opcode::ADJUST_QUANTITY:
+    {
+        int id = request.get_i32();
+        int delta = request.get_i32();
+        expect_end(request);
+
+        // Requests run one at a time, so the read and write cannot interleave with another writer
+        Product product;
+        if (!manager.try_get_product_by_id(id, product))
+        {
+            return not_found(id, message);
+        }
+        long long quantity = static_cast<long long>(product.get_quantity()) + delta;
+        if (quantity < 0 || quantity > INT32_MAX)
+        {
+            throw InventoryException(QUANTITY_OUT_OF_RANGE_MESSAGE + std::to_string(id));
+        }
+        product.set_quantity(static_cast<int>(quantity));
+        switch (manager.try_update_product(id, product))
+        {
+        case InventoryStatus::NOT_FOUND:
+            return not_found(id, message);
+        case InventoryStatus::SKU_TAKEN:
+            return sku_taken(product.get_sku(), message);
+        default:
+            break;
+        }
+        response.put_i32(product.get_quantity());
+        mutated = true;
+        return ResponseStatus::OK;
+    }
+    }
+
+    throw MalformedRequestException("Unknown opcode " + std::to_string(static_cast<int>(opcode)));
+}
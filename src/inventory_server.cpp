@@ -0,0 +1,364 @@
+#include "includes/inventory_server.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    // Stop reading from a client whose unsent responses exceed this, until it catches up
+    const size_t MAX_PENDING_OUTPUT = 8 * 1024 * 1024;
+
+    const size_t READ_CHUNK = 64 * 1024;
+    const int MAX_EVENTS = 256;
+
+    InventoryException system_error(const std::string &what)
+    {
+        return InventoryException(what + ": " + std::strerror(errno));
+    }
+}
+
+InventoryServer::InventoryServer(InventoryManager &manager)
+    : service(manager), epoll_fd(-1), wake_fd(-1)
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+    {
+        throw system_error("Failed to create epoll instance");
+    }
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0)
+    {
+        close(epoll_fd);
+        throw system_error("Failed to create eventfd");
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+}
+
+InventoryServer::~InventoryServer()
+{
+    for (const auto &connection : connections)
+    {
+        close(connection.first);
+    }
+    for (int fd : listen_fds)
+    {
+        close(fd);
+    }
+    if (!unix_path.empty())
+    {
+        unlink(unix_path.c_str());
+    }
+    close(wake_fd);
+    close(epoll_fd);
+}
+
+void InventoryServer::add_listener(int fd)
+{
+    if (::listen(fd, SOMAXCONN) < 0)
+    {
+        close(fd);
+        throw system_error("Failed to listen");
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    listen_fds.push_back(fd);
+}
+
+void InventoryServer::listen_unix(const std::string &path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+    {
+        throw InventoryException("Invalid Unix socket path: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        throw system_error("Failed to create socket");
+    }
+
+    // A socket file left behind by a previous run would make bind fail
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+    {
+        close(fd);
+        throw system_error("Failed to bind " + path);
+    }
+
+    add_listener(fd);
+    unix_path = path;
+}
+
+int InventoryServer::listen_tcp(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        throw system_error("Failed to create socket");
+    }
+
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+    {
+        close(fd);
+        throw system_error("Failed to bind port " + std::to_string(port));
+    }
+
+    socklen_t length = sizeof(address);
+    getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length);
+
+    add_listener(fd);
+    return ntohs(address.sin_port);
+}
+
+void InventoryServer::listen(const std::string &address)
+{
+    if (address.compare(0, 5, "unix:") == 0)
+    {
+        listen_unix(address.substr(5));
+        return;
+    }
+
+    if (address.compare(0, 4, "tcp:") == 0)
+    {
+        try
+        {
+            size_t consumed = 0;
+            int port = std::stoi(address.substr(4), &consumed);
+            if (consumed == address.size() - 4 && port >= 0 && port <= 65535)
+            {
+                listen_tcp(port);
+                return;
+            }
+        }
+        catch (const std::logic_error &)
+        {
+        }
+    }
+
+    throw InventoryException("Invalid listen address (expected unix:PATH or tcp:PORT): " + address);
+}
+
+void InventoryServer::stop()
+{
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd, &one, sizeof(one));
+    (void)written;
+}
+
+bool InventoryServer::has_mutations() const
+{
+    return service.has_mutations();
+}
+
+unsigned long long InventoryServer::get_request_count() const
+{
+    return service.get_request_count();
+}
+
+void InventoryServer::run()
+{
+    epoll_event events[MAX_EVENTS];
+    bool running = true;
+
+    while (running)
+    {
+        int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw system_error("epoll_wait failed");
+        }
+
+        for (int i = 0; i < ready; i++)
+        {
+            int fd = events[i].data.fd;
+            uint32_t flags = events[i].events;
+
+            if (fd == wake_fd)
+            {
+                uint64_t count;
+                ssize_t drained = read(wake_fd, &count, sizeof(count));
+                (void)drained;
+                running = false;
+                continue;
+            }
+
+            if (std::find(listen_fds.begin(), listen_fds.end(), fd) != listen_fds.end())
+            {
+                accept_connections(fd);
+                continue;
+            }
+
+            if (!connections.count(fd))
+            {
+                continue; // Closed earlier in this batch of events
+            }
+            if ((flags & EPOLLIN) && !read_requests(fd))
+            {
+                continue;
+            }
+            if ((flags & EPOLLOUT) && !flush_output(fd))
+            {
+                continue;
+            }
+            if ((flags & (EPOLLERR | EPOLLHUP)) && !(flags & EPOLLIN))
+            {
+                close_connection(fd);
+            }
+        }
+    }
+}
+
+void InventoryServer::accept_connections(int listen_fd)
+{
+    while (true)
+    {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return; // EAGAIN, or a transient error such as EMFILE
+        }
+
+        // Responses are already batched, so Nagle's algorithm only adds latency
+        int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        Connection connection;
+        connection.output_sent = 0;
+        connection.events = EPOLLIN;
+        connection.read_paused = false;
+        connections.emplace(fd, std::move(connection));
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+bool InventoryServer::read_requests(int fd)
+{
+    Connection &connection = connections[fd];
+    char chunk[READ_CHUNK];
+
+    while (connection.output.size() - connection.output_sent < MAX_PENDING_OUTPUT)
+    {
+        ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        if (received <= 0)
+        {
+            close_connection(fd);
+            return false;
+        }
+
+        connection.input.append(chunk, received);
+
+        // Execute every complete request received so far; their responses
+        // accumulate in output and go out together
+        size_t consumed = service.handle_frames(connection.input.data(), connection.input.size(), connection.output);
+        if (consumed == SIZE_MAX)
+        {
+            close_connection(fd);
+            return false;
+        }
+        connection.input.erase(0, consumed);
+    }
+
+    connection.read_paused = connection.output.size() - connection.output_sent >= MAX_PENDING_OUTPUT;
+    return flush_output(fd);
+}
+
+bool InventoryServer::flush_output(int fd)
+{
+    Connection &connection = connections[fd];
+
+    while (connection.output_sent < connection.output.size())
+    {
+        ssize_t sent = send(fd, connection.output.data() + connection.output_sent,
+                            connection.output.size() - connection.output_sent, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            close_connection(fd);
+            return false;
+        }
+        connection.output_sent += sent;
+    }
+
+    if (connection.output_sent == connection.output.size())
+    {
+        connection.output.clear();
+        connection.output_sent = 0;
+        connection.read_paused = false;
+    }
+
+    update_interest(fd);
+    return true;
+}
+
+void InventoryServer::update_interest(int fd)
+{
+    Connection &connection = connections[fd];
+    bool want_write = connection.output_sent < connection.output.size();
+    uint32_t events = (connection.read_paused ? 0u : uint32_t(EPOLLIN)) | (want_write ? uint32_t(EPOLLOUT) : 0u);
+    if (events == connection.events)
+    {
+        return; // Skip the system call in the common case
+    }
+
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    connection.events = events;
+}
+
+void InventoryServer::close_connection(int fd)
+{
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+}
@@ -0,0 +1,261 @@
+#include "includes/location_stock.h"
+#include "includes/inventory_manager.h"
+#include "includes/memory_accounting.h"
+#include <algorithm>
+
+int LocationStock::add_location(const std::string &name, const std::vector<Product> &products)
+{
+    if (name.empty())
+    {
+        throw InventoryException("Location name cannot be empty");
+    }
+    if (find_location(name) >= 0)
+    {
+        throw InventoryException("Location already exists: " + name);
+    }
+
+    int location = static_cast<int>(names.size());
+    names.push_back(name);
+    columns.emplace_back(row_ids.size(), 0);
+    totals.emplace_back();
+    if (location == 0)
+    {
+        // Rows are only kept once there is a location to hold them
+        row_ids.reserve(products.size());
+        for (const auto &product : products)
+        {
+            row_ids.push_back(product.get_id());
+            columns[0].push_back(product.get_quantity());
+            count_cell(0, product.get_quantity(), product.get_price_cents(), true);
+        }
+    }
+    return location;
+}
+
+int LocationStock::find_location(const std::string &name) const
+{
+    auto it = std::find(names.begin(), names.end(), name);
+    return it == names.end() ? -1 : static_cast<int>(it - names.begin());
+}
+
+const std::vector<std::string> &LocationStock::get_location_names() const
+{
+    return names;
+}
+
+void LocationStock::check_location(int location) const
+{
+    if (location < 0 || location >= static_cast<int>(names.size()))
+    {
+        throw InventoryException("No location with index " + std::to_string(location));
+    }
+}
+
+void LocationStock::insert_row(size_t row, const Product &product)
+{
+    if (names.empty())
+    {
+        return;
+    }
+
+    row_ids.insert(row_ids.begin() + row, product.get_id());
+    for (auto &column : columns)
+    {
+        column.insert(column.begin() + row, 0);
+    }
+    columns[0][row] = product.get_quantity();
+    count_cell(0, product.get_quantity(), product.get_price_cents(), true);
+}
+
+void LocationStock::erase_row(size_t row, Cents price)
+{
+    if (names.empty())
+    {
+        return;
+    }
+
+    row_ids.erase(row_ids.begin() + row);
+    for (size_t location = 0; location < columns.size(); location++)
+    {
+        count_cell(static_cast<int>(location), columns[location][row], price, false);
+        columns[location].erase(columns[location].begin() + row);
+    }
+}
+
+void LocationStock::update_row(size_t row, Cents previous_price, const Product &product)
+{
+    if (names.empty())
+    {
+        return;
+    }
+
+    Cents price = product.get_price_cents();
+    if (price != previous_price)
+    {
+        for (size_t location = 0; location < columns.size(); location++)
+        {
+            count_cell(static_cast<int>(location), columns[location][row], previous_price, false);
+            count_cell(static_cast<int>(location), columns[location][row], price, true);
+        }
+    }
+
+    long long difference = product.get_quantity() - row_total(row);
+    if (difference != 0)
+    {
+        set_quantity(row, 0, static_cast<int>(columns[0][row] + difference), price);
+    }
+}
+
+void LocationStock::rebuild(const std::vector<Product> &products)
+{
+    if (names.empty())
+    {
+        return;
+    }
+
+    // Both the old rows and the products are in ID order, so old cells are found by one forward walk
+    std::vector<std::vector<int>> rebuilt(columns.size(), std::vector<int>(products.size(), 0));
+    std::vector<int> rebuilt_ids;
+    rebuilt_ids.reserve(products.size());
+    size_t old_row = 0;
+    for (size_t row = 0; row < products.size(); row++)
+    {
+        int id = products[row].get_id();
+        rebuilt_ids.push_back(id);
+        while (old_row < row_ids.size() && row_ids[old_row] < id)
+        {
+            old_row++;
+        }
+        if (old_row < row_ids.size() && row_ids[old_row] == id)
+        {
+            for (size_t location = 0; location < columns.size(); location++)
+            {
+                rebuilt[location][row] = columns[location][old_row];
+            }
+        }
+    }
+    columns = std::move(rebuilt);
+    row_ids = std::move(rebuilt_ids);
+
+    std::fill(totals.begin(), totals.end(), LocationTotals());
+    for (size_t row = 0; row < products.size(); row++)
+    {
+        Cents price = products[row].get_price_cents();
+        long long difference = products[row].get_quantity() - row_total(row);
+        columns[0][row] = static_cast<int>(columns[0][row] + difference);
+        for (size_t location = 0; location < columns.size(); location++)
+        {
+            count_cell(static_cast<int>(location), columns[location][row], price, true);
+        }
+    }
+}
+
+void LocationStock::set_quantity(size_t row, int location, int quantity, Cents price)
+{
+    int &cell = columns[location][row];
+    count_cell(location, cell, price, false);
+    cell = quantity;
+    count_cell(location, cell, price, true);
+}
+
+long long LocationStock::row_total(size_t row) const
+{
+    long long total = 0;
+    for (const auto &column : columns)
+    {
+        total += column[row];
+    }
+    return total;
+}
+
+const LocationTotals &LocationStock::get_totals(int location) const
+{
+    check_location(location);
+    return totals[location];
+}
+
+std::vector<size_t> LocationStock::find_low_stock_rows(int threshold, int location) const
+{
+    std::vector<size_t> rows;
+    if (names.empty())
+    {
+        return rows;
+    }
+    if (location != ANY_LOCATION)
+    {
+        check_location(location);
+    }
+
+    // Rows are flagged a block at a time by branch-free passes over each column, which compilers
+    // vectorize; the flags are local so they cannot alias the columns. Then the flagged rows are collected.
+    const size_t BLOCK_ROWS = 1024;
+    int low[BLOCK_ROWS];
+    size_t row_count = row_ids.size();
+    size_t first = location == ANY_LOCATION ? 0 : static_cast<size_t>(location);
+    size_t last = location == ANY_LOCATION ? columns.size() : first + 1;
+    for (size_t start = 0; start < row_count; start += BLOCK_ROWS)
+    {
+        size_t block_rows = std::min(BLOCK_ROWS, row_count - start);
+        std::fill(low, low + block_rows, 0);
+        for (size_t column = first; column < last; column++)
+        {
+            const int *cells = columns[column].data() + start;
+            if (block_rows == BLOCK_ROWS)
+            {
+                // A constant count needs no remainder loop, so this vectorizes at -O2 as well
+                for (size_t row = 0; row < BLOCK_ROWS; row++)
+                {
+                    low[row] |= cells[row] < threshold;
+                }
+            }
+            else
+            {
+                for (size_t row = 0; row < block_rows; row++)
+                {
+                    low[row] |= cells[row] < threshold;
+                }
+            }
+        }
+
+        for (size_t row = 0; row < block_rows; row++)
+        {
+            if (low[row])
+            {
+                rows.push_back(start + row);
+            }
+        }
+    }
+    return rows;
+}
+
+size_t LocationStock::get_heap_bytes() const
+{
+    size_t bytes = heap_bytes(names) + heap_bytes(columns) + heap_bytes(totals) + heap_bytes(row_ids);
+    for (const auto &column : columns)
+    {
+        bytes += heap_bytes(column);
+    }
+    for (const auto &name : names)
+    {
+        bytes += heap_bytes(name);
+    }
+    return bytes;
+}
+
+void LocationStock::count_cell(int location, int quantity, Cents price, bool adding)
+{
+    LocationTotals &location_totals = totals[location];
+    Cents value = price * quantity;
+    if (adding)
+    {
+        location_totals.quantity += quantity;
+        location_totals.stocked += quantity > 0;
+        location_totals.value.add(value);
+    }
+    else
+    {
+        location_totals.quantity -= quantity;
+        location_totals.stocked -= quantity > 0;
+        location_totals.value.subtract(value);
+    }
+}
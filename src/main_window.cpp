@@ -1,5 +1,7 @@
 
 #include "includes/main_window.h"
+#include "includes/product_schema.h"
+#include "includes/trace.h"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -8,10 +10,26 @@
 #include <QMessageBox>
 #include <QHeaderView>
 #include <QStatusBar>
+#include <QMenuBar>
 #include <QDialog>
 #include <QFileDialog>
 #include <QProgressBar>
 #include <QTextStream>
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+    // Money is formatted from cents, so the table shows exactly what is stored
+    QString format_money(Cents cents)
+    {
+        return QString("$") + QString::fromStdString(format_cents(cents));
+    }
+
+    // Table cells in this column are highlighted for low stock products
+    constexpr int QUANTITY_COLUMN = ProductSchema::table_column_index("Quantity");
+    static_assert(QUANTITY_COLUMN >= 0, "The product table needs a Quantity column");
+}
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
 {
@@ -30,13 +48,20 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
     search_edit = new QLineEdit();
     search_name_button = new QPushButton("Search by Name");
     search_category_button = new QPushButton("Search by Category");
+    search_sku_button = new QPushButton("Find by SKU");
     reset_search_button = new QPushButton("Show All");
     low_stock_button = new QPushButton("Show Low Stock");
+    search_mode_combo_box = new QComboBox();
+    search_mode_combo_box->addItem("Ignore case", static_cast<int>(SearchMode::IGNORE_CASE));
+    search_mode_combo_box->addItem("Match case", static_cast<int>(SearchMode::EXACT));
+    search_mode_combo_box->addItem("Fuzzy", static_cast<int>(SearchMode::FUZZY));
 
     search_layout->addWidget(new QLabel("Search:"));
     search_layout->addWidget(search_edit);
+    search_layout->addWidget(search_mode_combo_box);
     search_layout->addWidget(search_name_button);
     search_layout->addWidget(search_category_button);
+    search_layout->addWidget(search_sku_button);
     search_layout->addWidget(reset_search_button);
     search_layout->addWidget(low_stock_button);
 
@@ -44,8 +69,13 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
     main_layout->addWidget(search_group);
 
     // Create product table
-    product_table = new QTableWidget(0, 6, this);
-    product_table->setHorizontalHeaderLabels({"ID", "Name", "Category", "Price", "Quantity", "Total Value"});
+    QStringList column_names;
+    for (const char *name : ProductSchema::table_column_names())
+    {
+        column_names << name;
+    }
+    product_table = new QTableWidget(0, column_names.size(), this);
+    product_table->setHorizontalHeaderLabels(column_names);
     product_table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     product_table->setSelectionBehavior(QAbstractItemView::SelectRows);
     product_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
@@ -64,12 +94,14 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
     quantity_spin_box = new QSpinBox();
     quantity_spin_box->setRange(0, 9999);
     description_edit = new QLineEdit();
+    sku_edit = new QLineEdit();
 
     form_layout->addRow("Name:", name_edit);
     form_layout->addRow("Category:", category_edit);
     form_layout->addRow("Price:", price_spin_box);
     form_layout->addRow("Quantity:", quantity_spin_box);
     form_layout->addRow("Description:", description_edit);
+    form_layout->addRow("SKU:", sku_edit);
 
     product_details_group->setLayout(form_layout);
     main_layout->addWidget(product_details_group);
@@ -112,6 +144,7 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
 
     connect(search_name_button, &QPushButton::clicked, this, &MainWindow::search_by_name);
     connect(search_category_button, &QPushButton::clicked, this, &MainWindow::search_by_category);
+    connect(search_sku_button, &QPushButton::clicked, this, &MainWindow::search_by_sku);
     connect(reset_search_button, &QPushButton::clicked, this, &MainWindow::reset_search);
     connect(low_stock_button, &QPushButton::clicked, [this]()
             { this->show_low_stock_products(); });
@@ -121,6 +154,50 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
     connect(value_chart_button, &QPushButton::clicked, this, &MainWindow::show_inventory_value_chart);
     connect(distribution_chart_button, &QPushButton::clicked, this, &MainWindow::show_category_distribution_chart);
 
+    // Create the edit menu; every change to the inventory can be undone
+    QMenu *edit_menu = menuBar()->addMenu("&Edit");
+    undo_action = edit_menu->addAction("&Undo");
+    undo_action->setShortcut(QKeySequence::Undo);
+    redo_action = edit_menu->addAction("&Redo");
+    redo_action->setShortcut(QKeySequence::Redo);
+
+    connect(undo_action, &QAction::triggered, this, &MainWindow::undo);
+    connect(redo_action, &QAction::triggered, this, &MainWindow::redo);
+
+    // Create the diagnostics menu for recording operation timings
+    QMenu *diagnostics_menu = menuBar()->addMenu("&Diagnostics");
+    QAction *record_timings_action = diagnostics_menu->addAction("&Record Timings");
+    record_timings_action->setCheckable(true);
+    QAction *save_timings_action = diagnostics_menu->addAction("&Save Timings...");
+    QAction *memory_usage_action = diagnostics_menu->addAction("&Memory Usage...");
+
+    connect(record_timings_action, &QAction::toggled, [](bool checked)
+            {
+                Tracing::set_enabled(checked);
+                Tracing::set_capture_events(checked);
+            });
+    connect(save_timings_action, &QAction::triggered, this, &MainWindow::save_timings);
+    connect(memory_usage_action, &QAction::triggered, this, &MainWindow::show_memory_usage);
+
+    inventory_manager.set_history_enabled(true);
+
+    // Keep the category charts current: totals follow every edit, and the
+    // open charts are redrawn once the edit (however many products it touched) is done
+    value_chart_dialog = nullptr;
+    distribution_chart_dialog = nullptr;
+    chart_refresh_timer = new QTimer(this);
+    chart_refresh_timer->setSingleShot(true);
+    chart_refresh_timer->setInterval(100);
+    connect(chart_refresh_timer, &QTimer::timeout, this, &MainWindow::refresh_charts);
+    inventory_manager.add_listener(&category_totals);
+    category_totals.set_change_callback([this]()
+                                        {
+                                            if (!chart_refresh_timer->isActive())
+                                            {
+                                                chart_refresh_timer->start();
+                                            }
+                                        });
+
     // Initialize inventory manager and update table
     update_table();
 }
@@ -151,8 +228,46 @@ bool MainWindow::validate_form()
     return isValid;
 }
 
+SearchMode MainWindow::selected_search_mode() const
+{
+    return static_cast<SearchMode>(search_mode_combo_box->currentData().toInt());
+}
+
+Cents MainWindow::fill_table(const std::vector<Product> &products, int low_stock_threshold)
+{
+    TRACE_SCOPE("MainWindow::fill_table");
+    product_table->setRowCount(0);
+    product_table->setRowCount(static_cast<int>(products.size()));
+
+    CentsTotal inventory_total;
+    for (size_t i = 0; i < products.size(); i++)
+    {
+        const Product &product = products[i];
+        int row = static_cast<int>(i);
+        inventory_total.add(product.get_total_value());
+
+        ProductSchema::for_each_table_cell(product, [this, row, &product, low_stock_threshold](int column, const std::string &text, bool numeric)
+                                           {
+                                               QTableWidgetItem *item = new QTableWidgetItem(QString::fromStdString(text));
+                                               if (numeric)
+                                               {
+                                                   item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                                               }
+
+                                               // Highlight low stock items
+                                               if (column == QUANTITY_COLUMN && product.is_low_stock(low_stock_threshold))
+                                               {
+                                                   item->setBackground(QColor(255, 200, 200)); // Light red background
+                                               }
+                                               product_table->setItem(row, column, item);
+                                           });
+    }
+    return inventory_total.to_cents();
+}
+
 void MainWindow::add_product()
 {
+    TRACE_SCOPE("MainWindow::add_product");
 
     if (!validate_form())
     {
@@ -163,9 +278,10 @@ void MainWindow::add_product()
         0,
         name_edit->text().toStdString(),
         category_edit->text().toStdString(),
-        price_spin_box->value(),
+        cents_from_double(price_spin_box->value()),
         quantity_spin_box->value(),
-        description_edit->text().toStdString());
+        description_edit->text().toStdString(),
+        sku_edit->text().trimmed().toStdString());
 
     try
     {
@@ -182,6 +298,7 @@ void MainWindow::add_product()
 
 void MainWindow::update_product()
 {
+    TRACE_SCOPE("MainWindow::update_product");
     QList<QTableWidgetItem *> selectedItems = product_table->selectedItems();
     if (selectedItems.isEmpty())
     {
@@ -196,9 +313,10 @@ void MainWindow::update_product()
         id,
         name_edit->text().toStdString(),
         category_edit->text().toStdString(),
-        price_spin_box->value(),
+        cents_from_double(price_spin_box->value()),
         quantity_spin_box->value(),
-        description_edit->text().toStdString());
+        description_edit->text().toStdString(),
+        sku_edit->text().trimmed().toStdString());
 
     try
     {
@@ -215,6 +333,7 @@ void MainWindow::update_product()
 
 void MainWindow::remove_product()
 {
+    TRACE_SCOPE("MainWindow::remove_product");
     QList<QTableWidgetItem *> selectedItems = product_table->selectedItems();
     if (selectedItems.isEmpty())
     {
@@ -249,6 +368,7 @@ void MainWindow::clear_form()
     price_spin_box->setValue(0.0);
     quantity_spin_box->setValue(0);
     description_edit->clear();
+    sku_edit->clear();
 
     product_table->clearSelection();
 }
@@ -269,9 +389,10 @@ void MainWindow::selection_changed()
         Product product = inventory_manager.get_product_by_id(id);
         name_edit->setText(QString::fromStdString(product.get_name()));
         category_edit->setText(QString::fromStdString(product.get_category()));
-        price_spin_box->setValue(product.get_price());
+        price_spin_box->setValue(cents_to_double(product.get_price_cents()));
         quantity_spin_box->setValue(product.get_quantity());
         description_edit->setText(QString::fromStdString(product.get_description()));
+        sku_edit->setText(QString::fromStdString(product.get_sku()));
     }
     catch (const std::exception &e)
     {
@@ -281,56 +402,29 @@ void MainWindow::selection_changed()
 
 void MainWindow::update_table()
 {
-    product_table->setRowCount(0);
-
-    const std::vector<Product> &products = inventory_manager.get_all_products();
-    double inventoryTotal = 0.0;
+    TRACE_SCOPE("MainWindow::update_table");
+    current_query = ProductQuery::all();
 
-    for (const auto &product : products)
+    // Runs from the constructor and undo/redo too, so the total overflowing must not escape
+    try
     {
-        int row = product_table->rowCount();
-        product_table->insertRow(row);
-
-        // Calculate total value
-        double totalValue = product.get_price() * product.get_quantity();
-        inventoryTotal += totalValue;
+        Cents inventory_total = fill_table(inventory_manager.get_all_products(), 10);
 
-        QTableWidgetItem *idItem = new QTableWidgetItem(QString::number(product.get_id()));
-        idItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-
-        QTableWidgetItem *nameItem = new QTableWidgetItem(QString::fromStdString(product.get_name()));
-
-        QTableWidgetItem *categoryItem = new QTableWidgetItem(QString::fromStdString(product.get_category()));
-
-        QTableWidgetItem *priceItem = new QTableWidgetItem(QString("$") + QString::number(product.get_price(), 'f', 2));
-        priceItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-
-        QTableWidgetItem *quantityItem = new QTableWidgetItem(QString::number(product.get_quantity()));
-        quantityItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-
-        // Highlight low stock items
-        if (product.get_quantity() < 10)
-        {
-            quantityItem->setBackground(QColor(255, 200, 200)); // Light red background
-        }
-
-        QTableWidgetItem *totalValueItem = new QTableWidgetItem(QString("$") + QString::number(totalValue, 'f', 2));
-        totalValueItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-
-        product_table->setItem(row, 0, idItem);
-        product_table->setItem(row, 1, nameItem);
-        product_table->setItem(row, 2, categoryItem);
-        product_table->setItem(row, 3, priceItem);
-        product_table->setItem(row, 4, quantityItem);
-        product_table->setItem(row, 5, totalValueItem);
+        // Update status bar with total inventory value
+        statusBar()->showMessage(QString("Total Inventory Value: %1").arg(format_money(inventory_total)));
+    }
+    catch (const std::exception &e)
+    {
+        QMessageBox::critical(this, "Error", QString("Failed to show inventory: %1").arg(e.what()));
     }
 
-    // Update status bar with total inventory value
-    statusBar()->showMessage(QString("Total Inventory Value: $%1").arg(inventoryTotal, 0, 'f', 2));
+    undo_action->setEnabled(inventory_manager.can_undo());
+    redo_action->setEnabled(inventory_manager.can_redo());
 }
 
 void MainWindow::export_to_csv()
 {
+    TRACE_SCOPE("MainWindow::export_to_csv");
     QString filename = QFileDialog::getSaveFileName(this,
                                                     "Export Inventory", "", "CSV Files (*.csv)");
 
@@ -347,8 +441,11 @@ void MainWindow::export_to_csv()
 
     try
     {
-        inventory_manager.save_to_file(filename.toStdString());
-        QMessageBox::information(this, "Success", "Inventory exported successfully to " + filename);
+        // Rows are streamed straight to the file, whatever filter is active
+        size_t rows = inventory_manager.export_query_to_file(filename.toStdString(), current_query);
+        QString scope = current_query.matches_all() ? "products" : "products matching the current search";
+        QMessageBox::information(this, "Success",
+                                 QString("Exported %1 %2 to %3").arg(rows).arg(scope).arg(filename));
     }
     catch (const std::exception &e)
     {
@@ -356,124 +453,46 @@ void MainWindow::export_to_csv()
     }
 }
 
-void MainWindow::show_inventory_value_chart()
+void MainWindow::show_chart_dialog(CategoryChartDialog *&dialog, CategoryChartDialog::Kind kind)
 {
-    // Create a dialog to display the chart
-    QDialog *chartDialog = new QDialog(this);
-    chartDialog->setWindowTitle("Inventory Value by Category");
-    chartDialog->resize(600, 400);
-
-    // Create a vertical layout for the dialog
-    QVBoxLayout *layout = new QVBoxLayout(chartDialog);
-
-    // Group products by category and calculate total value
-    std::map<std::string, double> categoryValues;
-    const std::vector<Product> &products = inventory_manager.get_all_products();
-
-    for (const auto &product : products)
-    {
-        double value = product.get_price() * product.get_quantity();
-        categoryValues[product.get_category()] += value;
-    }
-
-    // Create a single bar set for all categories
-    QBarSeries *series = new QBarSeries();
-
-    // Add a bar set for each category
-    for (const auto &pair : categoryValues)
+    if (!dialog)
     {
-        QBarSet *barSet = new QBarSet(QString::fromStdString(pair.first));
-        *barSet << pair.second;
-        series->append(barSet);
+        dialog = new CategoryChartDialog(kind, category_totals, this);
     }
+    dialog->show();
+    dialog->raise();
+    dialog->activateWindow();
+}
 
-    // Create the chart and add the series
-    QChart *chart = new QChart();
-    chart->addSeries(series);
-    chart->setTitle("Inventory Value by Category");
-    chart->setAnimationOptions(QChart::SeriesAnimations);
-
-    // Create the axes
-    QValueAxis *axisY = new QValueAxis();
-    axisY->setTitleText("Value ($)");
-    chart->addAxis(axisY, Qt::AlignLeft);
-    series->attachAxis(axisY);
-
-    // Add a simple axis with just "Categories" as the label
-    QBarCategoryAxis *axisX = new QBarCategoryAxis();
-    axisX->append("Categories");
-    chart->addAxis(axisX, Qt::AlignBottom);
-    series->attachAxis(axisX);
-
-    // Hide the x-axis labels since they're redundant
-    axisX->setLabelsVisible(false);
-
-    // Make the legend visible to identify categories
-    chart->legend()->setVisible(true);
-    chart->legend()->setAlignment(Qt::AlignRight);
-
-    // Create chart view
-    QChartView *chartView = new QChartView(chart);
-    chartView->setRenderHint(QPainter::Antialiasing);
-
-    layout->addWidget(chartView);
-
-    chartDialog->exec();
-
-    delete chartDialog;
+void MainWindow::show_inventory_value_chart()
+{
+    TRACE_SCOPE("MainWindow::show_inventory_value_chart");
+    show_chart_dialog(value_chart_dialog, CategoryChartDialog::Kind::VALUE_BARS);
 }
 
 void MainWindow::show_category_distribution_chart()
 {
-    // Create a dialog to display the chart
-    QDialog *chartDialog = new QDialog(this);
-    chartDialog->setWindowTitle("Product Distribution by Category");
-    chartDialog->resize(600, 400);
-
-    // Create a vertical layout for the dialog
-    QVBoxLayout *layout = new QVBoxLayout(chartDialog);
-
-    // Create a pie series for the chart
-    QPieSeries *series = new QPieSeries();
-
-    // Group products by category and count
-    std::map<std::string, int> categoryCount;
-    const std::vector<Product> &products = inventory_manager.get_all_products();
+    TRACE_SCOPE("MainWindow::show_category_distribution_chart");
+    show_chart_dialog(distribution_chart_dialog, CategoryChartDialog::Kind::COUNT_PIE);
+}
 
-    for (const auto &product : products)
+void MainWindow::refresh_charts()
+{
+    TRACE_SCOPE("MainWindow::refresh_charts");
+    // Hidden dialogs skip the refresh and catch up when shown again
+    if (value_chart_dialog)
     {
-        categoryCount[product.get_category()]++;
+        value_chart_dialog->refresh();
     }
-
-    // Add slices for each category
-    for (const auto &pair : categoryCount)
+    if (distribution_chart_dialog)
     {
-        series->append(QString::fromStdString(pair.first), pair.second);
+        distribution_chart_dialog->refresh();
     }
-
-    // Create the chart and add the series
-    QChart *chart = new QChart();
-    chart->addSeries(series);
-    chart->setTitle("Product Distribution by Category");
-    chart->legend()->setVisible(true);
-    chart->legend()->setAlignment(Qt::AlignRight);
-
-    // Create chart view
-    QChartView *chartView = new QChartView(chart);
-    chartView->setRenderHint(QPainter::Antialiasing);
-
-    // Add the chart view to the layout
-    layout->addWidget(chartView);
-
-    // Show the dialog
-    chartDialog->exec();
-
-    // Clean up
-    delete chartDialog;
 }
 
 void MainWindow::search_by_name()
 {
+    TRACE_SCOPE("MainWindow::search_by_name");
     QString search_text = search_edit->text().trimmed();
     if (search_text.isEmpty())
     {
@@ -481,61 +500,33 @@ void MainWindow::search_by_name()
         return;
     }
 
-    std::vector<Product> results = inventory_manager.find_products_by_name(search_text.toStdString());
+    std::vector<Product> results = inventory_manager.find_products_by_name(search_text.toStdString(),
+                                                                           selected_search_mode());
     if (results.empty())
     {
         QMessageBox::information(this, "Search Results", "No products found matching the search term.");
         return;
     }
+    current_query = ProductQuery::by_name(search_text.toStdString(), selected_search_mode());
 
-    // Clear the table and display only search results
-    product_table->setRowCount(0);
-    double inventory_total = 0.0;
-
-    for (const auto &product : results)
+    // Display only the search results
+    try
     {
-        int row = product_table->rowCount();
-        product_table->insertRow(row);
-
-        double total_value = product.get_total_value();
-        inventory_total += total_value;
-
-        QTableWidgetItem *id_item = new QTableWidgetItem(QString::number(product.get_id()));
-        id_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-
-        QTableWidgetItem *name_item = new QTableWidgetItem(QString::fromStdString(product.get_name()));
-        QTableWidgetItem *category_item = new QTableWidgetItem(QString::fromStdString(product.get_category()));
-
-        QTableWidgetItem *price_item = new QTableWidgetItem(QString("$") + QString::number(product.get_price(), 'f', 2));
-        price_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-
-        QTableWidgetItem *quantity_item = new QTableWidgetItem(QString::number(product.get_quantity()));
-        quantity_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        Cents inventory_total = fill_table(results, 10);
 
-        // Highlight low stock items
-        if (product.is_low_stock(10))
-        {
-            quantity_item->setBackground(QColor(255, 200, 200)); // Light red background
-        }
-
-        QTableWidgetItem *total_value_item = new QTableWidgetItem(QString("$") + QString::number(total_value, 'f', 2));
-        total_value_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-
-        product_table->setItem(row, 0, id_item);
-        product_table->setItem(row, 1, name_item);
-        product_table->setItem(row, 2, category_item);
-        product_table->setItem(row, 3, price_item);
-        product_table->setItem(row, 4, quantity_item);
-        product_table->setItem(row, 5, total_value_item);
+        statusBar()->showMessage(QString("Found %1 products. Total Value: %2")
+                                     .arg(results.size())
+                                     .arg(format_money(inventory_total)));
+    }
+    catch (const std::exception &e)
+    {
+        QMessageBox::critical(this, "Error", QString("Failed to show search results: %1").arg(e.what()));
     }
-
-    statusBar()->showMessage(QString("Found %1 products. Total Value: $%2")
-                                 .arg(results.size())
-                                 .arg(inventory_total, 0, 'f', 2));
 }
 
 void MainWindow::search_by_category()
 {
+    TRACE_SCOPE("MainWindow::search_by_category");
     QString search_text = search_edit->text().trimmed();
     if (search_text.isEmpty())
     {
@@ -543,58 +534,61 @@ void MainWindow::search_by_category()
         return;
     }
 
-    std::vector<Product> results = inventory_manager.find_products_by_category(search_text.toStdString());
+    std::vector<Product> results = inventory_manager.find_products_by_category(search_text.toStdString(),
+                                                                               selected_search_mode());
     if (results.empty())
     {
         QMessageBox::information(this, "Search Results", "No products found in this category.");
         return;
     }
+    current_query = ProductQuery::by_category(search_text.toStdString(), selected_search_mode());
 
-    // Clear the table and display only search results
-    product_table->setRowCount(0);
-    double inventory_total = 0.0;
-
-    for (const auto &product : results)
+    // Display only the search results
+    try
     {
-        int row = product_table->rowCount();
-        product_table->insertRow(row);
-
-        double total_value = product.get_total_value();
-        inventory_total += total_value;
-
-        QTableWidgetItem *id_item = new QTableWidgetItem(QString::number(product.get_id()));
-        id_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        Cents inventory_total = fill_table(results, 10);
 
-        QTableWidgetItem *name_item = new QTableWidgetItem(QString::fromStdString(product.get_name()));
-        QTableWidgetItem *category_item = new QTableWidgetItem(QString::fromStdString(product.get_category()));
-
-        QTableWidgetItem *price_item = new QTableWidgetItem(QString("$") + QString::number(product.get_price(), 'f', 2));
-        price_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        statusBar()->showMessage(QString("Found %1 products in category '%2'. Total Value: %3")
+                                     .arg(results.size())
+                                     .arg(search_text)
+                                     .arg(format_money(inventory_total)));
+    }
+    catch (const std::exception &e)
+    {
+        QMessageBox::critical(this, "Error", QString("Failed to show search results: %1").arg(e.what()));
+    }
+}
 
-        QTableWidgetItem *quantity_item = new QTableWidgetItem(QString::number(product.get_quantity()));
-        quantity_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+void MainWindow::search_by_sku()
+{
+    TRACE_SCOPE("MainWindow::search_by_sku");
+    QString search_text = search_edit->text().trimmed();
+    if (search_text.isEmpty())
+    {
+        QMessageBox::warning(this, "Search Error", "Please enter or scan a SKU.");
+        return;
+    }
 
-        // Highlight low stock items
-        if (product.is_low_stock(10))
-        {
-            quantity_item->setBackground(QColor(255, 200, 200)); // Light red background
-        }
+    std::vector<Product> results = inventory_manager.find_products(ProductQuery::by_sku(search_text.toStdString()));
+    if (results.empty())
+    {
+        QMessageBox::information(this, "Search Results", "No product has this SKU.");
+        return;
+    }
+    current_query = ProductQuery::by_sku(search_text.toStdString());
 
-        QTableWidgetItem *total_value_item = new QTableWidgetItem(QString("$") + QString::number(total_value, 'f', 2));
-        total_value_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    try
+    {
+        Cents inventory_total = fill_table(results, 10);
 
-        product_table->setItem(row, 0, id_item);
-        product_table->setItem(row, 1, name_item);
-        product_table->setItem(row, 2, category_item);
-        product_table->setItem(row, 3, price_item);
-        product_table->setItem(row, 4, quantity_item);
-        product_table->setItem(row, 5, total_value_item);
+        statusBar()->showMessage(QString("Found SKU '%1'. Total Value: %2")
+                                     .arg(search_text)
+                                     .arg(format_money(inventory_total)));
+    }
+    catch (const std::exception &e)
+    {
+        QMessageBox::critical(this, "Error", QString("Failed to show search results: %1").arg(e.what()));
     }
-
-    statusBar()->showMessage(QString("Found %1 products in category '%2'. Total Value: $%3")
-                                 .arg(results.size())
-                                 .arg(search_text)
-                                 .arg(inventory_total, 0, 'f', 2));
 }
 
 void MainWindow::reset_search()
@@ -604,59 +598,127 @@ void MainWindow::reset_search()
     statusBar()->showMessage("Showing all products");
 }
 
-void MainWindow::show_low_stock_products(int threshold)
+void MainWindow::undo()
 {
-    std::vector<Product> results = inventory_manager.get_low_stock_products(threshold);
-    if (results.empty())
+    TRACE_SCOPE("MainWindow::undo");
+    if (inventory_manager.undo())
     {
-        QMessageBox::information(this, "Low Stock", "No products are below the stock threshold.");
-        return;
+        update_table();
+        clear_form();
+        statusBar()->showMessage("Undid last change");
     }
+}
 
-    // Clear the table and display only low stock products
-    product_table->setRowCount(0);
-    double inventory_total = 0.0;
-
-    for (const auto &product : results)
+void MainWindow::redo()
+{
+    TRACE_SCOPE("MainWindow::redo");
+    if (inventory_manager.redo())
     {
-        int row = product_table->rowCount();
-        product_table->insertRow(row);
+        update_table();
+        clear_form();
+        statusBar()->showMessage("Redid last change");
+    }
+}
 
-        double total_value = product.get_total_value();
-        inventory_total += total_value;
+void MainWindow::save_timings()
+{
+    const QString summary_filter = "Latency summary (*.json)";
+    const QString trace_filter = "Chrome trace (*.trace.json)";
+    QString selected_filter;
+    QString filename = QFileDialog::getSaveFileName(this, "Save Timings", "", summary_filter + ";;" + trace_filter,
+                                                    &selected_filter);
+
+    if (filename.isEmpty())
+    {
+        return;
+    }
 
-        QTableWidgetItem *id_item = new QTableWidgetItem(QString::number(product.get_id()));
-        id_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    std::ofstream file(filename.toStdString());
+    if (!file.is_open())
+    {
+        QMessageBox::critical(this, "Error", "Failed to open " + filename);
+        return;
+    }
 
-        QTableWidgetItem *name_item = new QTableWidgetItem(QString::fromStdString(product.get_name()));
-        QTableWidgetItem *category_item = new QTableWidgetItem(QString::fromStdString(product.get_category()));
+    if (selected_filter == trace_filter)
+    {
+        Tracing::write_chrome_trace(file);
+    }
+    else
+    {
+        Tracing::write_json(file);
+    }
+    statusBar()->showMessage("Timings saved to " + filename);
+}
 
-        QTableWidgetItem *price_item = new QTableWidgetItem(QString("$") + QString::number(product.get_price(), 'f', 2));
-        price_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+void MainWindow::show_memory_usage()
+{
+    int product_count = std::max(inventory_manager.get_total_product_count(), 1);
+    size_t total = 0;
+    QString report;
+    for (const auto &component : inventory_manager.get_memory_usage())
+    {
+        total += component.bytes;
+        report += QString("%1: %2 KB (%3 bytes per product)\n")
+                      .arg(QString::fromStdString(component.name))
+                      .arg(component.bytes / 1024)
+                      .arg(double(component.bytes) / product_count, 0, 'f', 1);
+    }
+    report += QString("Total: %1 KB (%2 bytes per product)\n")
+                  .arg(total / 1024)
+                  .arg(double(total) / product_count, 0, 'f', 1);
 
-        QTableWidgetItem *quantity_item = new QTableWidgetItem(QString::number(product.get_quantity()));
-        quantity_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-        quantity_item->setBackground(QColor(255, 200, 200)); // Highlight all low stock items
+    // Allocation counts come from the traced operations, so they need Record Timings
+    std::vector<TraceStats> operations = Tracing::get_stats();
+    if (operations.empty())
+    {
+        report += "\nEnable Diagnostics > Record Timings to count allocations per operation.";
+    }
+    else
+    {
+        report += "\nAllocations per call:\n";
+        for (const auto &operation : operations)
+        {
+            report += QString("%1: %2 (%3 bytes)\n")
+                          .arg(QString::fromStdString(operation.name))
+                          .arg(double(operation.allocations) / operation.count, 0, 'f', 1)
+                          .arg(operation.allocated_bytes / operation.count);
+        }
+    }
 
-        QTableWidgetItem *total_value_item = new QTableWidgetItem(QString("$") + QString::number(total_value, 'f', 2));
-        total_value_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    QMessageBox::information(this, "Memory Usage", report);
+}
 
-        product_table->setItem(row, 0, id_item);
-        product_table->setItem(row, 1, name_item);
-        product_table->setItem(row, 2, category_item);
-        product_table->setItem(row, 3, price_item);
-        product_table->setItem(row, 4, quantity_item);
-        product_table->setItem(row, 5, total_value_item);
+void MainWindow::show_low_stock_products(int threshold)
+{
+    TRACE_SCOPE("MainWindow::show_low_stock_products");
+    std::vector<Product> results = inventory_manager.get_low_stock_products(threshold);
+    if (results.empty())
+    {
+        QMessageBox::information(this, "Low Stock", "No products are below the stock threshold.");
+        return;
     }
+    current_query = ProductQuery::low_stock(threshold);
+
+    // Display only low stock products; all of them are highlighted
+    try
+    {
+        Cents inventory_total = fill_table(results, threshold);
 
-    statusBar()->showMessage(QString("Found %1 products with low stock (below %2). Total Value: $%3")
-                                 .arg(results.size())
-                                 .arg(threshold)
-                                 .arg(inventory_total, 0, 'f', 2));
+        statusBar()->showMessage(QString("Found %1 products with low stock (below %2). Total Value: %3")
+                                     .arg(results.size())
+                                     .arg(threshold)
+                                     .arg(format_money(inventory_total)));
+    }
+    catch (const std::exception &e)
+    {
+        QMessageBox::critical(this, "Error", QString("Failed to show low stock products: %1").arg(e.what()));
+    }
 }
 
 void MainWindow::import_from_csv()
 {
+    TRACE_SCOPE("MainWindow::import_from_csv");
     QString filename = QFileDialog::getOpenFileName(this,
                                                     "Import Inventory", "", "CSV Files (*.csv)");
 
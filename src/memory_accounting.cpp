@@ -0,0 +1,112 @@
+#include "includes/memory_accounting.h"
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // Constant-initialized, so operator new can use it before any static
+    // constructor has run
+    thread_local AllocationCounts thread_counts = {0, 0};
+
+    void *counted_malloc(std::size_t size)
+    {
+        void *block = std::malloc(size == 0 ? 1 : size);
+        if (block)
+        {
+            thread_counts.allocations++;
+            thread_counts.allocated_bytes += size;
+        }
+        return block;
+    }
+
+    void *counted_new(std::size_t size)
+    {
+        for (;;)
+        {
+            void *block = counted_malloc(size);
+            if (block)
+            {
+                return block;
+            }
+
+            std::new_handler handler = std::get_new_handler();
+            if (!handler)
+            {
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+    }
+}
+
+AllocationCounts AllocationTracker::get_thread_counts()
+{
+    return thread_counts;
+}
+
+// Replacements for the global allocation functions. Over-aligned types keep
+// the standard library's aligned versions and are not counted.
+
+void *operator new(std::size_t size)
+{
+    return counted_new(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return counted_new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try
+    {
+        return counted_new(size);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return nullptr;
+    }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    try
+    {
+        return counted_new(size);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return nullptr;
+    }
+}
+
+void operator delete(void *block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete[](void *block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete(void *block, std::size_t) noexcept
+{
+    std::free(block);
+}
+
+void operator delete[](void *block, std::size_t) noexcept
+{
+    std::free(block);
+}
+
+void operator delete(void *block, const std::nothrow_t &) noexcept
+{
+    std::free(block);
+}
+
+void operator delete[](void *block, const std::nothrow_t &) noexcept
+{
+    std::free(block);
+}
@@ -0,0 +1,168 @@
+#include "includes/money.h"
+#include "includes/inventory_manager.h"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+    bool is_digit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    bool parse_cents_through_double(const std::string &text, Cents &cents)
+    {
+        const char *begin = text.c_str();
+        char *end = nullptr;
+        double amount = std::strtod(begin, &end);
+        while (end != begin && (*end == ' ' || *end == '\t' || *end == '\r'))
+        {
+            end++;
+        }
+        if (end == begin || *end != '\0' || !std::isfinite(amount) || std::fabs(amount) >= 9.2e16)
+        {
+            return false;
+        }
+        cents = std::llround(amount * 100.0);
+        return true;
+    }
+}
+
+bool parse_cents(const std::string &text, Cents &cents)
+{
+    size_t pos = 0;
+    bool negative = false;
+    if (pos < text.size() && (text[pos] == '-' || text[pos] == '+'))
+    {
+        negative = text[pos] == '-';
+        pos++;
+    }
+
+    // Whole dollars, handing very long numbers to the fallback before they could overflow
+    uint64_t magnitude = 0;
+    size_t digits = 0;
+    while (pos < text.size() && is_digit(text[pos]) && magnitude < 1000000000000000ULL)
+    {
+        magnitude = magnitude * 10 + static_cast<uint64_t>(text[pos] - '0');
+        pos++;
+        digits++;
+    }
+    magnitude *= 100;
+
+    if (pos < text.size() && text[pos] == '.')
+    {
+        pos++;
+        for (size_t place = 0; pos < text.size() && is_digit(text[pos]); pos++, place++, digits++)
+        {
+            uint64_t digit = static_cast<uint64_t>(text[pos] - '0');
+            if (place == 0)
+            {
+                magnitude += digit * 10;
+            }
+            else if (place == 1)
+            {
+                magnitude += digit;
+            }
+            else if (place == 2 && digit >= 5)
+            {
+                // The third decimal rounds half away from zero; later ones are ignored
+                magnitude += 1;
+            }
+        }
+    }
+
+    if (pos != text.size() || digits == 0)
+    {
+        return parse_cents_through_double(text, cents);
+    }
+
+    cents = negative ? -static_cast<Cents>(magnitude) : static_cast<Cents>(magnitude);
+    return true;
+}
+
+std::string format_cents(Cents cents)
+{
+    char buffer[CENTS_TEXT_SIZE];
+    return std::string(buffer, format_cents(cents, buffer));
+}
+
+size_t format_cents(Cents cents, char *buffer)
+{
+    uint64_t magnitude = cents < 0 ? 0 - static_cast<uint64_t>(cents) : static_cast<uint64_t>(cents);
+    uint64_t fraction = magnitude % 100;
+
+    char *end = buffer;
+    if (cents < 0)
+    {
+        *end++ = '-';
+    }
+    end = std::to_chars(end, buffer + CENTS_TEXT_SIZE, magnitude / 100).ptr;
+    *end++ = '.';
+    *end++ = static_cast<char>('0' + fraction / 10);
+    *end++ = static_cast<char>('0' + fraction % 10);
+    return static_cast<size_t>(end - buffer);
+}
+
+Cents cents_from_double(double amount)
+{
+    if (!std::isfinite(amount) || std::fabs(amount) >= 9.2e16)
+    {
+        throw InventoryException("Amount out of range: " + std::to_string(amount));
+    }
+    return std::llround(amount * 100.0);
+}
+
+void CentsTotal::normalize()
+{
+    high += static_cast<int64_t>(low >> 32);
+    low &= 0xFFFFFFFFu;
+}
+
+void CentsTotal::add(const CentsTotal &other)
+{
+    CentsTotal addend = other;
+    addend.normalize();
+    normalize();
+    low += addend.low;
+    high += addend.high;
+}
+
+void CentsTotal::subtract(Cents amount)
+{
+    // Valid totals are far from INT64_MIN, so the negation cannot overflow
+    add(-amount);
+    normalize();
+}
+
+Cents CentsTotal::to_cents() const
+{
+    CentsTotal sum = *this;
+    sum.normalize();
+    if (sum.high < INT32_MIN || sum.high > INT32_MAX)
+    {
+        throw InventoryException("Total value does not fit in 64-bit cents");
+    }
+    return static_cast<Cents>((static_cast<uint64_t>(sum.high) << 32) | sum.low);
+}
+
+double CentsTotal::to_double() const
+{
+    return (static_cast<double>(high) * 4294967296.0 + static_cast<double>(low)) / 100.0;
+}
+
+bool CentsTotal::operator==(const CentsTotal &other) const
+{
+    CentsTotal a = *this, b = other;
+    a.normalize();
+    b.normalize();
+    return a.low == b.low && a.high == b.high;
+}
+
+bool CentsTotal::operator<(const CentsTotal &other) const
+{
+    CentsTotal a = *this, b = other;
+    a.normalize();
+    b.normalize();
+    return a.high < b.high || (a.high == b.high && a.low < b.low);
+}
@@ -0,0 +1,382 @@
+#include "includes/persistent_product_map.h"
+#include "includes/memory_accounting.h"
+#include <algorithm>
+
+namespace
+{
+    // Levels consume 5 bits of the ID each, most significant first: the top
+    // level uses the 2 highest bits, then 6 levels of 5 bits
+    const int TOP_SHIFT = 30;
+    const int BITS_PER_LEVEL = 5;
+
+    uint32_t slot_bit(uint32_t key, int shift)
+    {
+        return uint32_t(1) << ((key >> shift) & 31);
+    }
+
+    size_t slot_index(uint32_t bitmap, uint32_t bit)
+    {
+        uint32_t below = bitmap & (bit - 1);
+        size_t count = 0;
+        while (below)
+        {
+            below &= below - 1;
+            count++;
+        }
+        return count;
+    }
+}
+
+PersistentProductMap::PersistentProductMap() : count(0) {}
+
+PersistentProductMap::PersistentProductMap(const NodePtr &root, size_t count) : root(root), count(count) {}
+
+PersistentProductMap::NodePtr PersistentProductMap::build(const Entry *begin, const Entry *end, int shift)
+{
+    std::shared_ptr<Node> node = std::make_shared<Node>();
+    while (begin != end)
+    {
+        // Entries are sorted by key, so each slot's entries are contiguous
+        uint32_t slot = (begin->first >> shift) & 31;
+        const Entry *slot_end = begin;
+        while (slot_end != end && ((slot_end->first >> shift) & 31) == slot)
+        {
+            ++slot_end;
+        }
+
+        node->bitmap |= uint32_t(1) << slot;
+        if (shift == 0)
+        {
+            node->values.push_back(begin->second);
+        }
+        else
+        {
+            node->children.push_back(build(begin, slot_end, shift - BITS_PER_LEVEL));
+        }
+        begin = slot_end;
+    }
+    return node;
+}
+
+PersistentProductMap PersistentProductMap::from_products(const std::vector<Product> &products)
+{
+    // Build bottom-up rather than by repeated set() so no node is copied
+    std::vector<Entry> entries;
+    entries.reserve(products.size());
+    for (const auto &product : products)
+    {
+        entries.emplace_back(static_cast<uint32_t>(product.get_id()), std::make_shared<const Product>(product));
+    }
+
+    // A later duplicate replaces an earlier one, as with set()
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b)
+                     { return a.first < b.first; });
+    std::vector<Entry> unique;
+    unique.reserve(entries.size());
+    for (auto &entry : entries)
+    {
+        if (!unique.empty() && unique.back().first == entry.first)
+        {
+            unique.back() = std::move(entry);
+        }
+        else
+        {
+            unique.push_back(std::move(entry));
+        }
+    }
+
+    if (unique.empty())
+    {
+        return PersistentProductMap();
+    }
+    return PersistentProductMap(build(unique.data(), unique.data() + unique.size(), TOP_SHIFT), unique.size());
+}
+
+PersistentProductMap::NodePtr PersistentProductMap::set_in(const NodePtr &node, uint32_t key, int shift,
+                                                           const std::shared_ptr<const Product> &value,
+                                                           bool &added)
+{
+    std::shared_ptr<Node> copy = node ? std::make_shared<Node>(*node) : std::make_shared<Node>();
+    uint32_t bit = slot_bit(key, shift);
+    size_t index = slot_index(copy->bitmap, bit);
+    bool present = (copy->bitmap & bit) != 0;
+
+    if (shift == 0)
+    {
+        if (present)
+        {
+            copy->values[index] = value;
+        }
+        else
+        {
+            copy->values.insert(copy->values.begin() + index, value);
+            copy->bitmap |= bit;
+            added = true;
+        }
+        return copy;
+    }
+
+    NodePtr child = set_in(present ? copy->children[index] : NodePtr(), key, shift - BITS_PER_LEVEL, value, added);
+    if (present)
+    {
+        copy->children[index] = child;
+    }
+    else
+    {
+        copy->children.insert(copy->children.begin() + index, child);
+        copy->bitmap |= bit;
+    }
+    return copy;
+}
+
+PersistentProductMap::NodePtr PersistentProductMap::erase_in(const NodePtr &node, uint32_t key, int shift,
+                                                             bool &removed)
+{
+    uint32_t bit = slot_bit(key, shift);
+    if (!node || !(node->bitmap & bit))
+    {
+        return node;
+    }
+
+    size_t index = slot_index(node->bitmap, bit);
+    std::shared_ptr<Node> copy;
+
+    if (shift == 0)
+    {
+        removed = true;
+        copy = std::make_shared<Node>(*node);
+        copy->values.erase(copy->values.begin() + index);
+    }
+    else
+    {
+        NodePtr child = erase_in(node->children[index], key, shift - BITS_PER_LEVEL, removed);
+        if (!removed)
+        {
+            return node;
+        }
+
+        copy = std::make_shared<Node>(*node);
+        if (child)
+        {
+            copy->children[index] = child;
+            return copy;
+        }
+        copy->children.erase(copy->children.begin() + index);
+    }
+
+    // Drop nodes that became empty so equal maps have equal shapes
+    copy->bitmap &= ~bit;
+    return copy->bitmap ? NodePtr(copy) : NodePtr();
+}
+
+PersistentProductMap PersistentProductMap::set(const Product &product) const
+{
+    bool added = false;
+    NodePtr new_root = set_in(root, static_cast<uint32_t>(product.get_id()), TOP_SHIFT,
+                              std::make_shared<const Product>(product), added);
+    return PersistentProductMap(new_root, count + (added ? 1 : 0));
+}
+
+PersistentProductMap PersistentProductMap::erase(int id) const
+{
+    bool removed = false;
+    NodePtr new_root = erase_in(root, static_cast<uint32_t>(id), TOP_SHIFT, removed);
+    return PersistentProductMap(new_root, count - (removed ? 1 : 0));
+}
+
+const Product *PersistentProductMap::find(int id) const
+{
+    uint32_t key = static_cast<uint32_t>(id);
+    const Node *node = root.get();
+
+    for (int shift = TOP_SHIFT; node; shift -= BITS_PER_LEVEL)
+    {
+        uint32_t bit = slot_bit(key, shift);
+        if (!(node->bitmap & bit))
+        {
+            return nullptr;
+        }
+
+        size_t index = slot_index(node->bitmap, bit);
+        if (shift == 0)
+        {
+            return node->values[index].get();
+        }
+        node = node->children[index].get();
+    }
+    return nullptr;
+}
+
+size_t PersistentProductMap::size() const
+{
+    return count;
+}
+
+size_t PersistentProductMap::get_memory_usage(std::unordered_set<const void *> &counted) const
+{
+    return root ? memory_usage_in(root, counted) : 0;
+}
+
+size_t PersistentProductMap::memory_usage_in(const NodePtr &node, std::unordered_set<const void *> &counted)
+{
+    if (!counted.insert(node.get()).second)
+    {
+        return 0;
+    }
+
+    // make_shared puts the two reference counts in the same block as the object
+    const size_t control_block = 2 * sizeof(int) + sizeof(void *);
+    size_t bytes = heap_block_size(control_block + sizeof(Node)) + heap_bytes(node->children) +
+                   heap_bytes(node->values);
+    for (const auto &child : node->children)
+    {
+        bytes += memory_usage_in(child, counted);
+    }
+    for (const auto &value : node->values)
+    {
+        if (counted.insert(value.get()).second)
+        {
+            bytes += heap_block_size(control_block + sizeof(Product)) + value->get_heap_bytes();
+        }
+    }
+    return bytes;
+}
+
+bool PersistentProductMap::same_version(const PersistentProductMap &other) const
+{
+    return root == other.root;
+}
+
+void PersistentProductMap::for_each_in(const NodePtr &node, int shift,
+                                       const std::function<void(const Product &)> &visit)
+{
+    if (!node)
+    {
+        return;
+    }
+
+    if (shift == 0)
+    {
+        for (const auto &value : node->values)
+        {
+            visit(*value);
+        }
+        return;
+    }
+
+    for (const auto &child : node->children)
+    {
+        for_each_in(child, shift - BITS_PER_LEVEL, visit);
+    }
+}
+
+void PersistentProductMap::for_each(const std::function<void(const Product &)> &visit) const
+{
+    for_each_in(root, TOP_SHIFT, visit);
+}
+
+std::vector<Product> PersistentProductMap::to_vector() const
+{
+    std::vector<Product> products;
+    products.reserve(count);
+    for_each([&products](const Product &product)
+             { products.push_back(product); });
+    return products;
+}
+
+void PersistentProductMap::report_all(const NodePtr &node, int shift, ProductDiff::Kind kind,
+                                      const DiffVisitor &visit)
+{
+    for_each_in(node, shift, [kind, &visit](const Product &product)
+                {
+                    ProductDiff diff;
+                    diff.kind = kind;
+                    if (kind == ProductDiff::Kind::ADDED)
+                    {
+                        diff.after = product;
+                    }
+                    else
+                    {
+                        diff.before = product;
+                    }
+                    visit(diff);
+                });
+}
+
+void PersistentProductMap::diff_in(const NodePtr &before, const NodePtr &after, int shift,
+                                   const DiffVisitor &visit)
+{
+    if (before == after)
+    {
+        return; // Shared subtree: nothing below can differ
+    }
+    if (!before)
+    {
+        report_all(after, shift, ProductDiff::Kind::ADDED, visit);
+        return;
+    }
+    if (!after)
+    {
+        report_all(before, shift, ProductDiff::Kind::REMOVED, visit);
+        return;
+    }
+
+    for (int slot = 0; slot < 32; slot++)
+    {
+        uint32_t bit = uint32_t(1) << slot;
+        bool in_before = (before->bitmap & bit) != 0;
+        bool in_after = (after->bitmap & bit) != 0;
+        if (!in_before && !in_after)
+        {
+            continue;
+        }
+
+        size_t before_index = slot_index(before->bitmap, bit);
+        size_t after_index = slot_index(after->bitmap, bit);
+
+        if (shift > 0)
+        {
+            diff_in(in_before ? before->children[before_index] : NodePtr(),
+                    in_after ? after->children[after_index] : NodePtr(),
+                    shift - BITS_PER_LEVEL, visit);
+            continue;
+        }
+
+        ProductDiff diff;
+        if (!in_after)
+        {
+            diff.kind = ProductDiff::Kind::REMOVED;
+            diff.before = *before->values[before_index];
+        }
+        else if (!in_before)
+        {
+            diff.kind = ProductDiff::Kind::ADDED;
+            diff.after = *after->values[after_index];
+        }
+        else
+        {
+            const auto &old_value = before->values[before_index];
+            const auto &new_value = after->values[after_index];
+            if (old_value == new_value)
+            {
+                continue;
+            }
+
+            diff.kind = ProductDiff::Kind::CHANGED;
+            diff.before = *old_value;
+            diff.after = *new_value;
+            diff.changes = InventoryDiff::compare_fields(diff.before, diff.after);
+            if (diff.changes.empty())
+            {
+                continue;
+            }
+        }
+        visit(diff);
+    }
+}
+
+void PersistentProductMap::diff(const PersistentProductMap &before, const PersistentProductMap &after,
+                                const DiffVisitor &visit)
+{
+    diff_in(before.root, after.root, TOP_SHIFT, visit);
+}
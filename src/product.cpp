@@ -1,34 +1,35 @@
 #include "includes/product.h"
-#include <sstream>
-#include <iomanip>
+#include "includes/product_schema.h"
 
-Product::Product() : id(0), price(0.0), quantity(0) {}
+Product::Product() : id(0), price_cents(0), quantity(0) {}
 
 Product::Product(int id, const std::string &name, const std::string &category,
-                 double price, int quantity, const std::string &description)
-    : id(id), name(name), category(category), price(price),
-      quantity(quantity), description(description) {}
+                 Cents price_cents, int quantity, const std::string &description, const std::string &sku)
+    : id(id), name(name), category(category), price_cents(price_cents),
+      quantity(quantity), description(description), sku(sku) {}
 
 // Getters
 int Product::get_id() const { return id; }
 std::string Product::get_name() const { return name; }
 std::string Product::get_category() const { return category; }
-double Product::get_price() const { return price; }
+Cents Product::get_price_cents() const { return price_cents; }
 int Product::get_quantity() const { return quantity; }
-std::string Product::get_description() const { return description; }
+std::string Product::get_description() const { return description.str(); }
+std::string Product::get_sku() const { return sku; }
 
 // Setters
 void Product::set_id(int new_id) { id = new_id; }
 void Product::set_name(const std::string &new_name) { name = new_name; }
 void Product::set_category(const std::string &new_category) { category = new_category; }
-void Product::set_price(double new_price) { price = new_price; }
+void Product::set_price_cents(Cents new_price_cents) { price_cents = new_price_cents; }
 void Product::set_quantity(int new_quantity) { quantity = new_quantity; }
-void Product::set_description(const std::string &new_description) { description = new_description; }
+void Product::set_description(const std::string &new_description) { description = ColdText(new_description); }
+void Product::set_sku(const std::string &new_sku) { sku = new_sku; }
 
 // Helper methods
-double Product::get_total_value() const
+Cents Product::get_total_value() const
 {
-    return price * quantity;
+    return price_cents * quantity;
 }
 
 bool Product::is_low_stock(int threshold) const
@@ -38,11 +39,10 @@ bool Product::is_low_stock(int threshold) const
 
 std::string Product::to_string() const
 {
-    std::stringstream ss;
-    ss << "ID: " << id << ", "
-       << "Name: " << name << ", "
-       << "Category: " << category << ", "
-       << "Price: $" << std::fixed << std::setprecision(2) << price << ", "
-       << "Quantity: " << quantity;
-    return ss.str();
-}
\ No newline at end of file
+    return ProductSchema::describe(*this);
+}
+
+size_t Product::get_heap_bytes() const
+{
+    return ProductSchema::get_heap_bytes(*this);
+}
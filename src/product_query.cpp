@@ -0,0 +1,122 @@
+#include "includes/product_query.h"
+#include "includes/text_fold.h"
+#include <algorithm>
+
+ProductQuery ProductQuery::all()
+{
+    return ProductQuery();
+}
+
+ProductQuery ProductQuery::by_name(const std::string &name, SearchMode mode)
+{
+    Clause clause;
+    clause.kind = Kind::NAME;
+    clause.mode = mode;
+    clause.text = name;
+    clause.folded_text = mode == SearchMode::EXACT ? std::string() : fold_text(name);
+    clause.threshold = 0;
+
+    ProductQuery query;
+    query.clauses.push_back(clause);
+    return query;
+}
+
+ProductQuery ProductQuery::by_category(const std::string &category, SearchMode mode)
+{
+    Clause clause;
+    clause.kind = Kind::CATEGORY;
+    clause.mode = mode;
+    clause.text = category;
+    clause.folded_text = mode == SearchMode::EXACT ? std::string() : fold_text(category);
+    clause.threshold = 0;
+
+    ProductQuery query;
+    query.clauses.push_back(clause);
+    return query;
+}
+
+ProductQuery ProductQuery::low_stock(int threshold)
+{
+    Clause clause;
+    clause.kind = Kind::LOW_STOCK;
+    clause.mode = SearchMode::EXACT;
+    clause.threshold = threshold;
+
+    ProductQuery query;
+    query.clauses.push_back(clause);
+    return query;
+}
+
+ProductQuery ProductQuery::by_sku(const std::string &sku)
+{
+    Clause clause;
+    clause.kind = Kind::SKU;
+    clause.mode = SearchMode::EXACT;
+    clause.text = sku;
+    clause.threshold = 0;
+
+    ProductQuery query;
+    query.clauses.push_back(clause);
+    return query;
+}
+
+ProductQuery ProductQuery::matching(const ProductFilter &filter)
+{
+    Clause clause;
+    clause.kind = Kind::PREDICATE;
+    clause.mode = SearchMode::EXACT;
+    clause.threshold = 0;
+    clause.filter = filter;
+
+    ProductQuery query;
+    query.clauses.push_back(clause);
+    return query;
+}
+
+ProductQuery &ProductQuery::and_also(const ProductQuery &other)
+{
+    clauses.insert(clauses.end(), other.clauses.begin(), other.clauses.end());
+    return *this;
+}
+
+bool ProductQuery::matches_all() const
+{
+    return clauses.empty();
+}
+
+bool ProductQuery::get_cache_key(std::string &key) const
+{
+    std::vector<std::string> parts;
+    for (const auto &clause : clauses)
+    {
+        if (clause.kind == Kind::PREDICATE || (clause.kind == Kind::NAME && clause.mode == SearchMode::FUZZY))
+        {
+            return false;
+        }
+
+        // Text is prefixed with its length, so it cannot run into the next clause
+        std::string part = std::to_string(static_cast<int>(clause.kind)) + ":" +
+                           std::to_string(static_cast<int>(clause.mode)) + ":";
+        if (clause.kind == Kind::LOW_STOCK)
+        {
+            part += std::to_string(clause.threshold);
+        }
+        else
+        {
+            const std::string &text = clause.mode == SearchMode::EXACT ? clause.text : clause.folded_text;
+            part += std::to_string(text.size()) + ":" + text;
+        }
+        parts.push_back(part);
+    }
+
+    // A conjunction does not depend on the order of its clauses or on repeats
+    std::sort(parts.begin(), parts.end());
+    parts.erase(std::unique(parts.begin(), parts.end()), parts.end());
+    key.clear();
+    for (const auto &part : parts)
+    {
+        key += part;
+        key += ';';
+    }
+    return true;
+}
@@ -0,0 +1,252 @@
+#include "includes/query_cache.h"
+#include "includes/memory_accounting.h"
+#include <algorithm>
+
+const size_t QueryCache::DEFAULT_MAX_BYTES;
+
+namespace
+{
+    // Changes logged before the oldest half is dropped; entries older than the log are evaluated again
+    const size_t MAX_LOGGED_CHANGES = 4096;
+}
+
+double QueryCacheStats::hit_ratio() const
+{
+    uint64_t lookups = hits + refreshes + misses;
+    return lookups == 0 ? 0.0 : double(hits + refreshes) / lookups;
+}
+
+QueryCache::QueryCache(size_t max_bytes) : bytes(0), max_bytes(max_bytes), generation(0), log_start(0) {}
+
+QueryCache::QueryCache(const QueryCache &other) : bytes(0)
+{
+    std::lock_guard<std::mutex> lock(other.mutex);
+    max_bytes = other.max_bytes;
+    generation = other.generation;
+    log_start = generation;
+}
+
+QueryCache &QueryCache::operator=(const QueryCache &other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    size_t other_max_bytes;
+    uint64_t other_generation;
+    {
+        std::lock_guard<std::mutex> lock(other.mutex);
+        other_max_bytes = other.max_bytes;
+        other_generation = other.generation;
+    }
+
+    // The products were replaced, so the generation moves on rather than back
+    std::lock_guard<std::mutex> lock(mutex);
+    max_bytes = other_max_bytes;
+    generation = std::max(generation, other_generation) + 1;
+    changed_ids.clear();
+    log_start = generation;
+    entries.clear();
+    by_key.clear();
+    bytes = 0;
+    return *this;
+}
+
+bool QueryCache::find(const std::string &key, IdList &ids, const std::function<bool(int)> &matches)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = by_key.find(key);
+    if (found == by_key.end())
+    {
+        stats.misses++;
+        return false;
+    }
+
+    auto entry = found->second;
+    if (entry->generation < log_start)
+    {
+        erase(entry);
+        stats.misses++;
+        return false;
+    }
+
+    if (entry->generation < generation)
+    {
+        // Each product changed since is tested once, then merged into the IDs in one pass
+        std::vector<int> changed(changed_ids.begin() + (entry->generation - log_start), changed_ids.end());
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+        auto refreshed = std::make_shared<std::vector<int>>();
+        refreshed->reserve(entry->ids->size() + changed.size());
+        size_t next = 0;
+        for (int id : *entry->ids)
+        {
+            for (; next < changed.size() && changed[next] < id; next++)
+            {
+                if (matches(changed[next]))
+                {
+                    refreshed->push_back(changed[next]);
+                }
+            }
+            if (next < changed.size() && changed[next] == id)
+            {
+                next++;
+                if (!matches(id))
+                {
+                    continue;
+                }
+            }
+            refreshed->push_back(id);
+        }
+        for (; next < changed.size(); next++)
+        {
+            if (matches(changed[next]))
+            {
+                refreshed->push_back(changed[next]);
+            }
+        }
+
+        entry->ids = std::move(refreshed);
+        entry->generation = generation;
+        bytes -= entry->bytes;
+        entry->bytes = entry_bytes(*entry);
+        bytes += entry->bytes;
+        stats.refreshes++;
+    }
+    else
+    {
+        stats.hits++;
+    }
+
+    entries.splice(entries.begin(), entries, entry);
+    ids = entry->ids;
+    evict();
+    return true;
+}
+
+void QueryCache::store(const std::string &key, IdList ids, uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (max_bytes == 0 || generation < log_start)
+    {
+        return;
+    }
+
+    auto found = by_key.find(key);
+    if (found != by_key.end())
+    {
+        erase(found->second);
+    }
+
+    entries.push_front(Entry());
+    Entry &entry = entries.front();
+    entry.key = key;
+    entry.ids = std::move(ids);
+    entry.generation = generation;
+    entry.bytes = entry_bytes(entry);
+    bytes += entry.bytes;
+    by_key[key] = entries.begin();
+    evict();
+}
+
+uint64_t QueryCache::get_generation() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return generation;
+}
+
+void QueryCache::product_changed(int id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+    if (entries.empty())
+    {
+        // Nothing to refresh, so nothing to log
+        changed_ids.clear();
+        log_start = generation;
+        return;
+    }
+
+    changed_ids.push_back(id);
+    if (changed_ids.size() > MAX_LOGGED_CHANGES)
+    {
+        size_t dropped = changed_ids.size() / 2;
+        changed_ids.erase(changed_ids.begin(), changed_ids.begin() + dropped);
+        log_start += dropped;
+        for (auto it = entries.begin(); it != entries.end();)
+        {
+            auto entry = it++;
+            if (entry->generation < log_start)
+            {
+                erase(entry);
+            }
+        }
+    }
+}
+
+void QueryCache::products_replaced()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+    changed_ids.clear();
+    log_start = generation;
+    entries.clear();
+    by_key.clear();
+    bytes = 0;
+}
+
+void QueryCache::set_max_bytes(size_t max_bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->max_bytes = max_bytes;
+    evict();
+}
+
+bool QueryCache::is_enabled() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return max_bytes > 0;
+}
+
+QueryCacheStats QueryCache::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    QueryCacheStats current = stats;
+    current.entries = entries.size();
+    current.bytes = bytes;
+    current.max_bytes = max_bytes;
+    return current;
+}
+
+size_t QueryCache::get_heap_bytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t buckets = by_key.bucket_count() > 1 ? by_key.bucket_count() : 0;
+    return bytes + heap_bytes(changed_ids) + heap_block_size(buckets * sizeof(void *));
+}
+
+size_t QueryCache::entry_bytes(const Entry &entry)
+{
+    // The key is held twice, by the entry and by the key table; the ID list shares a block with its count
+    return heap_block_size(2 * sizeof(void *) + sizeof(Entry)) + 2 * heap_bytes(entry.key) +
+           heap_block_size(2 * sizeof(long) + sizeof(std::vector<int>)) + heap_bytes(*entry.ids) +
+           heap_block_size(sizeof(void *) + sizeof(std::pair<const std::string, std::list<Entry>::iterator>));
+}
+
+void QueryCache::erase(std::list<Entry>::iterator entry)
+{
+    bytes -= entry->bytes;
+    by_key.erase(entry->key);
+    entries.erase(entry);
+}
+
+void QueryCache::evict()
+{
+    while (bytes > max_bytes && !entries.empty())
+    {
+        erase(std::prev(entries.end()));
+        stats.evictions++;
+    }
+}
@@ -0,0 +1,384 @@
+#include "includes/sharded_store.h"
+#include "includes/inventory_manager.h"
+#include "includes/csv_codec.h"
+#include "includes/memory_accounting.h"
+#include "includes/task_executor.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+namespace fs = std::filesystem;
+
+const char *const ShardedStore::MANIFEST_FILE = "inventory.manifest";
+
+namespace
+{
+    const char *const MANIFEST_MAGIC = "inventory-shards";
+    const int MANIFEST_VERSION = 1;
+
+    /**
+     * Run task(0) .. task(count - 1) on the shared executor.
+     * The first exception thrown by any task is rethrown once the others finish.
+     */
+    void run_parallel(size_t count, const std::function<void(size_t)> &task)
+    {
+        TaskExecutor::get_shared()->parallel_for(0, count, 1, [&task](size_t begin, size_t end)
+                                                 {
+                                                     for (size_t index = begin; index < end; index++)
+                                                     {
+                                                         task(index);
+                                                     }
+                                                 });
+    }
+
+    uint64_t fnv1a_hash(const std::string &text)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (char c : text)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+}
+
+ShardedStore::ShardedStore() : scheme(ShardScheme::BY_CATEGORY), id_range_size(0) {}
+
+bool ShardedStore::is_sharded_directory(const std::string &path)
+{
+    std::error_code error;
+    return fs::is_directory(path, error) && fs::is_regular_file(fs::path(path) / MANIFEST_FILE, error);
+}
+
+std::string ShardedStore::shard_key(const Product &product, ShardScheme scheme, int id_range_size)
+{
+    if (scheme == ShardScheme::BY_CATEGORY)
+    {
+        return product.get_category();
+    }
+    return std::to_string(product.get_id() / id_range_size * id_range_size);
+}
+
+std::string ShardedStore::shard_file_name(const std::string &key, ShardScheme scheme)
+{
+    if (scheme == ShardScheme::BY_ID_RANGE)
+    {
+        return "ids-" + key + ".csv";
+    }
+
+    // Category names may contain anything, so name the file after a hash
+    char hash[17];
+    std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(fnv1a_hash(key)));
+    return std::string("category-") + hash + ".csv";
+}
+
+ShardedStore::Manifest ShardedStore::read_manifest(const std::string &directory)
+{
+    std::string filename = (fs::path(directory) / MANIFEST_FILE).string();
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        throw FileOperationException("open", filename);
+    }
+
+    Manifest manifest;
+    manifest.scheme = ShardScheme::BY_CATEGORY;
+    manifest.id_range_size = 0;
+    manifest.next_product_id = 1;
+
+    std::string line;
+    std::getline(file, line);
+    std::vector<std::string> header = split_csv_line(line);
+    if (header.size() < 2 || header[0] != MANIFEST_MAGIC || header[1] != std::to_string(MANIFEST_VERSION))
+    {
+        throw FileOperationException("read manifest", filename);
+    }
+
+    try
+    {
+        while (std::getline(file, line))
+        {
+            std::vector<std::string> fields = split_csv_line(line);
+            if (fields[0] == "scheme" && fields.size() >= 3)
+            {
+                manifest.scheme = fields[1] == "id_range" ? ShardScheme::BY_ID_RANGE : ShardScheme::BY_CATEGORY;
+                manifest.id_range_size = std::stoi(fields[2]);
+            }
+            else if (fields[0] == "next_id" && fields.size() >= 2)
+            {
+                manifest.next_product_id = std::stoi(fields[1]);
+            }
+            else if (fields[0] == "shard" && fields.size() >= 4)
+            {
+                ShardEntry entry;
+                entry.file = fields[2];
+                entry.rows = std::stoul(fields[3]);
+                manifest.shards[fields[1]] = entry;
+            }
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        throw FileOperationException("read manifest", filename);
+    }
+
+    if (manifest.scheme == ShardScheme::BY_ID_RANGE && manifest.id_range_size <= 0)
+    {
+        throw FileOperationException("read manifest", filename);
+    }
+    return manifest;
+}
+
+void ShardedStore::write_manifest(const std::string &directory, const Manifest &manifest)
+{
+    auto write_entries = [&manifest](std::ostream &out)
+    {
+        out << MANIFEST_MAGIC << "," << MANIFEST_VERSION << "\n";
+        out << "scheme," << (manifest.scheme == ShardScheme::BY_ID_RANGE ? "id_range" : "category")
+            << "," << manifest.id_range_size << "\n";
+        out << "next_id," << manifest.next_product_id << "\n";
+        for (const auto &shard : manifest.shards)
+        {
+            out << "shard," << csv_quote(shard.first) << "," << csv_quote(shard.second.file) << ","
+                << shard.second.rows << "\n";
+        }
+    };
+    write_file_atomically((fs::path(directory) / MANIFEST_FILE).string(), write_entries);
+}
+
+std::vector<std::string> ShardedStore::shard_paths(const std::string &directory)
+{
+    std::vector<std::string> paths;
+    for (const auto &shard : read_manifest(directory).shards)
+    {
+        paths.push_back((fs::path(directory) / shard.second.file).string());
+    }
+    return paths;
+}
+
+std::vector<Product> ShardedStore::load(const std::string &directory, int &next_product_id)
+{
+    Manifest manifest = read_manifest(directory);
+
+    std::vector<const std::pair<const std::string, ShardEntry> *> entries;
+    for (const auto &shard : manifest.shards)
+    {
+        entries.push_back(&shard);
+    }
+
+    std::vector<std::vector<Product>> loaded(entries.size());
+    auto load_shard = [&](size_t index)
+    {
+        std::string filename = (fs::path(directory) / entries[index]->second.file).string();
+        std::vector<Product> &shard_products = loaded[index];
+        shard_products.reserve(entries[index]->second.rows);
+        read_product_csv_file_lazily(filename, [&shard_products](Product &product)
+                                     { shard_products.push_back(std::move(product)); });
+    };
+    run_parallel(entries.size(), load_shard);
+
+    size_t total = 0;
+    for (const auto &shard_products : loaded)
+    {
+        total += shard_products.size();
+    }
+
+    std::vector<Product> products;
+    products.reserve(total);
+    next_product_id = manifest.next_product_id;
+    for (auto &shard_products : loaded)
+    {
+        for (auto &product : shard_products)
+        {
+            next_product_id = std::max(next_product_id, product.get_id() + 1);
+            products.push_back(std::move(product));
+        }
+    }
+
+    this->directory = directory;
+    scheme = manifest.scheme;
+    id_range_size = manifest.id_range_size;
+    shards = manifest.shards;
+    dirty_shards.clear();
+    return products;
+}
+
+void ShardedStore::save(const std::string &directory, const std::vector<Product> &products, int next_product_id)
+{
+    if (!this->directory.empty() && directory == this->directory)
+    {
+        save(directory, scheme, id_range_size, products, next_product_id);
+    }
+    else if (is_sharded_directory(directory))
+    {
+        Manifest existing = read_manifest(directory);
+        save(directory, existing.scheme, existing.id_range_size, products, next_product_id);
+    }
+    else
+    {
+        save(directory, ShardScheme::BY_CATEGORY, 0, products, next_product_id);
+    }
+}
+
+void ShardedStore::save(const std::string &directory, ShardScheme scheme, int id_range_size,
+                        const std::vector<Product> &products, int next_product_id)
+{
+    if (scheme == ShardScheme::BY_ID_RANGE && id_range_size <= 0)
+    {
+        throw InventoryException("ID range shard size must be greater than zero");
+    }
+    if (scheme == ShardScheme::BY_CATEGORY)
+    {
+        id_range_size = 0;
+    }
+
+    std::error_code error;
+    fs::create_directories(directory, error);
+    if (error)
+    {
+        throw FileOperationException("create directory", directory);
+    }
+
+    bool incremental = !this->directory.empty() && directory == this->directory && scheme == this->scheme &&
+                       id_range_size == this->id_range_size;
+
+    // Shard files listed by a previous manifest, so unused ones can be removed
+    std::map<std::string, ShardEntry> previous_shards;
+    if (incremental)
+    {
+        previous_shards = shards;
+    }
+    else if (is_sharded_directory(directory))
+    {
+        previous_shards = read_manifest(directory).shards;
+    }
+
+    // Group the products of every shard that needs writing, preserving ID order
+    std::map<std::string, std::vector<const Product *>> groups;
+    if (incremental)
+    {
+        for (const auto &key : dirty_shards)
+        {
+            groups[key];
+        }
+    }
+    for (const auto &product : products)
+    {
+        std::string key = shard_key(product, scheme, id_range_size);
+        if (!incremental || dirty_shards.count(key))
+        {
+            groups[key].push_back(&product);
+        }
+    }
+
+    std::vector<const std::pair<const std::string, std::vector<const Product *>> *> pending;
+    for (const auto &group : groups)
+    {
+        if (!group.second.empty())
+        {
+            pending.push_back(&group);
+        }
+    }
+
+    auto save_shard = [&](size_t index)
+    {
+        const std::vector<const Product *> &shard_products = pending[index]->second;
+        auto write_rows = [&shard_products](std::ostream &out)
+        {
+            out << PRODUCT_CSV_HEADER << "\n";
+            for (const Product *product : shard_products)
+            {
+                write_product_csv_row(out, *product);
+            }
+        };
+        write_file_atomically((fs::path(directory) / shard_file_name(pending[index]->first, scheme)).string(), write_rows);
+    };
+    run_parallel(pending.size(), save_shard);
+
+    Manifest manifest;
+    manifest.scheme = scheme;
+    manifest.id_range_size = id_range_size;
+    manifest.next_product_id = next_product_id;
+    if (incremental)
+    {
+        manifest.shards = shards;
+    }
+    for (const auto &group : groups)
+    {
+        if (group.second.empty())
+        {
+            manifest.shards.erase(group.first);
+        }
+        else
+        {
+            ShardEntry entry;
+            entry.file = shard_file_name(group.first, scheme);
+            entry.rows = group.second.size();
+            manifest.shards[group.first] = entry;
+        }
+    }
+    write_manifest(directory, manifest);
+
+    // Only delete old shard files once the new manifest no longer refers to them
+    std::unordered_set<std::string> live_files;
+    for (const auto &shard : manifest.shards)
+    {
+        live_files.insert(shard.second.file);
+    }
+    for (const auto &shard : previous_shards)
+    {
+        if (!live_files.count(shard.second.file))
+        {
+            fs::remove(fs::path(directory) / shard.second.file, error);
+        }
+    }
+
+    this->directory = directory;
+    this->scheme = scheme;
+    this->id_range_size = id_range_size;
+    shards = manifest.shards;
+    dirty_shards.clear();
+}
+
+void ShardedStore::mark_dirty(const Product &product)
+{
+    if (!directory.empty())
+    {
+        dirty_shards.insert(shard_key(product, scheme, id_range_size));
+    }
+}
+
+void ShardedStore::unbind()
+{
+    directory.clear();
+    shards.clear();
+    dirty_shards.clear();
+}
+
+const std::string &ShardedStore::get_directory() const
+{
+    return directory;
+}
+
+size_t ShardedStore::get_dirty_shard_count() const
+{
+    return dirty_shards.size();
+}
+
+size_t ShardedStore::get_memory_usage() const
+{
+    size_t bytes = heap_bytes(directory) + tree_heap_bytes(shards) + hash_table_heap_bytes(dirty_shards);
+    for (const auto &shard : shards)
+    {
+        bytes += heap_bytes(shard.first) + heap_bytes(shard.second.file);
+    }
+    for (const auto &key : dirty_shards)
+    {
+        bytes += heap_bytes(key);
+    }
+    return bytes;
+}
@@ -0,0 +1,346 @@
+#include "includes/sku_index.h"
+#include "includes/memory_accounting.h"
+#include <algorithm>
+#include <functional>
+
+const uint32_t SkuIndex::EMPTY_ROW;
+
+namespace
+{
+    // Average SKUs per bucket; fewer spends more pilots, more makes pilots slower to find
+    const uint64_t BUCKET_SIZE = 4;
+
+    // Share of the position range the SKUs fill; the last SKUs placed still find a free position quickly
+    const double LOAD_FACTOR = 0.97;
+
+    // Pilots tried before a bucket's SKUs are left to the overflow map instead; never reached in practice
+    const uint32_t MAX_PILOT = 1u << 24;
+
+    // Overflow entries allowed before a rebuild, beside a quarter of the table
+    const size_t MIN_OVERFLOW = 1024;
+
+    uint64_t mix(uint64_t value)
+    {
+        // splitmix64 finalizer
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+
+    // Map a 64-bit value onto [0, range) without a division
+    uint64_t reduce(uint64_t value, uint64_t range)
+    {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(value) * range) >> 64);
+    }
+
+    uint64_t position(uint64_t key_hash, uint32_t pilot, uint64_t range)
+    {
+        return reduce(mix(key_hash ^ mix(pilot + 0x9E3779B97F4A7C15ULL)), range);
+    }
+
+    size_t bucket_of(uint64_t key_hash, size_t bucket_count)
+    {
+        return static_cast<size_t>(reduce(key_hash, bucket_count));
+    }
+}
+
+SkuIndex::SkuIndex() : position_range(0) {}
+
+uint64_t SkuIndex::hash(std::string_view sku)
+{
+    // The standard hash is not mixed well enough in every library for bucket and slot bits
+    return mix(std::hash<std::string_view>()(sku));
+}
+
+size_t SkuIndex::slot_of(uint64_t key_hash) const
+{
+    uint64_t at = position(key_hash, pilots[bucket_of(key_hash, pilots.size())], position_range);
+    return at < slots.size() ? static_cast<size_t>(at) : remap[at - slots.size()];
+}
+
+void SkuIndex::build(const std::vector<Product> &products)
+{
+    pilots.clear();
+    slots.clear();
+    remap.clear();
+    overflow.clear();
+    shadowed.clear();
+    position_range = 0;
+
+    struct Key
+    {
+        uint64_t hash;
+        uint32_t row;
+    };
+    std::vector<Key> keys;
+    for (size_t row = 0; row < products.size(); row++)
+    {
+        if (!products[row].sku.empty())
+        {
+            keys.push_back({hash(products[row].sku), static_cast<uint32_t>(row)});
+        }
+    }
+
+    // Equal hashes would never separate. The first of a repeated SKU is kept and the rest wait;
+    // a different SKU with the same 64-bit hash goes to the overflow map.
+    std::sort(keys.begin(), keys.end(), [](const Key &a, const Key &b)
+              { return a.hash != b.hash ? a.hash < b.hash : a.row < b.row; });
+    size_t kept = 0;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (kept > 0 && keys[kept - 1].hash == keys[i].hash)
+        {
+            const std::string &sku = products[keys[i].row].sku;
+            if (sku == products[keys[kept - 1].row].sku || !overflow.emplace(sku, keys[i].row).second)
+            {
+                shadowed.emplace(sku, keys[i].row);
+            }
+            continue;
+        }
+        keys[kept++] = keys[i];
+    }
+    keys.resize(kept);
+    if (keys.empty())
+    {
+        return;
+    }
+
+    size_t key_count = keys.size();
+    size_t bucket_count = (key_count + BUCKET_SIZE - 1) / BUCKET_SIZE;
+    position_range = std::max<uint64_t>(key_count, static_cast<uint64_t>(key_count / LOAD_FACTOR));
+
+    // Group the keys by bucket, then place the largest buckets first, while most positions are free
+    std::vector<uint32_t> bucket_start(bucket_count + 1, 0);
+    for (const Key &key : keys)
+    {
+        bucket_start[bucket_of(key.hash, bucket_count) + 1]++;
+    }
+    for (size_t bucket = 0; bucket < bucket_count; bucket++)
+    {
+        bucket_start[bucket + 1] += bucket_start[bucket];
+    }
+    std::vector<Key> grouped(key_count);
+    std::vector<uint32_t> fill(bucket_start.begin(), bucket_start.end() - 1);
+    for (const Key &key : keys)
+    {
+        grouped[fill[bucket_of(key.hash, bucket_count)]++] = key;
+    }
+
+    std::vector<uint32_t> order(bucket_count);
+    for (size_t bucket = 0; bucket < bucket_count; bucket++)
+    {
+        order[bucket] = static_cast<uint32_t>(bucket);
+    }
+    std::stable_sort(order.begin(), order.end(), [&bucket_start](uint32_t a, uint32_t b)
+                     { return bucket_start[a + 1] - bucket_start[a] > bucket_start[b + 1] - bucket_start[b]; });
+
+    pilots.assign(bucket_count, 0);
+    std::vector<uint32_t> owner(position_range, EMPTY_ROW); // Row placed at each position
+    std::vector<uint64_t> tried;
+    for (uint32_t bucket : order)
+    {
+        size_t begin = bucket_start[bucket], end = bucket_start[bucket + 1];
+        if (begin == end)
+        {
+            continue;
+        }
+
+        uint32_t pilot = 0;
+        for (; pilot < MAX_PILOT; pilot++)
+        {
+            tried.clear();
+            bool free = true;
+            for (size_t i = begin; i < end && free; i++)
+            {
+                uint64_t at = position(grouped[i].hash, pilot, position_range);
+                free = owner[at] == EMPTY_ROW && std::find(tried.begin(), tried.end(), at) == tried.end();
+                tried.push_back(at);
+            }
+            if (free)
+            {
+                break;
+            }
+        }
+
+        if (pilot == MAX_PILOT)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                overflow.emplace(products[grouped[i].row].sku, grouped[i].row);
+            }
+            continue;
+        }
+        pilots[bucket] = pilot;
+        for (size_t i = begin; i < end; i++)
+        {
+            owner[position(grouped[i].hash, pilot, position_range)] = grouped[i].row;
+        }
+    }
+
+    // Positions past the table end are remapped into the free slots below it, keeping the table minimal
+    slots.resize(key_count);
+    for (size_t at = 0; at < key_count; at++)
+    {
+        slots[at].row = owner[at];
+        slots[at].fingerprint = owner[at] == EMPTY_ROW ? 0 : static_cast<uint32_t>(hash(products[owner[at]].sku));
+    }
+    size_t free_slot = 0;
+    remap.assign(position_range - key_count, 0);
+    for (uint64_t at = key_count; at < position_range; at++)
+    {
+        if (owner[at] == EMPTY_ROW)
+        {
+            continue;
+        }
+        while (slots[free_slot].row != EMPTY_ROW)
+        {
+            free_slot++;
+        }
+        remap[at - key_count] = static_cast<uint32_t>(free_slot);
+        slots[free_slot].row = owner[at];
+        slots[free_slot].fingerprint = static_cast<uint32_t>(hash(products[owner[at]].sku));
+    }
+}
+
+size_t SkuIndex::find(std::string_view sku, const std::vector<Product> &products) const
+{
+    if (sku.empty())
+    {
+        return NOT_FOUND;
+    }
+
+    if (!slots.empty())
+    {
+        uint64_t key_hash = hash(sku);
+        const Slot &slot = slots[slot_of(key_hash)];
+        if (slot.fingerprint == static_cast<uint32_t>(key_hash) && slot.row != EMPTY_ROW &&
+            products[slot.row].sku == sku)
+        {
+            return slot.row;
+        }
+    }
+
+    if (overflow.empty())
+    {
+        return NOT_FOUND;
+    }
+    auto found = overflow.find(std::string(sku));
+    return found == overflow.end() ? NOT_FOUND : found->second;
+}
+
+void SkuIndex::add(size_t row, const std::vector<Product> &products)
+{
+    const std::string &sku = products[row].sku;
+    if (sku.empty())
+    {
+        return;
+    }
+    if (find(sku, products) != NOT_FOUND)
+    {
+        shadowed.emplace(sku, row);
+        return;
+    }
+
+    overflow.emplace(sku, row);
+    if (overflow.size() > std::max(MIN_OVERFLOW, slots.size() / 4))
+    {
+        build(products);
+    }
+}
+
+void SkuIndex::remove(size_t row, const std::string &sku)
+{
+    if (sku.empty())
+    {
+        return;
+    }
+
+    if (!slots.empty())
+    {
+        uint64_t key_hash = hash(sku);
+        Slot &slot = slots[slot_of(key_hash)];
+        if (slot.row == row && slot.fingerprint == static_cast<uint32_t>(key_hash))
+        {
+            slot.row = EMPTY_ROW;
+            promote_shadowed(sku);
+            return;
+        }
+    }
+
+    auto found = overflow.find(sku);
+    if (found != overflow.end() && found->second == row)
+    {
+        overflow.erase(found);
+        promote_shadowed(sku);
+        return;
+    }
+
+    auto waiting = shadowed.equal_range(sku);
+    for (auto it = waiting.first; it != waiting.second; ++it)
+    {
+        if (it->second == row)
+        {
+            shadowed.erase(it);
+            return;
+        }
+    }
+}
+
+void SkuIndex::promote_shadowed(const std::string &sku)
+{
+    if (shadowed.empty())
+    {
+        return;
+    }
+
+    auto waiting = shadowed.equal_range(sku);
+    if (waiting.first == waiting.second)
+    {
+        return;
+    }
+    auto lowest = std::min_element(waiting.first, waiting.second, [](const auto &a, const auto &b)
+                                   { return a.second < b.second; });
+    overflow.emplace(sku, lowest->second);
+    shadowed.erase(lowest);
+}
+
+void SkuIndex::shift_rows(size_t first, int offset)
+{
+    // A pass over every slot, but a sequential one; removals already move every later product
+    for (Slot &slot : slots)
+    {
+        if (slot.row != EMPTY_ROW && slot.row >= first)
+        {
+            slot.row += offset;
+        }
+    }
+    for (auto &entry : overflow)
+    {
+        if (entry.second >= first)
+        {
+            entry.second += offset;
+        }
+    }
+    for (auto &entry : shadowed)
+    {
+        if (entry.second >= first)
+        {
+            entry.second += offset;
+        }
+    }
+}
+
+size_t SkuIndex::get_heap_bytes() const
+{
+    size_t bytes = heap_bytes(pilots) + heap_bytes(slots) + heap_bytes(remap) + hash_table_heap_bytes(overflow) +
+                   hash_table_heap_bytes(shadowed);
+    for (const auto &entry : overflow)
+    {
+        bytes += heap_bytes(entry.first);
+    }
+    for (const auto &entry : shadowed)
+    {
+        bytes += heap_bytes(entry.first);
+    }
+    return bytes;
+}
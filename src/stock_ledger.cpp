@@ -0,0 +1,786 @@
+#include "includes/stock_ledger.h"
+#include "includes/csv_codec.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+static_assert(MOVEMENT_REASON_COUNT <= 4, "Reasons are stored in two bits");
+
+const int64_t StockLedger::MAX_TIMESTAMP;
+
+namespace
+{
+    const char FILE_MAGIC[] = "INVLDG";
+    const uint64_t FORMAT_VERSION = 1;
+
+    const char *const REASON_NAMES[MOVEMENT_REASON_COUNT] = {"received", "sold", "returned", "adjusted"};
+
+    /**
+     * Thrown internally when a saved ledger ends early or is inconsistent.
+     */
+    struct CorruptData
+    {
+    };
+
+    void put_varint(std::vector<uint8_t> &out, uint64_t value)
+    {
+        // Columns grow by a quarter rather than doubling: they are most of the
+        // ledger's memory, and appends are cheap next to the lookups around them
+        if (out.capacity() - out.size() < 10)
+        {
+            out.reserve(out.size() + out.size() / 4 + 16);
+        }
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void put_varint(std::string &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    // For columns this ledger wrote itself, so never past the end
+    uint64_t take_varint(const uint8_t *&in)
+    {
+        uint64_t value = 0;
+        int shift = 0;
+        while (*in & 0x80)
+        {
+            value |= static_cast<uint64_t>(*in++ & 0x7F) << shift;
+            shift += 7;
+        }
+        return value | static_cast<uint64_t>(*in++) << shift;
+    }
+
+    uint64_t zigzag(int64_t value)
+    {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value)
+    {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    MovementReason reason_at(const std::vector<uint8_t> &reasons, size_t index)
+    {
+        return static_cast<MovementReason>((reasons[index >> 2] >> ((index & 3) * 2)) & 3);
+    }
+
+    /**
+     * Sequential reader over a saved ledger that throws CorruptData on overrun.
+     */
+    class LedgerReader
+    {
+    public:
+        LedgerReader(const std::string &buffer) : data(buffer), pos(0) {}
+
+        uint64_t varint()
+        {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                if (pos >= data.size())
+                {
+                    throw CorruptData();
+                }
+                unsigned char byte = static_cast<unsigned char>(data[pos++]);
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                {
+                    return value;
+                }
+            }
+            throw CorruptData();
+        }
+
+        std::string bytes(uint64_t count)
+        {
+            if (count > data.size() - pos)
+            {
+                throw CorruptData();
+            }
+            std::string result = data.substr(pos, count);
+            pos += count;
+            return result;
+        }
+
+        bool at_end() const
+        {
+            return pos == data.size();
+        }
+
+    private:
+        const std::string &data;
+        size_t pos;
+    };
+
+    // Days since 1970-01-01 of a proleptic Gregorian date
+    int64_t days_from_civil(int64_t year, unsigned month, unsigned day)
+    {
+        year -= month <= 2;
+        int64_t era = (year >= 0 ? year : year - 399) / 400;
+        unsigned year_of_era = static_cast<unsigned>(year - era * 400);
+        unsigned day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+        return era * 146097 + static_cast<int64_t>(day_of_era) - 719468;
+    }
+
+    unsigned days_in_month(int64_t year, unsigned month)
+    {
+        static const unsigned DAYS[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        return month == 2 && leap ? 29 : DAYS[month - 1];
+    }
+
+    // Parse a fixed-width run of digits
+    bool parse_digits(const std::string &text, size_t start, size_t count, unsigned &value)
+    {
+        value = 0;
+        for (size_t i = start; i < start + count; i++)
+        {
+            if (text[i] < '0' || text[i] > '9')
+            {
+                return false;
+            }
+            value = value * 10 + static_cast<unsigned>(text[i] - '0');
+        }
+        return true;
+    }
+
+    bool parse_int64(const std::string &text, int64_t &value)
+    {
+        const char *end = text.data() + text.size();
+        auto result = std::from_chars(text.data(), end, value);
+        return result.ec == std::errc() && result.ptr == end && !text.empty();
+    }
+}
+
+const char *movement_reason_name(MovementReason reason)
+{
+    return REASON_NAMES[static_cast<size_t>(reason)];
+}
+
+bool parse_movement_reason(const std::string &name, MovementReason &reason)
+{
+    for (size_t i = 0; i < MOVEMENT_REASON_COUNT; i++)
+    {
+        if (name == REASON_NAMES[i])
+        {
+            reason = static_cast<MovementReason>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_timestamp(const std::string &text, int64_t &timestamp)
+{
+    if (parse_int64(text, timestamp))
+    {
+        return true;
+    }
+
+    // YYYY-MM-DD, then optionally THH:MM:SS and Z
+    size_t length = text.size();
+    if (length != 10 && length != 19 && !(length == 20 && text[19] == 'Z'))
+    {
+        return false;
+    }
+
+    unsigned year, month, day, hour = 0, minute = 0, second = 0;
+    if (!parse_digits(text, 0, 4, year) || text[4] != '-' || !parse_digits(text, 5, 2, month) || text[7] != '-' ||
+        !parse_digits(text, 8, 2, day))
+    {
+        return false;
+    }
+    if (length > 10 && (text[10] != 'T' || !parse_digits(text, 11, 2, hour) || text[13] != ':' ||
+                        !parse_digits(text, 14, 2, minute) || text[16] != ':' || !parse_digits(text, 17, 2, second)))
+    {
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > days_in_month(year, month) || hour > 23 || minute > 59 ||
+        second > 59)
+    {
+        return false;
+    }
+
+    timestamp = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+std::string format_timestamp(int64_t timestamp)
+{
+    int64_t days = timestamp >= 0 ? timestamp / 86400 : (timestamp - 86399) / 86400;
+    int64_t seconds = timestamp - days * 86400;
+
+    // Inverse of days_from_civil
+    int64_t z = days + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned day_of_era = static_cast<unsigned>(z - era * 146097);
+    unsigned year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    unsigned day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    unsigned month_index = (5 * day_of_year + 2) / 153;
+    unsigned day = day_of_year - (153 * month_index + 2) / 5 + 1;
+    unsigned month = month_index < 10 ? month_index + 3 : month_index - 9;
+    int64_t year = static_cast<int64_t>(year_of_era) + era * 400 + (month <= 2);
+
+    char buffer[40];
+    std::snprintf(buffer, sizeof(buffer), "%04lld-%02u-%02uT%02d:%02d:%02dZ", static_cast<long long>(year), month,
+                  day, static_cast<int>(seconds / 3600), static_cast<int>(seconds / 60 % 60),
+                  static_cast<int>(seconds % 60));
+    return buffer;
+}
+
+int64_t MovementTotals::net() const
+{
+    int64_t sum = 0;
+    for (int64_t reason_units : units)
+    {
+        sum += reason_units;
+    }
+    return sum;
+}
+
+void MovementTotals::add(const MovementTotals &other)
+{
+    for (size_t i = 0; i < MOVEMENT_REASON_COUNT; i++)
+    {
+        units[i] += other.units[i];
+    }
+    movements += other.movements;
+}
+
+void MovementTotals::subtract(const MovementTotals &other)
+{
+    for (size_t i = 0; i < MOVEMENT_REASON_COUNT; i++)
+    {
+        units[i] -= other.units[i];
+    }
+    movements -= other.movements;
+}
+
+StockLedger::StockLedger(int64_t bucket_seconds)
+    : bucket_seconds(bucket_seconds), movement_count(0), first_bucket(0), buckets(1)
+{
+    if (bucket_seconds <= 0)
+    {
+        throw InventoryException("Bucket width must be positive");
+    }
+}
+
+void StockLedger::record(int product_id, int64_t timestamp, int64_t delta, MovementReason reason)
+{
+    if (timestamp < 0 || timestamp >= MAX_TIMESTAMP)
+    {
+        throw InventoryException("Movement time out of range: " + std::to_string(timestamp));
+    }
+
+    Series &product = series[product_id];
+    uint64_t index = product.totals.movements;
+    if (index > 0 && timestamp < product.last_timestamp)
+    {
+        throw InventoryException("Movement for product " + std::to_string(product_id) +
+                                 " is earlier than its last one");
+    }
+    if (product.times.size() > UINT32_MAX - 10 || product.deltas.size() > UINT32_MAX - 10)
+    {
+        throw InventoryException("Too many movements for product " + std::to_string(product_id));
+    }
+
+    if (index % BLOCK_MOVEMENTS == 0)
+    {
+        Block block;
+        block.first_timestamp = timestamp;
+        block.time_offset = static_cast<uint32_t>(product.times.size());
+        block.delta_offset = static_cast<uint32_t>(product.deltas.size());
+        block.before = product.totals;
+        product.blocks.push_back(block);
+    }
+
+    put_varint(product.times, static_cast<uint64_t>(timestamp - (index > 0 ? product.last_timestamp : 0)));
+    put_varint(product.deltas, zigzag(delta));
+    if (index % 4 == 0)
+    {
+        if (product.reasons.size() == product.reasons.capacity())
+        {
+            product.reasons.reserve(product.reasons.size() + product.reasons.size() / 4 + 4);
+        }
+        product.reasons.push_back(0);
+    }
+    product.reasons.back() |= static_cast<uint8_t>(static_cast<unsigned>(reason) << ((index & 3) * 2));
+
+    product.last_timestamp = timestamp;
+    product.totals.add(reason, delta);
+    movement_count++;
+    add_to_bucket(timestamp, delta, reason);
+}
+
+MovementTotals StockLedger::totals_before(const Series &product, int64_t timestamp)
+{
+    // Blocks starting at or after the time hold only movements at or after it
+    auto after = std::lower_bound(product.blocks.begin(), product.blocks.end(), timestamp,
+                                  [](const Block &block, int64_t time)
+                                  { return block.first_timestamp < time; });
+    if (after == product.blocks.begin())
+    {
+        return MovementTotals();
+    }
+
+    const Block &block = *(after - 1);
+    size_t index = static_cast<size_t>(after - 1 - product.blocks.begin()) * BLOCK_MOVEMENTS;
+    size_t end = std::min<size_t>(index + BLOCK_MOVEMENTS, product.totals.movements);
+    const uint8_t *time = product.times.data() + block.time_offset;
+    const uint8_t *delta = product.deltas.data() + block.delta_offset;
+
+    MovementTotals totals = block.before;
+    int64_t current = block.first_timestamp;
+    take_varint(time); // The first gap is already in first_timestamp
+    for (; index < end; index++)
+    {
+        if (current >= timestamp)
+        {
+            break;
+        }
+        totals.add(reason_at(product.reasons, index), unzigzag(take_varint(delta)));
+        if (index + 1 < end)
+        {
+            current += static_cast<int64_t>(take_varint(time));
+        }
+    }
+    return totals;
+}
+
+int64_t StockLedger::get_level(int product_id) const
+{
+    auto found = series.find(product_id);
+    return found == series.end() ? 0 : found->second.totals.net();
+}
+
+int64_t StockLedger::level_at(int product_id, int64_t timestamp) const
+{
+    auto found = series.find(product_id);
+    if (found == series.end())
+    {
+        return 0;
+    }
+    return totals_before(found->second, std::min(timestamp, MAX_TIMESTAMP) + 1).net();
+}
+
+MovementTotals StockLedger::window(int product_id, int64_t from, int64_t to) const
+{
+    auto found = series.find(product_id);
+    if (found == series.end() || from >= to)
+    {
+        return MovementTotals();
+    }
+
+    MovementTotals totals = totals_before(found->second, to);
+    totals.subtract(totals_before(found->second, from));
+    return totals;
+}
+
+std::vector<StockMovement> StockLedger::get_movements(int product_id, int64_t from, int64_t to) const
+{
+    std::vector<StockMovement> movements;
+    auto found = series.find(product_id);
+    if (found == series.end() || from >= to)
+    {
+        return movements;
+    }
+
+    // Start from the last block that begins before the window
+    const Series &product = found->second;
+    auto after = std::lower_bound(product.blocks.begin(), product.blocks.end(), from,
+                                  [](const Block &block, int64_t time)
+                                  { return block.first_timestamp < time; });
+    size_t first_block = after == product.blocks.begin() ? 0 : static_cast<size_t>(after - product.blocks.begin()) - 1;
+
+    for (size_t b = first_block; b < product.blocks.size(); b++)
+    {
+        const Block &block = product.blocks[b];
+        if (block.first_timestamp >= to)
+        {
+            break;
+        }
+
+        size_t index = b * BLOCK_MOVEMENTS;
+        size_t end = std::min<size_t>(index + BLOCK_MOVEMENTS, product.totals.movements);
+        const uint8_t *time = product.times.data() + block.time_offset;
+        const uint8_t *delta = product.deltas.data() + block.delta_offset;
+        int64_t current = block.first_timestamp;
+        take_varint(time);
+        for (; index < end; index++)
+        {
+            if (index > b * BLOCK_MOVEMENTS)
+            {
+                current += static_cast<int64_t>(take_varint(time));
+            }
+            int64_t units = unzigzag(take_varint(delta));
+            if (current >= to)
+            {
+                break;
+            }
+            if (current >= from)
+            {
+                movements.push_back({product_id, current, units, reason_at(product.reasons, index)});
+            }
+        }
+    }
+    return movements;
+}
+
+std::vector<int> StockLedger::get_product_ids() const
+{
+    std::vector<int> ids;
+    ids.reserve(series.size());
+    for (const auto &entry : series)
+    {
+        ids.push_back(entry.first);
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+uint64_t StockLedger::get_movement_count() const
+{
+    return movement_count;
+}
+
+int64_t StockLedger::get_bucket_seconds() const
+{
+    return bucket_seconds;
+}
+
+MovementTotals StockLedger::bucket_prefix(size_t count) const
+{
+    MovementTotals totals;
+    for (size_t i = count; i > 0; i -= i & (~i + 1))
+    {
+        totals.add(buckets[i]);
+    }
+    return totals;
+}
+
+void StockLedger::add_to_bucket(int64_t timestamp, int64_t delta, MovementReason reason)
+{
+    int64_t bucket = timestamp / bucket_seconds;
+    size_t size = buckets.size() - 1;
+    if (size == 0)
+    {
+        first_bucket = bucket;
+    }
+    else if (bucket < first_bucket)
+    {
+        // Rare, as movements mostly arrive in time order: unwind the tree to
+        // plain bucket totals, shift them up and build it again
+        for (size_t i = size; i > 0; i--)
+        {
+            size_t parent = i + (i & (~i + 1));
+            if (parent <= size)
+            {
+                buckets[parent].subtract(buckets[i]);
+            }
+        }
+        buckets.insert(buckets.begin() + 1, static_cast<size_t>(first_bucket - bucket), MovementTotals());
+        first_bucket = bucket;
+        size = buckets.size() - 1;
+        for (size_t i = 1; i <= size; i++)
+        {
+            size_t parent = i + (i & (~i + 1));
+            if (parent <= size)
+            {
+                buckets[parent].add(buckets[i]);
+            }
+        }
+    }
+
+    // Extend the tree to the bucket; each new node covers buckets that are
+    // already in the tree, plus its own empty one
+    size_t position = static_cast<size_t>(bucket - first_bucket) + 1;
+    while (buckets.size() <= position)
+    {
+        size_t i = buckets.size();
+        MovementTotals node = bucket_prefix(i - 1);
+        node.subtract(bucket_prefix(i - (i & (~i + 1))));
+        buckets.push_back(node);
+    }
+
+    for (size_t i = position; i < buckets.size(); i += i & (~i + 1))
+    {
+        buckets[i].add(reason, delta);
+    }
+}
+
+MovementTotals StockLedger::buckets_before(int64_t timestamp) const
+{
+    int64_t bucket = std::max<int64_t>(0, std::min(timestamp, MAX_TIMESTAMP)) / bucket_seconds;
+    int64_t count = std::min<int64_t>(bucket - first_bucket, static_cast<int64_t>(buckets.size()) - 1);
+    return count > 0 ? bucket_prefix(static_cast<size_t>(count)) : MovementTotals();
+}
+
+MovementTotals StockLedger::window_all(int64_t from, int64_t to) const
+{
+    if (from >= to)
+    {
+        return MovementTotals();
+    }
+    MovementTotals totals = buckets_before(to);
+    totals.subtract(buckets_before(from));
+    return totals;
+}
+
+std::vector<MemoryComponent> StockLedger::get_memory_usage() const
+{
+    size_t columns = 0, index = 0;
+    for (const auto &entry : series)
+    {
+        columns += heap_bytes(entry.second.times) + heap_bytes(entry.second.deltas) +
+                   heap_bytes(entry.second.reasons);
+        index += heap_bytes(entry.second.blocks);
+    }
+    return {
+        {"movement columns", columns},
+        {"block index", index},
+        {"product table", hash_table_heap_bytes(series)},
+        {"time buckets", heap_bytes(buckets)},
+    };
+}
+
+void StockLedger::save_to_file(const std::string &filename) const
+{
+    write_file_atomically(filename, [this](std::ostream &out)
+                          {
+                              std::string header(FILE_MAGIC, sizeof(FILE_MAGIC) - 1);
+                              put_varint(header, FORMAT_VERSION);
+                              put_varint(header, static_cast<uint64_t>(bucket_seconds));
+                              put_varint(header, series.size());
+                              out.write(header.data(), header.size());
+
+                              // The columns are written as they are held; blocks and buckets are rebuilt on load
+                              for (int id : get_product_ids())
+                              {
+                                  const Series &product = series.at(id);
+                                  std::string entry;
+                                  put_varint(entry, zigzag(id));
+                                  put_varint(entry, product.totals.movements);
+                                  for (const auto *column : {&product.times, &product.deltas, &product.reasons})
+                                  {
+                                      put_varint(entry, column->size());
+                                  }
+                                  out.write(entry.data(), entry.size());
+                                  for (const auto *column : {&product.times, &product.deltas, &product.reasons})
+                                  {
+                                      out.write(reinterpret_cast<const char *>(column->data()),
+                                                static_cast<std::streamsize>(column->size()));
+                                  }
+                              }
+                          });
+}
+
+void StockLedger::load_from_file(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw FileOperationException("open", filename);
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    try
+    {
+        LedgerReader in(data);
+        if (in.bytes(sizeof(FILE_MAGIC) - 1) != FILE_MAGIC || in.varint() != FORMAT_VERSION)
+        {
+            throw CorruptData();
+        }
+        uint64_t width = in.varint();
+        if (width == 0 || width > static_cast<uint64_t>(MAX_TIMESTAMP))
+        {
+            throw CorruptData();
+        }
+
+        // Rebuilt by recording every movement again, which checks the columns as it goes
+        StockLedger loaded(static_cast<int64_t>(width));
+        uint64_t product_count = in.varint();
+        for (uint64_t p = 0; p < product_count; p++)
+        {
+            int64_t id = unzigzag(in.varint());
+            uint64_t count = in.varint();
+            uint64_t sizes[3];
+            for (auto &size : sizes)
+            {
+                size = in.varint();
+            }
+            std::string times = in.bytes(sizes[0]);
+            std::string deltas = in.bytes(sizes[1]);
+            std::string reasons = in.bytes(sizes[2]);
+            if (id < INT32_MIN || id > INT32_MAX || count == 0 || loaded.series.count(static_cast<int>(id)) ||
+                reasons.size() != (count + 3) / 4)
+            {
+                throw CorruptData();
+            }
+
+            LedgerReader time_reader(times), delta_reader(deltas);
+            int64_t timestamp = 0;
+            for (uint64_t i = 0; i < count; i++)
+            {
+                uint64_t gap = time_reader.varint();
+                if (gap >= static_cast<uint64_t>(MAX_TIMESTAMP))
+                {
+                    throw CorruptData();
+                }
+                timestamp += static_cast<int64_t>(gap);
+                unsigned reason = (static_cast<unsigned char>(reasons[i >> 2]) >> ((i & 3) * 2)) & 3;
+                loaded.record(static_cast<int>(id), timestamp, unzigzag(delta_reader.varint()),
+                              static_cast<MovementReason>(reason));
+            }
+            if (!time_reader.at_end() || !delta_reader.at_end())
+            {
+                throw CorruptData();
+            }
+        }
+        if (!in.at_end())
+        {
+            throw CorruptData();
+        }
+        *this = std::move(loaded);
+    }
+    catch (const CorruptData &)
+    {
+        throw FileOperationException("read", filename);
+    }
+    catch (const InventoryException &)
+    {
+        // Out-of-range or out-of-order times in the columns
+        throw FileOperationException("read", filename);
+    }
+}
+
+bool StockLedger::is_ledger_file(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(FILE_MAGIC) - 1];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+size_t StockLedger::import_csv(std::istream &in)
+{
+    std::vector<StockMovement> movements;
+    std::vector<std::string> fields;
+    size_t line_number = 0;
+    for (std::string line; std::getline(in, line);)
+    {
+        line_number++;
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (line.empty())
+        {
+            continue;
+        }
+
+        split_csv_line(line, fields);
+        if (line_number == 1 && !fields.empty() && fields[0] == "ID")
+        {
+            continue;
+        }
+
+        StockMovement movement;
+        int64_t id = 0;
+        if (fields.size() != 4 || !parse_int64(fields[0], id) || id < INT32_MIN || id > INT32_MAX ||
+            !parse_timestamp(fields[1], movement.timestamp) || !parse_int64(fields[2], movement.delta) ||
+            !parse_movement_reason(fields[3], movement.reason))
+        {
+            throw InventoryException("Malformed movement on line " + std::to_string(line_number));
+        }
+        movement.product_id = static_cast<int>(id);
+        movements.push_back(movement);
+    }
+
+    std::stable_sort(movements.begin(), movements.end(), [](const StockMovement &a, const StockMovement &b)
+                     { return a.timestamp < b.timestamp; });
+    for (const auto &movement : movements)
+    {
+        record(movement.product_id, movement.timestamp, movement.delta, movement.reason);
+    }
+    return movements.size();
+}
+
+void StockLedger::export_csv(std::ostream &out) const
+{
+    out << "ID,Timestamp,Delta,Reason\n";
+    for (int id : get_product_ids())
+    {
+        for (const auto &movement : get_movements(id, 0, MAX_TIMESTAMP))
+        {
+            out << id << "," << format_timestamp(movement.timestamp) << "," << movement.delta << ","
+                << movement_reason_name(movement.reason) << "\n";
+        }
+    }
+}
+
+int64_t StockLedger::now()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+void StockLedger::product_changed(const Product *before, const Product *after)
+{
+    int64_t delta = (after ? after->get_quantity() : 0) - (before ? before->get_quantity() : 0);
+    if (delta == 0)
+    {
+        return;
+    }
+
+    int id = after ? after->get_id() : before->get_id();
+    auto found = series.find(id);
+    int64_t timestamp = std::max(now(), found == series.end() ? 0 : found->second.last_timestamp);
+    record(id, timestamp, delta, before ? MovementReason::ADJUSTED : MovementReason::RECEIVED);
+}
+
+void StockLedger::products_replaced(const std::vector<Product> &products)
+{
+    int64_t current = now();
+    auto adjust = [this, current](int id, int64_t delta)
+    {
+        if (delta != 0)
+        {
+            auto found = series.find(id);
+            record(id, std::max(current, found == series.end() ? 0 : found->second.last_timestamp), delta,
+                   MovementReason::ADJUSTED);
+        }
+    };
+
+    for (const auto &product : products)
+    {
+        adjust(product.get_id(), product.get_quantity() - get_level(product.get_id()));
+    }
+
+    // Products are in ID order, so the ones that are gone are found by binary search
+    for (int id : get_product_ids())
+    {
+        auto position = std::lower_bound(products.begin(), products.end(), id,
+                                         [](const Product &product, int value)
+                                         { return product.get_id() < value; });
+        if (position == products.end() || position->get_id() != id)
+        {
+            adjust(id, -get_level(id));
+        }
+    }
+}
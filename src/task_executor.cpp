@@ -0,0 +1,219 @@
+#include "includes/task_executor.h"
+
+namespace
+{
+    // Chunks per thread taking part, so threads that finish early can even out slower ones
+    const size_t CHUNKS_PER_THREAD = 4;
+
+    /**
+     * The executor whose worker is running on this thread, and that worker's queue
+     */
+    struct CurrentWorker
+    {
+        const TaskExecutor *executor;
+        size_t queue;
+    };
+
+    thread_local CurrentWorker current_worker = {nullptr, 0};
+}
+
+TaskExecutor::TaskExecutor(size_t thread_count) : next_queue(0), queued(0), stopping(false)
+{
+    if (thread_count == 0)
+    {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t index = 0; index < thread_count; index++)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t index = 0; index < thread_count; index++)
+    {
+        threads.emplace_back(&TaskExecutor::work, this, index);
+    }
+}
+
+TaskExecutor::~TaskExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+std::shared_ptr<TaskExecutor> TaskExecutor::get_shared()
+{
+    static std::shared_ptr<TaskExecutor> shared = std::make_shared<TaskExecutor>();
+    return shared;
+}
+
+size_t TaskExecutor::get_thread_count() const
+{
+    return threads.size();
+}
+
+void TaskExecutor::submit(std::function<void()> task)
+{
+    size_t index = current_worker.executor == this ? current_worker.queue : next_queue++ % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Counted under the sleep lock, so a worker deciding to sleep cannot miss it
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        queued++;
+    }
+    wake.notify_one();
+}
+
+bool TaskExecutor::take_task(size_t home, std::function<void()> &task)
+{
+    {
+        std::lock_guard<std::mutex> lock(queues[home]->mutex);
+        if (!queues[home]->tasks.empty())
+        {
+            task = std::move(queues[home]->tasks.back());
+            queues[home]->tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < queues.size(); offset++)
+    {
+        Queue &victim = *queues[(home + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TaskExecutor::run_one()
+{
+    std::function<void()> task;
+    size_t home = current_worker.executor == this ? current_worker.queue : next_queue++ % queues.size();
+    if (!take_task(home, task))
+    {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void TaskExecutor::work(size_t index)
+{
+    current_worker = {this, index};
+    for (;;)
+    {
+        std::function<void()> task;
+        if (take_task(index, task))
+        {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [this]
+                  { return stopping || queued > 0; });
+        if (stopping && queued <= 0)
+        {
+            return;
+        }
+    }
+}
+
+size_t TaskExecutor::chunk_count(size_t size, size_t grain) const
+{
+    if (size <= std::max<size_t>(grain, 1))
+    {
+        return 1;
+    }
+    // The caller works too, but threads beyond the cores only take turns
+    size_t parallelism = std::min<size_t>(threads.size() + 1, std::max(1u, std::thread::hardware_concurrency()));
+    if (parallelism == 1)
+    {
+        return 1;
+    }
+    size_t chunks = (size + grain - 1) / grain;
+    return std::min(chunks, CHUNKS_PER_THREAD * parallelism);
+}
+
+void TaskExecutor::run_chunks(size_t count, const std::function<void(size_t)> &run)
+{
+    if (count <= 1)
+    {
+        if (count == 1)
+        {
+            run(0);
+        }
+        return;
+    }
+
+    // Chunks are claimed from a counter rather than handed out, so whichever threads get there
+    // first share them. Helpers starting after the last chunk is claimed find nothing left and
+    // never touch run, so the state outlives this call but run need not.
+    struct Progress
+    {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::exception_ptr failure;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto progress = std::make_shared<Progress>();
+    const std::function<void(size_t)> *chunk_runner = &run;
+
+    auto claim_chunks = [progress, chunk_runner, count]()
+    {
+        size_t chunk;
+        while ((chunk = progress->next++) < count)
+        {
+            try
+            {
+                (*chunk_runner)(chunk);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(progress->mutex);
+                if (!progress->failure)
+                {
+                    progress->failure = std::current_exception();
+                }
+            }
+            if (++progress->done == count)
+            {
+                std::lock_guard<std::mutex> lock(progress->mutex);
+                progress->finished.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(count - 1, threads.size());
+    for (size_t i = 0; i < helpers; i++)
+    {
+        submit(claim_chunks);
+    }
+    claim_chunks();
+
+    // Every chunk is claimed by now, and each is running on a thread that will finish it
+    std::unique_lock<std::mutex> lock(progress->mutex);
+    progress->finished.wait(lock, [&progress, count]
+                            { return progress->done == count; });
+    if (progress->failure)
+    {
+        std::rethrow_exception(progress->failure);
+    }
+}
@@ -0,0 +1,248 @@
+#include "includes/text_fold.h"
+
+namespace
+{
+    // Base letters for U+0100..U+017F (Latin Extended-A); '*' marks ligatures
+    // that expand to two letters and are handled separately
+    const char LATIN_EXTENDED_A_BASE[] =
+        "aaaaaaccccccccdd"
+        "ddeeeeeeeeeegggg"
+        "gggghhhhiiiiiiii"
+        "ii**jjkkklllllll"
+        "lllnnnnnnnnnoooo"
+        "oo**rrrrrrssssss"
+        "ssttttttuuuuuuuu"
+        "uuuuwwyyyzzzzzzs";
+
+    // Base letters for U+00E0..U+00FF; '*' marks characters handled separately
+    const char LATIN_1_LOWER_BASE[] =
+        "aaaaaa*ceeeeiiii"
+        "dnooooo*ouuuuy*y";
+
+    void append_utf8(std::string &out, unsigned int code_point)
+    {
+        if (code_point < 0x80)
+        {
+            out += static_cast<char>(code_point);
+        }
+        else if (code_point < 0x800)
+        {
+            out += static_cast<char>(0xC0 | (code_point >> 6));
+            out += static_cast<char>(0x80 | (code_point & 0x3F));
+        }
+        else if (code_point < 0x10000)
+        {
+            out += static_cast<char>(0xE0 | (code_point >> 12));
+            out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code_point & 0x3F));
+        }
+        else
+        {
+            out += static_cast<char>(0xF0 | (code_point >> 18));
+            out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code_point & 0x3F));
+        }
+    }
+
+    /**
+     * Decode one UTF-8 sequence starting at pos. Returns the number of bytes
+     * consumed, or 0 if the bytes at pos are not a valid sequence.
+     */
+    size_t decode_utf8(const std::string &text, size_t pos, unsigned int &code_point)
+    {
+        unsigned char lead = static_cast<unsigned char>(text[pos]);
+        size_t length;
+        unsigned int min_value;
+
+        if (lead < 0x80)
+        {
+            code_point = lead;
+            return 1;
+        }
+        else if ((lead & 0xE0) == 0xC0)
+        {
+            length = 2;
+            min_value = 0x80;
+            code_point = lead & 0x1F;
+        }
+        else if ((lead & 0xF0) == 0xE0)
+        {
+            length = 3;
+            min_value = 0x800;
+            code_point = lead & 0x0F;
+        }
+        else if ((lead & 0xF8) == 0xF0)
+        {
+            length = 4;
+            min_value = 0x10000;
+            code_point = lead & 0x07;
+        }
+        else
+        {
+            return 0;
+        }
+
+        if (pos + length > text.size())
+        {
+            return 0;
+        }
+
+        for (size_t i = 1; i < length; i++)
+        {
+            unsigned char c = static_cast<unsigned char>(text[pos + i]);
+            if ((c & 0xC0) != 0x80)
+            {
+                return 0;
+            }
+            code_point = (code_point << 6) | (c & 0x3F);
+        }
+
+        if (code_point < min_value || code_point > 0x10FFFF)
+        {
+            return 0;
+        }
+        return length;
+    }
+
+    bool is_space(unsigned int code_point)
+    {
+        return code_point == ' ' || code_point == '\t' || code_point == '\n' ||
+               code_point == '\r' || code_point == '\f' || code_point == '\v' ||
+               code_point == 0xA0 || code_point == 0x3000;
+    }
+
+    /**
+     * Append the folded form of a single code point.
+     */
+    void append_folded(std::string &out, unsigned int c)
+    {
+        // Fullwidth ASCII variants fold to their ASCII equivalents
+        if (c >= 0xFF01 && c <= 0xFF5E)
+        {
+            c -= 0xFEE0;
+        }
+
+        if (c < 0x80)
+        {
+            if (c >= 'A' && c <= 'Z')
+            {
+                c += 'a' - 'A';
+            }
+            out += static_cast<char>(c);
+        }
+        else if (c >= 0xC0 && c <= 0xFF && c != 0xD7 && c != 0xF7)
+        {
+            // Latin-1 letters: lowercase, then strip the diacritic
+            if (c == 0xDF)
+            {
+                out += "ss";
+                return;
+            }
+            if (c <= 0xDE)
+            {
+                c += 0x20;
+            }
+
+            char base = LATIN_1_LOWER_BASE[c - 0xE0];
+            if (base != '*')
+            {
+                out += base;
+            }
+            else if (c == 0xE6)
+            {
+                out += "ae";
+            }
+            else if (c == 0xFE)
+            {
+                out += "th";
+            }
+        }
+        else if (c >= 0x100 && c <= 0x17F)
+        {
+            char base = LATIN_EXTENDED_A_BASE[c - 0x100];
+            if (base != '*')
+            {
+                out += base;
+            }
+            else if (c == 0x132 || c == 0x133)
+            {
+                out += "ij";
+            }
+            else
+            {
+                out += "oe";
+            }
+        }
+        else if (c >= 0x300 && c <= 0x36F)
+        {
+            // Combining diacritical marks are dropped
+        }
+        else if ((c >= 0x391 && c <= 0x3A9 && c != 0x3A2))
+        {
+            append_utf8(out, c + 0x20);
+        }
+        else if (c == 0x3C2)
+        {
+            // Final sigma folds to the medial form
+            append_utf8(out, 0x3C3);
+        }
+        else if (c >= 0x400 && c <= 0x40F)
+        {
+            append_utf8(out, c + 0x50);
+        }
+        else if (c >= 0x410 && c <= 0x42F)
+        {
+            append_utf8(out, c + 0x20);
+        }
+        else
+        {
+            append_utf8(out, c);
+        }
+    }
+}
+
+std::string fold_text(const std::string &text)
+{
+    std::string folded;
+    folded.reserve(text.size());
+
+    bool pending_space = false;
+    size_t pos = 0;
+
+    while (pos < text.size())
+    {
+        unsigned int code_point = 0;
+        size_t length = decode_utf8(text, pos, code_point);
+
+        if (length == 0)
+        {
+            // Not valid UTF-8: keep the raw byte so matching still works
+            if (pending_space)
+            {
+                folded += ' ';
+                pending_space = false;
+            }
+            folded += text[pos];
+            pos++;
+            continue;
+        }
+        pos += length;
+
+        if (is_space(code_point))
+        {
+            // Collapse runs of whitespace and drop leading whitespace
+            pending_space = !folded.empty();
+            continue;
+        }
+
+        if (pending_space)
+        {
+            folded += ' ';
+            pending_space = false;
+        }
+        append_folded(folded, code_point);
+    }
+
+    return folded;
+}
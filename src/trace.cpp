@@ -0,0 +1,449 @@
+#include "includes/trace.h"
+#include <algorithm>
+#include <climits>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+const unsigned Tracing::MAX_SITES;
+
+namespace
+{
+    // Values below LINEAR_LIMIT get a bucket each; above it every power of
+    // two is split into SUB_BUCKETS equal buckets
+    const unsigned SUB_BUCKETS = 16;
+    const unsigned LINEAR_LIMIT = 2 * SUB_BUCKETS;
+    const unsigned BUCKET_COUNT = LINEAR_LIMIT + (64 - 5) * SUB_BUCKETS;
+
+    unsigned highest_bit(uint64_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - __builtin_clzll(value);
+#else
+        unsigned bit = 0;
+        while (value >>= 1)
+        {
+            bit++;
+        }
+        return bit;
+#endif
+    }
+
+    unsigned bucket_of(uint64_t value)
+    {
+        if (value < LINEAR_LIMIT)
+        {
+            return static_cast<unsigned>(value);
+        }
+        unsigned shift = highest_bit(value) - 4;
+        return LINEAR_LIMIT + (shift - 1) * SUB_BUCKETS + static_cast<unsigned>((value >> shift) - SUB_BUCKETS);
+    }
+
+    uint64_t bucket_upper_bound(unsigned bucket)
+    {
+        if (bucket < LINEAR_LIMIT)
+        {
+            return bucket;
+        }
+        unsigned offset = bucket - LINEAR_LIMIT;
+        unsigned shift = offset / SUB_BUCKETS + 1;
+        uint64_t sub_bucket = offset % SUB_BUCKETS + SUB_BUCKETS;
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+    // Only the owning thread writes a histogram, so a relaxed load and store
+    // is enough and avoids a locked instruction
+    void add_relaxed(std::atomic<uint64_t> &counter, uint64_t amount)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Durations recorded by one thread at one call site
+     */
+    struct Histogram
+    {
+        std::atomic<uint64_t> buckets[BUCKET_COUNT];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> total_ns;
+        std::atomic<uint64_t> min_ns;
+        std::atomic<uint64_t> max_ns;
+        std::atomic<uint64_t> allocations;
+        std::atomic<uint64_t> allocated_bytes;
+
+        Histogram()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            for (auto &bucket : buckets)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            count.store(0, std::memory_order_relaxed);
+            total_ns.store(0, std::memory_order_relaxed);
+            min_ns.store(UINT64_MAX, std::memory_order_relaxed);
+            max_ns.store(0, std::memory_order_relaxed);
+            allocations.store(0, std::memory_order_relaxed);
+            allocated_bytes.store(0, std::memory_order_relaxed);
+        }
+
+        void record(uint64_t duration_ns, const AllocationCounts &scope_allocations)
+        {
+            add_relaxed(allocations, scope_allocations.allocations);
+            add_relaxed(allocated_bytes, scope_allocations.allocated_bytes);
+            add_relaxed(buckets[bucket_of(duration_ns)], 1);
+            add_relaxed(count, 1);
+            add_relaxed(total_ns, duration_ns);
+            if (duration_ns < min_ns.load(std::memory_order_relaxed))
+            {
+                min_ns.store(duration_ns, std::memory_order_relaxed);
+            }
+            if (duration_ns > max_ns.load(std::memory_order_relaxed))
+            {
+                max_ns.store(duration_ns, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    /**
+     * @brief One captured scope, for Chrome traces
+     */
+    struct TraceEvent
+    {
+        std::atomic<uint64_t> site;
+        std::atomic<uint64_t> start_ns;
+        std::atomic<uint64_t> duration_ns;
+    };
+
+    /**
+     * @brief Everything one thread records; reused by a later thread once its owner exits
+     */
+    struct ThreadTrace
+    {
+        unsigned thread_number;
+        std::atomic<bool> in_use;
+        std::atomic<Histogram *> histograms[Tracing::MAX_SITES];
+        std::atomic<TraceEvent *> events; // Ring of EVENTS_PER_THREAD, allocated on first capture
+        std::atomic<uint64_t> event_count;
+
+        explicit ThreadTrace(unsigned thread_number) : thread_number(thread_number), in_use(true), events(nullptr), event_count(0)
+        {
+            for (auto &histogram : histograms)
+            {
+                histogram.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        ~ThreadTrace()
+        {
+            for (auto &histogram : histograms)
+            {
+                delete histogram.load();
+            }
+            delete[] events.load();
+        }
+    };
+
+    std::atomic<const char *> site_names[Tracing::MAX_SITES];
+    std::atomic<unsigned> site_count(0);
+    std::atomic<bool> capture_events(false);
+
+    std::mutex &registry_mutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::vector<std::unique_ptr<ThreadTrace>> &thread_traces()
+    {
+        static std::vector<std::unique_ptr<ThreadTrace>> traces;
+        return traces;
+    }
+
+    /**
+     * @brief Releases the calling thread's ThreadTrace for reuse when the thread exits
+     */
+    struct ThreadTraceHandle
+    {
+        ThreadTrace *trace = nullptr;
+
+        ~ThreadTraceHandle()
+        {
+            if (trace)
+            {
+                trace->in_use.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    ThreadTrace &current_thread_trace()
+    {
+        thread_local ThreadTraceHandle handle;
+        if (!handle.trace)
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            for (auto &trace : thread_traces())
+            {
+                if (!trace->in_use.load(std::memory_order_acquire))
+                {
+                    trace->in_use.store(true, std::memory_order_relaxed);
+                    handle.trace = trace.get();
+                    break;
+                }
+            }
+            if (!handle.trace)
+            {
+                thread_traces().emplace_back(new ThreadTrace(static_cast<unsigned>(thread_traces().size()) + 1));
+                handle.trace = thread_traces().back().get();
+            }
+        }
+        return *handle.trace;
+    }
+
+    unsigned registered_sites()
+    {
+        return std::min(site_count.load(std::memory_order_acquire), Tracing::MAX_SITES);
+    }
+
+    void write_json_string(std::ostream &out, const char *text)
+    {
+        out << '"';
+        for (const char *c = text; *c; c++)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                out << '\\';
+            }
+            out << *c;
+        }
+        out << '"';
+    }
+}
+
+std::atomic<bool> Tracing::enabled(false);
+
+TraceSite::TraceSite(const char *name)
+{
+    index = site_count.fetch_add(1, std::memory_order_relaxed);
+    if (index < Tracing::MAX_SITES)
+    {
+        site_names[index].store(name, std::memory_order_release);
+    }
+    else
+    {
+        index = Tracing::MAX_SITES;
+    }
+}
+
+unsigned TraceSite::get_index() const
+{
+    return index;
+}
+
+void Tracing::set_enabled(bool on)
+{
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+bool Tracing::is_enabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void Tracing::set_capture_events(bool capture)
+{
+    capture_events.store(capture, std::memory_order_relaxed);
+}
+
+void Tracing::record(const TraceSite &site, uint64_t start_ns, uint64_t duration_ns,
+                     const AllocationCounts &allocations)
+{
+    unsigned index = site.get_index();
+    if (index >= MAX_SITES)
+    {
+        return;
+    }
+
+    ThreadTrace &trace = current_thread_trace();
+    Histogram *histogram = trace.histograms[index].load(std::memory_order_relaxed);
+    if (!histogram)
+    {
+        histogram = new Histogram();
+        trace.histograms[index].store(histogram, std::memory_order_release);
+    }
+    histogram->record(duration_ns, allocations);
+
+    if (capture_events.load(std::memory_order_relaxed))
+    {
+        TraceEvent *events = trace.events.load(std::memory_order_relaxed);
+        if (!events)
+        {
+            events = new TraceEvent[EVENTS_PER_THREAD]();
+            trace.events.store(events, std::memory_order_release);
+        }
+
+        uint64_t count = trace.event_count.load(std::memory_order_relaxed);
+        TraceEvent &event = events[count % EVENTS_PER_THREAD];
+        event.site.store(index, std::memory_order_relaxed);
+        event.start_ns.store(start_ns, std::memory_order_relaxed);
+        event.duration_ns.store(duration_ns, std::memory_order_relaxed);
+        trace.event_count.store(count + 1, std::memory_order_release);
+    }
+}
+
+void Tracing::reset()
+{
+    // Samples recorded while this runs may survive the reset
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    for (auto &trace : thread_traces())
+    {
+        for (auto &slot : trace->histograms)
+        {
+            Histogram *histogram = slot.load(std::memory_order_acquire);
+            if (histogram)
+            {
+                histogram->clear();
+            }
+        }
+        trace->event_count.store(0, std::memory_order_release);
+    }
+}
+
+std::vector<TraceStats> Tracing::get_stats()
+{
+    std::vector<TraceStats> result;
+    std::vector<uint64_t> merged(BUCKET_COUNT);
+
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    for (unsigned site = 0; site < registered_sites(); site++)
+    {
+        const char *name = site_names[site].load(std::memory_order_acquire);
+        if (!name)
+        {
+            continue;
+        }
+
+        TraceStats stats = {name, 0, 0, UINT64_MAX, 0, 0, 0, 0, 0, 0, 0};
+        std::fill(merged.begin(), merged.end(), 0);
+        for (auto &trace : thread_traces())
+        {
+            Histogram *histogram = trace->histograms[site].load(std::memory_order_acquire);
+            if (!histogram)
+            {
+                continue;
+            }
+            for (unsigned b = 0; b < BUCKET_COUNT; b++)
+            {
+                merged[b] += histogram->buckets[b].load(std::memory_order_relaxed);
+            }
+            stats.count += histogram->count.load(std::memory_order_relaxed);
+            stats.total_ns += histogram->total_ns.load(std::memory_order_relaxed);
+            stats.min_ns = std::min(stats.min_ns, histogram->min_ns.load(std::memory_order_relaxed));
+            stats.max_ns = std::max(stats.max_ns, histogram->max_ns.load(std::memory_order_relaxed));
+            stats.allocations += histogram->allocations.load(std::memory_order_relaxed);
+            stats.allocated_bytes += histogram->allocated_bytes.load(std::memory_order_relaxed);
+        }
+
+        if (stats.count == 0)
+        {
+            continue;
+        }
+
+        // Percentiles report the upper bound of the bucket holding that rank
+        const double fractions[] = {0.50, 0.90, 0.99, 0.999};
+        uint64_t *targets[] = {&stats.p50_ns, &stats.p90_ns, &stats.p99_ns, &stats.p999_ns};
+        uint64_t bucket_total = 0;
+        for (uint64_t count : merged)
+        {
+            bucket_total += count;
+        }
+        for (int p = 0; p < 4; p++)
+        {
+            uint64_t rank = static_cast<uint64_t>(fractions[p] * bucket_total);
+            uint64_t seen = 0;
+            for (unsigned b = 0; b < BUCKET_COUNT; b++)
+            {
+                seen += merged[b];
+                if (seen > rank)
+                {
+                    *targets[p] = std::min(bucket_upper_bound(b), stats.max_ns);
+                    break;
+                }
+            }
+        }
+        result.push_back(stats);
+    }
+
+    std::sort(result.begin(), result.end(), [](const TraceStats &a, const TraceStats &b)
+              { return a.total_ns > b.total_ns; });
+    return result;
+}
+
+void Tracing::write_json(std::ostream &out)
+{
+    std::vector<TraceStats> stats = get_stats();
+
+    out << "[";
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        const TraceStats &site = stats[i];
+        out << (i == 0 ? "\n  {" : ",\n  {") << "\"name\": ";
+        write_json_string(out, site.name.c_str());
+        out << ", \"count\": " << site.count << ", \"total_ns\": " << site.total_ns
+            << ", \"mean_ns\": " << site.total_ns / site.count << ", \"min_ns\": " << site.min_ns
+            << ", \"max_ns\": " << site.max_ns << ", \"p50_ns\": " << site.p50_ns << ", \"p90_ns\": " << site.p90_ns
+            << ", \"p99_ns\": " << site.p99_ns << ", \"p999_ns\": " << site.p999_ns
+            << ", \"allocations\": " << site.allocations << ", \"allocated_bytes\": " << site.allocated_bytes << "}";
+    }
+    out << "\n]\n";
+}
+
+void Tracing::write_chrome_trace(std::ostream &out)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex());
+
+    // Timestamps are written relative to the earliest event kept
+    uint64_t base_ns = UINT64_MAX;
+    for (auto &trace : thread_traces())
+    {
+        TraceEvent *events = trace->events.load(std::memory_order_acquire);
+        uint64_t count = trace->event_count.load(std::memory_order_acquire);
+        uint64_t first = count > EVENTS_PER_THREAD ? count - EVENTS_PER_THREAD : 0;
+        for (uint64_t e = first; events && e < count; e++)
+        {
+            base_ns = std::min(base_ns, events[e % EVENTS_PER_THREAD].start_ns.load(std::memory_order_relaxed));
+        }
+    }
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    bool first_event = true;
+    for (auto &trace : thread_traces())
+    {
+        TraceEvent *events = trace->events.load(std::memory_order_acquire);
+        uint64_t count = trace->event_count.load(std::memory_order_acquire);
+        uint64_t first = count > EVENTS_PER_THREAD ? count - EVENTS_PER_THREAD : 0;
+        for (uint64_t e = first; events && e < count; e++)
+        {
+            const TraceEvent &event = events[e % EVENTS_PER_THREAD];
+            const char *name = site_names[event.site.load(std::memory_order_relaxed)].load(std::memory_order_acquire);
+
+            out << (first_event ? "\n" : ",\n") << "{\"name\": ";
+            write_json_string(out, name ? name : "?");
+            out << ", \"cat\": \"inventory\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << trace->thread_number
+                << ", \"ts\": " << (event.start_ns.load(std::memory_order_relaxed) - base_ns) / 1000.0
+                << ", \"dur\": " << event.duration_ns.load(std::memory_order_relaxed) / 1000.0 << "}";
+            first_event = false;
+        }
+    }
+    out << "\n]}\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,113 @@
+#include "includes/inventory_manager.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool passed, const std::string &what)
+    {
+        if (!passed)
+        {
+            std::cerr << "FAILED: " << what << "\n";
+            failures++;
+        }
+    }
+
+    /**
+     * @brief Check that the products are in ascending ID order and each is found by its ID
+     * @param manager The inventory
+     * @param what Describes the step, for the failure message
+     */
+    void check_ids(const InventoryManager &manager, const std::string &what)
+    {
+        const std::vector<Product> &products = manager.get_all_products();
+        for (size_t i = 0; i < products.size(); i++)
+        {
+            check(i == 0 || products[i - 1].get_id() < products[i].get_id(), what + ": IDs ascending");
+            check(manager.get_product_by_id(products[i].get_id()).get_name() == products[i].get_name(),
+                  what + ": product found by its ID");
+        }
+    }
+
+    /**
+     * @brief Fill an inventory with IDs 1 to 10 and history enabled, then load a one-row file over it
+     * @param manager Receives the inventory
+     */
+    void load_over_ten_products(InventoryManager &manager)
+    {
+        manager.set_history_enabled(true);
+        for (int i = 1; i <= 10; i++)
+        {
+            manager.add_product(Product(0, "Part " + std::to_string(i), "Hardware", 100, 5));
+        }
+
+        const std::string path = (fs::temp_directory_path() / "inventory_history_test.csv").string();
+        {
+            std::ofstream file(path);
+            file << "ID,Name,Category,Price,Quantity,Description,SKU,Total Value\n"
+                 << "1,\"Loaded\",\"Hardware\",1.00,5,\"\",\"\",5.00\n";
+        }
+        manager.load_from_file(path);
+        fs::remove(path);
+    }
+
+    void test_add_after_undoing_load()
+    {
+        InventoryManager manager;
+        load_over_ten_products(manager);
+        check(manager.undo(), "load can be undone");
+        check(manager.get_total_product_count() == 10, "undo restores the ten products");
+
+        int id = manager.add_product(Product(0, "Added", "Hardware", 100, 1));
+        check(id == 11, "add after undoing a load takes an ID above the restored ones");
+        check(manager.get_total_product_count() == 11, "add after undoing a load keeps every product");
+        check_ids(manager, "add after undoing a load");
+    }
+
+    void test_add_after_redoing_load()
+    {
+        InventoryManager manager;
+        load_over_ten_products(manager);
+        manager.undo();
+        check(manager.redo(), "undone load can be redone");
+        check(manager.get_total_product_count() == 1, "redo restores the loaded product");
+
+        int id = manager.add_product(Product(0, "Added", "Hardware", 100, 1));
+        check(id > 1, "add after redoing a load takes an unused ID");
+        check(manager.get_total_product_count() == 2, "add after redoing a load keeps every product");
+        check_ids(manager, "add after redoing a load");
+
+        // Undoing the add and the redo brings back IDs 1 to 10, which the next add must not reuse
+        manager.undo();
+        manager.undo();
+        id = manager.add_product(Product(0, "Added again", "Hardware", 100, 1));
+        check(id > 10, "add after undoing past a redo takes an ID above the restored ones");
+        check_ids(manager, "add after undoing past a redo");
+    }
+}
+
+int main()
+{
+    try
+    {
+        test_add_after_undoing_load();
+        test_add_after_redoing_load();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "FAILED: " << e.what() << "\n";
+        failures++;
+    }
+
+    if (failures > 0)
+    {
+        return 1;
+    }
+    std::cout << "history_test: all passed\n";
+    return 0;
+}
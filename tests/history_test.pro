@@ -0,0 +1,12 @@
+# history_test.pro
+QT -= core gui
+
+TARGET = history_test
+TEMPLATE = app
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+include(../core/core.pri)
+
+SOURCES += history_test.cpp
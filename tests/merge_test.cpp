@@ -0,0 +1,190 @@
+#include "includes/inventory_manager.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char *const HEADER = "ID,Name,Category,Price,Quantity,Description,SKU,Total Value,Action\n";
+
+    int failures = 0;
+
+    void check(bool passed, const std::string &what)
+    {
+        if (!passed)
+        {
+            std::cerr << "FAILED: " << what << "\n";
+            failures++;
+        }
+    }
+
+    /**
+     * @brief Merge CSV rows into an inventory
+     * @param rows The rows after the header
+     * @param manager The inventory to merge into
+     * @return The merge report
+     */
+    MergeReport merge_into(const std::string &rows, InventoryManager &manager)
+    {
+        const std::string path = (fs::temp_directory_path() / "inventory_merge_test.csv").string();
+        {
+            std::ofstream file(path);
+            file << HEADER << rows;
+        }
+        MergeReport report = manager.merge_from_file(path);
+        fs::remove(path);
+        return report;
+    }
+
+    /**
+     * @brief Merge CSV rows into an inventory of two products, IDs 1 and 2
+     * @param rows The rows after the header
+     * @param manager Receives the merged inventory
+     * @return The merge report
+     */
+    MergeReport merge_rows(const std::string &rows, InventoryManager &manager)
+    {
+        manager.add_product(Product(0, "Bolt", "Hardware", 150, 10));
+        manager.add_product(Product(0, "Nut", "Hardware", 20, 40));
+        return merge_into(rows, manager);
+    }
+
+    /**
+     * @brief Fill an inventory with two products, IDs 1 and 2, with SKUs B1 and N2
+     * @param manager Receives the products
+     */
+    void add_products_with_skus(InventoryManager &manager)
+    {
+        manager.add_product(Product(0, "Bolt", "Hardware", 150, 10, "", "B1"));
+        manager.add_product(Product(0, "Nut", "Hardware", 20, 40, "", "N2"));
+    }
+
+    void test_upsert_after_delete_keeps_product()
+    {
+        InventoryManager manager;
+        MergeReport report = merge_rows("1,,,,,,,,delete\n"
+                                        "1,\"Bolt\",\"Hardware\",2.00,12,\"\",\"\",24.00,\n",
+                                        manager);
+        check(manager.get_total_product_count() == 2, "upsert after delete keeps the product");
+        check(manager.get_product_by_id(1).get_quantity() == 12, "upsert after delete applies the later row");
+        check(report.deleted == 0 && report.updated == 1, "upsert after delete is reported as an update");
+    }
+
+    void test_unchanged_upsert_after_delete_keeps_product()
+    {
+        InventoryManager manager;
+        MergeReport report = merge_rows("2,,,,,,,,delete\n"
+                                        "2,\"Nut\",\"Hardware\",0.20,40,\"\",\"\",8.00,\n",
+                                        manager);
+        check(manager.get_total_product_count() == 2, "unchanged upsert after delete keeps the product");
+        check(report.deleted == 0 && report.unchanged == 1, "unchanged upsert after delete is reported as unchanged");
+    }
+
+    void test_delete_after_upsert_removes_product()
+    {
+        InventoryManager manager;
+        MergeReport report = merge_rows("1,\"Bolt\",\"Hardware\",2.00,12,\"\",\"\",24.00,\n"
+                                        "1,,,,,,,,delete\n",
+                                        manager);
+        check(manager.get_total_product_count() == 1, "delete after upsert removes the product");
+        check(report.deleted == 1, "delete after upsert is reported as a deletion");
+    }
+
+    void test_delete_upsert_delete_removes_product()
+    {
+        InventoryManager manager;
+        MergeReport report = merge_rows("1,,,,,,,,delete\n"
+                                        "1,\"Bolt\",\"Hardware\",2.00,12,\"\",\"\",24.00,\n"
+                                        "1,,,,,,,,delete\n",
+                                        manager);
+        check(manager.get_total_product_count() == 1, "delete, upsert, delete removes the product");
+        check(report.deleted == 1, "delete, upsert, delete counts one deletion");
+    }
+
+    void test_insert_after_delete_of_new_id_keeps_product()
+    {
+        InventoryManager manager;
+        MergeReport report = merge_rows("7,\"Washer\",\"Hardware\",0.05,100,\"\",\"\",5.00,\n"
+                                        "7,,,,,,,,delete\n"
+                                        "7,\"Washer\",\"Hardware\",0.05,90,\"\",\"\",4.50,\n",
+                                        manager);
+        check(manager.get_total_product_count() == 3, "insert after deleting a new ID keeps the product");
+        check(manager.get_product_by_id(7).get_quantity() == 90, "insert after deleting a new ID applies the later row");
+        check(report.inserted == 1, "insert after deleting a new ID counts one insert");
+    }
+
+    void test_update_to_taken_sku_is_skipped()
+    {
+        InventoryManager manager;
+        add_products_with_skus(manager);
+        MergeReport report = merge_into("2,\"Nut\",\"Hardware\",0.20,40,\"\",\"B1\",8.00,\n", manager);
+        check(report.skipped == 1 && report.updated == 0, "update to a taken SKU is skipped");
+        check(manager.get_product_by_id(2).get_sku() == "N2", "update to a taken SKU leaves the product as it was");
+        check(manager.get_product_by_sku("B1").get_id() == 1, "update to a taken SKU leaves the SKU with its owner");
+    }
+
+    void test_insert_with_taken_sku_is_skipped()
+    {
+        InventoryManager manager;
+        add_products_with_skus(manager);
+        MergeReport report = merge_into("7,\"Washer\",\"Hardware\",0.05,100,\"\",\"N2\",5.00,\n"
+                                        "0,\"Screw\",\"Hardware\",0.05,100,\"\",\"B1\",5.00,\n",
+                                        manager);
+        check(report.skipped == 2 && report.inserted == 0, "inserts with taken SKUs are skipped");
+        check(manager.get_total_product_count() == 2, "inserts with taken SKUs add nothing");
+    }
+
+    void test_inserts_sharing_a_sku_keep_the_first()
+    {
+        InventoryManager manager;
+        add_products_with_skus(manager);
+        MergeReport report = merge_into("7,\"Washer\",\"Hardware\",0.05,100,\"\",\"W7\",5.00,\n"
+                                        "8,\"Spacer\",\"Hardware\",0.05,100,\"\",\"W7\",5.00,\n"
+                                        "7,\"Washer\",\"Hardware\",0.05,90,\"\",\"W7\",4.50,\n",
+                                        manager);
+        check(report.inserted == 1 && report.skipped == 1, "second insert with the same SKU is skipped");
+        check(manager.get_product_by_sku("W7").get_id() == 7, "first insert keeps its SKU");
+        check(manager.get_product_by_id(7).get_quantity() == 90, "repeated row for the same insert keeps its SKU");
+    }
+
+    void test_sku_moved_within_file_is_free()
+    {
+        InventoryManager manager;
+        add_products_with_skus(manager);
+        MergeReport report = merge_into("1,\"Bolt\",\"Hardware\",1.50,10,\"\",\"B9\",15.00,\n"
+                                        "2,\"Nut\",\"Hardware\",0.20,40,\"\",\"B1\",8.00,\n",
+                                        manager);
+        check(report.updated == 2 && report.skipped == 0, "SKU given up by an earlier row can be taken");
+        check(manager.get_product_by_sku("B1").get_id() == 2, "SKU moves to the later row's product");
+    }
+}
+
+int main()
+{
+    try
+    {
+        test_upsert_after_delete_keeps_product();
+        test_unchanged_upsert_after_delete_keeps_product();
+        test_delete_after_upsert_removes_product();
+        test_delete_upsert_delete_removes_product();
+        test_insert_after_delete_of_new_id_keeps_product();
+        test_update_to_taken_sku_is_skipped();
+        test_insert_with_taken_sku_is_skipped();
+        test_inserts_sharing_a_sku_keep_the_first();
+        test_sku_moved_within_file_is_free();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "FAILED: " << e.what() << "\n";
+        failures++;
+    }
+
+    if (failures > 0)
+    {
+        return 1;
+    }
+    std::cout << "merge_test: all passed\n";
+    return 0;
+}
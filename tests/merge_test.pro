@@ -0,0 +1,12 @@
+# merge_test.pro
+QT -= core gui
+
+TARGET = merge_test
+TEMPLATE = app
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+include(../core/core.pri)
+
+SOURCES += merge_test.cpp
@@ -0,0 +1,7 @@
+# tests.pro
+TEMPLATE = subdirs
+
+# Each test is a console program that exits non-zero on failure
+# merge_test:   merge_from_file row ordering and SKU collisions
+# history_test: product IDs handed out after undo and redo
+SUBDIRS += merge_test.pro history_test.pro